@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2026 Adiscon GmbH
+ * Rainer Gerhards <rgerhards@adiscon.com>
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See COPYING for details.
+ *
+ */
+
+/* allocator hooks
+ *
+ * Applications that use jemalloc, tcmalloc or an allocator of their own
+ * (for example one per thread) want the library to use it as well. The
+ * hooks are plain function pointers that are set once at startup, so
+ * calling through them costs next to nothing. calloc() is emulated for
+ * replaced allocators, so that they only need to provide three functions.
+ */
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+
+#include "json.h"
+#include "alloc.h"
+
+void *(*_fjson_malloc_fn)(size_t size) = malloc;
+void *(*_fjson_realloc_fn)(void *ptr, size_t size) = realloc;
+void (*_fjson_free_fn)(void *ptr) = free;
+
+void *
+_fjson_calloc(const size_t nmemb, const size_t size)
+{
+	void *ptr;
+	FJSON_STAT_INC(allocs);
+	if (_fjson_malloc_fn == malloc)
+		return calloc(nmemb, size); /* may know that fresh pages are zero */
+	if (size != 0 && nmemb > SIZE_MAX / size) {
+		errno = ENOMEM;
+		return NULL;
+	}
+	if ((ptr = _fjson_malloc_fn(nmemb * size)) != NULL)
+		memset(ptr, 0, nmemb * size);
+	return ptr;
+}
+
+char *
+_fjson_strdup(const char *const s)
+{
+	const size_t len = strlen(s);
+	char *const d = _fjson_malloc(len + 1);
+	if (d != NULL)
+		memcpy(d, s, len + 1);
+	return d;
+}
+
+void
+fjson_global_set_allocator(void *(*const malloc_fn)(size_t),
+	void *(*const realloc_fn)(void *, size_t),
+	void (*const free_fn)(void *))
+{
+	if (malloc_fn == NULL || realloc_fn == NULL || free_fn == NULL) {
+		_fjson_malloc_fn = malloc;
+		_fjson_realloc_fn = realloc;
+		_fjson_free_fn = free;
+	} else {
+		_fjson_malloc_fn = malloc_fn;
+		_fjson_realloc_fn = realloc_fn;
+		_fjson_free_fn = free_fn;
+	}
+}
@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) 2026 Adiscon GmbH
+ * Rainer Gerhards <rgerhards@adiscon.com>
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See COPYING for details.
+ *
+ */
+
+#ifndef _fj_alloc_h_
+#define _fj_alloc_h_
+
+#include <stddef.h>
+#include "stats.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* All heap memory of the library goes through these, so that it can be
+ * routed to the allocator set via fjson_global_set_allocator(). They
+ * behave like their libc counterparts.
+ */
+
+extern void *(*_fjson_malloc_fn)(size_t size);
+extern void *(*_fjson_realloc_fn)(void *ptr, size_t size);
+extern void (*_fjson_free_fn)(void *ptr);
+
+static inline void *
+_fjson_malloc(const size_t size)
+{
+	FJSON_STAT_INC(allocs);
+	return _fjson_malloc_fn(size);
+}
+
+static inline void *
+_fjson_realloc(void *const ptr, const size_t size)
+{
+	FJSON_STAT_INC(allocs);
+	return _fjson_realloc_fn(ptr, size);
+}
+
+static inline void
+_fjson_free(void *const ptr)
+{
+	if (ptr != NULL) {
+		FJSON_STAT_INC(frees);
+		_fjson_free_fn(ptr);
+	}
+}
+
+extern void *_fjson_calloc(size_t nmemb, size_t size);
+extern char *_fjson_strdup(const char *s);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,195 @@
+/*
+ * Copyright (c) 2026 Adiscon GmbH
+ * Rainer Gerhards <rgerhards@adiscon.com>
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See COPYING for details.
+ *
+ */
+
+/* arena (bump) allocator
+ *
+ * A parsed event usually consists of dozens of small allocations
+ * (nodes, keys, pages, array storage) which are all released together
+ * when the event is done. Doing this via malloc/free is costly,
+ * especially in multi-threaded programs where the malloc arenas
+ * contend. The arena hands out memory from large blocks by simply
+ * advancing a pointer and releases everything in one step. It is NOT
+ * thread-safe; the idea is to have one arena per worker (or tokener).
+ */
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "alloc.h"
+#include "json_object.h"
+#include "arena.h"
+
+#define ARENA_ALIGN(n) (((n) + (sizeof(void*) - 1)) & ~(sizeof(void*) - 1))
+#define BLK_DATA(blk) ((char*)(blk) + sizeof(struct fjson_arena_blk))
+
+static struct fjson_arena_blk *
+arena_new_blk(const size_t size)
+{
+	struct fjson_arena_blk *const blk = _fjson_malloc(sizeof(struct fjson_arena_blk) + size);
+	if (blk == NULL)
+		return NULL;
+	blk->next = NULL;
+	blk->size = size;
+	blk->used = 0;
+	return blk;
+}
+
+void *
+_fjson_arena_alloc(struct fjson_arena *const arena, size_t size)
+{
+	struct fjson_arena_blk *blk = arena->blk;
+	char *p;
+
+	size = ARENA_ALIGN(size);
+	if (blk == NULL || blk->size - blk->used < size) {
+		struct fjson_arena_blk *const nblk =
+			arena_new_blk(size > arena->blksize / 4 ? size : arena->blksize);
+		if (nblk == NULL)
+			return NULL;
+		if (size > arena->blksize / 4 && blk != NULL) {
+			/* large request: give it a block of its own, but keep
+			 * filling the current one with the small stuff.
+			 */
+			nblk->next = blk->next;
+			blk->next = nblk;
+			nblk->used = size;
+			return BLK_DATA(nblk);
+		}
+		nblk->next = blk;
+		arena->blk = blk = nblk;
+	}
+	p = BLK_DATA(blk) + blk->used;
+	blk->used += size;
+	return p;
+}
+
+void *
+_fjson_arena_calloc(struct fjson_arena *const arena, const size_t size)
+{
+	void *const p = _fjson_arena_alloc(arena, size);
+	if (p != NULL)
+		memset(p, 0, size);
+	return p;
+}
+
+/* grows an allocation. If it is the most recent one in the current block
+ * and there is room left, this happens in place. Otherwise new space is
+ * handed out and the old one is lost until the arena is reset.
+ */
+void *
+_fjson_arena_realloc(struct fjson_arena *const arena,
+	void *const ptr,
+	const size_t oldsize,
+	const size_t newsize)
+{
+	struct fjson_arena_blk *const blk = arena->blk;
+	void *p;
+
+	if (ptr == NULL)
+		return _fjson_arena_alloc(arena, newsize);
+	if (newsize <= ARENA_ALIGN(oldsize))
+		return ptr;
+	if (blk != NULL && (char*)ptr + ARENA_ALIGN(oldsize) == BLK_DATA(blk) + blk->used
+	    && blk->size - blk->used >= ARENA_ALIGN(newsize) - ARENA_ALIGN(oldsize)) {
+		blk->used += ARENA_ALIGN(newsize) - ARENA_ALIGN(oldsize);
+		return ptr;
+	}
+	if ((p = _fjson_arena_alloc(arena, newsize)) == NULL)
+		return NULL;
+	memcpy(p, ptr, oldsize);
+	return p;
+}
+
+char *
+_fjson_arena_memdup(struct fjson_arena *const arena, const char *const s, const size_t len)
+{
+	char *const p = _fjson_arena_alloc(arena, len + 1);
+	if (p != NULL) {
+		memcpy(p, s, len);
+		p[len] = '\0';
+	}
+	return p;
+}
+
+char *
+_fjson_arena_strdup(struct fjson_arena *const arena, const char *const s)
+{
+	return _fjson_arena_memdup(arena, s, strlen(s));
+}
+
+int
+_fjson_arena_add_cleanup(struct fjson_arena *const arena, void (*fn)(void *), void *const ptr)
+{
+	struct fjson_arena_cleanup *const c = _fjson_arena_alloc(arena, sizeof(struct fjson_arena_cleanup));
+	if (c == NULL)
+		return -1;
+	c->fn = fn;
+	c->ptr = ptr;
+	c->next = arena->cleanup;
+	arena->cleanup = c;
+	return 0;
+}
+
+static void
+arena_run_cleanup(struct fjson_arena *const arena)
+{
+	struct fjson_arena_cleanup *c;
+	for (c = arena->cleanup ; c != NULL ; c = c->next)
+		c->fn(c->ptr);
+	arena->cleanup = NULL;
+}
+
+
+/* public interface */
+
+struct fjson_arena *
+fjson_arena_new(const size_t blksize)
+{
+	struct fjson_arena *const arena = _fjson_calloc(1, sizeof(struct fjson_arena));
+	if (arena == NULL)
+		return NULL;
+	arena->blksize = (blksize == 0) ? FJSON_ARENA_DFLT_BLKSIZE : ARENA_ALIGN(blksize);
+	return arena;
+}
+
+void
+fjson_arena_reset(struct fjson_arena *const arena)
+{
+	struct fjson_arena_blk *blk, *next;
+	struct fjson_arena_blk *keep = NULL;
+
+	if (arena == NULL)
+		return;
+	arena_run_cleanup(arena);
+	/* we keep one regular block so that the typical "parse, process,
+	 * reset" cycle does not need to malloc at all.
+	 */
+	for (blk = arena->blk ; blk != NULL ; blk = next) {
+		next = blk->next;
+		if (keep == NULL && blk->size == arena->blksize) {
+			keep = blk;
+			keep->next = NULL;
+			keep->used = 0;
+		} else {
+			_fjson_free(blk);
+		}
+	}
+	arena->blk = keep;
+}
+
+void
+fjson_arena_free(struct fjson_arena *const arena)
+{
+	if (arena == NULL)
+		return;
+	fjson_arena_reset(arena);
+	_fjson_free(arena->blk);
+	_fjson_free(arena);
+}
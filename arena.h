@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2026 Adiscon GmbH
+ * Rainer Gerhards <rgerhards@adiscon.com>
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See COPYING for details.
+ *
+ */
+
+#ifndef _fj_arena_h_
+#define _fj_arena_h_
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FJSON_ARENA_DFLT_BLKSIZE 8192
+
+struct fjson_arena_blk {
+	struct fjson_arena_blk *next;
+	size_t size;	/* usable bytes in data[] */
+	size_t used;
+	/* data follows, aligned to sizeof(void*) because the header is */
+};
+
+/* heap objects the arena must release together with its blocks */
+struct fjson_arena_cleanup {
+	struct fjson_arena_cleanup *next;
+	void (*fn)(void *);
+	void *ptr;
+};
+
+struct fjson_arena {
+	struct fjson_arena_blk *blk; /* current block, head of all blocks */
+	size_t blksize;
+	struct fjson_arena_cleanup *cleanup;
+};
+
+/* all of these return NULL on malloc error */
+extern void *_fjson_arena_alloc(struct fjson_arena *arena, size_t size);
+extern void *_fjson_arena_calloc(struct fjson_arena *arena, size_t size);
+extern void *_fjson_arena_realloc(struct fjson_arena *arena, void *ptr,
+	size_t oldsize, size_t newsize);
+extern char *_fjson_arena_memdup(struct fjson_arena *arena, const char *s, size_t len);
+extern char *_fjson_arena_strdup(struct fjson_arena *arena, const char *s);
+/* register a heap object to be freed via fn() on arena reset/free */
+extern int _fjson_arena_add_cleanup(struct fjson_arena *arena, void (*fn)(void *), void *ptr);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -20,19 +20,43 @@
 #endif /* HAVE_STRINGS_H */
 
 #include "arraylist.h"
+#include "alloc.h"
+#include "arena.h"
+#include "pool.h"
 
 struct array_list*
 array_list_new(array_list_free_fn *free_fn)
+{
+	return array_list_new_arena(free_fn, NULL);
+}
+
+struct array_list*
+array_list_new_arena(array_list_free_fn *free_fn, struct fjson_arena *arena)
+{
+	return array_list_new_sized(free_fn, ARRAY_LIST_DEFAULT_SIZE, arena);
+}
+
+struct array_list*
+array_list_new_sized(array_list_free_fn *free_fn, int size, struct fjson_arena *arena)
 {
 	struct array_list *arr;
 
-	arr = (struct array_list*)calloc(1, sizeof(struct array_list));
+	if (arena == NULL)
+		arr = (struct array_list*)_fjson_pool_calloc(sizeof(struct array_list));
+	else
+		arr = (struct array_list*)_fjson_arena_calloc(arena, sizeof(struct array_list));
 	if(!arr) return NULL;
-	arr->size = ARRAY_LIST_DEFAULT_SIZE;
+	arr->size = (size < 1) ? 1 : size;
 	arr->length = 0;
 	arr->free_fn = free_fn;
-	if(!(arr->array = (void**)calloc(sizeof(void*), arr->size))) {
-		free(arr);
+	arr->arena = arena;
+	if (arena == NULL)
+		arr->array = (void**)_fjson_pool_calloc(sizeof(void*) * arr->size);
+	else
+		arr->array = (void**)_fjson_arena_calloc(arena, sizeof(void*) * arr->size);
+	if(!arr->array) {
+		if (arena == NULL)
+			_fjson_pool_free(arr, sizeof(struct array_list));
 		return NULL;
 	}
 	return arr;
@@ -44,8 +68,10 @@ array_list_free(struct array_list *arr)
 	int i;
 	for(i = 0; i < arr->length; i++)
 	if(arr->array[i]) arr->free_fn(arr->array[i]);
-	free(arr->array);
-	free(arr);
+	if (arr->arena != NULL)
+		return; /* memory is released together with the arena */
+	_fjson_pool_free(arr->array, arr->size * sizeof(void*));
+	_fjson_pool_free(arr, sizeof(struct array_list));
 }
 
 void*
@@ -55,20 +81,50 @@ array_list_get_idx(struct array_list *arr, int i)
 	return arr->array[i];
 }
 
-static int array_list_expand_internal(struct array_list *arr, int max)
+/* change the room to new_size elements, which must not be less than length */
+static int array_list_resize(struct array_list *arr, int new_size)
 {
 	void *t;
+
+	if (arr->arena == NULL)
+		t = _fjson_realloc(arr->array, new_size*sizeof(void*));
+	else
+		t = _fjson_arena_realloc(arr->arena, arr->array,
+			arr->size*sizeof(void*), new_size*sizeof(void*));
+	if(!t) return -1;
+	arr->array = (void**)t;
+	if (new_size > arr->size)
+		(void)memset(arr->array + arr->size, 0, (new_size-arr->size)*sizeof(void*));
+	arr->size = new_size;
+	return 0;
+}
+
+static int array_list_expand_internal(struct array_list *arr, int max)
+{
 	int new_size;
 
 	if(max < arr->size) return 0;
 	new_size = arr->size << 1;
 	if (new_size < max)
 		new_size = max;
-	if(!(t = realloc(arr->array, new_size*sizeof(void*)))) return -1;
-	arr->array = (void**)t;
-	(void)memset(arr->array + arr->size, 0, (new_size-arr->size)*sizeof(void*));
-	arr->size = new_size;
-	return 0;
+	return array_list_resize(arr, new_size);
+}
+
+int
+array_list_reserve(struct array_list *arr, int size)
+{
+	if (size <= arr->size)
+		return 0;
+	return array_list_resize(arr, size);
+}
+
+int
+array_list_shrink_to_fit(struct array_list *arr)
+{
+	const int new_size = (arr->length < 1) ? 1 : arr->length;
+	if (arr->arena != NULL || new_size == arr->size)
+		return 0;
+	return array_list_resize(arr, new_size);
 }
 
 int
@@ -87,21 +143,37 @@ array_list_add(struct array_list *arr, void *data)
 	return array_list_put_idx(arr, arr->length, data);
 }
 
+int
+array_list_add_many(struct array_list *arr, void *const *data, int count)
+{
+	if (count < 0)
+		return -1;
+	if (array_list_expand_internal(arr, arr->length + count))
+		return -1;
+	memcpy(arr->array + arr->length, data, count * sizeof(void *));
+	arr->length += count;
+	return 0;
+}
+
 /*
- * Deleting the idx-th element in the array_list.
+ * Deleting count elements starting at idx in the array_list.
  */
-void
-array_list_del_idx(struct array_list *const arr, const int idx)
+int
+array_list_del_idx(struct array_list *const arr, const int idx, const int count)
 {
-	if (idx < 0 || idx >= arr->length) {
-		return;
+	int i;
+	if (idx < 0 || count < 0 || idx > arr->length - count) {
+		return -1;
 	}
-	if(arr->array[idx]) arr->free_fn(arr->array[idx]);
-	if (--arr->length > idx) {
-		memmove(arr->array + idx, arr->array + idx + 1, (arr->length - idx) * sizeof(void *));
+	for (i = idx ; i < idx + count ; ++i) {
+		if(arr->array[i]) arr->free_fn(arr->array[i]);
 	}
-	arr->array[arr->length] = NULL;
-	return;
+	arr->length -= count;
+	if (arr->length > idx) {
+		memmove(arr->array + idx, arr->array + idx + count, (arr->length - idx) * sizeof(void *));
+	}
+	memset(arr->array + arr->length, 0, count * sizeof(void *));
+	return 0;
 }
 
 /* work around wrong compiler message: GCC and clang do
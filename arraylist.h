@@ -18,17 +18,27 @@ extern "C" {
 
 typedef void (array_list_free_fn) (void *data);
 
+struct fjson_arena;
+
 struct array_list
 {
 	void **array;
 	int length;
 	int size;
 	array_list_free_fn *free_fn;
+	struct fjson_arena *arena; /**< if non-NULL, owns this list's memory */
 };
 
 extern struct array_list*
 array_list_new(array_list_free_fn *free_fn);
 
+extern struct array_list*
+array_list_new_arena(array_list_free_fn *free_fn, struct fjson_arena *arena);
+
+/* like array_list_new_arena(), but with room for size elements */
+extern struct array_list*
+array_list_new_sized(array_list_free_fn *free_fn, int size, struct fjson_arena *arena);
+
 extern void
 array_list_free(struct array_list *al);
 
@@ -41,8 +51,22 @@ array_list_put_idx(struct array_list *al, int i, void *data);
 extern int
 array_list_add(struct array_list *al, void *data);
 
-extern void
-array_list_del_idx(struct array_list *const arr, const int idx);
+extern int
+array_list_add_many(struct array_list *al, void *const *data, int count);
+
+/* make sure there is room for size elements in total */
+extern int
+array_list_reserve(struct array_list *al, int size);
+
+/* release unused room; lists in an arena are left as they are */
+extern int
+array_list_shrink_to_fit(struct array_list *al);
+
+/* delete count elements starting at idx. Returns -1 if the range is
+ * not fully inside the list, in which case nothing is deleted.
+ */
+extern int
+array_list_del_idx(struct array_list *const arr, const int idx, const int count);
 
 extern int
 array_list_length(struct array_list *al);
@@ -0,0 +1,828 @@
+/* libfastjson benchmark tool
+ *
+ * Measures the hot paths (parsing, serializing, member lookup) on a set
+ * of generated corpora that resemble what the library sees in practice:
+ * flat syslog-style events, a deeply nested document, one wide object,
+ * number-heavy arrays and strings full of escapes. All corpora are built
+ * from a fixed seed, so runs are comparable across versions and hosts.
+ *
+ * For each case, we report throughput in MB/s of JSON text, the time per
+ * operation and (where the C library permits counting) the number of
+ * heap allocations per operation. The "mt" cases run the same operation
+ * on several threads at once; there, ns/op is wall time divided by the
+ * total number of operations.
+ *
+ * Usage: fjbench [-t seconds] [-j threads] [-l] [filter...]
+ * Only cases whose name contains one of the filters are run.
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See COPYING for details.
+ *
+ */
+#include "config.h"
+
+#include "../json.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef HAVE_PTHREAD_H
+#	include <pthread.h>
+#endif
+
+#define CHK(x) if (!(x)) { \
+	fprintf(stderr, "%s:%d: unexpected result with '%s'\n", \
+		__FILE__, __LINE__, #x); \
+	exit(1); \
+}
+
+
+/* allocation counting
+ *
+ * With glibc, the program can replace malloc() and friends, and the
+ * library (as well as libc itself, e.g. for strdup()) then calls our
+ * versions. They count and pass on to the original implementation.
+ * This is not possible under sanitizers, which replace malloc themselves.
+ */
+#if defined(HAVE___LIBC_MALLOC) && defined(HAVE_TLS) && !defined(__SANITIZE_ADDRESS__)
+#	define COUNT_ALLOCS 1
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+
+static __thread uint64_t nallocs;
+
+void *
+malloc(size_t size)
+{
+	++nallocs;
+	return __libc_malloc(size);
+}
+
+void *
+calloc(size_t nmemb, size_t size)
+{
+	++nallocs;
+	return __libc_calloc(nmemb, size);
+}
+
+void *
+realloc(void *ptr, size_t size)
+{
+	++nallocs;
+	return __libc_realloc(ptr, size);
+}
+
+void
+free(void *ptr)
+{
+	__libc_free(ptr);
+}
+#endif
+
+
+/* corpora */
+
+struct corpus {
+	const char *name;
+	char **texts;
+	size_t *lens;
+	int n;
+	struct fjson_object **trees;	/**< texts, parsed */
+	struct fjson_object **str_trees; /**< same, for the to_string cases (which cache output) */
+	const char **keys;		/**< for lookups in trees, one per text */
+	int *klens;
+	uint32_t *hashes;
+	int nkeys;			/**< keys per text */
+};
+
+struct gen {
+	char *buf;
+	size_t len;
+	size_t size;
+	uint64_t rnd;
+};
+
+static uint64_t
+gen_rand(struct gen *const g)
+{
+	/* xorshift64 */
+	g->rnd ^= g->rnd << 13;
+	g->rnd ^= g->rnd >> 7;
+	g->rnd ^= g->rnd << 17;
+	return g->rnd;
+}
+
+static void __attribute__((format(printf, 2, 3)))
+gen_add(struct gen *const g, const char *const fmt, ...)
+{
+	va_list ap;
+	int len;
+	while (1) {
+		va_start(ap, fmt);
+		len = vsnprintf(g->buf + g->len, g->size - g->len, fmt, ap);
+		va_end(ap);
+		if ((size_t) len < g->size - g->len)
+			break;
+		g->size = 2 * g->size + len;
+		CHK((g->buf = realloc(g->buf, g->size)) != NULL);
+	}
+	g->len += len;
+}
+
+static void
+corpus_add(struct corpus *const c, struct gen *const g)
+{
+	CHK((c->texts = realloc(c->texts, (c->n + 1) * sizeof(char *))) != NULL);
+	CHK((c->lens = realloc(c->lens, (c->n + 1) * sizeof(size_t))) != NULL);
+	CHK((c->texts[c->n] = strdup(g->buf)) != NULL);
+	c->lens[c->n] = g->len;
+	++c->n;
+	g->len = 0;
+	g->buf[0] = '\0';
+}
+
+static const char *const hosts[] = { "web-01", "web-02", "db-main", "lb-edge-3", "mail" };
+static const char *const progs[] = { "sshd", "nginx", "postfix/smtpd", "kernel", "CRON", "systemd" };
+static const char *const sevs[] = { "emerg", "alert", "crit", "err", "warning", "notice", "info", "debug" };
+
+/* events as rsyslog would produce them with a JSON template */
+static void
+gen_syslog(struct corpus *const c, struct gen *const g)
+{
+	uint64_t r[18];
+	int i, k;
+	/* the order of evaluating arguments is unspecified, so draw the
+	 * random numbers beforehand
+	 */
+	for (i = 0 ; i < 1000 ; ++i) {
+		const char *prog;
+		unsigned pid;
+		for (k = 0 ; k < 18 ; ++k)
+			r[k] = gen_rand(g);
+		prog = progs[r[0] % 6];
+		pid = 100 + r[1] % 30000;
+		gen_add(g, "{\"timestamp\":\"2026-10-14T%02u:%02u:%02u.%06u+02:00\","
+			"\"hostname\":\"%s\",\"fromhost-ip\":\"10.0.%u.%u\","
+			"\"syslogtag\":\"%s[%u]:\",\"programname\":\"%s\",\"procid\":\"%u\","
+			"\"pri\":%u,\"syslogfacility-text\":\"auth\",\"syslogseverity-text\":\"%s\","
+			"\"msg\":\"Accepted publickey for user%u from 192.168.%u.%u port %u ssh2: "
+			"RSA SHA256:%016llx%016llx\",\"$!\":{\"app\":{\"latency_ms\":%u,\"ok\":%s}}}",
+			(unsigned) (r[2] % 24), (unsigned) (r[3] % 60), (unsigned) (r[4] % 60),
+			(unsigned) (r[5] % 1000000), hosts[r[6] % 5], (unsigned) (r[7] % 256),
+			(unsigned) (r[8] % 256), prog, pid, prog, pid, (unsigned) (r[9] % 192),
+			sevs[r[10] % 8], (unsigned) (r[11] % 1000), (unsigned) (r[12] % 256),
+			(unsigned) (r[13] % 256), (unsigned) (1024 + r[14] % 60000),
+			(unsigned long long) r[15], (unsigned long long) r[16],
+			(unsigned) (r[17] % 5000), (r[17] & 1) ? "true" : "false");
+		corpus_add(c, g);
+	}
+}
+
+static void
+gen_nested_level(struct gen *const g, const int depth)
+{
+	const uint64_t r = gen_rand(g);
+	int i;
+	gen_add(g, "{\"id\":%u,\"name\":\"node-%d\",\"weight\":%.3f,\"tags\":[\"a\",\"b\",%d]",
+		(unsigned) (r % 100000), depth, (double) ((r >> 32) % 100000) / 1000, depth);
+	if (depth > 0) {
+		const int fanout = (depth > 10) ? 2 : 1;
+		gen_add(g, ",\"children\":[");
+		for (i = 0 ; i < fanout ; ++i) {
+			if (i > 0)
+				gen_add(g, ",");
+			gen_nested_level(g, depth - 1);
+		}
+		gen_add(g, "]");
+	}
+	gen_add(g, "}");
+}
+
+/* the default tokener depth is 32, and each level takes two */
+static void
+gen_nested(struct corpus *const c, struct gen *const g)
+{
+	int i;
+	for (i = 0 ; i < 20 ; ++i) {
+		gen_nested_level(g, 14);
+		corpus_add(c, g);
+	}
+}
+
+static void
+gen_wide(struct corpus *const c, struct gen *const g)
+{
+	int i;
+	gen_add(g, "{");
+	for (i = 0 ; i < 5000 ; ++i) {
+		const unsigned r = (unsigned) gen_rand(g);
+		gen_add(g, "%s\"field_%04d\":", (i > 0) ? "," : "", i);
+		switch (r % 4) {
+		case 0: gen_add(g, "%u", r); break;
+		case 1: gen_add(g, "\"value %u\"", r); break;
+		case 2: gen_add(g, "%s", (r & 8) ? "true" : "null"); break;
+		default: gen_add(g, "[%u,%u]", r % 10, r % 100); break;
+		}
+	}
+	gen_add(g, "}");
+	corpus_add(c, g);
+}
+
+static void
+gen_numbers(struct corpus *const c, struct gen *const g)
+{
+	int i, j;
+	for (i = 0 ; i < 10 ; ++i) {
+		gen_add(g, "{\"ints\":[");
+		for (j = 0 ; j < 1000 ; ++j) {
+			const int64_t v = (int64_t) gen_rand(g);
+			gen_add(g, "%s%lld", (j > 0) ? "," : "", (long long) (v / ((int64_t) 1 << ((uint64_t) v % 62))));
+		}
+		gen_add(g, "],\"doubles\":[");
+		for (j = 0 ; j < 1000 ; ++j) {
+			const int64_t v = (int64_t) gen_rand(g);
+			const uint64_t d = gen_rand(g);
+			gen_add(g, "%s%.*g", (j > 0) ? "," : "", 1 + (int) (d % 17),
+				(double) v / (double) (1 + (d >> 8) % 1000000));
+		}
+		gen_add(g, "]}");
+		corpus_add(c, g);
+	}
+}
+
+static void
+gen_escapes(struct corpus *const c, struct gen *const g)
+{
+	static const char *const parts[] = {
+		"plain text ", "\\\"quoted\\\" ", "back\\\\slash ", "line\\nbreak ", "tab\\there ",
+		"\\u00e4\\u00f6\\u00fc ", "\\ud83d\\ude00 ", "path\\/to\\/file ", "\\u0001ctl "
+	};
+	int i, j;
+	for (i = 0 ; i < 100 ; ++i) {
+		gen_add(g, "{\"tab\\tkey\":\"");
+		for (j = 0 ; j < 30 ; ++j)
+			gen_add(g, "%s", parts[gen_rand(g) % 9]);
+		gen_add(g, "\",\"list\":[");
+		for (j = 0 ; j < 10 ; ++j) {
+			const uint64_t r = gen_rand(g);
+			gen_add(g, "%s\"%s%s\"", (j > 0) ? "," : "", parts[r % 9], parts[(r >> 32) % 9]);
+		}
+		gen_add(g, "]}");
+		corpus_add(c, g);
+	}
+}
+
+/* all events of the syslog corpus in one array, as a bulk export would
+ * have them
+ */
+static void
+gen_big(struct corpus *const c, struct gen *const g, const struct corpus *const events)
+{
+	int i;
+	gen_add(g, "[");
+	for (i = 0 ; i < events->n ; ++i)
+		gen_add(g, "%s\n%s", (i > 0) ? "," : "", events->texts[i]);
+	gen_add(g, "]\n");
+	corpus_add(c, g);
+}
+
+/* parse all texts and pick the lookup keys: nkeys members of each, and
+ * one miss
+ */
+static void
+corpus_prepare(struct corpus *const c, const int nkeys, struct gen *const g)
+{
+	int i, k;
+	c->nkeys = nkeys;
+	CHK((c->trees = calloc(c->n, sizeof(struct fjson_object *))) != NULL);
+	CHK((c->str_trees = calloc(c->n, sizeof(struct fjson_object *))) != NULL);
+	CHK((c->keys = calloc((size_t) c->n * nkeys, sizeof(char *))) != NULL);
+	CHK((c->klens = calloc((size_t) c->n * nkeys, sizeof(int))) != NULL);
+	CHK((c->hashes = calloc((size_t) c->n * nkeys, sizeof(uint32_t))) != NULL);
+	for (i = 0 ; i < c->n ; ++i) {
+		struct fjson_object *const jso = fjson_tokener_parse(c->texts[i]);
+		CHK(jso != NULL);
+		c->trees[i] = jso;
+		CHK((c->str_trees[i] = fjson_tokener_parse(c->texts[i])) != NULL);
+		for (k = 0 ; k < nkeys ; ++k) {
+			const char **const key = &c->keys[(size_t) i * nkeys + k];
+			if (k == nkeys - 1) {
+				*key = "no-such-key";
+			} else {
+				int idx = (int) (gen_rand(g) % fjson_object_object_length(jso));
+				struct fjson_object_iterator it = fjson_object_iter_begin(jso);
+				while (idx-- > 0)
+					fjson_object_iter_next(&it);
+				*key = fjson_object_iter_peek_name(&it);
+			}
+			c->klens[(size_t) i * nkeys + k] = (int) strlen(*key);
+			c->hashes[(size_t) i * nkeys + k] = fjson_object_key_hash(*key, -1);
+		}
+	}
+}
+
+
+/* operations; each returns the number of bytes of JSON text processed */
+
+struct worker {
+	const struct corpus *c;
+	struct fjson_tokener *tok;
+	struct fjson_print_ctx *pctx;
+	size_t out;		/**< bytes seen by the dump sink */
+	/* results */
+	uint64_t ops;
+	uint64_t bytes;
+	uint64_t allocs;
+	double secs;
+};
+
+typedef size_t (bench_fn)(struct worker *w, uint64_t i);
+
+static size_t
+op_parse(struct worker *const w, const uint64_t i)
+{
+	const int t = (int) (i % w->c->n);
+	struct fjson_object *jso;
+	fjson_tokener_reset(w->tok);
+	jso = fjson_tokener_parse_ex(w->tok, w->c->texts[t], (int) w->c->lens[t]);
+	CHK(jso != NULL);
+	fjson_object_put(jso);
+	return w->c->lens[t];
+}
+
+static size_t
+op_validate(struct worker *const w, const uint64_t i)
+{
+	const int t = (int) (i % w->c->n);
+	fjson_tokener_reset(w->tok);
+	CHK(fjson_tokener_validate(w->tok, w->c->texts[t], (int) w->c->lens[t]) == fjson_tokener_success);
+	return w->c->lens[t];
+}
+
+#ifdef HAVE_PTHREAD_H
+struct exec_task {
+	fjson_task_fn *fn;
+	void *arg;
+};
+
+static void *
+exec_thread(void *const arg)
+{
+	struct exec_task *const t = arg;
+	t->fn(t->arg);
+	return NULL;
+}
+
+/* a thread per task but the first, which runs on the caller's */
+static void
+thread_executor(void __attribute__((unused)) *const ctx, fjson_task_fn *const fn,
+	void *const *const args, const int ntasks)
+{
+	pthread_t tids[16];
+	struct exec_task tasks[16];
+	int i;
+	CHK(ntasks <= 16);
+	for (i = 1 ; i < ntasks ; ++i) {
+		tasks[i].fn = fn;
+		tasks[i].arg = args[i];
+		CHK(pthread_create(&tids[i], NULL, exec_thread, &tasks[i]) == 0);
+	}
+	fn(args[0]);
+	for (i = 1 ; i < ntasks ; ++i)
+		pthread_join(tids[i], NULL);
+}
+#else
+#	define thread_executor NULL
+#endif
+
+static size_t
+parse_indexed(struct worker *const w, const uint64_t i, const int nparts)
+{
+	const int t = (int) (i % w->c->n);
+	struct fjson_object *const jso = fjson_tokener_parse_indexed(w->tok, w->c->texts[t],
+		w->c->lens[t], nparts, (nparts > 1) ? thread_executor : NULL, NULL);
+	CHK(jso != NULL);
+	fjson_object_put(jso);
+	return w->c->lens[t];
+}
+
+static size_t
+op_parse_indexed(struct worker *const w, const uint64_t i)
+{
+	return parse_indexed(w, i, 1);
+}
+
+static size_t
+op_parse_indexed4(struct worker *const w, const uint64_t i)
+{
+	return parse_indexed(w, i, 4);
+}
+
+/* fjson_object_to_json_string_ext() caches its result for the flags it
+ * was called with, so alternate between two sets in order to measure the
+ * actual work. Both produce about the same amount of text.
+ */
+static size_t
+op_to_string(struct worker *const w, const uint64_t i)
+{
+	const char *const s = fjson_object_to_json_string_ext(w->c->str_trees[i % w->c->n],
+		((i / w->c->n) & 1) ? FJSON_TO_STRING_SPACED : FJSON_TO_STRING_PLAIN);
+	CHK(s != NULL);
+	return w->c->lens[i % w->c->n];
+}
+
+/* nothing is cached here, so the plain trees can be used */
+static size_t
+op_to_string_ctx(struct worker *const w, const uint64_t i)
+{
+	const char *const s = fjson_object_to_json_string_ctx(w->c->trees[i % w->c->n],
+		FJSON_TO_STRING_PLAIN, w->pctx, NULL);
+	CHK(s != NULL);
+	return w->c->lens[i % w->c->n];
+}
+
+static size_t
+sink_write(void *const ptr, __attribute__((unused)) const char *const buffer, const size_t size)
+{
+	struct worker *const w = ptr;
+	w->out += size;
+	return size;
+}
+
+static size_t
+op_dump(struct worker *const w, const uint64_t i)
+{
+	char temp[4096];
+	fjson_object_dump_buffered(w->c->trees[i % w->c->n], FJSON_TO_STRING_PLAIN,
+		temp, sizeof(temp), sink_write, w);
+	return w->c->lens[i % w->c->n];
+}
+
+static size_t
+op_get_ex(struct worker *const w, const uint64_t i)
+{
+	const struct corpus *const c = w->c;
+	const size_t k = i % ((size_t) c->n * c->nkeys);
+	struct fjson_object *v;
+	fjson_object_object_get_ex(c->trees[k / c->nkeys], c->keys[k], &v);
+	return 0;
+}
+
+static size_t
+op_get_ex_len(struct worker *const w, const uint64_t i)
+{
+	const struct corpus *const c = w->c;
+	const size_t k = i % ((size_t) c->n * c->nkeys);
+	struct fjson_object *v;
+	fjson_object_object_get_ex_len(c->trees[k / c->nkeys], c->keys[k], c->klens[k],
+		c->hashes[k], &v);
+	return 0;
+}
+
+/* a nested property, as rsyslog templates access it: by a chain of
+ * lookups, a path compiled for each access, and a precompiled path
+ */
+static struct fjson_path *bench_path;
+
+static size_t
+op_get_ex_chain(struct worker *const w, const uint64_t i)
+{
+	struct fjson_object *v;
+	CHK(fjson_object_object_get_ex(w->c->trees[i % w->c->n], "$!", &v)
+		&& fjson_object_object_get_ex(v, "app", &v)
+		&& fjson_object_object_get_ex(v, "latency_ms", &v));
+	return 0;
+}
+
+static size_t
+op_get_path(struct worker *const w, const uint64_t i)
+{
+	CHK(fjson_object_get_path(w->c->trees[i % w->c->n], "/$!/app/latency_ms", NULL));
+	return 0;
+}
+
+static size_t
+op_path_get(struct worker *const w, const uint64_t i)
+{
+	CHK(fjson_path_get(w->c->trees[i % w->c->n], bench_path, NULL));
+	return 0;
+}
+
+/* enriching an event with the members of another one: by iterating and
+ * adding them one by one, and by merging
+ */
+static size_t
+op_merge_iter(struct worker *const w, const uint64_t i)
+{
+	struct fjson_object *const src = w->c->trees[i % w->c->n];
+	struct fjson_object *const dst = fjson_object_new_object();
+	struct fjson_object_iterator it = fjson_object_iter_begin(src);
+	struct fjson_object_iterator itEnd = fjson_object_iter_end(src);
+	CHK(dst != NULL);
+	while (!fjson_object_iter_equal(&it, &itEnd)) {
+		fjson_object_object_add(dst, fjson_object_iter_peek_name(&it),
+			fjson_object_get(fjson_object_iter_peek_value(&it)));
+		fjson_object_iter_next(&it);
+	}
+	fjson_object_put(dst);
+	return 0;
+}
+
+static size_t
+op_merge(struct worker *const w, const uint64_t i)
+{
+	struct fjson_object *const dst = fjson_object_new_object();
+	CHK(dst != NULL && fjson_object_object_merge(dst, w->c->trees[i % w->c->n], 0) == 0);
+	fjson_object_put(dst);
+	return 0;
+}
+
+/* comparing two trees parsed from the same text */
+static size_t
+op_equal(struct worker *const w, const uint64_t i)
+{
+	CHK(fjson_object_equal(w->c->trees[i % w->c->n], w->c->str_trees[i % w->c->n]));
+	return w->c->lens[i % w->c->n];
+}
+
+/* objects keep their hash, so for the actual work we first replace a
+ * nested value by an equal one, as enriching an event would
+ */
+static size_t
+op_hash(struct worker *const w, const uint64_t i)
+{
+	struct fjson_object *const jso = w->c->trees[i % w->c->n];
+	struct fjson_object *app, *v;
+	CHK(fjson_object_object_get_ex(jso, "$!", &app)
+		&& fjson_object_object_get_ex(app, "app", &app)
+		&& fjson_object_object_get_ex(app, "latency_ms", &v));
+	fjson_object_object_add(app, "latency_ms", fjson_object_new_int64(fjson_object_get_int64(v)));
+	fjson_object_hash(jso);
+	return w->c->lens[i % w->c->n];
+}
+
+
+/* runner */
+
+static double
+now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+struct run {
+	struct worker w;
+	bench_fn *fn;
+	double secs;
+};
+
+/* run fn for the given time, in batches that are large enough for the
+ * clock calls not to matter
+ */
+static void *
+run_worker(void *const arg)
+{
+	struct run *const r = arg;
+	struct worker *const w = &r->w;
+	uint64_t batch = 1, i = 0, j;
+	const double start = now();
+	double elapsed = 0;
+#ifdef COUNT_ALLOCS
+	const uint64_t allocs_start = nallocs;
+#endif
+	while (elapsed < r->secs) {
+		const double t = now();
+		for (j = 0 ; j < batch ; ++j, ++i)
+			w->bytes += r->fn(w, i);
+		elapsed = now() - start;
+		if (now() - t < 0.001)
+			batch *= 2;
+	}
+	w->ops = i;
+	w->secs = elapsed;
+#ifdef COUNT_ALLOCS
+	w->allocs = nallocs - allocs_start;
+#endif
+	return NULL;
+}
+
+struct bench_case {
+	const char *name;
+	int corpus;
+	bench_fn *fn;
+	int mt;
+};
+
+static struct corpus corpora[] = {
+	{ .name = "syslog" },
+	{ .name = "nested" },
+	{ .name = "wide" },
+	{ .name = "numbers" },
+	{ .name = "escapes" },
+	{ .name = "big" },
+};
+enum { C_SYSLOG, C_NESTED, C_WIDE, C_NUMBERS, C_ESCAPES, C_BIG };
+
+static const struct bench_case cases[] = {
+	{ "parse/syslog", C_SYSLOG, op_parse, 0 },
+	{ "parse/nested", C_NESTED, op_parse, 0 },
+	{ "parse/wide", C_WIDE, op_parse, 0 },
+	{ "parse/numbers", C_NUMBERS, op_parse, 0 },
+	{ "parse/escapes", C_ESCAPES, op_parse, 0 },
+	{ "parse/big", C_BIG, op_parse, 0 },
+	{ "validate/syslog", C_SYSLOG, op_validate, 0 },
+	{ "validate/escapes", C_ESCAPES, op_validate, 0 },
+	{ "validate/big", C_BIG, op_validate, 0 },
+	{ "parse_indexed/syslog", C_SYSLOG, op_parse_indexed, 0 },
+	{ "parse_indexed/big", C_BIG, op_parse_indexed, 0 },
+	{ "parse_indexed4/big", C_BIG, op_parse_indexed4, 0 },
+	{ "to_string/syslog", C_SYSLOG, op_to_string, 0 },
+	{ "to_string/nested", C_NESTED, op_to_string, 0 },
+	{ "to_string/wide", C_WIDE, op_to_string, 0 },
+	{ "to_string/numbers", C_NUMBERS, op_to_string, 0 },
+	{ "to_string/escapes", C_ESCAPES, op_to_string, 0 },
+	{ "to_string_ctx/syslog", C_SYSLOG, op_to_string_ctx, 0 },
+	{ "to_string_ctx/nested", C_NESTED, op_to_string_ctx, 0 },
+	{ "to_string_ctx/wide", C_WIDE, op_to_string_ctx, 0 },
+	{ "to_string_ctx/numbers", C_NUMBERS, op_to_string_ctx, 0 },
+	{ "to_string_ctx/escapes", C_ESCAPES, op_to_string_ctx, 0 },
+	{ "dump/syslog", C_SYSLOG, op_dump, 0 },
+	{ "dump/nested", C_NESTED, op_dump, 0 },
+	{ "dump/wide", C_WIDE, op_dump, 0 },
+	{ "dump/numbers", C_NUMBERS, op_dump, 0 },
+	{ "dump/escapes", C_ESCAPES, op_dump, 0 },
+	{ "get_ex/syslog", C_SYSLOG, op_get_ex, 0 },
+	{ "get_ex/wide", C_WIDE, op_get_ex, 0 },
+	{ "get_ex_len/syslog", C_SYSLOG, op_get_ex_len, 0 },
+	{ "get_ex_len/wide", C_WIDE, op_get_ex_len, 0 },
+	{ "get_ex_chain/syslog", C_SYSLOG, op_get_ex_chain, 0 },
+	{ "get_path/syslog", C_SYSLOG, op_get_path, 0 },
+	{ "path_get/syslog", C_SYSLOG, op_path_get, 0 },
+	{ "merge_iter/syslog", C_SYSLOG, op_merge_iter, 0 },
+	{ "merge/syslog", C_SYSLOG, op_merge, 0 },
+	{ "equal/syslog", C_SYSLOG, op_equal, 0 },
+	{ "equal/nested", C_NESTED, op_equal, 0 },
+	{ "equal/wide", C_WIDE, op_equal, 0 },
+	{ "hash/syslog", C_SYSLOG, op_hash, 0 },
+	{ "mt/parse/syslog", C_SYSLOG, op_parse, 1 },
+	{ "mt/parse/nested", C_NESTED, op_parse, 1 },
+	{ "mt/dump/syslog", C_SYSLOG, op_dump, 1 },
+	{ "mt/to_string_ctx/syslog", C_SYSLOG, op_to_string_ctx, 1 },
+	{ "mt/get_ex/wide", C_WIDE, op_get_ex, 1 },
+};
+#define NCASES ((int) (sizeof(cases) / sizeof(cases[0])))
+
+static void
+run_case(const struct bench_case *const bc, const int nthreads, const double secs)
+{
+	struct run *runs;
+	uint64_t ops = 0, bytes = 0, allocs = 0;
+	double wall = 0;
+	int i;
+
+	CHK((runs = calloc(nthreads, sizeof(struct run))) != NULL);
+	for (i = 0 ; i < nthreads ; ++i) {
+		runs[i].w.c = &corpora[bc->corpus];
+		CHK((runs[i].w.tok = fjson_tokener_new()) != NULL);
+		CHK((runs[i].w.pctx = fjson_print_ctx_new()) != NULL);
+		runs[i].fn = bc->fn;
+		runs[i].secs = secs;
+	}
+	{
+		/* warm up caches and lazily built indexes (before threads use them) */
+		struct run warm = runs[0];
+		warm.secs = secs / 10;
+		run_worker(&warm);
+	}
+
+	if (nthreads == 1) {
+		run_worker(&runs[0]);
+	} else {
+#ifdef HAVE_PTHREAD_H
+		pthread_t *const tids = calloc(nthreads, sizeof(pthread_t));
+		const double start = now();
+		CHK(tids != NULL);
+		for (i = 0 ; i < nthreads ; ++i)
+			CHK(pthread_create(&tids[i], NULL, run_worker, &runs[i]) == 0);
+		for (i = 0 ; i < nthreads ; ++i)
+			pthread_join(tids[i], NULL);
+		wall = now() - start;
+		free(tids);
+#endif
+	}
+	for (i = 0 ; i < nthreads ; ++i) {
+		ops += runs[i].w.ops;
+		bytes += runs[i].w.bytes;
+		allocs += runs[i].w.allocs;
+		fjson_tokener_free(runs[i].w.tok);
+		fjson_print_ctx_free(runs[i].w.pctx);
+	}
+	if (nthreads == 1)
+		wall = runs[0].w.secs;
+
+	printf("%-24s %3d", bc->name, nthreads);
+	if (bytes > 0)
+		printf(" %10.1f", bytes / wall / 1e6);
+	else
+		printf(" %10s", "-");
+	printf(" %12.1f", wall * 1e9 / ops);
+#ifdef COUNT_ALLOCS
+	printf(" %10.2f\n", (double) allocs / ops);
+#else
+	printf(" %10s\n", "n/a");
+#endif
+	fflush(stdout);
+	free(runs);
+}
+
+static void
+usage(void)
+{
+	fprintf(stderr, "usage: fjbench [-t seconds] [-j threads] [-l] [filter...]\n");
+	exit(1);
+}
+
+int
+main(int argc, char **argv)
+{
+	double secs = 1.0;
+	int nthreads = 4;
+	int list = 0;
+	struct gen g;
+	int opt, i, j;
+
+	while ((opt = getopt(argc, argv, "t:j:l")) != -1) {
+		switch (opt) {
+		case 't': secs = atof(optarg); break;
+		case 'j': nthreads = atoi(optarg); break;
+		case 'l': list = 1; break;
+		default: usage();
+		}
+	}
+	if (secs <= 0 || nthreads < 1)
+		usage();
+	if (list) {
+		for (i = 0 ; i < NCASES ; ++i)
+			printf("%s\n", cases[i].name);
+		return 0;
+	}
+
+	memset(&g, 0, sizeof(g));
+	g.rnd = 0x9e3779b97f4a7c15ull;
+	CHK((g.buf = malloc(g.size = 1 << 16)) != NULL);
+	gen_syslog(&corpora[C_SYSLOG], &g);
+	gen_nested(&corpora[C_NESTED], &g);
+	gen_wide(&corpora[C_WIDE], &g);
+	gen_numbers(&corpora[C_NUMBERS], &g);
+	gen_escapes(&corpora[C_ESCAPES], &g);
+	gen_big(&corpora[C_BIG], &g, &corpora[C_SYSLOG]);
+	free(g.buf);
+	corpus_prepare(&corpora[C_SYSLOG], 4, &g);
+	corpus_prepare(&corpora[C_NESTED], 1, &g);
+	corpus_prepare(&corpora[C_WIDE], 1000, &g);
+	corpus_prepare(&corpora[C_NUMBERS], 1, &g);
+	corpus_prepare(&corpora[C_ESCAPES], 1, &g);
+	corpus_prepare(&corpora[C_BIG], 1, &g);
+	CHK((bench_path = fjson_path_compile("/$!/app/latency_ms")) != NULL);
+
+	printf("%-24s %3s %10s %12s %10s\n", "case", "thr", "MB/s", "ns/op", "allocs/op");
+	for (i = 0 ; i < NCASES ; ++i) {
+		const struct bench_case *const bc = &cases[i];
+		int selected = (optind == argc);
+		for (j = optind ; j < argc ; ++j)
+			selected |= strstr(bc->name, argv[j]) != NULL;
+		if (!selected)
+			continue;
+#ifndef HAVE_PTHREAD_H
+		if (bc->mt)
+			continue;
+#endif
+		run_case(bc, bc->mt ? nthreads : 1, secs);
+	}
+
+	for (i = 0 ; i < (int) (sizeof(corpora) / sizeof(corpora[0])) ; ++i) {
+		for (j = 0 ; j < corpora[i].n ; ++j) {
+			fjson_object_put(corpora[i].trees[j]);
+			fjson_object_put(corpora[i].str_trees[j]);
+			free(corpora[i].texts[j]);
+		}
+		free(corpora[i].trees);
+		free(corpora[i].str_trees);
+		free(corpora[i].texts);
+		free(corpora[i].lens);
+		free(corpora[i].keys);
+		free(corpora[i].klens);
+		free(corpora[i].hashes);
+	}
+	fjson_path_free(bench_path);
+	return 0;
+}
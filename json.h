@@ -21,6 +21,10 @@ extern "C" {
 #include "json_object.h"
 #include "json_tokener.h"
 #include "json_object_iterator.h"
+#include "json_extract.h"
+#include "json_cbor.h"
+#include "json_keydict.h"
+#include "json_pointer.h"
 
 /**
  * Set initial size allocation for memory when creating strings,
@@ -37,12 +41,102 @@ extern "C" {
  * affected. This function is usually meant to be called just once
  * at start of an application, but there is no harm calling it more
  * than once. Note that the function is NOT thread-safe and must not
- * be called on different threads concurrently.
+ * be called on different threads concurrently. For settings that only
+ * apply to some tokeners, see fjson_ctx_set_printbuf_initial_size().
  *
  * @param size new initial size for printbuf (formatting buffer)
  */
 extern void fjson_global_set_printbuf_initial_size(int size);
 
+/**
+ * Limit the nesting depth of the values the serializers write (all
+ * fjson_object_to_json_string*() and fjson_object_dump*() functions and
+ * fjson_object_size()). Each open object or array counts as one level.
+ * Serializing a deeper tree stops when the limit is reached: the
+ * fjson_object_to_json_string*() functions then return NULL, and all
+ * others leave their output incomplete. In both cases, errno is set to
+ * ELOOP. This is a safeguard against runaway trees that were built by
+ * the application (the serializers do not recurse, so deep trees are
+ * no danger to the stack). Like fjson_global_set_printbuf_initial_size(),
+ * it is NOT thread-safe.
+ *
+ * @param depth the maximum depth, 0 (the default) means no limit
+ */
+extern void fjson_global_set_max_print_depth(int depth);
+
+/**
+ * Enable pooling of the memory blocks objects and arrays are made of.
+ * Freed blocks are kept on per-thread free lists, up to the given
+ * number of bytes per thread, and reused by later allocations of the
+ * same size on that thread. That makes building and freeing trees
+ * piecemeal considerably cheaper. 0 (the default) disables pooling,
+ * blocks already pooled stay so until fjson_global_pool_trim().
+ * Threads that end must call fjson_global_pool_trim() beforehand, or
+ * their pooled blocks are lost. Like fjson_global_set_printbuf_initial_size(),
+ * this is meant to be called at startup and is NOT thread-safe.
+ * Without compiler support for thread-local storage, this does nothing.
+ *
+ * @param bytes limit on memory pooled by each thread
+ */
+extern void fjson_global_set_pool_limit(size_t bytes);
+
+/**
+ * Release all memory pooled by the calling thread.
+ */
+extern void fjson_global_pool_trim(void);
+
+/**
+ * @returns the number of bytes pooled by the calling thread
+ */
+extern size_t fjson_global_pool_bytes(void);
+
+/**
+ * Route all memory the library allocates to a different allocator, for
+ * example jemalloc or tcmalloc. The functions must behave like malloc(),
+ * realloc() and free(); calloc() is done via malloc_fn. Passing NULL for
+ * any of them restores the libc allocator.
+ *
+ * This must be called before the library allocates anything (including
+ * tokeners, contexts and key dictionaries), as memory must be released
+ * by the allocator it came from. Like fjson_global_set_pool_limit(), it
+ * is NOT thread-safe.
+ */
+extern void fjson_global_set_allocator(void *(*malloc_fn)(size_t),
+	void *(*realloc_fn)(void *, size_t),
+	void (*free_fn)(void *));
+
+/**
+ * Instrumentation counters, see fjson_global_get_stats().
+ */
+struct fjson_stats {
+	uint64_t allocs;		/**< calls to malloc/calloc/realloc (or their hooks) */
+	uint64_t frees;			/**< calls to free (or its hook) */
+	uint64_t nodes;			/**< fjson_object nodes created */
+	uint64_t printbuf_reallocs;	/**< times an output buffer had to grow */
+	uint64_t bytes_parsed;		/**< input consumed by fjson_tokener_parse_ex() */
+	uint64_t parse_ns;		/**< time spent in fjson_tokener_parse_ex() */
+	uint64_t lookups;		/**< key lookups in objects (including on add) */
+	uint64_t lookup_probes;		/**< entries looked at by these lookups */
+	uint64_t lookup_probes_max;	/**< most entries looked at by a single lookup */
+};
+
+/**
+ * Read the instrumentation counters of the calling thread (or of the
+ * whole process, if the compiler lacks thread-local storage; updates
+ * from concurrent threads may then be lost). The counters are only
+ * maintained if the library was configured with --enable-stats.
+ *
+ * @param stats receives the counters, all zero if they are not available
+ * @returns 0 on success, -1 if the library has been built without
+ *   counters (errno is set to ENOTSUP)
+ */
+extern int fjson_global_get_stats(struct fjson_stats *stats);
+
+/**
+ * Reset the instrumentation counters of the calling thread to zero.
+ */
+extern void fjson_global_reset_stats(void);
+
 /**
  * Set case sensitive/insensitive comparison mode. If set to 0,
  * comparisons for JSON keys will be case-insensitive. Otherwise,
@@ -52,6 +146,8 @@ extern void fjson_global_set_printbuf_initial_size(int size);
  * if keys exists which only differ in case, only partial data
  * access is possible. So use with care and only if you know
  * exactly what you are doing!
+ * This applies to all objects not created with a context that says
+ * otherwise, see fjson_ctx_set_case_sensitive().
  */
 extern void fjson_global_do_case_sensitive_comparison(const int newval);
 
@@ -0,0 +1,600 @@
+/*
+ * Copyright (c) 2026 Adiscon GmbH
+ * Rainer Gerhards <rgerhards@adiscon.com>
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See COPYING for details.
+ *
+ */
+
+/* CBOR encoding and decoding
+ *
+ * For passing trees between processes (queues, disk spools), JSON text
+ * is wasteful: numbers need to be formatted and parsed again, strings
+ * escaped and unescaped. CBOR stores them as they are, so both sides
+ * mostly copy memory. The encoder uses the same write callback as
+ * fjson_object_dump_ext(); small items are collected in a buffer on the
+ * stack, long strings and packed array data are passed on directly.
+ */
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <errno.h>
+#include <math.h>
+
+#include "alloc.h"
+#include "json_object.h"
+#include "json_object_private.h"
+#include "json_object_iterator.h"
+#include "json_cbor.h"
+
+/* major types */
+#define CBOR_UINT   0
+#define CBOR_NINT   1
+#define CBOR_BYTES  2
+#define CBOR_TEXT   3
+#define CBOR_ARRAY  4
+#define CBOR_MAP    5
+#define CBOR_TAG    6
+#define CBOR_SIMPLE 7
+
+#define CBOR_FALSE     0xf4
+#define CBOR_TRUE      0xf5
+#define CBOR_NULL      0xf6
+#define CBOR_FLOAT32   0xfa
+#define CBOR_FLOAT64   0xfb
+#define CBOR_BREAK     0xff
+#define CBOR_INDEFINITE 31
+
+/* RFC 8746 typed arrays are tags 64..87, where bit 4 marks floats,
+ * bit 3 signed integers, bit 2 little endian and the low bits give the
+ * element size (1 << n bytes for integers, 2 << n bytes for floats).
+ */
+#define CBOR_TAG_TYPED_FIRST 64
+#define CBOR_TAG_TYPED_LAST  87
+#define CBOR_TYPED_FLOAT  0x10
+#define CBOR_TYPED_SIGNED 0x08
+#define CBOR_TYPED_LE     0x04
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#	define CBOR_TYPED_HOST 0
+#else
+#	define CBOR_TYPED_HOST CBOR_TYPED_LE
+#endif
+#define CBOR_TAG_SINT64_HOST (CBOR_TAG_TYPED_FIRST | CBOR_TYPED_SIGNED | CBOR_TYPED_HOST | 3)
+#define CBOR_TAG_FLOAT64_HOST (CBOR_TAG_TYPED_FIRST | CBOR_TYPED_FLOAT | CBOR_TYPED_HOST | 2)
+
+/* the decoder recurses for each level */
+#define CBOR_MAX_DEPTH 1024
+
+/* data at least this long is handed to the callback directly */
+#define CBOR_MIN_REF 128
+
+
+/* encoder */
+
+struct cbor_out {
+	fjson_write_fn *func;
+	void *ptr;
+	size_t filled;
+	size_t result;
+	unsigned char buf[1024];
+};
+
+static void
+out_flush(struct cbor_out *const out)
+{
+	if (out->filled > 0)
+		out->result += out->func(out->ptr, (const char *) out->buf, out->filled);
+	out->filled = 0;
+}
+
+static void
+out_append(struct cbor_out *const out, const void *const data, const size_t size)
+{
+	if (size >= CBOR_MIN_REF || size > sizeof(out->buf) - out->filled) {
+		out_flush(out);
+		if (size >= CBOR_MIN_REF) {
+			out->result += out->func(out->ptr, data, size);
+			return;
+		}
+	}
+	memcpy(out->buf + out->filled, data, size);
+	out->filled += size;
+}
+
+static void
+out_byte(struct cbor_out *const out, const unsigned char b)
+{
+	if (out->filled == sizeof(out->buf))
+		out_flush(out);
+	out->buf[out->filled++] = b;
+}
+
+/* write the head of an item with its argument in the shortest form */
+static void
+out_head(struct cbor_out *const out, const int major, const uint64_t arg)
+{
+	unsigned char head[9];
+	int n, i;
+	if (arg < 24) {
+		out_byte(out, (unsigned char) ((major << 5) | arg));
+		return;
+	}
+	if (arg <= 0xff) {
+		n = 1;
+		head[0] = (unsigned char) ((major << 5) | 24);
+	} else if (arg <= 0xffff) {
+		n = 2;
+		head[0] = (unsigned char) ((major << 5) | 25);
+	} else if (arg <= 0xffffffff) {
+		n = 4;
+		head[0] = (unsigned char) ((major << 5) | 26);
+	} else {
+		n = 8;
+		head[0] = (unsigned char) ((major << 5) | 27);
+	}
+	for (i = 0 ; i < n ; ++i)
+		head[n - i] = (unsigned char) (arg >> (8 * i));
+	out_append(out, head, n + 1);
+}
+
+static void
+out_double(struct cbor_out *const out, const double d)
+{
+	unsigned char item[9];
+	const float f = (float) d;
+	int n, i;
+	if ((double) f == d) {
+		uint32_t bits;
+		memcpy(&bits, &f, sizeof(bits));
+		item[0] = CBOR_FLOAT32;
+		for (i = 0 ; i < 4 ; ++i)
+			item[4 - i] = (unsigned char) (bits >> (8 * i));
+		n = 4;
+	} else {
+		uint64_t bits;
+		memcpy(&bits, &d, sizeof(bits));
+		item[0] = CBOR_FLOAT64;
+		for (i = 0 ; i < 8 ; ++i)
+			item[8 - i] = (unsigned char) (bits >> (8 * i));
+		n = 8;
+	}
+	out_append(out, item, n + 1);
+}
+
+static void
+out_text(struct cbor_out *const out, const char *const s, const size_t len)
+{
+	out_head(out, CBOR_TEXT, len);
+	out_append(out, s, len);
+}
+
+static void out_value(struct cbor_out *out, struct fjson_object *jso);
+
+static void
+out_array(struct cbor_out *const out, struct fjson_object *const jso)
+{
+	int count, i;
+	if (jso->_flags.packed != JSO_PACKED_NONE) {
+		const struct _fjson_packed *const packed = jso->o.c_packed;
+		out_head(out, CBOR_TAG, (jso->_flags.packed == JSO_PACKED_INT64) ?
+			CBOR_TAG_SINT64_HOST : CBOR_TAG_FLOAT64_HOST);
+		out_head(out, CBOR_BYTES, (uint64_t) packed->length * 8);
+		if (packed->length > 0)
+			out_append(out, packed->data.i64, (size_t) packed->length * 8);
+		return;
+	}
+	count = fjson_object_array_length(jso);
+	out_head(out, CBOR_ARRAY, count);
+	for (i = 0 ; i < count ; ++i)
+		out_value(out, fjson_object_array_get_idx(jso, i));
+}
+
+static void
+out_object(struct cbor_out *const out, struct fjson_object *const jso)
+{
+	struct fjson_object_iterator it = fjson_object_iter_begin(jso);
+	const struct fjson_object_iterator itEnd = fjson_object_iter_end(jso);
+	out_head(out, CBOR_MAP, fjson_object_object_length(jso));
+	while (!fjson_object_iter_equal(&it, &itEnd)) {
+		const struct _fjson_child *const chld = _fjson_object_iter_peek_child(&it);
+		out_text(out, chld->k, chld->klen);
+		out_value(out, chld->v);
+		fjson_object_iter_next(&it);
+	}
+}
+
+static void
+out_value(struct cbor_out *const out, struct fjson_object *const jso)
+{
+	if (jso == NULL) {
+		out_byte(out, CBOR_NULL);
+		return;
+	}
+	switch (jso->o_type) {
+	case fjson_type_null:
+		out_byte(out, CBOR_NULL);
+		break;
+	case fjson_type_boolean:
+		out_byte(out, jso->o.c_boolean ? CBOR_TRUE : CBOR_FALSE);
+		break;
+	case fjson_type_int:
+		if (jso->o.c_int64 >= 0)
+			out_head(out, CBOR_UINT, (uint64_t) jso->o.c_int64);
+		else
+			out_head(out, CBOR_NINT, ~(uint64_t) jso->o.c_int64);
+		break;
+	case fjson_type_double:
+		if (jso->o.c_double.source != NULL) {
+			out_head(out, CBOR_TAG, FJSON_CBOR_TAG_NUMBER_TEXT);
+			out_head(out, CBOR_ARRAY, 2);
+			out_double(out, jso->o.c_double.value);
+			out_text(out, jso->o.c_double.source, strlen(jso->o.c_double.source));
+		} else {
+			out_double(out, jso->o.c_double.value);
+		}
+		break;
+	case fjson_type_string:
+		out_text(out, (jso->o.c_string.len < LEN_DIRECT_STRING_DATA) ?
+			jso->o.c_string.str.data : jso->o.c_string.str.ptr, jso->o.c_string.len);
+		break;
+	case fjson_type_array:
+		out_array(out, jso);
+		break;
+	case fjson_type_object:
+		out_object(out, jso);
+		break;
+	}
+}
+
+size_t
+fjson_object_dump_cbor(struct fjson_object *const jso, fjson_write_fn *const func, void *const ptr)
+{
+	struct cbor_out out;
+	out.func = func;
+	out.ptr = ptr;
+	out.filled = 0;
+	out.result = 0;
+	out_value(&out, jso);
+	out_flush(&out);
+	return out.result;
+}
+
+
+/* decoder */
+
+struct cbor_in {
+	const unsigned char *p;
+	const unsigned char *end;
+	int depth;
+};
+
+/* read the head of an item. For indefinite lengths, *arg is not set.
+ * Returns -1 if the input ends or the head is malformed.
+ */
+static int
+in_head(struct cbor_in *const in, int *const major, int *const info, uint64_t *const arg)
+{
+	int n, i;
+	if (in->p == in->end)
+		return -1;
+	*major = *in->p >> 5;
+	*info = *in->p & 0x1f;
+	++in->p;
+	if (*info < 24) {
+		*arg = *info;
+		return 0;
+	}
+	if (*info == CBOR_INDEFINITE)
+		return (*major >= CBOR_BYTES && *major != CBOR_TAG) ? 0 : -1;
+	if (*info > 27)
+		return -1;
+	n = 1 << (*info - 24);
+	if (in->end - in->p < n)
+		return -1;
+	*arg = 0;
+	for (i = 0 ; i < n ; ++i)
+		*arg = (*arg << 8) | in->p[i];
+	in->p += n;
+	return 0;
+}
+
+/* RFC 8949, appendix D */
+static double
+half_to_double(const unsigned half)
+{
+	const int exp = (half >> 10) & 0x1f;
+	const int mant = half & 0x3ff;
+	double val;
+	if (exp == 0)
+		val = ldexp(mant, -24);
+	else if (exp != 31)
+		val = ldexp(mant + 1024, exp - 25);
+	else
+		val = (mant == 0) ? INFINITY : NAN;
+	return (half & 0x8000) ? -val : val;
+}
+
+static double
+float_bits_to_double(const uint64_t bits, const int size)
+{
+	if (size == 2)
+		return half_to_double((unsigned) bits);
+	if (size == 4) {
+		const uint32_t b32 = (uint32_t) bits;
+		float f;
+		memcpy(&f, &b32, sizeof(f));
+		return f;
+	} else {
+		double d;
+		memcpy(&d, &bits, sizeof(d));
+		return d;
+	}
+}
+
+static int in_value(struct cbor_in *in, struct fjson_object **jso);
+
+/* a typed array; tag is one of the typed array tags, the content follows */
+static int
+in_typed_array(struct cbor_in *const in, const int tag, struct fjson_object **const jso)
+{
+	const int is_float = tag & CBOR_TYPED_FLOAT;
+	const int is_signed = tag & CBOR_TYPED_SIGNED;
+	const int is_le = tag & CBOR_TYPED_LE;
+	const int size = is_float ? (2 << (tag & 3)) : (1 << (tag & 3));
+	const unsigned char *data;
+	int major, info, count, i;
+	uint64_t len;
+	void *vals;
+
+	if ((is_float && is_signed) || size > 8)
+		return -1; /* reserved or float128 */
+	if (in_head(in, &major, &info, &len) != 0 || major != CBOR_BYTES
+	    || info == CBOR_INDEFINITE || len > (uint64_t) (in->end - in->p)
+	    || len % size != 0 || len / size > INT_MAX)
+		return -1;
+	data = in->p;
+	in->p += len;
+	count = (int) (len / size);
+
+	/* our own output on the same platform can be used as it is */
+	if (size == 8 && (is_float || is_signed) && (tag & CBOR_TYPED_LE) == CBOR_TYPED_HOST
+	    && ((uintptr_t) data & 7) == 0) {
+		*jso = is_float ? fjson_object_new_array_double((const double *) data, count)
+			: fjson_object_new_array_int64((const int64_t *) data, count);
+		return (*jso == NULL) ? -2 : 0;
+	}
+
+	if ((vals = _fjson_malloc((size_t) count * 8 + 1)) == NULL)
+		return -2;
+	for (i = 0 ; i < count ; ++i) {
+		const unsigned char *const e = data + (size_t) i * size;
+		uint64_t bits = 0;
+		int b;
+		for (b = 0 ; b < size ; ++b)
+			bits = (bits << 8) | e[is_le ? size - 1 - b : b];
+		if (is_float) {
+			((double *) vals)[i] = float_bits_to_double(bits, size);
+		} else if (is_signed) {
+			/* sign-extend */
+			const int shift = 64 - 8 * size;
+			((int64_t *) vals)[i] = (int64_t) (bits << shift) >> shift;
+		} else if (bits > INT64_MAX) {
+			_fjson_free(vals);
+			return -1;
+		} else {
+			((int64_t *) vals)[i] = (int64_t) bits;
+		}
+	}
+	*jso = is_float ? fjson_object_new_array_double(vals, count)
+		: fjson_object_new_array_int64(vals, count);
+	_fjson_free(vals);
+	return (*jso == NULL) ? -2 : 0;
+}
+
+/* a double with its original text; the tag has been read */
+static int
+in_number_text(struct cbor_in *const in, struct fjson_object **const jso)
+{
+	struct fjson_object *val = NULL;
+	const unsigned char *text;
+	int major, info, r;
+	uint64_t arg;
+	char *ds;
+
+	if (in_head(in, &major, &info, &arg) != 0 || major != CBOR_ARRAY || arg != 2
+	    || info == CBOR_INDEFINITE)
+		return -1;
+	if ((r = in_value(in, &val)) != 0)
+		return r;
+	if (!fjson_object_is_type(val, fjson_type_double)) {
+		fjson_object_put(val);
+		return -1;
+	}
+	if (in_head(in, &major, &info, &arg) != 0 || major != CBOR_TEXT
+	    || info == CBOR_INDEFINITE || arg > (uint64_t) (in->end - in->p)) {
+		fjson_object_put(val);
+		return -1;
+	}
+	text = in->p;
+	in->p += arg;
+	if ((ds = _fjson_malloc(arg + 1)) == NULL) {
+		fjson_object_put(val);
+		return -2;
+	}
+	memcpy(ds, text, arg);
+	ds[arg] = '\0';
+	*jso = fjson_object_new_double_s(val->o.c_double.value, ds);
+	_fjson_free(ds);
+	fjson_object_put(val);
+	return (*jso == NULL) ? -2 : 0;
+}
+
+/* is the next item a break? If so, it is consumed. */
+static int
+in_break(struct cbor_in *const in)
+{
+	if (in->p != in->end && *in->p == CBOR_BREAK) {
+		++in->p;
+		return 1;
+	}
+	return 0;
+}
+
+static int
+in_array(struct cbor_in *const in, const int indefinite, const uint64_t n,
+	struct fjson_object **const jso)
+{
+	uint64_t i;
+	int r;
+	/* each element takes at least one byte */
+	if (!indefinite && n > (uint64_t) (in->end - in->p))
+		return -1;
+	if ((*jso = fjson_object_new_array_ex(indefinite ? 0 : (int) n)) == NULL)
+		return -2;
+	for (i = 0 ; indefinite ? !in_break(in) : i < n ; ++i) {
+		struct fjson_object *val = NULL;
+		if ((r = in_value(in, &val)) != 0)
+			return r;
+		if (fjson_object_array_add(*jso, val) != 0) {
+			fjson_object_put(val);
+			return -2;
+		}
+	}
+	return 0;
+}
+
+static int
+in_map(struct cbor_in *const in, const int indefinite, const uint64_t n,
+	struct fjson_object **const jso)
+{
+	char keybuf[256];
+	uint64_t i;
+	int r;
+	if (!indefinite && n > (uint64_t) (in->end - in->p) / 2)
+		return -1;
+	if ((*jso = fjson_object_new_object()) == NULL)
+		return -2;
+	for (i = 0 ; indefinite ? !in_break(in) : i < n ; ++i) {
+		struct fjson_object *val = NULL;
+		int major, info;
+		uint64_t klen;
+		char *key = keybuf;
+		if (in_head(in, &major, &info, &klen) != 0 || major != CBOR_TEXT
+		    || info == CBOR_INDEFINITE || klen > (uint64_t) (in->end - in->p)
+		    || memchr(in->p, '\0', klen) != NULL)
+			return -1;
+		if (klen >= sizeof(keybuf) && (key = _fjson_malloc(klen + 1)) == NULL)
+			return -2;
+		memcpy(key, in->p, klen);
+		key[klen] = '\0';
+		in->p += klen;
+		if ((r = in_value(in, &val)) == 0)
+			fjson_object_object_add_ex(*jso, key, val, 0);
+		if (key != keybuf)
+			_fjson_free(key);
+		if (r != 0)
+			return r;
+	}
+	return 0;
+}
+
+/* decode one item into *jso. Returns 0 on success, -1 if the data is
+ * invalid and -2 if we are out of memory. On error, *jso may hold a
+ * partial result, which in_value() releases.
+ */
+static int
+in_item(struct cbor_in *const in, struct fjson_object **const jso)
+{
+	int major, info, r;
+	uint64_t arg;
+
+	*jso = NULL;
+	if (in_head(in, &major, &info, &arg) != 0)
+		return -1;
+	switch (major) {
+	case CBOR_UINT:
+		*jso = (arg > INT64_MAX) ? fjson_object_new_double((double) arg)
+			: fjson_object_new_int64((int64_t) arg);
+		return (*jso == NULL) ? -2 : 0;
+	case CBOR_NINT:
+		*jso = (arg > INT64_MAX) ? fjson_object_new_double(-1.0 - (double) arg)
+			: fjson_object_new_int64(-1 - (int64_t) arg);
+		return (*jso == NULL) ? -2 : 0;
+	case CBOR_BYTES:
+	case CBOR_TEXT:
+		if (info == CBOR_INDEFINITE || arg > (uint64_t) (in->end - in->p) || arg > INT_MAX)
+			return -1;
+		*jso = fjson_object_new_string_len((const char *) in->p, (int) arg);
+		in->p += arg;
+		return (*jso == NULL) ? -2 : 0;
+	case CBOR_ARRAY:
+	case CBOR_MAP:
+		if (++in->depth > CBOR_MAX_DEPTH)
+			return -1;
+		r = (major == CBOR_ARRAY) ? in_array(in, info == CBOR_INDEFINITE, arg, jso)
+			: in_map(in, info == CBOR_INDEFINITE, arg, jso);
+		--in->depth;
+		return r;
+	case CBOR_TAG:
+		if (++in->depth > CBOR_MAX_DEPTH)
+			return -1;
+		if (arg == FJSON_CBOR_TAG_NUMBER_TEXT)
+			r = in_number_text(in, jso);
+		else if (arg >= CBOR_TAG_TYPED_FIRST && arg <= CBOR_TAG_TYPED_LAST)
+			r = in_typed_array(in, (int) arg, jso);
+		else
+			r = in_value(in, jso);
+		--in->depth;
+		return r;
+	default: /* CBOR_SIMPLE */
+		switch (info) {
+		case 20:
+		case 21:
+			*jso = fjson_object_new_boolean(info == 21);
+			return 0;
+		case 22:
+		case 23:
+			return 0;
+		case 25:
+		case 26:
+		case 27:
+			*jso = fjson_object_new_double(float_bits_to_double(arg, 1 << (info - 24)));
+			return (*jso == NULL) ? -2 : 0;
+		default:
+			return -1;
+		}
+	}
+}
+
+static int
+in_value(struct cbor_in *const in, struct fjson_object **const jso)
+{
+	const int r = in_item(in, jso);
+	if (r != 0) {
+		fjson_object_put(*jso);
+		*jso = NULL;
+	}
+	return r;
+}
+
+int
+fjson_cbor_parse(const void *const buf, const size_t len, struct fjson_object **const obj,
+	size_t *const used)
+{
+	struct cbor_in in;
+	int r;
+	in.p = buf;
+	in.end = in.p + len;
+	in.depth = 0;
+	if ((r = in_value(&in, obj)) != 0) {
+		errno = (r == -2) ? ENOMEM : EINVAL;
+		return -1;
+	}
+	if (used != NULL)
+		*used = in.p - (const unsigned char *) buf;
+	return 0;
+}
@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2026 Adiscon GmbH
+ * Rainer Gerhards <rgerhards@adiscon.com>
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See COPYING for details.
+ *
+ */
+
+#ifndef _fj_json_cbor_h_
+#define _fj_json_cbor_h_
+
+#include <stddef.h>
+#include "json_object.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * CBOR tag used for doubles that carry their original text (see
+ * fjson_object_new_double_s()). The tagged item is an array of the
+ * value and the text. This tag is not registered with IANA; decoders
+ * that do not know it still see both parts.
+ */
+#define FJSON_CBOR_TAG_NUMBER_TEXT 0x666a
+
+/**
+ * Write an object tree in CBOR (RFC 8949), a binary format that is
+ * considerably more compact and faster to process than JSON text.
+ *
+ * Objects, arrays, strings, integers, booleans and null map to the
+ * respective CBOR types. Doubles are written as float32 if this is
+ * exact, and as float64 otherwise; doubles that keep their original
+ * text are written with FJSON_CBOR_TAG_NUMBER_TEXT. Packed arrays
+ * (see fjson_object_new_array_int64()) are written as RFC 8746 typed
+ * arrays in host byte order. All lengths are definite ones.
+ *
+ * @param obj object to be written, NULL writes a CBOR null
+ * @param func your function that will be called to write the data
+ * @param ptr pointer that will be passed as first argument to your function
+ * @returns number of bytes written (the sum of all return values of calls to func)
+ */
+extern size_t fjson_object_dump_cbor(struct fjson_object *obj, fjson_write_fn *func, void *ptr);
+
+/**
+ * Build an object tree from a CBOR data item, as written by
+ * fjson_object_dump_cbor() or any other encoder.
+ *
+ * Besides what fjson_object_dump_cbor() writes, this accepts float16,
+ * indefinite-length arrays and maps, byte strings (which become
+ * strings), undefined (which becomes null), unsigned integers beyond
+ * the int64 range (which become doubles) and typed arrays of all
+ * integer and float formats except float128. Tags other than the ones
+ * mentioned above are ignored. Indefinite-length strings and map keys
+ * that are not text strings are not supported.
+ *
+ * @param buf the CBOR data
+ * @param len length of buf
+ * @param obj receives the object tree, which must be released with
+ *   fjson_object_put(). A CBOR null yields NULL.
+ * @param used if not NULL, receives the number of bytes taken up by the
+ *   data item, so that a sequence of items can be parsed one by one
+ * @returns 0 on success, or -1 with errno set to EINVAL if the data is
+ *   malformed, truncated or too deeply nested, or ENOMEM if out of memory
+ */
+extern int fjson_cbor_parse(const void *buf, size_t len, struct fjson_object **obj, size_t *used);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
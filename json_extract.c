@@ -0,0 +1,372 @@
+/*
+ * Copyright (c) 2026 Adiscon GmbH
+ * Rainer Gerhards <rgerhards@adiscon.com>
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See COPYING for details.
+ *
+ */
+
+/* path-targeted extraction
+ *
+ * Typical consumers route on one or two fields of a message and never
+ * look at the rest. Building the full object tree for that is mostly
+ * wasted work. Here, we walk the input with a structural scan that
+ * only follows the keys leading to requested values and skips all other
+ * members by looking for the matching bracket (strings are skipped with
+ * the SIMD scanner). Only the requested values themselves are fed into
+ * a regular tokener, so the result consists of normal objects.
+ */
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+
+#include "alloc.h"
+#include "simd_scan.h"
+#include "json_object.h"
+#include "json_object_private.h"
+#include "json_tokener.h"
+#include "json_extract.h"
+
+struct path_comp {
+	const char *name;
+	int len;
+};
+
+struct path {
+	struct path_comp *comps;
+	int ncomps;
+};
+
+struct extract_ctx {
+	const char *end;	/* end of input */
+	const char *tok_end;	/* end of input as passed to the tokener (may include NUL) */
+	struct fjson_tokener *tok;
+	struct path *paths;
+	struct fjson_object **values;
+	char *found;		/* per path: value has been found */
+	int *cand;		/* scratch space for candidate lists */
+	int npaths;
+	int nfound;
+	int (*cmp)(const char *, const char *, size_t);
+};
+
+/* split a path into its components. comps must have room for all. */
+static void
+split_path(const char *p, struct path *const path, struct path_comp *const comps)
+{
+	char sep = '.';
+	path->comps = comps;
+	path->ncomps = 0;
+	if (p[0] == '$' && p[1] == '!') {
+		sep = '!';
+		p += 2;
+	}
+	while (*p != '\0') {
+		const char *const next = strchr(p, sep);
+		const int len = (next == NULL) ? (int) strlen(p) : (int) (next - p);
+		comps[path->ncomps].name = p;
+		comps[path->ncomps].len = len;
+		++path->ncomps;
+		if (next == NULL)
+			break;
+		p = next + 1;
+	}
+}
+
+/* skip a string. p points to the opening quote; returns a pointer just
+ * behind the closing one or NULL if the input ends before.
+ */
+static const char *
+skip_string(const char *p, const char *const end)
+{
+	++p;
+	while (1) {
+		p = _fjson_scan_str(p, end, '"');
+		if (p == end)
+			return NULL;
+		if (*p == '"')
+			return p + 1;
+		if (*p == '\\') {
+			p += 2;
+			if (p > end)
+				return NULL;
+		} else {
+			++p; /* control char, the tokener would bail out on it later */
+		}
+	}
+}
+
+/* skip a complete value without looking at it in detail. Returns a
+ * pointer behind it or NULL if the input ends before.
+ */
+static const char *
+skip_value(const char *p, const char *const end)
+{
+	int depth = 0;
+	while (p != end) {
+		switch (*p) {
+		case '"':
+			if ((p = skip_string(p, end)) == NULL)
+				return NULL;
+			if (depth == 0)
+				return p;
+			continue;
+		case '{':
+		case '[':
+			++depth;
+			break;
+		case '}':
+		case ']':
+			if (depth == 0)
+				return p; /* end of a scalar directly before the bracket */
+			if (--depth == 0)
+				return p + 1;
+			break;
+		case ',':
+			if (depth == 0)
+				return p;
+			break;
+		default:
+			if (depth == 0 && FJSON_IS_WS(*p))
+				return p;
+			break;
+		}
+		++p;
+	}
+	return NULL;
+}
+
+/* parse a value with the tokener. Returns a pointer behind it or NULL on error */
+static const char *
+parse_value(struct extract_ctx *const ctx, const char *const p, struct fjson_object **const value)
+{
+	fjson_tokener_reset(ctx->tok);
+	*value = fjson_tokener_parse_ex(ctx->tok, p, (int) (ctx->tok_end - p));
+	if (fjson_tokener_get_error(ctx->tok) != fjson_tokener_success) {
+		fjson_object_put(*value);
+		*value = NULL;
+		return NULL;
+	}
+	return p + ctx->tok->char_offset;
+}
+
+static void
+set_value(struct extract_ctx *const ctx, const int i, struct fjson_object *const value)
+{
+	fjson_object_put(ctx->values[i]);
+	ctx->values[i] = value;
+	if (!ctx->found[i]) {
+		ctx->found[i] = 1;
+		++ctx->nfound;
+	}
+}
+
+/* a value has been parsed for some path; resolve the longer paths that
+ * go through it from the object just built.
+ */
+static void
+resolve_in_value(struct extract_ctx *const ctx, const int i, const int level,
+	struct fjson_object *const value)
+{
+	const struct path *const path = &ctx->paths[i];
+	struct fjson_object *jso = value;
+	int l;
+	for (l = level ; l < path->ncomps ; ++l) {
+		const struct path_comp *const comp = &path->comps[l];
+		if (!fjson_object_object_get_ex_len(jso, comp->name, comp->len,
+		    fjson_object_key_hash(comp->name, comp->len), &jso))
+			return;
+	}
+	set_value(ctx, i, fjson_object_get(jso));
+}
+
+/* does the key at k (with escapes, if any, still in place) equal the
+ * path component?
+ */
+static int
+key_matches(struct extract_ctx *const ctx, const char *const k, const int klen,
+	const int has_esc, const struct path_comp *const comp)
+{
+	if (!has_esc)
+		return klen == comp->len && ctx->cmp(k, comp->name, klen) == 0;
+	/* rare case: let the tokener decode the key */
+	struct fjson_object *key;
+	int r = 0;
+	if (parse_value(ctx, k - 1, &key) != NULL) {
+		r = fjson_object_get_string_len(key) == comp->len
+		    && ctx->cmp(fjson_object_get_string(key), comp->name, comp->len) == 0;
+		fjson_object_put(key);
+	}
+	return r;
+}
+
+/* scan the members of an object. p points behind the opening brace; cand
+ * lists the ncand paths that matched the keys leading here (level many).
+ * Returns a pointer behind the closing brace or NULL on error. If all
+ * paths have been found, we stop early and return the current position.
+ */
+static const char *
+scan_object(struct extract_ctx *const ctx, const char *p, const int level,
+	int *const cand, const int ncand)
+{
+	const char *const end = ctx->end;
+	int *const next = cand + ncand; /* room for the next level's list */
+	int i;
+
+	p = _fjson_skip_ws(p, end);
+	if (p != end && *p == '}')
+		return p + 1;
+	while (1) {
+		const char *k, *kend;
+		int nnext = 0, nfull = 0, has_esc = 0;
+
+		if (p == end || *p != '"')
+			return NULL;
+		k = p + 1;
+		if ((p = skip_string(p, end)) == NULL)
+			return NULL;
+		kend = p - 1;
+		has_esc = memchr(k, '\\', kend - k) != NULL;
+		p = _fjson_skip_ws(p, end);
+		if (p == end || *p != ':')
+			return NULL;
+		p = _fjson_skip_ws(p + 1, end);
+
+		/* full matches first, then those that need to look deeper */
+		for (i = 0 ; i < ncand ; ++i) {
+			const struct path *const path = &ctx->paths[cand[i]];
+			if (path->ncomps == level + 1
+			    && key_matches(ctx, k, kend - k, has_esc, &path->comps[level]))
+				next[nfull++] = cand[i];
+		}
+		nnext = nfull;
+		for (i = 0 ; i < ncand ; ++i) {
+			const struct path *const path = &ctx->paths[cand[i]];
+			if (path->ncomps > level + 1
+			    && key_matches(ctx, k, kend - k, has_esc, &path->comps[level]))
+				next[nnext++] = cand[i];
+		}
+
+		if (nfull > 0) {
+			struct fjson_object *value;
+			if ((p = parse_value(ctx, p, &value)) == NULL)
+				return NULL;
+			for (i = 0 ; i < nnext ; ++i) {
+				if (i < nfull)
+					set_value(ctx, next[i], fjson_object_get(value));
+				else
+					resolve_in_value(ctx, next[i], level + 1, value);
+			}
+			fjson_object_put(value);
+		} else if (nnext > 0 && p != end && *p == '{') {
+			if ((p = scan_object(ctx, p + 1, level + 1, next, nnext)) == NULL)
+				return NULL;
+		} else {
+			const char *const v = p;
+			if ((p = skip_value(p, end)) == NULL || p == v)
+				return NULL;
+		}
+
+		if (ctx->nfound == ctx->npaths)
+			return p; /* no need to look at the rest */
+		p = _fjson_skip_ws(p, end);
+		if (p == end)
+			return NULL;
+		if (*p == '}')
+			return p + 1;
+		if (*p != ',')
+			return NULL;
+		p = _fjson_skip_ws(p + 1, end);
+	}
+}
+
+int
+fjson_extract_paths(const char *const buf, const int len,
+	const char *const *const paths, const int npaths, struct fjson_object **const values)
+{
+	struct extract_ctx ctx;
+	struct path_comp *comps = NULL;
+	const char *p;
+	int ncomps = 0;
+	int nroot = 0;
+	int i, r = -1;
+
+	memset(&ctx, 0, sizeof(ctx));
+	for (i = 0 ; i < npaths ; ++i) {
+		values[i] = NULL;
+		ncomps += strlen(paths[i]) + 1;
+	}
+	ctx.end = buf + ((len == -1) ? strlen(buf) : (size_t) len);
+	ctx.tok_end = ctx.end + (len == -1); /* a terminating NUL ends numbers */
+	ctx.values = values;
+	ctx.npaths = npaths;
+	ctx.cmp = _fjson_keys_case_sensitive() ? strncmp : strncasecmp;
+	ctx.tok = fjson_tokener_new();
+	ctx.paths = _fjson_malloc(npaths * sizeof(struct path));
+	ctx.found = _fjson_calloc(npaths, 1);
+	comps = _fjson_malloc(ncomps * sizeof(struct path_comp));
+	/* each level's candidate list is at most npaths long, and there are
+	 * at most as many levels as path components.
+	 */
+	ctx.cand = _fjson_malloc((ncomps + 1) * npaths * sizeof(int) + 1);
+	if (ctx.tok == NULL || ctx.paths == NULL || ctx.found == NULL || comps == NULL
+	    || ctx.cand == NULL) {
+		errno = ENOMEM;
+		goto done;
+	}
+
+	ncomps = 0;
+	for (i = 0 ; i < npaths ; ++i) {
+		split_path(paths[i], &ctx.paths[i], comps + ncomps);
+		ncomps += ctx.paths[i].ncomps;
+	}
+
+	for (i = 0 ; i < npaths ; ++i) {
+		if (ctx.paths[i].ncomps == 0)
+			++nroot;
+	}
+	if (nroot > 0) {
+		/* the root itself is requested, so we need to parse it anyway */
+		struct fjson_object *root;
+		if (parse_value(&ctx, buf, &root) == NULL)
+			goto done;
+		for (i = 0 ; i < npaths ; ++i)
+			resolve_in_value(&ctx, i, 0, root);
+		fjson_object_put(root);
+		r = ctx.nfound;
+		goto done;
+	}
+
+	p = _fjson_skip_ws(buf, ctx.end);
+	if (p == ctx.end || *p != '{') {
+		/* nothing can match if the root is not an object */
+		struct fjson_object *root;
+		if (parse_value(&ctx, p, &root) != NULL)
+			r = 0;
+		fjson_object_put(root);
+		goto done;
+	}
+	for (i = 0 ; i < npaths ; ++i)
+		ctx.cand[i] = i;
+	if (scan_object(&ctx, p + 1, 0, ctx.cand, npaths) != NULL)
+		r = ctx.nfound;
+
+done:
+	if (r == -1) {
+		for (i = 0 ; i < npaths ; ++i) {
+			fjson_object_put(values[i]);
+			values[i] = NULL;
+		}
+	}
+	if (ctx.tok != NULL)
+		fjson_tokener_free(ctx.tok);
+	_fjson_free(ctx.paths);
+	_fjson_free(ctx.found);
+	_fjson_free(ctx.cand);
+	_fjson_free(comps);
+	return r;
+}
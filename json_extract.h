@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2026 Adiscon GmbH
+ * Rainer Gerhards <rgerhards@adiscon.com>
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See COPYING for details.
+ *
+ */
+
+#ifndef _fj_json_extract_h_
+#define _fj_json_extract_h_
+
+#include "json_object.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Extract the values of some fields from a JSON text without parsing
+ * all of it.
+ *
+ * Each path names a member of the top-level object or of objects nested
+ * in it (array elements cannot be addressed). It is either written with
+ * dots, like "a.b.c", or in rsyslog notation, like "$!a!b!c". The path
+ * "$!" as well as the empty path denote the root itself.
+ *
+ * Parts of the input that are not requested are skipped by a structural
+ * scan, which only checks that brackets and quotes are balanced. Only
+ * the requested values are parsed into fjson_object's, so the work done
+ * is mostly proportional to the size of the data that is actually
+ * needed. The scan ends as soon as all paths have been found; the
+ * remaining input is not checked at all. Comments are not supported in
+ * skipped parts. If a requested key occurs more than once in the same
+ * object, it is unspecified which of its values is returned.
+ *
+ * @param buf the JSON text
+ * @param len length of buf, or -1 if it is NUL-terminated
+ * @param paths the paths to extract
+ * @param npaths number of entries in paths
+ * @param values receives the value for each path, which must be released
+ *   with fjson_object_put(). Paths that are not present as well as JSON
+ *   null values are set to NULL.
+ * @returns the number of paths found (including those with null values),
+ *   or -1 if the input is invalid or out of memory, in which case all
+ *   values are NULL
+ */
+extern int fjson_extract_paths(const char *buf, int len,
+	const char *const *paths, int npaths, struct fjson_object **values);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,147 @@
+/*
+ * Copyright (c) 2026 Adiscon GmbH
+ * Rainer Gerhards <rgerhards@adiscon.com>
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See COPYING for details.
+ *
+ */
+
+/* interned keys
+ *
+ * The dictionary is a hash table with a fixed number of chains, sized
+ * for the maximum number of keys. Keys are only ever prepended to a
+ * chain, after they are fully set up, and never removed. So lookups,
+ * which are by far the most frequent operation, walk the chains without
+ * any locking. Only adding a key takes a lock, which ensures that two
+ * threads interning the same new key end up with the same pointer.
+ */
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "alloc.h"
+#include "atomic.h"
+#include "simd_scan.h"
+#include "json_object.h"
+#include "json_object_private.h"
+#include "json_keydict.h"
+
+#define KEYDICT_DFLT_MAX_KEYS 4096
+
+struct fjson_keydict {
+	int max_keys;
+	int nkeys;
+	unsigned mask;		/**< number of chains - 1 */
+	int lock;
+	struct _fjson_key **chains;
+	DEF_ATOMIC_HELPER_MUT(mut)
+};
+
+struct fjson_keydict*
+fjson_keydict_new(int max_keys)
+{
+	struct fjson_keydict *dict;
+	unsigned nchains = 64;
+
+	if (max_keys <= 0)
+		max_keys = KEYDICT_DFLT_MAX_KEYS;
+	while (nchains < (unsigned) max_keys && nchains < (1u << 30))
+		nchains *= 2;
+	if ((dict = _fjson_calloc(1, sizeof(struct fjson_keydict))) == NULL)
+		return NULL;
+	if ((dict->chains = _fjson_calloc(nchains, sizeof(struct _fjson_key *))) == NULL) {
+		_fjson_free(dict);
+		return NULL;
+	}
+	dict->max_keys = max_keys;
+	dict->mask = nchains - 1;
+	INIT_ATOMIC_HELPER_MUT(dict->mut);
+	return dict;
+}
+
+void
+fjson_keydict_free(struct fjson_keydict *const dict)
+{
+	if (dict == NULL)
+		return;
+	for (unsigned i = 0 ; i <= dict->mask ; ++i) {
+		struct _fjson_key *key, *next;
+		for (key = dict->chains[i] ; key != NULL ; key = next) {
+			next = key->next;
+			_fjson_free(key);
+		}
+	}
+	DESTROY_ATOMIC_HELPER_MUT(dict->mut);
+	_fjson_free(dict->chains);
+	_fjson_free(dict);
+}
+
+static void
+keydict_lock(struct fjson_keydict *const dict)
+{
+	while (!ATOMIC_CAS(&dict->lock, 0, 1, &dict->mut))
+		;
+}
+
+static void
+keydict_unlock(struct fjson_keydict *const dict)
+{
+	ATOMIC_STORE_0_TO_INT(&dict->lock, &dict->mut);
+}
+
+static struct _fjson_key *
+keydict_find(struct _fjson_key *key, const char *const str,
+	const uint32_t hash, const unsigned len)
+{
+	for ( ; key != NULL ; key = key->next) {
+		if (key->hash == hash && key->len == len && !memcmp(key->str, str, len))
+			return key;
+	}
+	return NULL;
+}
+
+const char*
+fjson_keydict_intern(struct fjson_keydict *const dict, const char *const str)
+{
+	unsigned len;
+	const uint32_t hash = _fjson_key_hash(str, &len);
+	struct _fjson_key *volatile *const chain = &dict->chains[hash & dict->mask];
+	struct _fjson_key *key;
+
+#ifdef HAVE_ATOMIC_BUILTINS
+	if ((key = keydict_find(*chain, str, hash, len)) != NULL)
+		return key->str;
+#endif
+	keydict_lock(dict);
+	if ((key = keydict_find(*chain, str, hash, len)) != NULL)
+		goto done;
+	if (dict->nkeys == dict->max_keys)
+		goto done;
+	if ((key = _fjson_malloc(sizeof(struct _fjson_key) + len + 1)) == NULL) {
+		errno = ENOMEM;
+		goto done;
+	}
+	key->hash = hash;
+	key->len = len;
+	key->no_escape = _fjson_scan_escape(str, str + len) == str + len;
+	memcpy(key->str, str, len + 1);
+	key->next = *chain;
+#ifdef HAVE_ATOMIC_BUILTINS
+	/* readers must see the key complete before it becomes reachable */
+	__sync_synchronize();
+#endif
+	*chain = key;
+	++dict->nkeys;
+done:
+	keydict_unlock(dict);
+	return (key == NULL) ? NULL : key->str;
+}
+
+int
+fjson_keydict_count(struct fjson_keydict *const dict)
+{
+	return ATOMIC_FETCH_32BIT(&dict->nkeys, &dict->mut);
+}
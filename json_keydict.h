@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2026 Adiscon GmbH
+ * Rainer Gerhards <rgerhards@adiscon.com>
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See COPYING for details.
+ *
+ */
+
+#ifndef _fj_json_keydict_h_
+#define _fj_json_keydict_h_
+
+#include "json_object.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * A dictionary of interned keys.
+ *
+ * Interning a key returns a pointer to a copy owned by the dictionary;
+ * interning the same key again returns the same pointer. Objects store
+ * such keys without copying them and do not free them, and lookups can
+ * use the hash computed when the key was interned. This pays off if the
+ * same key names occur in many objects, as is typical for log data.
+ *
+ * A dictionary can be used from multiple threads concurrently. Keys are
+ * never removed, so the dictionary must outlive all objects holding its
+ * keys. It can be pre-seeded by the application and is handed to
+ * tokeners via fjson_ctx_set_keydict().
+ */
+typedef struct fjson_keydict fjson_keydict;
+
+/**
+ * Create a key dictionary.
+ * @param max_keys the maximum number of keys it holds; once reached,
+ *   fjson_keydict_intern() fails for new keys. This protects against
+ *   input with an unbounded set of key names. 0 selects a default of
+ *   4096.
+ * @returns the new dictionary or NULL on malloc error
+ */
+extern struct fjson_keydict* fjson_keydict_new(int max_keys);
+
+/**
+ * Free a key dictionary and all its keys.
+ * @param dict the dictionary, may be NULL
+ */
+extern void fjson_keydict_free(struct fjson_keydict *dict);
+
+/**
+ * Intern a key.
+ * @param dict the dictionary
+ * @param key the key, NUL-terminated
+ * @returns the interned copy of key, which is valid as long as the
+ *   dictionary exists, or NULL if the dictionary is full or on malloc
+ *   error. The result can be passed to fjson_object_object_add_ex()
+ *   together with FJSON_OBJECT_KEY_IS_INTERNED.
+ */
+extern const char* fjson_keydict_intern(struct fjson_keydict *dict, const char *key);
+
+/**
+ * @returns the number of keys in the dictionary
+ */
+extern int fjson_keydict_count(struct fjson_keydict *dict);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
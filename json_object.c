@@ -24,11 +24,17 @@
 #include <errno.h>
 #include <assert.h>
 #include <stdint.h>
+#include <limits.h>
 
 #include "debug.h"
+#include "alloc.h"
 #include "atomic.h"
 #include "printbuf.h"
 #include "arraylist.h"
+#include "arena.h"
+#include "pool.h"
+#include "simd_scan.h"
+#include "numconv.h"
 #include "json.h"
 #include "json_object.h"
 #include "json_object_private.h"
@@ -47,14 +53,14 @@ const char *fjson_number_chars = "0123456789.+-eE";
 const char *fjson_hex_chars = "0123456789abcdefABCDEF";
 
 static void fjson_object_generic_delete(struct fjson_object* jso);
-static struct fjson_object* fjson_object_new(enum fjson_type o_type);
-
-static fjson_object_to_json_string_fn fjson_object_object_to_json_string;
-static fjson_object_to_json_string_fn fjson_object_boolean_to_json_string;
-static fjson_object_to_json_string_fn fjson_object_int_to_json_string;
-static fjson_object_to_json_string_fn fjson_object_double_to_json_string;
-static fjson_object_to_json_string_fn fjson_object_string_to_json_string;
-static fjson_object_to_json_string_fn fjson_object_array_to_json_string;
+static void fjson_object_object_delete(struct fjson_object* jso);
+static void fjson_object_array_delete(struct fjson_object* jso);
+static void fjson_object_array_entry_free(void *data);
+static void fjson_object_double_delete(struct fjson_object* jso);
+static void fjson_object_string_delete(struct fjson_object* jso);
+static struct fjson_object* fjson_object_new(enum fjson_type o_type, size_t size,
+	struct fjson_arena *arena);
+static struct fjson_object* jso_copy_containers(struct fjson_object *src);
 
 static int do_case_sensitive_comparison = 1;
 void fjson_global_do_case_sensitive_comparison(const int newval)
@@ -62,6 +68,44 @@ void fjson_global_do_case_sensitive_comparison(const int newval)
 	do_case_sensitive_comparison = newval;
 }
 
+int _fjson_keys_case_sensitive(void)
+{
+	return do_case_sensitive_comparison;
+}
+
+
+/* contexts
+ *
+ * A context holds the settings that used to be process-global only, so
+ * that different users in the same process can have their own. Objects
+ * and tokeners copy what they need when they are created; the context
+ * itself can be freed at any time.
+ */
+struct fjson_ctx* fjson_ctx_new(void)
+{
+	return (struct fjson_ctx*)_fjson_calloc(1, sizeof(struct fjson_ctx));
+}
+
+void fjson_ctx_free(struct fjson_ctx *ctx)
+{
+	_fjson_free(ctx);
+}
+
+void fjson_ctx_set_case_sensitive(struct fjson_ctx *ctx, int newval)
+{
+	ctx->key_cmp = newval ? JSO_KEY_CMP_CASE : JSO_KEY_CMP_NOCASE;
+}
+
+void fjson_ctx_set_printbuf_initial_size(struct fjson_ctx *ctx, int size)
+{
+	ctx->printbuf_initial_size = size;
+}
+
+void fjson_ctx_set_keydict(struct fjson_ctx *ctx, struct fjson_keydict *dict)
+{
+	ctx->keys = dict;
+}
+
 /* helper for accessing the optimized string data component in fjson_object
  */
 static const char *
@@ -71,155 +115,373 @@ get_string_component(struct fjson_object *jso)
 		   jso->o.c_string.str.data : jso->o.c_string.str.ptr;
 }
 
-/* string escaping
+/* same, but returns a NUL-terminated string. Strings referencing the
+ * parser input do not have one and are materialized for this reason.
+ * Returns NULL if we are out of memory.
+ */
+static int string_materialize(struct fjson_object *jso);
+static const char *
+get_string_cstr(struct fjson_object *const jso)
+{
+	if (jso->_flags.str_ref && !jso->_flags.str_nul && string_materialize(jso) != 0)
+		return NULL;
+	return get_string_component(jso);
+}
+
+/* arena support
  *
- * String escaping is a surprisingly performance intense operation.
- * I spent many hours in the profiler, and the root problem seems
- * to be that there is no easy way to detect the character classes
- * that need to be escaped, where the root cause is that these
- * characters are spread all over the ascii table. I tried
- * several approaches, including call tables, re-structuring
- * the case condition, different types of if conditions and
- * reordering the if conditions. What worked out best is this:
- * The regular case is that a character must not be escaped. So
- * we want to process that as fast as possible. In order to
- * detect this as quickly as possible, we have a lookup table
- * that tells us if a char needs escaping ("needsEscape", below).
- * This table has a spot for each ascii code. Note that it uses
- * chars, because anything larger causes worse cache operation
- * and anything smaller requires bit indexing and masking
- * operations, which are also comparatively costly. So plain
- * chars work best. What we then do is a single lookup into the
- * table to detect if we need to escape a character. If we need,
- * we go into the depth of actual escape detection. But if we
- * do NOT need to escape, we just quickly advance the index
- * and are done with that char. Note that it may look like the
- * extra table lookup costs performance, but right the contrary
- * is the case. We get amore than 30% performance increase due
- * to it (compared to the latest version of the code that did not
- * do the lookups).
- * rgerhards@adiscon.com, 2015-11-18
- * I have renamed needsEscape to char_needsEscape and made it
- * external. This makes it possible to share the implementation
- * with the newly contributed json_print.c module.
- * rgerhards, 2016-11-30
+ * Objects allocated from an arena carry the arena pointer directly in
+ * front of them. This way we do not need to grow every object for a
+ * pointer that only few of them need, and can still find the arena
+ * when an object needs additional memory later on (e.g. new keys).
  */
+struct _fjson_arena_node {
+	struct fjson_arena *arena;
+	struct fjson_object obj;
+};
+#define JSO_ARENA(jso) (((struct _fjson_arena_node *)(void *) \
+	((char *)(jso) - offsetof(struct _fjson_arena_node, obj)))->arena)
+
+static void *
+jso_alloc(struct fjson_object *const jso, const size_t size)
+{
+	return jso->_flags.in_arena ? _fjson_arena_alloc(JSO_ARENA(jso), size) : _fjson_malloc(size);
+}
 
-char char_needsEscape[256] = {
-	1, 1, 1, 1, 1, 1, 1, 1, /* ascii codes 0 .. 7 */
-	1, 1, 1, 1, 1, 1, 1, 1,
-	1, 1, 1, 1, 1, 1, 1, 1,
-	1, 1, 1, 1, 1, 1, 1, 1,
-	0, 0, 1, 0, 0, 0, 0, 0, /* ascii codes 32 .. 39 */
-	0, 0, 0, 0, 0, 0, 0, 1,
-	0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 1, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0, 0, 0, 0
+static void *
+jso_calloc(struct fjson_object *const jso, const size_t size)
+{
+	return jso->_flags.in_arena ? _fjson_arena_calloc(JSO_ARENA(jso), size) : _fjson_calloc(1, size);
+}
+
+/* children pages come from the pool, their size tells which block size */
+#define JSO_PG_BYTES(n) (sizeof(struct _fjson_child_pg) + (n) * sizeof(struct _fjson_child) \
+	+ JSO_FREEMAP_WORDS(n) * sizeof(uint64_t))
+
+static struct _fjson_child_pg *
+jso_pg_alloc(struct fjson_object *const jso, const int size)
+{
+	const size_t bytes = JSO_PG_BYTES(size);
+	return jso->_flags.in_arena ? _fjson_arena_calloc(JSO_ARENA(jso), bytes)
+		: _fjson_pool_calloc(bytes);
+}
+
+static void
+jso_pg_free(struct fjson_object *const jso, struct _fjson_child_pg *const pg)
+{
+	if (!jso->_flags.in_arena && pg != NULL)
+		_fjson_pool_free(pg, JSO_PG_BYTES(pg->size));
+}
+
+static char *
+jso_memdup(struct fjson_object *const jso, const char *const s, const size_t len)
+{
+	char *p;
+	if (jso->_flags.in_arena)
+		return _fjson_arena_memdup(JSO_ARENA(jso), s, len);
+	if ((p = _fjson_malloc(len + 1)) != NULL) {
+		memcpy(p, s, len);
+		p[len] = '\0';
+	}
+	return p;
+}
+
+static void
+jso_free(struct fjson_object *const jso, void *const ptr)
+{
+	if (!jso->_flags.in_arena)
+		_fjson_free(ptr);
+}
+
+/* object keys
+ *
+ * The keys an object owns on the heap are reference counted, so copies
+ * and merges can share them instead of duplicating each one; keys never
+ * change. The count sits right in front of the characters. Keys in an
+ * arena are plain copies, freed with the arena. Constant and interned
+ * keys (k_is_constant) are not owned at all.
+ */
+struct jso_key {
+	int refs;
+	char str[];
 };
+#define JSO_KEY(k) ((struct jso_key *) ((char *) (k) - offsetof(struct jso_key, str)))
+#ifndef HAVE_ATOMIC_BUILTINS
+static pthread_mutex_t jso_key_mut = PTHREAD_MUTEX_INITIALIZER;
+#endif
 
-static void fjson_escape_str(struct printbuf *pb, const char *str)
-{
-	const char *start_offset = str;
-	while(1) { /* broken below on 0-byte */
-		if(char_needsEscape[*((unsigned char*)str)]) {
-			if(*str == '\0')
-				break;
-			if(str != start_offset)
-				printbuf_memappend_no_nul(pb, start_offset, str - start_offset);
-			switch(*str) {
-			case '\b': printbuf_memappend_no_nul(pb, "\\b", 2);
-				break;
-			case '\n': printbuf_memappend_no_nul(pb, "\\n", 2);
-				break;
-			case '\r': printbuf_memappend_no_nul(pb, "\\r", 2);
-				break;
-			case '\t': printbuf_memappend_no_nul(pb, "\\t", 2);
-				break;
-			case '\f': printbuf_memappend_no_nul(pb, "\\f", 2);
-				break;
-			case '"': printbuf_memappend_no_nul(pb, "\\\"", 2);
-				break;
-			case '\\': printbuf_memappend_no_nul(pb, "\\\\", 2);
-				break;
-			case '/': printbuf_memappend_no_nul(pb, "\\/", 2);
-				break;
-			default: sprintbuf(pb, "\\u00%c%c",
-				fjson_hex_chars[*str >> 4],
-				fjson_hex_chars[*str & 0xf]);
-				break;
-			}
-			start_offset = ++str;
-		} else
-			++str;
+static char *
+jso_key_new(struct fjson_object *const jso, const char *const s)
+{
+	struct jso_key *key;
+	const size_t len = strlen(s);
+	if (jso->_flags.in_arena)
+		return _fjson_arena_memdup(JSO_ARENA(jso), s, len);
+	if ((key = _fjson_malloc(sizeof(struct jso_key) + len + 1)) == NULL)
+		return NULL;
+	key->refs = 1;
+	memcpy(key->str, s, len + 1);
+	return key->str;
+}
+
+/* another reference to a key that a heap object owns */
+static const char *
+jso_key_get(const char *const k)
+{
+	ATOMIC_INC(&JSO_KEY(k)->refs, &jso_key_mut);
+	return k;
+}
+
+static void
+jso_key_put(struct fjson_object *const jso, const char *const k)
+{
+	if (jso->_flags.in_arena || k == NULL)
+		return;
+	/* with a single reference, nobody else can take another one */
+	if (JSO_KEY(k)->refs == 1 || ATOMIC_DEC_AND_FETCH(&JSO_KEY(k)->refs, &jso_key_mut) == 0)
+		_fjson_free(JSO_KEY(k));
+}
+
+static void
+arena_printbuf_free(void *const pb)
+{
+	printbuf_free((struct printbuf *)pb);
+}
+
+
+/* serialization cache
+ *
+ * The output of fjson_object_to_json_string_ext() is kept in _pb and
+ * handed out again as long as the node and its descendants are not
+ * modified and the same flags are asked for. Containers also splice the
+ * cached output of their children into their own (except when pretty
+ * printing, where the output depends on the nesting level). To know when
+ * the cache becomes stale, each node points to the container holding it,
+ * and modifications invalidate the whole chain up to the root. Nodes that
+ * are held in more than one place cannot be tracked this way, so all
+ * containers above them simply do not cache. The same applies to the
+ * hash objects keep for fjson_object_hash().
+ */
+static void
+jso_invalidate(struct fjson_object *jso)
+{
+	for ( ; jso != NULL ; jso = jso->_parent) {
+		jso->_flags.pb_valid = 0;
+		if (jso->o_type == fjson_type_object)
+			jso->o.c_obj.hash = 0;
+	}
+}
+
+static void
+jso_set_nocache(struct fjson_object *jso)
+{
+	for ( ; jso != NULL ; jso = jso->_parent) {
+		jso->_flags.nocache = 1;
+		jso->_flags.pb_valid = 0;
+		if (jso->o_type == fjson_type_object)
+			jso->o.c_obj.hash = 0;
+	}
+}
+
+/* child is about to be stored in parent */
+static void
+jso_attach(struct fjson_object *const parent, struct fjson_object *const child)
+{
+	jso_invalidate(parent);
+	if (child == NULL || child->_flags.immortal)
+		return; /* singletons never change, so the parent may cache */
+	if (child->_flags.shared || child->_parent != NULL) {
+		if (!child->_flags.shared) {
+			jso_set_nocache(child->_parent);
+			child->_parent = NULL;
+			child->_flags.shared = 1;
+		}
+		jso_set_nocache(parent);
+	} else {
+		child->_parent = parent;
+		if (child->_flags.nocache)
+			jso_set_nocache(parent);
 	}
-	if(str != start_offset)
-		printbuf_memappend_no_nul(pb, start_offset, str - start_offset);
 }
 
+/* child is about to be removed from parent */
+static void
+jso_detach(struct fjson_object *const parent, struct fjson_object *const child)
+{
+	jso_invalidate(parent);
+	if (child != NULL && child->_parent == parent)
+		child->_parent = NULL;
+}
 
-/* reference counting */
+/* reference counting
+ *
+ * Trees that never are used by multiple threads at once (most
+ * of them, in practice) can do without atomic operations, see
+ * FJSON_TOKENER_LOCAL_REFCOUNT.
+ */
 
 extern struct fjson_object* fjson_object_get(struct fjson_object *jso)
 {
-	if (!jso) return jso;
-	ATOMIC_INC_AND_FETCH_int(&jso->_ref_count, &jso->_mut_ref_count);
+	if (!jso || jso->_flags.immortal) return jso;
+	if (jso->_flags.local_ref)
+		++jso->_ref_count;
+	else
+		ATOMIC_INC_AND_FETCH_int(&jso->_ref_count, &jso->_mut_ref_count);
 	return jso;
 }
 
 int fjson_object_put(struct fjson_object *jso)
 {
-	if(!jso) return 0;
+	if(!jso || jso->_flags.immortal) return 0;
 
-	const int cnt = ATOMIC_DEC_AND_FETCH(&jso->_ref_count, &jso->_mut_ref_count);
+	const int cnt = jso->_flags.local_ref ? --jso->_ref_count
+		: ATOMIC_DEC_AND_FETCH(&jso->_ref_count, &jso->_mut_ref_count);
 	if(cnt > 0) return 0;
 
-	jso->_delete(jso);
+	switch (jso->o_type) {
+	case fjson_type_object:
+		fjson_object_object_delete(jso);
+		break;
+	case fjson_type_array:
+		fjson_object_array_delete(jso);
+		break;
+	case fjson_type_double:
+		fjson_object_double_delete(jso);
+		break;
+	case fjson_type_string:
+		fjson_object_string_delete(jso);
+		break;
+	case fjson_type_null:
+	case fjson_type_boolean:
+	case fjson_type_int:
+	default:
+		fjson_object_generic_delete(jso);
+		break;
+	}
 	return 1;
 }
 
+static void jso_share(struct fjson_object *jso)
+{
+	if (!jso || jso->_flags.immortal)
+		return;
+	jso->_flags.local_ref = 0;
+	switch(jso->o_type) {
+	case fjson_type_object:
+		{
+			const struct _fjson_child_pg *pg;
+			for (pg = &jso->o.c_obj.pg ; pg != NULL ; pg = pg->next) {
+				for (int i = 0 ; i < pg->size ; ++i) {
+					if (pg->children[i].k != NULL)
+						jso_share(pg->children[i].v);
+				}
+			}
+		}
+		break;
+	case fjson_type_array:
+		if (!jso->_flags.packed) {
+			/* boxed nodes of packed arrays never use local_ref */
+			const int len = fjson_object_array_length(jso);
+			for (int i = 0 ; i < len ; ++i)
+				jso_share(fjson_object_array_get_idx(jso, i));
+		}
+		break;
+	case fjson_type_null:
+	case fjson_type_boolean:
+	case fjson_type_double:
+	case fjson_type_int:
+	case fjson_type_string:
+	default:
+		break;
+	}
+}
+
+void fjson_object_share(struct fjson_object *jso)
+{
+	jso_share(jso);
+#ifdef HAVE_ATOMIC_BUILTINS
+	/* make the plain counts visible before the tree is published */
+	__sync_synchronize();
+#endif
+}
+
 
 /* generic object construction and destruction parts */
 
+/* nodes only have the union member for their type */
+#define JSO_NODE_SIZE(member) (offsetof(struct fjson_object, o.member) \
+	+ sizeof(((struct fjson_object *) 0)->o.member))
+
+/* bytes a node of the given type needs. For strings, len is the length
+ * of the string, which is stored in the node if it is short enough.
+ * We round to full words, so every node can hold at least an int64.
+ */
+static size_t
+jso_node_size(const enum fjson_type o_type, const int len)
+{
+	size_t size;
+	switch (o_type) {
+	case fjson_type_boolean:
+		size = JSO_NODE_SIZE(c_boolean);
+		break;
+	case fjson_type_double:
+		size = JSO_NODE_SIZE(c_double);
+		break;
+	case fjson_type_int:
+		size = JSO_NODE_SIZE(c_int64);
+		break;
+	case fjson_type_object:
+		size = JSO_NODE_SIZE(c_obj);
+		break;
+	case fjson_type_array:
+		size = JSO_NODE_SIZE(c_array);
+		break;
+	case fjson_type_string:
+		size = (len < LEN_DIRECT_STRING_DATA)
+			? offsetof(struct fjson_object, o.c_string.str.data) + len + 1
+			: JSO_NODE_SIZE(c_string.str.ptr);
+		break;
+	case fjson_type_null:
+	default:
+		size = sizeof(struct fjson_object);
+		break;
+	}
+	return (size + 7) & ~(size_t) 7;
+}
+
 static void fjson_object_generic_delete(struct fjson_object* jso)
 {
 	if (jso) {
-		printbuf_free(jso->_pb);
 		DESTROY_ATOMIC_HELPER_MUT(jso->_mut_ref_count);
-		free(jso);
+		if (jso->_flags.in_arena)
+			return; /* node and _pb are released by the arena */
+		printbuf_free(jso->_pb);
+		_fjson_pool_free(jso, jso_node_size(jso->o_type,
+			(jso->o_type == fjson_type_string) ? jso->o.c_string.len : 0));
 	}
 }
 
-static struct fjson_object* fjson_object_new(const enum fjson_type o_type)
+static struct fjson_object* fjson_object_new(const enum fjson_type o_type,
+	const size_t size,
+	struct fjson_arena *const arena)
 {
-	struct fjson_object *const jso = (struct fjson_object*)calloc(sizeof(struct fjson_object), 1);
-	if (!jso)
-		return NULL;
+	struct fjson_object *jso;
+	if (arena == NULL) {
+		jso = (struct fjson_object*)_fjson_pool_calloc(size);
+		if (!jso)
+			return NULL;
+	} else {
+		struct _fjson_arena_node *const node = (struct _fjson_arena_node *)
+			_fjson_arena_calloc(arena, offsetof(struct _fjson_arena_node, obj) + size);
+		if (!node)
+			return NULL;
+		node->arena = arena;
+		jso = &node->obj;
+		jso->_flags.in_arena = 1;
+	}
+	FJSON_STAT_INC(nodes);
 	jso->o_type = o_type;
 	jso->_ref_count = 1;
-	jso->_delete = &fjson_object_generic_delete;
 	INIT_ATOMIC_HELPER_MUT(jso->_mut_ref_count);
 	return jso;
 }
@@ -241,22 +503,177 @@ enum fjson_type fjson_object_get_type(struct fjson_object *jso)
 	return jso->o_type;
 }
 
+/* singletons
+ *
+ * Booleans, small integers and the empty string are so frequent in
+ * practice that we keep one immortal, statically allocated node for
+ * each of them. Reference counting on these is a no-op and they are
+ * never modified, so they can be shared freely, even between threads.
+ * Their output is static as well, so they do not need a _pb.
+ */
+#define JSO_IMMORTAL(type, member, val) { \
+	._ref_count = 1, .o_type = (type), ._flags = { .immortal = 1 }, .o = { .member = (val) } }
+
+/* like the heap nodes (see jso_node_size()), the static ones only have
+ * room for their own union member: the header of struct fjson_object,
+ * followed by the scalar. Used as a struct fjson_object.
+ */
+struct jso_static_node {
+	int _ref_count;
+	enum fjson_type o_type : 8;
+	unsigned char _pb_flags;
+	__typeof__(((struct fjson_object *) 0)->_flags) _flags;
+	struct printbuf *_pb;
+	struct fjson_object *_parent;
+	DEF_ATOMIC_HELPER_MUT(_mut_ref_count)
+	union {
+		fjson_bool c_boolean;
+		int64_t c_int64;
+		struct {
+			int len;
+			union {
+				char *ptr;
+				char data[sizeof(char *)];
+			} str;
+		} c_string;
+	} o;
+};
+#define JSO_STATIC_NODE_MATCHES(member) \
+	(offsetof(struct jso_static_node, member) == offsetof(struct fjson_object, member))
+_Static_assert(JSO_STATIC_NODE_MATCHES(_flags) && JSO_STATIC_NODE_MATCHES(_pb)
+	&& JSO_STATIC_NODE_MATCHES(_parent) && JSO_STATIC_NODE_MATCHES(o.c_boolean)
+	&& JSO_STATIC_NODE_MATCHES(o.c_int64) && JSO_STATIC_NODE_MATCHES(o.c_string.str.data),
+	"struct jso_static_node must mirror the header of struct fjson_object");
+#define JSO_STATIC(node) ((struct fjson_object *) &(node))
+#define JSO_IMMORTAL_INT(n) JSO_IMMORTAL(fjson_type_int, c_int64, n)
+#define JSO_STR(n) #n
+
+#define JSO_SMALL_INT_MIN (-1)
+#define JSO_SMALL_INT_MAX 255
+/* applies F to -1..255 */
+#define JSO_D10(F, p) F(p##0), F(p##1), F(p##2), F(p##3), F(p##4), \
+	F(p##5), F(p##6), F(p##7), F(p##8), F(p##9)
+#define JSO_SMALL_INTS(F) F(-1), F(0), F(1), F(2), F(3), F(4), F(5), F(6), F(7), F(8), F(9), \
+	JSO_D10(F, 1), JSO_D10(F, 2), JSO_D10(F, 3), JSO_D10(F, 4), JSO_D10(F, 5), \
+	JSO_D10(F, 6), JSO_D10(F, 7), JSO_D10(F, 8), JSO_D10(F, 9), JSO_D10(F, 10), \
+	JSO_D10(F, 11), JSO_D10(F, 12), JSO_D10(F, 13), JSO_D10(F, 14), JSO_D10(F, 15), \
+	JSO_D10(F, 16), JSO_D10(F, 17), JSO_D10(F, 18), JSO_D10(F, 19), JSO_D10(F, 20), \
+	JSO_D10(F, 21), JSO_D10(F, 22), JSO_D10(F, 23), JSO_D10(F, 24), \
+	F(250), F(251), F(252), F(253), F(254), F(255)
+
+static struct jso_static_node jso_true = JSO_IMMORTAL(fjson_type_boolean, c_boolean, 1);
+static struct jso_static_node jso_false = JSO_IMMORTAL(fjson_type_boolean, c_boolean, 0);
+static struct jso_static_node jso_empty_string = JSO_IMMORTAL(fjson_type_string, c_string.len, 0);
+static struct jso_static_node jso_small_ints[] = { JSO_SMALL_INTS(JSO_IMMORTAL_INT) };
+static const char *const jso_small_int_text[] = { JSO_SMALL_INTS(JSO_STR) };
+
+static const char *
+jso_immortal_text(const struct fjson_object *const jso)
+{
+	switch (jso->o_type) {
+	case fjson_type_boolean:
+		return jso->o.c_boolean ? "true" : "false";
+	case fjson_type_int:
+		return jso_small_int_text[jso->o.c_int64 - JSO_SMALL_INT_MIN];
+	case fjson_type_string:
+		return "\"\"";
+	case fjson_type_null:
+	case fjson_type_double:
+	case fjson_type_object:
+	case fjson_type_array:
+	default:
+		return "null";
+	}
+}
+
 /* extended conversion to string */
 
+/* make sure jso has an empty printbuf for its output; returns 0 on
+ * success. The cached output is gone from here on, even if writing the
+ * new one fails.
+ */
+static int jso_prepare_pb(struct fjson_object *jso, int flags)
+{
+	jso->_flags.pb_valid = 0;
+	if (!jso->_pb) {
+		if (!(jso->_pb = printbuf_new()))
+			return -1;
+		/* size it right from the start instead of growing it step by
+		 * step. Later calls will usually find it large enough.
+		 */
+		const size_t len = fjson_object_size_ext(jso, flags);
+		if (len < INT_MAX)
+			printbuf_reserve(jso->_pb, (int) len + 1);
+		if (jso->_flags.in_arena && _fjson_arena_add_cleanup(JSO_ARENA(jso),
+				arena_printbuf_free, jso->_pb) != 0) {
+			printbuf_free(jso->_pb);
+			jso->_pb = NULL;
+			return -1;
+		}
+	}
+	printbuf_reset(jso->_pb);
+	return 0;
+}
+
+/* the output in _pb is complete */
+static const char* jso_pb_done(struct fjson_object *jso, int flags)
+{
+	printbuf_terminate_string(jso->_pb);
+	jso->_flags.pb_valid = !jso->_flags.nocache;
+	jso->_pb_flags = flags;
+	return jso->_pb->buf;
+}
+
 const char* fjson_object_to_json_string_ext(struct fjson_object *jso, int flags)
 {
 	if (!jso)
 		return "null";
 
-	if ((!jso->_pb) && !(jso->_pb = printbuf_new()))
+	if (jso->_flags.immortal)
+		return jso_immortal_text(jso);
+
+	if (jso->_flags.pb_valid && jso->_pb_flags == flags)
+		return jso->_pb->buf;
+
+	if (jso_prepare_pb(jso, flags) != 0)
 		return NULL;
 
-	printbuf_reset(jso->_pb);
+	if (_fjson_object_write_printbuf(jso, flags, jso->_pb) != 0)
+		return NULL;
 
-	jso->_to_json_string(jso, jso->_pb, 0, flags);
+	return jso_pb_done(jso, flags);
+}
 
-	printbuf_terminate_string(jso->_pb);
-	return jso->_pb->buf;
+static size_t printbuf_writer(void *ptr, const char *buf, size_t size)
+{
+	printbuf_memappend_no_nul(ptr, buf, (int) size);
+	return size;
+}
+
+const char* fjson_object_to_json_string_parallel(struct fjson_object *jso, int flags,
+	int nparts, fjson_executor_fn *exec, void *exec_ctx)
+{
+	if (!jso)
+		return "null";
+
+	if (jso->_flags.immortal)
+		return jso_immortal_text(jso);
+
+	if (jso->_flags.pb_valid && jso->_pb_flags == flags)
+		return jso->_pb->buf;
+
+	if (jso_prepare_pb(jso, flags) != 0)
+		return NULL;
+
+	/* errno is the only way the dump reports that it had to stop */
+	const int saved_errno = errno;
+	errno = 0;
+	fjson_object_dump_parallel(jso, flags, nparts, exec, exec_ctx, printbuf_writer, jso->_pb);
+	if (errno != 0)
+		return NULL;
+	errno = saved_errno;
+
+	return jso_pb_done(jso, flags);
 }
 
 /* backwards-compatible conversion to string */
@@ -266,201 +683,449 @@ const char* fjson_object_to_json_string(struct fjson_object *jso)
 	return fjson_object_to_json_string_ext(jso, FJSON_TO_STRING_SPACED);
 }
 
-static void indent(struct printbuf *pb, int level, int flags)
+/* conversion to string with a caller-owned buffer
+ *
+ * Nothing is stored in the node, so this neither makes it hold on to a
+ * buffer nor conflicts with other threads serializing the same tree.
+ */
+
+struct fjson_print_ctx {
+	struct printbuf *pb;
+};
+
+struct fjson_print_ctx* fjson_print_ctx_new(void)
 {
-	if (flags & FJSON_TO_STRING_PRETTY)
-	{
-		if (flags & FJSON_TO_STRING_PRETTY_TAB)
-		{
-			printbuf_memset(pb, -1, '\t', level);
-		}
-		else
-		{
-			printbuf_memset(pb, -1, ' ', level * 2);
-		}
+	struct fjson_print_ctx *const pctx = _fjson_malloc(sizeof(struct fjson_print_ctx));
+	if (pctx == NULL)
+		return NULL;
+	if ((pctx->pb = printbuf_new()) == NULL) {
+		_fjson_free(pctx);
+		return NULL;
 	}
+	return pctx;
 }
 
-/* fjson_object_object */
+void fjson_print_ctx_free(struct fjson_print_ctx *pctx)
+{
+	if (pctx == NULL)
+		return;
+	printbuf_free(pctx->pb);
+	_fjson_free(pctx);
+}
 
-static int fjson_object_object_to_json_string(struct fjson_object* jso,
-						 struct printbuf *pb,
-						 int level,
-						 int flags)
+const char* fjson_object_to_json_string_ctx(struct fjson_object *jso, int flags,
+	struct fjson_print_ctx *pctx, size_t *len)
 {
-	struct fjson_object *val;
-	int had_children = 0;
-
-	printbuf_memappend_char(pb, '{' /*}*/);
-	if (flags & FJSON_TO_STRING_PRETTY)
-		printbuf_memappend_char(pb, '\n');
-	struct fjson_object_iterator it = fjson_object_iter_begin(jso);
-	struct fjson_object_iterator itEnd = fjson_object_iter_end(jso);
-	while (!fjson_object_iter_equal(&it, &itEnd)) {
-		if (had_children)
-		{
-			printbuf_memappend_char(pb, ',');
-			if (flags & FJSON_TO_STRING_PRETTY)
-				printbuf_memappend_char(pb, '\n');
-		}
-		had_children = 1;
-		if (flags & FJSON_TO_STRING_SPACED)
-			printbuf_memappend_char(pb, ' ');
-		indent(pb, level+1, flags);
-		printbuf_memappend_char(pb, '\"');
-		fjson_escape_str(pb, fjson_object_iter_peek_name(&it));
-		if (flags & FJSON_TO_STRING_SPACED)
-			printbuf_memappend_no_nul(pb, "\": ", 3);
-		else
-			printbuf_memappend_no_nul(pb, "\":", 2);
-		val = fjson_object_iter_peek_value(&it);
-		if(val == NULL)
-			printbuf_memappend_no_nul(pb, "null", 4);
-		else
-			val->_to_json_string(val, pb, level+1,flags);
-		fjson_object_iter_next(&it);
-	}
-	if (flags & FJSON_TO_STRING_PRETTY)
-	{
-		if (had_children)
-			printbuf_memappend_no_nul(pb, "\n",1);
-		indent(pb,level,flags);
-	}
-	if (flags & FJSON_TO_STRING_SPACED)
-		printbuf_memappend_no_nul(pb, /*{*/ " }", 2);
-	else
-		printbuf_memappend_char(pb, /*{*/ '}');
-	return 0; /* we need to keep compatible with the API */
+	struct printbuf *const pb = pctx->pb;
+
+	printbuf_reset(pb);
+	if (_fjson_object_write_printbuf(jso, flags, pb) != 0)
+		return NULL;
+	printbuf_terminate_string(pb);
+	if (len != NULL)
+		*len = pb->bpos;
+	return pb->buf;
 }
 
 
+/* fjson_object_object */
+
 static void fjson_object_object_delete(struct fjson_object *const __restrict__ jso)
 {
 	struct _fjson_child_pg *pg = &jso->o.c_obj.pg;
 	struct _fjson_child_pg *del = NULL; /* do NOT delete first elt! */
 	while (pg != NULL) {
-		for (int i = 0 ; i < FJSON_OBJECT_CHLD_PG_SIZE ; ++i) {
+		for (int i = 0 ; i < pg->size ; ++i) {
 			if (pg->children[i].k == NULL)
 				continue; /* indicates empty slot */
-			if(!pg->children[i].flags.k_is_constant)
-				free ((void*)pg->children[i].k);
+			if(!pg->children[i].k_is_constant)
+				jso_key_put(jso, pg->children[i].k);
+			jso_detach(jso, pg->children[i].v);
 			fjson_object_put (pg->children[i].v);
 		}
 		pg = pg->next;
-		free(del);
+		jso_pg_free(jso, del);
 		del = pg;
 	}
+	jso_free(jso, jso->o.c_obj.idx);
 	fjson_object_generic_delete(jso);
 }
 
 struct fjson_object* fjson_object_new_object(void)
 {
-	struct fjson_object *jso = fjson_object_new(fjson_type_object);
+	return _fjson_object_new_object_a(NULL);
+}
+
+struct fjson_object* fjson_object_new_object_ctx(const struct fjson_ctx *ctx)
+{
+	struct fjson_object *const jso = _fjson_object_new_object_a(NULL);
+	if (jso != NULL && ctx != NULL)
+		jso->_flags.key_cmp = ctx->key_cmp;
+	return jso;
+}
+
+struct fjson_object* _fjson_object_new_object_a(struct fjson_arena *const arena)
+{
+	struct fjson_object *jso = fjson_object_new(fjson_type_object, jso_node_size(fjson_type_object, 0), arena);
 	if (!jso)
 		return NULL;
-	jso->_delete = &fjson_object_object_delete;
-	jso->_to_json_string = &fjson_object_object_to_json_string;
 	jso->o.c_obj.nelem = 0;
+	jso->o.c_obj.pg.children = jso->o.c_obj.first;
+	jso->o.c_obj.pg.freemap = jso->o.c_obj.firstmap;
+	jso->o.c_obj.pg.size = FJSON_OBJECT_CHLD_PG_SIZE;
 	jso->o.c_obj.lastpg = &jso->o.c_obj.pg;
 	return jso;
 }
 
 
-/* finds the child with given key if it exists in a json object
- * and returns a pointer to it. Returns NULL if not found.
+/* hash index for large objects
+ *
+ * Members are kept in insertion order inside the children pages, as
+ * required by the iterator and the serializers. Searching them is a
+ * linear scan, which becomes a bottleneck for objects with many
+ * members. So once an object has more than FJSON_OBJECT_HASH_THRESHOLD
+ * members, we keep an open-addressing hash table that points into the
+ * pages, so it does not interfere with ordering. It is only ever built
+ * and updated by the functions that modify the object (adding members,
+ * compaction, copies), never by lookups: trees may be read by several
+ * threads at once, and a lookup must not write to them. Child entries
+ * only move when the object is compacted, which rebuilds the index.
+ * The hash is computed over the ASCII-lowercased key and also stored in
+ * the child entry, where it lets the linear scan skip mismatches
+ * cheaply. That way the same index serves both the case-sensitive and
+ * case-insensitive comparison modes, even if the mode is changed while
+ * the object exists; the comparison function has the final word on
+ * whether a candidate matches.
  */
-static struct _fjson_child*
-_fjson_find_child(struct fjson_object *const __restrict__ jso,
-	const char *const key)
-{
-	struct fjson_object_iterator it = fjson_object_iter_begin(jso);
-	struct fjson_object_iterator itEnd = fjson_object_iter_end(jso);
-	while (!fjson_object_iter_equal(&it, &itEnd)) {
-		if (do_case_sensitive_comparison) {
-			if (!strcmp (key, fjson_object_iter_peek_name(&it)))
-				return _fjson_object_iter_peek_child(&it);
-		} else {
-			if (!strcasecmp (key, fjson_object_iter_peek_name(&it)))
-				return _fjson_object_iter_peek_child(&it);
-		}
-		fjson_object_iter_next(&it);
-	}
-	return NULL;
+static struct _fjson_child idx_tombstone; /* marks deleted index slots */
+
+/* insert a child into an index that is known to have enough free slots */
+static void
+_fjson_idx_put(struct _fjson_child_idx *const __restrict__ idx,
+	const uint32_t hash,
+	struct _fjson_child *const chld)
+{
+	const int mask = idx->size - 1;
+	int i = hash & mask;
+	while (idx->slots[i].chld != NULL && idx->slots[i].chld != &idx_tombstone)
+		i = (i + 1) & mask;
+	if (idx->slots[i].chld == &idx_tombstone)
+		--idx->ntomb;
+	idx->slots[i].hash = hash;
+	idx->slots[i].chld = chld;
+	++idx->nused;
 }
 
-/* get an empty entry/slot for adding a new child. If the current data
- * structure is full, alloc a new page. Returns NULL on (malloc) error.
+/* (re)build the index so that it can hold at least nelem entries while
+ * staying at most half full. Returns 0 on success, -1 on malloc error,
+ * in which case the object simply continues to work without an index.
  */
-static struct _fjson_child *
-fjson_child_get_empty_etry(struct fjson_object *const __restrict__ jso)
+static int
+_fjson_idx_rebuild(struct fjson_object *const __restrict__ jso, const int nelem)
 {
-	struct _fjson_child *chld = NULL;
-	struct _fjson_child_pg *pg;
-	int pg_idx;
+	struct _fjson_child_idx *const old = jso->o.c_obj.idx;
+	struct _fjson_child_idx *idx;
+	int size = FJSON_OBJECT_HASH_THRESHOLD * 4;
+	int i;
+
+	while (size < nelem * 2)
+		size *= 2;
+	idx = (struct _fjson_child_idx *) jso_calloc(jso, sizeof(struct _fjson_child_idx)
+		+ size * sizeof(struct _fjson_child_idx_slot));
+	if (idx == NULL) {
+		jso_free(jso, old);
+		jso->o.c_obj.idx = NULL;
+		return -1;
+	}
+	idx->size = size;
 
-	if (jso->o.c_obj.ndeleted > 0) {
-		/* we first fill deleted spots */
-		pg = &jso->o.c_obj.pg;
-		while (chld == NULL) {
-			for (int i = 0 ; i < FJSON_OBJECT_CHLD_PG_SIZE ; ++i) {
-				if(pg->children[i].k == NULL) {
-					chld = &(pg->children[i]);
-					--jso->o.c_obj.ndeleted;
-					goto done;
-				}
-			}
-			pg = pg->next;
+	if (old != NULL) {
+		for (i = 0 ; i < old->size ; ++i) {
+			if (old->slots[i].chld != NULL && old->slots[i].chld != &idx_tombstone)
+				_fjson_idx_put(idx, old->slots[i].hash, old->slots[i].chld);
+		}
+		jso_free(jso, old);
+	} else {
+		struct fjson_object_iterator it = fjson_object_iter_begin(jso);
+		struct fjson_object_iterator itEnd = fjson_object_iter_end(jso);
+		while (!fjson_object_iter_equal(&it, &itEnd)) {
+			struct _fjson_child *const chld = _fjson_object_iter_peek_child(&it);
+			_fjson_idx_put(idx, chld->hash, chld);
+			fjson_object_iter_next(&it);
 		}
-		/* if we reach this point, we have a program error */
-		assert(0);
-		goto done;
 	}
+	jso->o.c_obj.idx = idx;
+	return 0;
+}
 
-	pg_idx = jso->o.c_obj.nelem % FJSON_OBJECT_CHLD_PG_SIZE;
-	if (jso->o.c_obj.nelem > 0 && pg_idx == 0) {
-		if((pg = calloc(1, sizeof(struct _fjson_child_pg))) == NULL) {
-			errno = ENOMEM;
-			goto done;
+/* add a freshly inserted (and already counted) child to the index. If
+ * the object has just grown beyond the threshold, or an earlier attempt
+ * ran out of memory, the index is built instead, which includes chld.
+ */
+static void
+_fjson_idx_add(struct fjson_object *const __restrict__ jso,
+	struct _fjson_child *const chld)
+{
+	struct _fjson_child_idx *const idx = jso->o.c_obj.idx;
+	if (idx == NULL) {
+		if (jso->o.c_obj.nelem > FJSON_OBJECT_HASH_THRESHOLD)
+			_fjson_idx_rebuild(jso, jso->o.c_obj.nelem);
+		return;
+	}
+	if ((idx->nused + idx->ntomb + 1) * 2 > idx->size) {
+		if (_fjson_idx_rebuild(jso, idx->nused + 1) != 0)
+			return;
+	}
+	_fjson_idx_put(jso->o.c_obj.idx, chld->hash, chld);
+}
+
+/* remove a child (which is about to be deleted) from the index */
+static void
+_fjson_idx_del(struct fjson_object *const __restrict__ jso,
+	const struct _fjson_child *const chld)
+{
+	struct _fjson_child_idx *const idx = jso->o.c_obj.idx;
+	if (idx == NULL)
+		return;
+	const int mask = idx->size - 1;
+	int i = chld->hash & mask;
+	while (idx->slots[i].chld != NULL) {
+		if (idx->slots[i].chld == chld) {
+			idx->slots[i].chld = &idx_tombstone;
+			--idx->nused;
+			++idx->ntomb;
+			return;
 		}
-		jso->o.c_obj.lastpg->next = pg;
-		jso->o.c_obj.lastpg = pg;
+		i = (i + 1) & mask;
 	}
-	pg = jso->o.c_obj.lastpg;
-	if (pg->children[pg_idx].k == NULL) {
-		/* we can use this spot and save us search time */
-		chld = &(pg->children[pg_idx]);
+}
+
+/* finds the child with given key if it exists in a json object
+ * and returns a pointer to it. Returns NULL if not found.
+ * h and len are the key's hash and length as by _fjson_key_hash().
+ * The key need not be NUL-terminated. Interned keys are found by
+ * pointer comparison.
+ */
+static struct _fjson_child*
+_fjson_find_child(struct fjson_object *const __restrict__ jso,
+	const char *const key,
+	const uint32_t h,
+	const unsigned len)
+{
+	const int case_sensitive = (jso->_flags.key_cmp == JSO_KEY_CMP_GLOBAL)
+		? do_case_sensitive_comparison : jso->_flags.key_cmp == JSO_KEY_CMP_CASE;
+	int (*const cmp)(const char *, const char *, size_t) = case_sensitive ? strncmp : strncasecmp;
+
+	struct _fjson_child *found = NULL;
+	unsigned probes = 0;
+
+	if (jso->o.c_obj.idx != NULL) {
+		const struct _fjson_child_idx *const idx = jso->o.c_obj.idx;
+		const int mask = idx->size - 1;
+		int i = h & mask;
+		while (idx->slots[i].chld != NULL) {
+			++probes;
+			if (idx->slots[i].hash == h && idx->slots[i].chld != &idx_tombstone
+			    && idx->slots[i].chld->klen == len
+			    && (idx->slots[i].chld->k == key || !cmp(key, idx->slots[i].chld->k, len))) {
+				found = idx->slots[i].chld;
+				goto done;
+			}
+			i = (i + 1) & mask;
+		}
 		goto done;
 	}
 
+	struct _fjson_child_pg *pg;
+	for (pg = &jso->o.c_obj.pg ; pg != NULL ; pg = pg->next) {
+		const int n = (pg == jso->o.c_obj.lastpg) ? jso->o.c_obj.lastpg_used : pg->size;
+		for (int i = 0 ; i < n ; ++i) {
+			struct _fjson_child *const chld = &pg->children[i];
+			++probes;
+			/* deleted entries have k == NULL */
+			if (chld->hash == h && chld->klen == len && chld->k != NULL
+			    && (chld->k == key || !cmp(key, chld->k, len))) {
+				found = chld;
+				goto done;
+			}
+		}
+	}
+done:
+	FJSON_STAT_INC(lookups);
+	FJSON_STAT_ADD(lookup_probes, probes);
+	FJSON_STAT_MAX(lookup_probes_max, probes);
+	return found;
+}
+
+/* append a page of given size, which becomes the one new entries are
+ * taken from. Returns -1 on (malloc) error.
+ */
+static int
+jso_pg_append(struct fjson_object *const __restrict__ jso, const int size)
+{
+	struct _fjson_child_pg *const pg = jso_pg_alloc(jso, size);
+	if (pg == NULL) {
+		errno = ENOMEM;
+		return -1;
+	}
+	pg->children = (struct _fjson_child *) (pg + 1);
+	pg->freemap = (uint64_t *) (pg->children + size);
+	pg->size = size;
+	jso->o.c_obj.lastpg->next = pg;
+	jso->o.c_obj.lastpg = pg;
+	jso->o.c_obj.lastpg_used = 0;
+	return 0;
+}
+
+/* get an empty entry/slot for adding a new child. If the current data
+ * structure is full, alloc a new page. Returns NULL on (malloc) error.
+ */
+static struct _fjson_child *
+fjson_child_get_empty_etry(struct fjson_object *const __restrict__ jso)
+{
+	struct _fjson_child *chld = NULL;
+	struct _fjson_child_pg *pg;
+
+	if (jso->o.c_obj.ndeleted > 0) {
+		/* we first fill deleted spots, the lowest one first */
+		for (pg = &jso->o.c_obj.pg ; pg->nfree == 0 ; pg = pg->next)
+			;
+		for (int w = 0 ; ; ++w) {
+			if (pg->freemap[w] != 0) {
+				const int bit = __builtin_ctzll(pg->freemap[w]);
+				pg->freemap[w] &= pg->freemap[w] - 1;
+				--pg->nfree;
+				--jso->o.c_obj.ndeleted;
+				chld = &pg->children[w * 64 + bit];
+				goto done;
+			}
+		}
+	}
+
+	pg = jso->o.c_obj.lastpg;
+	if (jso->o.c_obj.lastpg_used == pg->size) {
+		/* grow geometrically, so wide objects need few pages */
+		const int size = (pg->size < FJSON_OBJECT_CHLD_PG_MAX) ? pg->size * 2 : pg->size;
+		if (jso_pg_append(jso, size) != 0)
+			goto done;
+		pg = jso->o.c_obj.lastpg;
+	}
+	chld = &(pg->children[jso->o.c_obj.lastpg_used++]);
+
 done:	return chld;
 }
 
-void fjson_object_object_add_ex(struct fjson_object *const __restrict__ jso,
+/* make sure at least n more children can be added without allocating.
+ * If the last page is too small, we leave its unused entries behind as
+ * deleted ones, so they are still filled first. Returns -1 on (malloc)
+ * error.
+ */
+static int
+jso_object_reserve(struct fjson_object *const __restrict__ jso, const int n)
+{
+	struct _fjson_child_pg *const pg = jso->o.c_obj.lastpg;
+	const int used = jso->o.c_obj.lastpg_used;
+	const int avail = jso->o.c_obj.ndeleted + pg->size - used;
+	int size;
+
+	if (n <= avail)
+		return 0;
+	size = (pg->size < FJSON_OBJECT_CHLD_PG_MAX) ? pg->size * 2 : pg->size;
+	if (size < n - avail)
+		size = n - avail;
+	if (jso_pg_append(jso, size) != 0)
+		return -1;
+	for (int i = used ; i < pg->size ; ++i) {
+		pg->freemap[i / 64] |= (uint64_t) 1 << (i % 64);
+		++pg->nfree;
+		++jso->o.c_obj.ndeleted;
+	}
+	return 0;
+}
+
+static void _fjson_object_compact(struct fjson_object *const __restrict__ jso);
+#define JSO_HOLES_DOMINATE(jso) ((jso)->o.c_obj.ndeleted > FJSON_OBJECT_CHLD_PG_SIZE \
+	&& (jso)->o.c_obj.ndeleted > (jso)->o.c_obj.nelem)
+
+/* add or replace a member whose key hash and length are known. ikey is
+ * the dictionary entry of an interned key, or NULL. Returns -1 if out of
+ * memory, in which case val is not added.
+ */
+static int
+jso_object_add(struct fjson_object *const __restrict__ jso,
 	const char *const key,
+	const unsigned klen,
+	const uint32_t hash,
+	const struct _fjson_key *const ikey,
 	struct fjson_object *const val,
 	const unsigned opts)
 {
 	// We lookup the entry and replace the value, rather than just deleting
 	// and re-adding it, so the existing key remains valid.
-	struct _fjson_child *chld;
-	chld = (opts & FJSON_OBJECT_ADD_KEY_IS_NEW) ? NULL : _fjson_find_child(jso, key);
+	struct _fjson_child *chld = NULL;
+	if (!(opts & FJSON_OBJECT_ADD_KEY_IS_NEW))
+		chld = _fjson_find_child(jso, key, hash, klen);
 	if (chld != NULL) {
+		jso_detach(jso, chld->v);
+		jso_attach(jso, val);
 		if (chld->v != NULL)
 			fjson_object_put(chld->v);
 		chld->v = val;
-		goto done;
+		return 0;
 	}
 
-	/* insert new entry */
-	if ((chld = fjson_child_get_empty_etry(jso)) == NULL)
-		goto done;
-	chld->k = (opts & FJSON_OBJECT_KEY_IS_CONSTANT) ? key : strdup(key);
-	chld->flags.k_is_constant = (opts & FJSON_OBJECT_KEY_IS_CONSTANT) != 0;
+	/* if holes dominate, iteration pays for them; get rid of them here,
+	 * as deletes must not move the children under an iterator
+	 */
+	if (JSO_HOLES_DOMINATE(jso))
+		_fjson_object_compact(jso);
+	/* insert new entry; the key is copied first, as a slot cannot
+	 * be given back
+	 */
+	const int k_is_constant = (opts & (FJSON_OBJECT_KEY_IS_CONSTANT | FJSON_OBJECT_KEY_IS_INTERNED)) != 0;
+	char *const k = k_is_constant ? NULL : jso_key_new(jso, key);
+	if (!k_is_constant && k == NULL)
+		return -1;
+	if ((chld = fjson_child_get_empty_etry(jso)) == NULL) {
+		jso_key_put(jso, k);
+		return -1;
+	}
+	chld->k = k_is_constant ? key : k;
+	chld->k_is_constant = k_is_constant;
+	chld->hash = hash;
+	chld->klen = klen;
+	/* the serializers can then copy the key as it is */
+	chld->k_no_escape = (ikey != NULL) ? ikey->no_escape
+		: _fjson_scan_escape(key, key + klen) == key + klen;
+	jso_attach(jso, val);
 	chld->v = val;
 	++jso->o.c_obj.nelem;
+	_fjson_idx_add(jso, chld);
+	return 0;
+}
 
-done:
-	return;
+void fjson_object_object_add_ex(struct fjson_object *const __restrict__ jso,
+	const char *const key,
+	struct fjson_object *const val,
+	const unsigned opts)
+{
+	const struct _fjson_key *ikey = NULL;
+	uint32_t hash;
+	unsigned klen;
+	if (opts & FJSON_OBJECT_KEY_IS_INTERNED) {
+		ikey = _fjson_key_of(key);
+		hash = ikey->hash;
+		klen = ikey->len;
+	} else {
+		hash = _fjson_key_hash(key, &klen);
+	}
+	jso_object_add(jso, key, klen, hash, ikey, val, opts);
+}
+
+int _fjson_object_object_add_hashed(struct fjson_object *const jso, const char *const key,
+	const unsigned klen, const uint32_t hash, struct fjson_object *const val)
+{
+	return jso_object_add(jso, key, klen, hash, NULL, val, 0);
 }
 
 void fjson_object_object_add(struct fjson_object *const __restrict__ jso,
@@ -484,6 +1149,32 @@ struct fjson_object* fjson_object_object_get(struct fjson_object* jso, const cha
 }
 
 fjson_bool fjson_object_object_get_ex(struct fjson_object* jso, const char *key, struct fjson_object **value)
+{
+	unsigned klen;
+	uint32_t hash;
+
+	if (jso == NULL || jso->o_type != fjson_type_object) {
+		if (value != NULL)
+			*value = NULL;
+		return FALSE;
+	}
+	hash = _fjson_key_hash(key, &klen);
+	return fjson_object_object_get_ex_len(jso, key, (int) klen, hash, value);
+}
+
+uint32_t fjson_object_key_hash(const char *const key, const int keylen)
+{
+	unsigned klen;
+	if (keylen == -1)
+		return _fjson_key_hash(key, &klen);
+	return _fjson_key_hash_len(key, keylen);
+}
+
+fjson_bool fjson_object_object_get_ex_len(struct fjson_object *const jso,
+	const char *const key,
+	const int keylen,
+	const uint32_t hash,
+	struct fjson_object **const value)
 {
 	if (value != NULL)
 		*value = NULL;
@@ -492,7 +1183,8 @@ fjson_bool fjson_object_object_get_ex(struct fjson_object* jso, const char *key,
 		return FALSE;
 
 	if(jso->o_type == fjson_type_object) {
-		struct _fjson_child *const chld = _fjson_find_child(jso, key);
+		const unsigned klen = KLEN((keylen == -1) ? strlen(key) : (size_t) keylen);
+		struct _fjson_child *const chld = _fjson_find_child(jso, key, hash, klen);
 		if (chld == 0) {
 			return FALSE;
 		} else {
@@ -507,45 +1199,118 @@ fjson_bool fjson_object_object_get_ex(struct fjson_object* jso, const char *key,
 	}
 }
 
-void fjson_object_object_del(struct fjson_object* jso, const char *key)
+/* record a deleted entry in the free map of its page */
+static void
+_fjson_mark_free(struct fjson_object *const __restrict__ jso,
+	struct _fjson_child *const chld)
 {
-	struct _fjson_child *const chld = _fjson_find_child(jso, key);
-	if (chld != NULL) {
-		if(!chld->flags.k_is_constant) {
-			free((void*)chld->k);
+	struct _fjson_child_pg *pg;
+	for (pg = &jso->o.c_obj.pg ; chld >= pg->children + pg->size || chld < pg->children ;
+	     pg = pg->next)
+		;
+	const int i = chld - pg->children;
+	pg->freemap[i / 64] |= (uint64_t) 1 << (i % 64);
+	++pg->nfree;
+}
+
+/* move all children to the front, keeping their order, and release the
+ * pages no longer needed. This invalidates pointers to children, so
+ * the index is built anew.
+ */
+static void
+_fjson_object_compact(struct fjson_object *const __restrict__ jso)
+{
+	struct _fjson_child_pg *wpg = &jso->o.c_obj.pg;
+	struct _fjson_child_pg *pg, *next;
+	int widx = 0;
+
+	for (pg = &jso->o.c_obj.pg ; pg != NULL ; pg = pg->next) {
+		const int n = (pg == jso->o.c_obj.lastpg) ? jso->o.c_obj.lastpg_used : pg->size;
+		for (int i = 0 ; i < n ; ++i) {
+			if (pg->children[i].k == NULL)
+				continue;
+			if (widx == wpg->size) {
+				wpg = wpg->next;
+				widx = 0;
+			}
+			if (&wpg->children[widx] != &pg->children[i])
+				wpg->children[widx] = pg->children[i];
+			++widx;
 		}
-		fjson_object_put(chld->v);
-		chld->flags.k_is_constant = 0;
-		chld->k = NULL;
-		chld->v = NULL;
-		--jso->o.c_obj.nelem;
-		++jso->o.c_obj.ndeleted;
 	}
+	if (widx == 0 && wpg != &jso->o.c_obj.pg) {
+		/* wpg itself is not needed; its predecessor ends up full */
+		for (pg = &jso->o.c_obj.pg ; pg->next != wpg ; pg = pg->next)
+			;
+		wpg = pg;
+		widx = pg->size;
+	}
+	memset(&wpg->children[widx], 0, (wpg->size - widx) * sizeof(struct _fjson_child));
+	for (pg = &jso->o.c_obj.pg ; pg != wpg->next ; pg = pg->next) {
+		memset(pg->freemap, 0, JSO_FREEMAP_WORDS(pg->size) * sizeof(uint64_t));
+		pg->nfree = 0;
+	}
+	for (pg = wpg->next ; pg != NULL ; pg = next) {
+		next = pg->next;
+		jso_pg_free(jso, pg);
+	}
+	wpg->next = NULL;
+	jso->o.c_obj.lastpg = wpg;
+	jso->o.c_obj.lastpg_used = widx;
+	jso->o.c_obj.ndeleted = 0;
+	jso_free(jso, jso->o.c_obj.idx);
+	jso->o.c_obj.idx = NULL;
+	if (jso->o.c_obj.nelem > FJSON_OBJECT_HASH_THRESHOLD)
+		_fjson_idx_rebuild(jso, jso->o.c_obj.nelem);
+}
+
+/* remove a child. The others stay where they are, so an iterator that
+ * has already moved past chld remains valid.
+ */
+static void
+jso_del_child(struct fjson_object *const __restrict__ jso, struct _fjson_child *const chld)
+{
+	_fjson_idx_del(jso, chld);
+	if(!chld->k_is_constant) {
+		jso_key_put(jso, chld->k);
+	}
+	jso_detach(jso, chld->v);
+	fjson_object_put(chld->v);
+	chld->k_is_constant = 0;
+	chld->k = NULL;
+	chld->v = NULL;
+	_fjson_mark_free(jso, chld);
+	--jso->o.c_obj.nelem;
+	++jso->o.c_obj.ndeleted;
+}
+
+void fjson_object_object_del(struct fjson_object* jso, const char *key)
+{
+	unsigned klen;
+	const uint32_t hash = _fjson_key_hash(key, &klen);
+	struct _fjson_child *const chld = _fjson_find_child(jso, key, hash, klen);
+	if (chld != NULL)
+		jso_del_child(jso, chld);
+}
+
+void fjson_object_object_compact(struct fjson_object *const jso)
+{
+	if (jso != NULL && jso->o_type == fjson_type_object && jso->o.c_obj.ndeleted > 0)
+		_fjson_object_compact(jso);
 }
 
 
 /* fjson_object_boolean */
 
-static int fjson_object_boolean_to_json_string(struct fjson_object* jso,
-						  struct printbuf *pb,
-						  int __attribute__((unused)) level,
-						  int __attribute__((unused)) flags)
+struct fjson_object* fjson_object_new_boolean(fjson_bool b)
 {
-	if (jso->o.c_boolean)
-		printbuf_memappend_no_nul(pb, "true", 4);
-	else
-		printbuf_memappend_no_nul(pb, "false", 5);
-	return 0; /* we need to keep compatible with the API */
+	return _fjson_object_new_boolean_a(NULL, b);
 }
 
-struct fjson_object* fjson_object_new_boolean(fjson_bool b)
+struct fjson_object* _fjson_object_new_boolean_a(struct fjson_arena __attribute__((unused)) *const arena,
+	fjson_bool b)
 {
-	struct fjson_object *jso = fjson_object_new(fjson_type_boolean);
-	if (!jso)
-		return NULL;
-	jso->_to_json_string = &fjson_object_boolean_to_json_string;
-	jso->o.c_boolean = b;
-	return jso;
+	return b ? JSO_STATIC(jso_true) : JSO_STATIC(jso_false);
 }
 
 fjson_bool fjson_object_get_boolean(struct fjson_object *jso)
@@ -573,23 +1338,9 @@ fjson_bool fjson_object_get_boolean(struct fjson_object *jso)
 
 /* fjson_object_int */
 
-static int fjson_object_int_to_json_string(struct fjson_object* jso,
-					  struct printbuf *pb,
-					  int __attribute__((unused)) level,
-					  int __attribute__((unused)) flags)
-{
-	sprintbuf(pb, "%" PRId64, jso->o.c_int64);
-	return 0; /* we need to keep compatible with the API */
-}
-
 struct fjson_object* fjson_object_new_int(int32_t i)
 {
-	struct fjson_object *jso = fjson_object_new(fjson_type_int);
-	if (!jso)
-		return NULL;
-	jso->_to_json_string = &fjson_object_int_to_json_string;
-	jso->o.c_int64 = i;
-	return jso;
+	return _fjson_object_new_int64_a(NULL, i);
 }
 
 int32_t fjson_object_get_int(struct fjson_object *jso)
@@ -607,7 +1358,8 @@ int32_t fjson_object_get_int(struct fjson_object *jso)
 		 * Parse strings into 64-bit numbers, then use the
 		 * 64-to-32-bit number handling below.
 		 */
-		if (fjson_parse_int64(get_string_component(jso), &cint64) != 0)
+		const char *const str = get_string_cstr(jso);
+		if (str == NULL || fjson_parse_int64(str, &cint64) != 0)
 			return 0; /* whoops, it didn't work. */
 		o_type = fjson_type_int;
 	}
@@ -636,10 +1388,17 @@ int32_t fjson_object_get_int(struct fjson_object *jso)
 
 struct fjson_object* fjson_object_new_int64(int64_t i)
 {
-	struct fjson_object *jso = fjson_object_new(fjson_type_int);
+	return _fjson_object_new_int64_a(NULL, i);
+}
+
+struct fjson_object* _fjson_object_new_int64_a(struct fjson_arena *const arena, int64_t i)
+{
+	if (i >= JSO_SMALL_INT_MIN && i <= JSO_SMALL_INT_MAX)
+		return JSO_STATIC(jso_small_ints[i - JSO_SMALL_INT_MIN]);
+	struct fjson_object *jso = fjson_object_new(fjson_type_int,
+		jso_node_size(fjson_type_int, 0), arena);
 	if (!jso)
 		return NULL;
-	jso->_to_json_string = &fjson_object_int_to_json_string;
 	jso->o.c_int64 = i;
 	return jso;
 }
@@ -659,6 +1418,7 @@ uint32_t fjson_object_get_uint(struct fjson_object *jso)
 int64_t fjson_object_get_int64(struct fjson_object *jso)
 {
 	int64_t cint;
+	const char *str;
 
 	if (!jso)
 		return 0;
@@ -671,7 +1431,8 @@ int64_t fjson_object_get_int64(struct fjson_object *jso)
 	case fjson_type_boolean:
 		return jso->o.c_boolean;
 	case fjson_type_string:
-		if (fjson_parse_int64(get_string_component(jso), &cint) == 0)
+		str = get_string_cstr(jso);
+		if (str != NULL && fjson_parse_int64(str, &cint) == 0)
 			return cint;
 		ATTR_FALLTHROUGH
 	case fjson_type_null:
@@ -685,69 +1446,22 @@ int64_t fjson_object_get_int64(struct fjson_object *jso)
 
 /* fjson_object_double */
 
-static int fjson_object_double_to_json_string(struct fjson_object* jso,
-						 struct printbuf *pb,
-						 int __attribute__((unused)) level,
-						 int __attribute__((unused)) flags)
-{
-	char buf[128], *p, *q;
-	int size;
-	double dummy;  /* needed for modf() */
-	
-	if (jso->o.c_double.source) {
-		printbuf_memappend_no_nul(pb, jso->o.c_double.source, strlen(jso->o.c_double.source));
-		return 0; /* we need to keep compatible with the API */
-	}
-	
-	/* Although JSON RFC does not support
-	 * NaN or Infinity as numeric values
-	 * ECMA 262 section 9.8.1 defines
-	 * how to handle these cases as strings
-	 */
-	if(isnan(jso->o.c_double.value))
-		size = snprintf(buf, sizeof(buf), "NaN");
-	else if(isinf(jso->o.c_double.value))
-		if(jso->o.c_double.value > 0)
-			size = snprintf(buf, sizeof(buf), "Infinity");
-		else
-			size = snprintf(buf, sizeof(buf), "-Infinity");
-	else
-		size = snprintf(buf, sizeof(buf),
-			(modf(jso->o.c_double.value, &dummy)==0)?"%.17g.0":"%.17g",
-			jso->o.c_double.value);
-
-	p = strchr(buf, ',');
-	if (p) {
-		*p = '.';
-	} else {
-		p = strchr(buf, '.');
-	}
-	if (p && (flags & FJSON_TO_STRING_NOZERO)) {
-		/* last useful digit, always keep 1 zero */
-		p++;
-		for (q=p ; *q ; q++) {
-			if (*q!='0') p=q;
-		}
-		/* drop trailing zeroes */
-		*(++p) = 0;
-		size = p-buf;
-	}
-	printbuf_memappend_no_nul(pb, buf, size);
-	return 0; /* we need to keep compatible with the API */
-}
-
 static void fjson_object_double_delete(struct fjson_object *jso)
 {
-	free(jso->o.c_double.source);
+	jso_free(jso, jso->o.c_double.source);
 	fjson_object_generic_delete(jso);
 }
 
 struct fjson_object* fjson_object_new_double(double d)
 {
-	struct fjson_object *jso = fjson_object_new(fjson_type_double);
+	return _fjson_object_new_double_a(NULL, d);
+}
+
+struct fjson_object* _fjson_object_new_double_a(struct fjson_arena *const arena, double d)
+{
+	struct fjson_object *jso = fjson_object_new(fjson_type_double, jso_node_size(fjson_type_double, 0), arena);
 	if (!jso)
 		return NULL;
-	jso->_to_json_string = &fjson_object_double_to_json_string;
 	jso->o.c_double.value = d;
 	jso->o.c_double.source = NULL;
 	return jso;
@@ -755,24 +1469,30 @@ struct fjson_object* fjson_object_new_double(double d)
 
 struct fjson_object* fjson_object_new_double_s(double d, const char *ds)
 {
-	struct fjson_object *jso = fjson_object_new_double(d);
+	return _fjson_object_new_double_s_a(NULL, d, ds, strlen(ds));
+}
+
+struct fjson_object* _fjson_object_new_double_s_a(struct fjson_arena *const arena,
+	double d, const char *ds, size_t len)
+{
+	struct fjson_object *jso = _fjson_object_new_double_a(arena, d);
 	if (!jso)
 		return NULL;
 
-	jso->o.c_double.source = strdup(ds);
+	jso->o.c_double.source = jso_memdup(jso, ds, len);
 	if (!jso->o.c_double.source)
 	{
 		fjson_object_generic_delete(jso);
 		errno = ENOMEM;
 		return NULL;
 	}
-	jso->_delete = &fjson_object_double_delete;
 	return jso;
 }
 
 double fjson_object_get_double(struct fjson_object *jso)
 {
 	double cdouble;
+	const char *str;
 	char *errPtr = NULL;
 
 	if(!jso) return 0.0;
@@ -784,11 +1504,13 @@ double fjson_object_get_double(struct fjson_object *jso)
 	case fjson_type_boolean:
 		return jso->o.c_boolean;
 	case fjson_type_string:
+		if ((str = get_string_cstr(jso)) == NULL)
+			return 0.0;
 		errno = 0;
-		cdouble = strtod(get_string_component(jso), &errPtr);
+		cdouble = strtod(str, &errPtr);
 
 		/* if conversion stopped at the first character, return 0.0 */
-		if (errPtr == get_string_component(jso))
+		if (errPtr == str)
 			return 0.0;
 
 		/*
@@ -825,36 +1547,27 @@ double fjson_object_get_double(struct fjson_object *jso)
 
 /* fjson_object_string */
 
-static int fjson_object_string_to_json_string(struct fjson_object* jso,
-						 struct printbuf *pb,
-						 int __attribute__((unused)) level,
-						 int __attribute__((unused)) flags)
-{
-	printbuf_memappend_char(pb, '\"');
-	fjson_escape_str(pb, get_string_component(jso));
-	printbuf_memappend_char(pb, '\"');
-	return 0; /* we need to keep compatible with the API */
-}
-
 static void fjson_object_string_delete(struct fjson_object* jso)
 {
-	if(jso->o.c_string.len >= LEN_DIRECT_STRING_DATA)
-		free(jso->o.c_string.str.ptr);
+	if(jso->o.c_string.len >= LEN_DIRECT_STRING_DATA && !jso->_flags.str_ref)
+		jso_free(jso, jso->o.c_string.str.ptr);
 	fjson_object_generic_delete(jso);
 }
 
 struct fjson_object* fjson_object_new_string(const char *s)
 {
-	struct fjson_object *jso = fjson_object_new(fjson_type_string);
+	const int len = strlen(s);
+	if (len == 0)
+		return JSO_STATIC(jso_empty_string);
+	struct fjson_object *jso = fjson_object_new(fjson_type_string,
+		jso_node_size(fjson_type_string, len), NULL);
 	if (!jso)
 		return NULL;
-	jso->_delete = &fjson_object_string_delete;
-	jso->_to_json_string = &fjson_object_string_to_json_string;
-	jso->o.c_string.len = strlen(s);
+	jso->o.c_string.len = len;
 	if(jso->o.c_string.len < LEN_DIRECT_STRING_DATA) {
 		memcpy(jso->o.c_string.str.data, s, jso->o.c_string.len);
 	} else {
-		jso->o.c_string.str.ptr = strdup(s);
+		jso->o.c_string.str.ptr = _fjson_strdup(s);
 		if (!jso->o.c_string.str.ptr)
 		{
 			fjson_object_generic_delete(jso);
@@ -866,17 +1579,25 @@ struct fjson_object* fjson_object_new_string(const char *s)
 }
 
 struct fjson_object* fjson_object_new_string_len(const char *s, int len)
+{
+	return _fjson_object_new_string_len_a(NULL, s, len);
+}
+
+struct fjson_object* _fjson_object_new_string_len_a(struct fjson_arena *const arena,
+	const char *s, int len)
 {
 	char *dstbuf;
-	struct fjson_object *jso = fjson_object_new(fjson_type_string);
+	if (len == 0)
+		return JSO_STATIC(jso_empty_string);
+	struct fjson_object *jso = fjson_object_new(fjson_type_string,
+		jso_node_size(fjson_type_string, len), arena);
 	if (!jso)
 		return NULL;
-	jso->_delete = &fjson_object_string_delete;
-	jso->_to_json_string = &fjson_object_string_to_json_string;
+	jso->o.c_string.len = len; /* the node size depends on it */
 	if(len < LEN_DIRECT_STRING_DATA) {
 		dstbuf = jso->o.c_string.str.data;
 	} else {
-		jso->o.c_string.str.ptr = (char*)malloc(len + 1);
+		jso->o.c_string.str.ptr = (char*)jso_alloc(jso, len + 1);
 		if (!jso->o.c_string.str.ptr)
 		{
 			fjson_object_generic_delete(jso);
@@ -887,16 +1608,93 @@ struct fjson_object* fjson_object_new_string_len(const char *s, int len)
 	}
 	memcpy(dstbuf, (void *)s, len);
 	dstbuf[len] = '\0';
+	return jso;
+}
+
+struct fjson_object* _fjson_object_new_string_ref_a(struct fjson_arena *const arena,
+	const char *const s, const int len)
+{
+	struct fjson_object *jso;
+	if(len < LEN_DIRECT_STRING_DATA)
+		return _fjson_object_new_string_len_a(arena, s, len);
+	if (!(jso = fjson_object_new(fjson_type_string, jso_node_size(fjson_type_string, len), arena)))
+		return NULL;
+	jso->_flags.str_ref = 1;
+	jso->o.c_string.str.ptr = (char*)s;
 	jso->o.c_string.len = len;
 	return jso;
 }
 
+struct fjson_object* _fjson_object_new_string_inplace_a(struct fjson_arena *const arena,
+	const char *const s, const int len)
+{
+	struct fjson_object *const jso = _fjson_object_new_string_ref_a(arena, s, len);
+	if (jso != NULL && jso->_flags.str_ref)
+		jso->_flags.str_nul = 1;
+	return jso;
+}
+
+/* copy a referenced string into memory owned by the object */
+static int
+string_materialize(struct fjson_object *const jso)
+{
+	char *const buf = (char*)jso_alloc(jso, jso->o.c_string.len + 1);
+	if (buf == NULL) {
+		errno = ENOMEM;
+		return -1;
+	}
+	memcpy(buf, jso->o.c_string.str.ptr, jso->o.c_string.len);
+	buf[jso->o.c_string.len] = '\0';
+	jso->o.c_string.str.ptr = buf;
+	jso->_flags.str_ref = 0;
+	jso->_flags.str_nul = 0;
+	return 0;
+}
+
+int fjson_object_materialize(struct fjson_object *const jso)
+{
+	int r = 0;
+	if (!jso)
+		return 0;
+	switch(jso->o_type) {
+	case fjson_type_string:
+		if (jso->_flags.str_ref)
+			r = string_materialize(jso);
+		break;
+	case fjson_type_object:
+		{
+			const struct _fjson_child_pg *pg;
+			for (pg = &jso->o.c_obj.pg ; pg != NULL && r == 0 ; pg = pg->next) {
+				for (int i = 0 ; i < pg->size && r == 0 ; ++i) {
+					if (pg->children[i].k != NULL)
+						r = fjson_object_materialize(pg->children[i].v);
+				}
+			}
+		}
+		break;
+	case fjson_type_array:
+		if (!jso->_flags.packed) {
+			const int len = fjson_object_array_length(jso);
+			for (int i = 0 ; i < len && r == 0 ; ++i)
+				r = fjson_object_materialize(fjson_object_array_get_idx(jso, i));
+		}
+		break;
+	case fjson_type_null:
+	case fjson_type_boolean:
+	case fjson_type_double:
+	case fjson_type_int:
+	default:
+		break;
+	}
+	return r;
+}
+
 const char* fjson_object_get_string(struct fjson_object *jso)
 {
 	if (!jso)
 		return NULL;
 	if(jso->o_type == fjson_type_string)
-		return get_string_component(jso);
+		return get_string_cstr(jso);
 	else
 		return fjson_object_to_json_string(jso);
 }
@@ -914,120 +1712,379 @@ int fjson_object_get_string_len(struct fjson_object *jso)
 
 /* fjson_object_array */
 
-static int fjson_object_array_to_json_string(struct fjson_object* jso,
-	struct printbuf *pb,
-	int level,
-	int flags)
-{
-	int had_children = 0;
-	int ii;
-	printbuf_memappend_char(pb, '[');
-	if (flags & FJSON_TO_STRING_PRETTY)
-		printbuf_memappend_char(pb, '\n');
-	for(ii=0; ii < fjson_object_array_length(jso); ii++)
-	{
-		struct fjson_object *val;
-		if (had_children)
-		{
-			printbuf_memappend_char(pb, ',');
-			if (flags & FJSON_TO_STRING_PRETTY)
-				printbuf_memappend_char(pb, '\n');
-		}
-		had_children = 1;
-		if (flags & FJSON_TO_STRING_SPACED)
-			printbuf_memappend_char(pb, ' ');
-		indent(pb, level + 1, flags);
-		val = fjson_object_array_get_idx(jso, ii);
-		if(val == NULL)
-			printbuf_memappend_no_nul(pb, "null", 4);
-		else
-			val->_to_json_string(val, pb, level+1, flags);
-	}
-	if (flags & FJSON_TO_STRING_PRETTY)
-	{
-		if (had_children)
-			printbuf_memappend_char(pb, '\n');
-		indent(pb,level,flags);
-	}
+/* packed arrays
+ *
+ * Arrays of numbers (metric samples, histogram buckets) are often large,
+ * and a node per element costs far more than the value itself. Packed
+ * arrays keep the raw values in a C array. Everything that only reads
+ * works on them directly; boxed nodes are created on demand for
+ * fjson_object_array_get_idx(). Modifications that do not fit the
+ * packed representation first convert the array into a regular one.
+ */
 
-	if (flags & FJSON_TO_STRING_SPACED)
-		printbuf_memappend_no_nul(pb, " ]", 2);
-	else
-		printbuf_memappend_char(pb, ']');
-	return 0; /* we need to keep compatible with the API */
+static size_t jso_packed_elem_size(const struct fjson_object *const jso)
+{
+	return (jso->_flags.packed == JSO_PACKED_INT64) ? sizeof(int64_t) : sizeof(double);
 }
 
-static void fjson_object_array_entry_free(void *data)
+static void packed_lock(struct _fjson_packed *const p)
 {
-	fjson_object_put((struct fjson_object*)data);
+	while (!ATOMIC_CAS(&p->lock, 0, 1, &p->mut))
+		;
 }
 
-static void fjson_object_array_delete(struct fjson_object* jso)
+static void packed_unlock(struct _fjson_packed *const p)
 {
-	array_list_free(jso->o.c_array);
-	fjson_object_generic_delete(jso);
+	ATOMIC_STORE_0_TO_INT(&p->lock, &p->mut);
 }
 
-struct fjson_object* fjson_object_new_array(void)
+/* make room for size elements; data and boxed always have the same size */
+static int jso_packed_resize(struct fjson_object *const jso, const int size)
 {
-	struct fjson_object *jso = fjson_object_new(fjson_type_array);
-	if (!jso)
-		return NULL;
-	jso->_delete = &fjson_object_array_delete;
-	jso->_to_json_string = &fjson_object_array_to_json_string;
-	jso->o.c_array = array_list_new(&fjson_object_array_entry_free);
-	return jso;
+	struct _fjson_packed *const p = jso->o.c_packed;
+	void *t = _fjson_realloc(p->data.i64, size * jso_packed_elem_size(jso));
+	if (t == NULL)
+		return -1;
+	p->data.i64 = t;
+	if (p->boxed != NULL) {
+		if ((t = _fjson_realloc((void *) p->boxed, size * sizeof(struct fjson_object *))) == NULL)
+			return -1; /* data is larger, which does no harm */
+		p->boxed = t;
+		if (size > p->size)
+			memset((void *) (p->boxed + p->size), 0,
+				(size - p->size) * sizeof(struct fjson_object *));
+	}
+	p->size = size;
+	return 0;
 }
 
-struct array_list* fjson_object_get_array(struct fjson_object *jso)
+static int jso_packed_reserve(struct fjson_object *const jso, const int size)
 {
-	if (!jso)
+	const int cur = jso->o.c_packed->size;
+	if (size <= cur)
+		return 0;
+	return jso_packed_resize(jso, (size < 2 * cur) ? 2 * cur : size);
+}
+
+static struct fjson_object* jso_new_packed(const int packed, const void *const vals, const int count)
+{
+	struct fjson_object *jso;
+	struct _fjson_packed *p;
+	if (count < 0)
 		return NULL;
-	if(jso->o_type == fjson_type_array)
-		return jso->o.c_array;
-	else
+	if ((jso = fjson_object_new(fjson_type_array, jso_node_size(fjson_type_array, 0), NULL)) == NULL)
+		return NULL;
+	if ((p = _fjson_calloc(1, sizeof(struct _fjson_packed))) == NULL) {
+		fjson_object_generic_delete(jso);
 		return NULL;
+	}
+	INIT_ATOMIC_HELPER_MUT(p->mut);
+	jso->_flags.packed = packed;
+	jso->o.c_packed = p;
+	if (jso_packed_resize(jso, (count > 0) ? count : ARRAY_LIST_DEFAULT_SIZE) != 0) {
+		fjson_object_put(jso);
+		return NULL;
+	}
+	if (count > 0)
+		memcpy(p->data.i64, vals, count * jso_packed_elem_size(jso));
+	p->length = count;
+	return jso;
 }
 
-void fjson_object_array_sort(struct fjson_object *jso, int(*sort_fn)(const void *, const void *))
+static void jso_packed_free(struct _fjson_packed *const p)
 {
-	array_list_sort(jso->o.c_array, sort_fn);
+	if (p->boxed != NULL) {
+		for (int i = 0 ; i < p->length ; ++i)
+			fjson_object_put(p->boxed[i]);
+		_fjson_free((void *) p->boxed);
+	}
+	_fjson_free(p->data.i64);
+	DESTROY_ATOMIC_HELPER_MUT(p->mut);
+	_fjson_free(p);
 }
 
-struct fjson_object* fjson_object_array_bsearch(
-		const struct fjson_object *key,
-		const struct fjson_object *jso,
-		int (*sort_fn)(const void *, const void *))
+/* the node for element idx, created on first use. Readers may run
+ * concurrently, so creation is done under the lock.
+ */
+static struct fjson_object* jso_packed_box(struct fjson_object *const jso, const int idx)
 {
-	struct fjson_object **result;
-
-	result = (struct fjson_object **)array_list_bsearch(
-			(const void **)&key, jso->o.c_array, sort_fn);
+	struct _fjson_packed *const p = jso->o.c_packed;
+	struct fjson_object *box = NULL;
 
-	if (!result)
+	if (idx < 0 || idx >= p->length)
 		return NULL;
-	return *result;
+#ifdef HAVE_ATOMIC_BUILTINS
+	if (p->boxed != NULL && (box = p->boxed[idx]) != NULL)
+		return box;
+#endif
+	packed_lock(p);
+	if (p->boxed == NULL) {
+		struct fjson_object **const boxed = _fjson_calloc(p->size, sizeof(struct fjson_object *));
+#ifdef HAVE_ATOMIC_BUILTINS
+		__sync_synchronize(); /* only publish it zeroed */
+#endif
+		p->boxed = boxed;
+	}
+	if (p->boxed != NULL && (box = p->boxed[idx]) == NULL) {
+		box = (jso->_flags.packed == JSO_PACKED_INT64)
+			? fjson_object_new_int64(p->data.i64[idx])
+			: fjson_object_new_double(p->data.d[idx]);
+#ifdef HAVE_ATOMIC_BUILTINS
+		/* readers must see the node complete before it becomes reachable */
+		__sync_synchronize();
+#endif
+		p->boxed[idx] = box;
+	}
+	packed_unlock(p);
+	return box;
 }
 
-int fjson_object_array_length(struct fjson_object *jso)
+/* turn a packed array into a regular one. On error, it stays packed. */
+static int jso_unpack(struct fjson_object *const jso)
 {
-	return array_list_length(jso->o.c_array);
+	struct _fjson_packed *const p = jso->o.c_packed;
+	struct array_list *list;
+	int i;
+
+	if (!jso->_flags.packed)
+		return 0;
+	/* box everything first, so that there is nothing to undo later */
+	for (i = 0 ; i < p->length ; ++i) {
+		if (jso_packed_box(jso, i) == NULL)
+			return -1;
+	}
+	list = array_list_new_sized(&fjson_object_array_entry_free, p->length, NULL);
+	if (list == NULL)
+		return -1;
+	array_list_add_many(list, (void *const *) p->boxed, p->length);
+	p->length = 0; /* the nodes now belong to list */
+	jso_packed_free(p);
+	jso->_flags.packed = JSO_PACKED_NONE;
+	jso->o.c_array = list;
+	for (i = 0 ; i < array_list_length(list) ; ++i)
+		jso_attach(jso, array_list_get_idx(list, i));
+	return 0;
+}
+
+struct fjson_object* fjson_object_new_array_int64(const int64_t *const vals, const int count)
+{
+	return jso_new_packed(JSO_PACKED_INT64, vals, count);
+}
+
+struct fjson_object* fjson_object_new_array_double(const double *const vals, const int count)
+{
+	return jso_new_packed(JSO_PACKED_DOUBLE, vals, count);
+}
+
+int fjson_object_array_add_int64(struct fjson_object *const jso, const int64_t val)
+{
+	struct fjson_object *node;
+	if (jso->_flags.packed == JSO_PACKED_INT64) {
+		struct _fjson_packed *const p = jso->o.c_packed;
+		if (jso_packed_reserve(jso, p->length + 1) != 0)
+			return -1;
+		jso_invalidate(jso);
+		p->data.i64[p->length++] = val;
+		return 0;
+	}
+	if ((node = fjson_object_new_int64(val)) == NULL)
+		return -1;
+	if (fjson_object_array_add(jso, node) != 0) {
+		fjson_object_put(node);
+		return -1;
+	}
+	return 0;
+}
+
+int fjson_object_array_add_double(struct fjson_object *const jso, const double val)
+{
+	struct fjson_object *node;
+	if (jso->_flags.packed == JSO_PACKED_DOUBLE) {
+		struct _fjson_packed *const p = jso->o.c_packed;
+		if (jso_packed_reserve(jso, p->length + 1) != 0)
+			return -1;
+		jso_invalidate(jso);
+		p->data.d[p->length++] = val;
+		return 0;
+	}
+	if ((node = fjson_object_new_double(val)) == NULL)
+		return -1;
+	if (fjson_object_array_add(jso, node) != 0) {
+		fjson_object_put(node);
+		return -1;
+	}
+	return 0;
+}
+
+const int64_t* fjson_object_array_get_int64_data(struct fjson_object *const jso, int *const count)
+{
+	if (!jso || jso->o_type != fjson_type_array || jso->_flags.packed != JSO_PACKED_INT64)
+		return NULL;
+	if (count != NULL)
+		*count = jso->o.c_packed->length;
+	return jso->o.c_packed->data.i64;
+}
+
+const double* fjson_object_array_get_double_data(struct fjson_object *const jso, int *const count)
+{
+	if (!jso || jso->o_type != fjson_type_array || jso->_flags.packed != JSO_PACKED_DOUBLE)
+		return NULL;
+	if (count != NULL)
+		*count = jso->o.c_packed->length;
+	return jso->o.c_packed->data.d;
+}
+
+static void fjson_object_array_entry_free(void *data)
+{
+	fjson_object_put((struct fjson_object*)data);
+}
+
+static void fjson_object_array_delete(struct fjson_object* jso)
+{
+	if (jso->_flags.packed) {
+		jso_packed_free(jso->o.c_packed);
+		fjson_object_generic_delete(jso);
+		return;
+	}
+	for (int i = 0 ; i < fjson_object_array_length(jso) ; ++i)
+		jso_detach(jso, fjson_object_array_get_idx(jso, i));
+	array_list_free(jso->o.c_array);
+	fjson_object_generic_delete(jso);
+}
+
+struct fjson_object* fjson_object_new_array(void)
+{
+	return _fjson_object_new_array_a(NULL);
+}
+
+static struct fjson_object* jso_new_array(struct fjson_arena *const arena, const int size)
+{
+	struct fjson_object *jso = fjson_object_new(fjson_type_array,
+		jso_node_size(fjson_type_array, 0), arena);
+	if (!jso)
+		return NULL;
+	jso->o.c_array = array_list_new_sized(&fjson_object_array_entry_free, size, arena);
+	if (!jso->o.c_array) {
+		fjson_object_generic_delete(jso);
+		return NULL;
+	}
+	return jso;
+}
+
+struct fjson_object* _fjson_object_new_array_a(struct fjson_arena *const arena)
+{
+	return jso_new_array(arena, ARRAY_LIST_DEFAULT_SIZE);
+}
+
+struct fjson_object* fjson_object_new_array_ex(const int initial_size)
+{
+	return jso_new_array(NULL, (initial_size > 0) ? initial_size : ARRAY_LIST_DEFAULT_SIZE);
+}
+
+struct array_list* fjson_object_get_array(struct fjson_object *jso)
+{
+	if (!jso)
+		return NULL;
+	if(jso->o_type == fjson_type_array) {
+		if (jso_unpack(jso) != 0)
+			return NULL;
+		/* the caller may modify the list behind our back */
+		jso_set_nocache(jso);
+		return jso->o.c_array;
+	}
+	else
+		return NULL;
+}
+
+void fjson_object_array_sort(struct fjson_object *jso, int(*sort_fn)(const void *, const void *))
+{
+	if (jso_unpack(jso) != 0)
+		return;
+	jso_invalidate(jso);
+	array_list_sort(jso->o.c_array, sort_fn);
+}
+
+struct fjson_object* fjson_object_array_bsearch(
+		const struct fjson_object *key,
+		const struct fjson_object *jso,
+		int (*sort_fn)(const void *, const void *))
+{
+	struct fjson_object **result;
+
+	/* the pointer array to search in must exist */
+	if (jso_unpack((struct fjson_object *) jso) != 0)
+		return NULL;
+	result = (struct fjson_object **)array_list_bsearch(
+			(const void **)&key, jso->o.c_array, sort_fn);
+
+	if (!result)
+		return NULL;
+	return *result;
+}
+
+int fjson_object_array_length(struct fjson_object *jso)
+{
+	if (jso->_flags.packed)
+		return jso->o.c_packed->length;
+	return array_list_length(jso->o.c_array);
 }
 
 int fjson_object_array_add(struct fjson_object *jso,struct fjson_object *val)
 {
-	return array_list_add(jso->o.c_array, val);
+	return fjson_object_array_put_idx(jso, fjson_object_array_length(jso), val);
+}
+
+int fjson_object_array_add_many(struct fjson_object *const jso,
+	struct fjson_object *const *const vals, const int count)
+{
+	int i;
+	if (jso_unpack(jso) != 0)
+		return -1;
+	if (count < 0 || array_list_reserve(jso->o.c_array,
+		fjson_object_array_length(jso) + count) != 0)
+		return -1;
+	for (i = 0 ; i < count ; ++i)
+		jso_attach(jso, vals[i]);
+	/* cannot fail, the room is there */
+	return array_list_add_many(jso->o.c_array, (void *const *) vals, count);
+}
+
+int fjson_object_array_reserve(struct fjson_object *const jso, const int size)
+{
+	if (jso->_flags.packed)
+		return jso_packed_reserve(jso, size);
+	return array_list_reserve(jso->o.c_array, size);
+}
+
+int fjson_object_array_shrink_to_fit(struct fjson_object *const jso)
+{
+	if (jso->_flags.packed) {
+		const int length = jso->o.c_packed->length;
+		return jso_packed_resize(jso, (length < 1) ? 1 : length);
+	}
+	return array_list_shrink_to_fit(jso->o.c_array);
 }
 
 int fjson_object_array_put_idx(struct fjson_object *jso, int idx,
 				  struct fjson_object *val)
 {
-	return array_list_put_idx(jso->o.c_array, idx, val);
+	if (idx < 0 || jso_unpack(jso) != 0)
+		return -1;
+	if (idx < fjson_object_array_length(jso))
+		jso_detach(jso, fjson_object_array_get_idx(jso, idx));
+	jso_attach(jso, val);
+	if (array_list_put_idx(jso->o.c_array, idx, val) != 0) {
+		jso_detach(jso, val);
+		return -1;
+	}
+	return 0;
 }
 
 struct fjson_object* fjson_object_array_get_idx(struct fjson_object *jso,
 						  int idx)
 {
+	if (jso->_flags.packed)
+		return jso_packed_box(jso, idx);
 	return (struct fjson_object*)array_list_get_idx(jso->o.c_array, idx);
 }
 
@@ -1036,10 +2093,696 @@ struct fjson_object* fjson_object_array_get_idx(struct fjson_object *jso,
  */
 void fjson_object_array_del_idx(struct fjson_object *jso, int idx)
 {
-	array_list_del_idx(jso->o.c_array, idx);
+	fjson_object_array_del_range(jso, idx, 1);
+}
+
+int fjson_object_array_del_range(struct fjson_object *const jso, const int idx, const int count)
+{
+	int i;
+	if (idx < 0 || count < 0 || idx > fjson_object_array_length(jso) - count)
+		return -1;
+	if (jso->_flags.packed) {
+		struct _fjson_packed *const p = jso->o.c_packed;
+		const size_t esize = jso_packed_elem_size(jso);
+		const int tail = p->length - idx - count;
+		jso_invalidate(jso);
+		memmove((char *) p->data.i64 + idx * esize,
+			(char *) p->data.i64 + (idx + count) * esize, tail * esize);
+		if (p->boxed != NULL) {
+			for (i = idx ; i < idx + count ; ++i)
+				fjson_object_put(p->boxed[i]);
+			memmove((void *) (p->boxed + idx), (void *) (p->boxed + idx + count),
+				tail * sizeof(struct fjson_object *));
+			memset((void *) (p->boxed + p->length - count), 0,
+				count * sizeof(struct fjson_object *));
+		}
+		p->length -= count;
+		return 0;
+	}
+	for (i = idx ; i < idx + count ; ++i)
+		jso_detach(jso, fjson_object_array_get_idx(jso, i));
+	return array_list_del_idx(jso->o.c_array, idx, count);
 }
 
 int fjson_object_get_member_count(struct fjson_object *jso)
 {
 	return jso->o.c_obj.nelem;
 }
+
+
+/* copying
+ *
+ * fjson_object_deep_copy() rebuilds the whole tree. Container copies
+ * only rebuild the containers and share everything else by reference:
+ * scalars and keys are never modified, so both trees can keep using the
+ * same ones. Containers cannot be shared that way, which is why we do
+ * not copy lazily on write. Lookups and iterators hand out the node
+ * itself, so a node held by both trees could not tell which of them a
+ * later modification is meant for. With a private container on each
+ * side, lookups never need to write anything, and the mutators work as
+ * usual. The cost of a copy still grows with the tree, but it takes a
+ * node per container only.
+ *
+ * Shared scalars are flagged as such and detached from their container,
+ * so that neither tree updates the other one when they are added
+ * elsewhere. As they never change, there is nothing to
+ * invalidate, and the containers of both trees may still cache their
+ * output. The scalars do write their own output cache, though (a
+ * fjson_object_get_string() on a number), so the trees must not be used
+ * by different threads at the same time.
+ */
+
+/* append a child to an object we are building, taking over the key of
+ * the source entry (and its hash) as far as possible. Keys in an arena
+ * may be flagged constant, but only live as long as the arena.
+ */
+static int
+jso_copy_child(struct fjson_object *const dst, const struct fjson_object *const src_obj,
+	const struct _fjson_child *const src, struct fjson_object *const val)
+{
+	struct _fjson_child *const chld = fjson_child_get_empty_etry(dst);
+	const int keep_key = src->k_is_constant && !src_obj->_flags.in_arena;
+	const int share_key = !keep_key && !src_obj->_flags.in_arena && !dst->_flags.in_arena;
+	if (chld == NULL)
+		return -1;
+	chld->k = keep_key ? src->k : share_key ? jso_key_get(src->k) : jso_key_new(dst, src->k);
+	if (chld->k == NULL)
+		return -1; /* the caller frees dst, empty entries are skipped */
+	chld->k_is_constant = keep_key;
+	chld->hash = src->hash;
+	chld->klen = src->klen;
+	chld->k_no_escape = src->k_no_escape;
+	chld->v = val;
+	++dst->o.c_obj.nelem;
+	_fjson_idx_add(dst, chld);
+	return 0;
+}
+
+/* what a container copy holds in place of val */
+static struct fjson_object *
+jso_copy_value(struct fjson_object *const dst, struct fjson_object *const val)
+{
+	struct fjson_object *copy;
+
+	if (val == NULL || (val->o_type != fjson_type_object && val->o_type != fjson_type_array)) {
+		if (val != NULL && !val->_flags.immortal) {
+			val->_parent = NULL;
+			val->_flags.shared = 1;
+		}
+		return fjson_object_get(val);
+	}
+	if ((copy = jso_copy_containers(val)) != NULL)
+		jso_attach(dst, copy);
+	return copy;
+}
+
+static struct fjson_object *
+jso_copy_containers(struct fjson_object *const src)
+{
+	struct fjson_object *dst, *val;
+	const struct _fjson_child_pg *pg;
+	int i;
+
+	if (src->o_type == fjson_type_array && src->_flags.packed)
+		return jso_new_packed(src->_flags.packed, src->o.c_packed->data.i64,
+			src->o.c_packed->length);
+	if (src->o_type == fjson_type_array) {
+		const int len = fjson_object_array_length(src);
+		if ((dst = jso_new_array(NULL, len)) == NULL)
+			return NULL;
+		for (i = 0 ; i < len ; ++i) {
+			val = fjson_object_array_get_idx(src, i);
+			if (val != NULL && (val = jso_copy_value(dst, val)) == NULL)
+				goto fail;
+			array_list_add(dst->o.c_array, val);
+		}
+		return dst;
+	}
+	if ((dst = fjson_object_new_object()) == NULL)
+		return NULL;
+	dst->_flags.key_cmp = src->_flags.key_cmp;
+	if (jso_object_reserve(dst, src->o.c_obj.nelem) != 0)
+		goto fail;
+	for (pg = &src->o.c_obj.pg ; pg != NULL ; pg = pg->next) {
+		for (i = 0 ; i < pg->size ; ++i) {
+			if (pg->children[i].k == NULL)
+				continue;
+			val = pg->children[i].v;
+			if (val != NULL && (val = jso_copy_value(dst, val)) == NULL)
+				goto fail;
+			if (jso_copy_child(dst, src, &pg->children[i], val) != 0) {
+				jso_detach(dst, val);
+				fjson_object_put(val);
+				goto fail;
+			}
+		}
+	}
+	return dst;
+fail:
+	fjson_object_put(dst);
+	return NULL;
+}
+
+int fjson_object_copy_containers(struct fjson_object *const src, struct fjson_object **const dst)
+{
+	if (src == NULL || (src->o_type != fjson_type_object && src->o_type != fjson_type_array)) {
+		*dst = fjson_object_get(src);
+		return 0;
+	}
+	if (src->_flags.in_arena)
+		return fjson_object_deep_copy(src, dst); /* the arena may go away */
+	if ((*dst = jso_copy_containers(src)) == NULL) {
+		errno = ENOMEM;
+		return -1;
+	}
+	return 0;
+}
+
+static struct fjson_object *
+jso_deep_copy(struct fjson_object *const src)
+{
+	struct fjson_object *dst = NULL, *val;
+	const struct _fjson_child_pg *pg;
+	int i;
+
+	if (src->_flags.immortal)
+		return src;
+	switch(src->o_type) {
+	case fjson_type_boolean:
+		return fjson_object_new_boolean(src->o.c_boolean);
+	case fjson_type_int:
+		return fjson_object_new_int64(src->o.c_int64);
+	case fjson_type_double:
+		return (src->o.c_double.source == NULL)
+			? fjson_object_new_double(src->o.c_double.value)
+			: fjson_object_new_double_s(src->o.c_double.value, src->o.c_double.source);
+	case fjson_type_string:
+		return fjson_object_new_string_len(get_string_component(src), src->o.c_string.len);
+	case fjson_type_array:
+		if (src->_flags.packed)
+			return jso_copy_containers(src); /* values are all there is */
+		{
+			const int len = fjson_object_array_length(src);
+			if ((dst = jso_new_array(NULL, len)) == NULL)
+				return NULL;
+			for (i = 0 ; i < len ; ++i) {
+				val = fjson_object_array_get_idx(src, i);
+				if (val != NULL && (val = jso_deep_copy(val)) == NULL)
+					goto fail;
+				jso_attach(dst, val);
+				array_list_add(dst->o.c_array, val);
+			}
+		}
+		return dst;
+	case fjson_type_object:
+		if ((dst = fjson_object_new_object()) == NULL)
+			return NULL;
+		dst->_flags.key_cmp = src->_flags.key_cmp;
+		for (pg = &src->o.c_obj.pg ; pg != NULL ; pg = pg->next) {
+			for (i = 0 ; i < pg->size ; ++i) {
+				if (pg->children[i].k == NULL)
+					continue;
+				val = pg->children[i].v;
+				if (val != NULL && (val = jso_deep_copy(val)) == NULL)
+					goto fail;
+				if (jso_copy_child(dst, src, &pg->children[i], val) != 0) {
+					fjson_object_put(val);
+					goto fail;
+				}
+				jso_attach(dst, val);
+			}
+		}
+		return dst;
+	case fjson_type_null:
+	default:
+		return NULL;
+	}
+fail:
+	fjson_object_put(dst);
+	return NULL;
+}
+
+int fjson_object_deep_copy(struct fjson_object *const src, struct fjson_object **const dst)
+{
+	if (src == NULL) {
+		*dst = NULL;
+		return 0;
+	}
+	if ((*dst = jso_deep_copy(src)) == NULL) {
+		errno = ENOMEM;
+		return -1;
+	}
+	return 0;
+}
+
+
+/* merging objects
+ *
+ * Members are merged straight from the children of one object into the
+ * other: the source entry already has the hash and length of the key,
+ * and its key can be kept, shared or even taken over, so a merge needs
+ * no key copies (unless an arena is involved) and only one allocation for the new entries.
+ */
+
+/* values of an arena tree must be copied unless dst lives in the same arena */
+#define JSO_MERGE_MUST_COPY(dst, src) ((src)->_flags.in_arena \
+	&& (!(dst)->_flags.in_arena || JSO_ARENA(dst) != JSO_ARENA(src)))
+
+/* store val in dst under the key of entry sc of src, replacing the value of
+ * member chld if there is one. Otherwise a constant key of sc is kept, a non-
+ * constant one taken over if take_key is set, and shared otherwise (copied if
+ * an arena is involved).
+ * Returns -1 on malloc error, in which case val is not stored.
+ */
+static int
+jso_merge_child(struct fjson_object *const dst, const struct fjson_object *const src,
+	struct _fjson_child *const sc, struct _fjson_child *chld,
+	struct fjson_object *const val, const int take_key)
+{
+	if (chld != NULL) {
+		jso_detach(dst, chld->v);
+		jso_attach(dst, val);
+		fjson_object_put(chld->v);
+		chld->v = val;
+		return 0;
+	}
+
+	const int keep_key = sc->k_is_constant && !src->_flags.in_arena;
+	const int move_key = !keep_key && take_key && !dst->_flags.in_arena;
+	const int share_key = !keep_key && !src->_flags.in_arena && !dst->_flags.in_arena;
+	const char *const k = (keep_key || move_key) ? NULL
+		: share_key ? jso_key_get(sc->k) : jso_key_new(dst, sc->k);
+	if (!keep_key && !move_key && k == NULL)
+		return -1;
+	if ((chld = fjson_child_get_empty_etry(dst)) == NULL) {
+		jso_key_put(dst, k);
+		return -1;
+	}
+	chld->k = (k == NULL) ? sc->k : k;
+	chld->k_is_constant = keep_key;
+	chld->hash = sc->hash;
+	chld->klen = sc->klen;
+	chld->k_no_escape = sc->k_no_escape;
+	if (move_key)
+		sc->k_is_constant = 1; /* so that src does not free it */
+	jso_attach(dst, val);
+	chld->v = val;
+	++dst->o.c_obj.nelem;
+	_fjson_idx_add(dst, chld);
+	return 0;
+}
+
+static int
+jso_merge(struct fjson_object *const dst, struct fjson_object *const src, const unsigned flags)
+{
+	const int move = (flags & FJSON_OBJECT_MERGE_CONSUME) && !src->_flags.in_arena
+		&& ATOMIC_FETCH_32BIT(&src->_ref_count, &src->_mut_ref_count) == 1;
+	const int copy = JSO_MERGE_MUST_COPY(dst, src);
+	struct _fjson_child_pg *pg;
+	int i;
+
+	if (jso_object_reserve(dst, src->o.c_obj.nelem) != 0)
+		return -1;
+	for (pg = &src->o.c_obj.pg ; pg != NULL ; pg = pg->next) {
+		for (i = 0 ; i < pg->size ; ++i) {
+			struct _fjson_child *const sc = &pg->children[i];
+			struct _fjson_child *chld;
+			struct fjson_object *val = sc->v;
+			if (sc->k == NULL)
+				continue;
+			chld = _fjson_find_child(dst, sc->k, sc->hash, sc->klen);
+			if (chld != NULL && (flags & FJSON_OBJECT_MERGE_RECURSIVE)
+			    && fjson_object_is_type(chld->v, fjson_type_object)
+			    && fjson_object_is_type(val, fjson_type_object)) {
+				/* only what src alone holds may be moved */
+				if (jso_merge(chld->v, val, move ? flags : flags & ~FJSON_OBJECT_MERGE_CONSUME) != 0)
+					return -1;
+				continue;
+			}
+			if (chld != NULL && (flags & FJSON_OBJECT_MERGE_KEEP_EXISTING))
+				continue;
+			if (move) {
+				jso_detach(src, val);
+			} else if (copy) {
+				if (val != NULL && (val = jso_deep_copy(val)) == NULL) {
+					errno = ENOMEM;
+					return -1;
+				}
+			} else {
+				fjson_object_get(val);
+			}
+			if (jso_merge_child(dst, src, sc, chld, val, move) != 0) {
+				if (move)
+					jso_attach(src, val);
+				else
+					fjson_object_put(val);
+				errno = ENOMEM;
+				return -1;
+			}
+			if (move)
+				sc->v = NULL;
+		}
+	}
+	return 0;
+}
+
+int fjson_object_object_merge(struct fjson_object *const dst, struct fjson_object *const src,
+	const unsigned flags)
+{
+	int r = 0;
+
+	if (!fjson_object_is_type(dst, fjson_type_object)
+	    || !fjson_object_is_type(src, fjson_type_object)) {
+		errno = EINVAL;
+		r = -1;
+	} else if (dst != src) {
+		r = jso_merge(dst, src, flags);
+	}
+	if (flags & FJSON_OBJECT_MERGE_CONSUME) {
+		const int err = errno;
+		fjson_object_put(src);
+		errno = err;
+	}
+	return r;
+}
+
+static int
+jso_patch(struct fjson_object *const target, struct fjson_object *const patch)
+{
+	const int copy = JSO_MERGE_MUST_COPY(target, patch);
+	struct _fjson_child_pg *pg;
+	int i;
+
+	if (jso_object_reserve(target, patch->o.c_obj.nelem) != 0)
+		return -1;
+	for (pg = &patch->o.c_obj.pg ; pg != NULL ; pg = pg->next) {
+		for (i = 0 ; i < pg->size ; ++i) {
+			struct _fjson_child *const pc = &pg->children[i];
+			struct _fjson_child *chld;
+			struct fjson_object *val = pc->v;
+			if (pc->k == NULL)
+				continue;
+			chld = _fjson_find_child(target, pc->k, pc->hash, pc->klen);
+			if (val == NULL) {
+				if (chld != NULL)
+					jso_del_child(target, chld);
+				continue;
+			}
+			if (val->o_type == fjson_type_object) {
+				if (chld != NULL && fjson_object_is_type(chld->v, fjson_type_object)) {
+					if (jso_patch(chld->v, val) != 0)
+						return -1;
+					continue;
+				}
+				/* a new object, which gets the patch without its nulls */
+				if ((val = fjson_object_new_object()) == NULL) {
+					errno = ENOMEM;
+					return -1;
+				}
+				val->_flags.key_cmp = target->_flags.key_cmp;
+				if (jso_patch(val, pc->v) != 0) {
+					fjson_object_put(val);
+					return -1;
+				}
+			} else if (copy) {
+				if ((val = jso_deep_copy(val)) == NULL) {
+					errno = ENOMEM;
+					return -1;
+				}
+			} else {
+				fjson_object_get(val);
+			}
+			if (jso_merge_child(target, patch, pc, chld, val, 0) != 0) {
+				fjson_object_put(val);
+				errno = ENOMEM;
+				return -1;
+			}
+		}
+	}
+	return 0;
+}
+
+int fjson_object_merge_patch(struct fjson_object **const target, struct fjson_object *const patch)
+{
+	struct fjson_object *val;
+
+	if (!fjson_object_is_type(patch, fjson_type_object)) {
+		if (patch != NULL && patch->_flags.in_arena) {
+			if ((val = jso_deep_copy(patch)) == NULL) {
+				errno = ENOMEM;
+				return -1;
+			}
+		} else {
+			val = fjson_object_get(patch);
+		}
+		fjson_object_put(*target);
+		*target = val;
+		return 0;
+	}
+	if (!fjson_object_is_type(*target, fjson_type_object)) {
+		if ((val = fjson_object_new_object()) == NULL) {
+			errno = ENOMEM;
+			return -1;
+		}
+		fjson_object_put(*target);
+		*target = val;
+	}
+	return jso_patch(*target, patch);
+}
+
+
+/* comparing and hashing trees
+ *
+ * Both work on the nodes directly, so elements of packed arrays are not
+ * boxed. Numbers are compared by value within their type: 1 and 1.0
+ * differ, while 1.5 and 1.50 do not.
+ * Keys are hashed by the case-folded hash the children already store,
+ * so the hash is the same in both comparison modes.
+ */
+
+/* seeds, so that values of different types do not hash alike */
+#define JSO_HASH_K 0x9e3779b97f4a7c15ULL
+#define JSO_HASH_SEED(type) (JSO_HASH_K * ((uint64_t) (type) + 1))
+#define JSO_HASH_SEED_KEY JSO_HASH_SEED(16)
+
+static inline uint64_t
+hash_mix(uint64_t h, const uint64_t v)
+{
+	h = (h ^ v) * JSO_HASH_K;
+	return h ^ (h >> 29);
+}
+
+/* final avalanche, as in MurmurHash3 */
+static inline uint64_t
+hash_fmix(uint64_t h)
+{
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	return h ^ (h >> 33);
+}
+
+static uint64_t
+hash_int64(const int64_t i)
+{
+	return hash_fmix(hash_mix(JSO_HASH_SEED(fjson_type_int), (uint64_t) i));
+}
+
+static uint64_t
+hash_double(double d)
+{
+	uint64_t bits;
+	if (d == 0)
+		d = 0; /* -0.0 equals 0.0 */
+	memcpy(&bits, &d, sizeof(bits));
+	return hash_fmix(hash_mix(JSO_HASH_SEED(fjson_type_double), bits));
+}
+
+/* words are read as little endian, so the hash is the same everywhere */
+static uint64_t
+hash_string(const char *p, size_t len)
+{
+	uint64_t h = hash_mix(JSO_HASH_SEED(fjson_type_string), len);
+	uint64_t w;
+
+	for ( ; len >= sizeof(w) ; p += sizeof(w), len -= sizeof(w)) {
+		memcpy(&w, p, sizeof(w));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+		w = __builtin_bswap64(w);
+#endif
+		h = hash_mix(h, w);
+	}
+	if (len > 0) {
+		for (w = 0 ; len > 0 ; --len)
+			w = (w << 8) | (unsigned char) p[len - 1];
+		h = hash_mix(h, w);
+	}
+	return hash_fmix(h);
+}
+
+static uint64_t
+jso_hash(struct fjson_object *const jso)
+{
+	const struct _fjson_child_pg *pg;
+	uint64_t h;
+	int i, len;
+
+	if (jso == NULL)
+		return hash_fmix(JSO_HASH_SEED(fjson_type_null));
+	switch(jso->o_type) {
+	case fjson_type_boolean:
+		return hash_fmix(hash_mix(JSO_HASH_SEED(fjson_type_boolean), jso->o.c_boolean != 0));
+	case fjson_type_int:
+		return hash_int64(jso->o.c_int64);
+	case fjson_type_double:
+		return hash_double(jso->o.c_double.value);
+	case fjson_type_string:
+		return hash_string(get_string_component(jso), jso->o.c_string.len);
+	case fjson_type_array:
+		len = fjson_object_array_length(jso);
+		h = hash_mix(JSO_HASH_SEED(fjson_type_array), len);
+		for (i = 0 ; i < len ; ++i) {
+			const uint64_t eh = (jso->_flags.packed == JSO_PACKED_INT64)
+				? hash_int64(jso->o.c_packed->data.i64[i])
+				: (jso->_flags.packed == JSO_PACKED_DOUBLE)
+				? hash_double(jso->o.c_packed->data.d[i])
+				: jso_hash((struct fjson_object *) array_list_get_idx(jso->o.c_array, i));
+			h = hash_mix(h, eh);
+		}
+		return hash_fmix(h);
+	case fjson_type_object:
+		if (jso->o.c_obj.hash != 0)
+			return jso->o.c_obj.hash;
+		/* member order does not matter, so we add up their hashes */
+		h = 0;
+		for (pg = &jso->o.c_obj.pg ; pg != NULL ; pg = pg->next) {
+			for (i = 0 ; i < pg->size ; ++i) {
+				const struct _fjson_child *const chld = &pg->children[i];
+				if (chld->k == NULL)
+					continue;
+				h += hash_fmix(hash_mix(hash_mix(JSO_HASH_SEED_KEY,
+					chld->hash | (uint64_t) chld->klen << 32), jso_hash(chld->v)));
+			}
+		}
+		h = hash_fmix(hash_mix(hash_mix(JSO_HASH_SEED(fjson_type_object),
+			jso->o.c_obj.nelem), h));
+		if (h == 0)
+			h = 1; /* 0 means "not known" */
+		if (!jso->_flags.nocache)
+			jso->o.c_obj.hash = h;
+		return h;
+	case fjson_type_null:
+	default:
+		return hash_fmix(JSO_HASH_SEED(fjson_type_null));
+	}
+}
+
+uint64_t fjson_object_hash(struct fjson_object *const jso)
+{
+	return jso_hash(jso);
+}
+
+static int jso_equal(struct fjson_object *a, struct fjson_object *b);
+
+/* element i of packed array arr equals jso */
+static int
+jso_packed_elem_equal(const struct fjson_object *const arr, const int i,
+	const struct fjson_object *const jso)
+{
+	if (jso == NULL)
+		return 0;
+	if (arr->_flags.packed == JSO_PACKED_INT64)
+		return jso->o_type == fjson_type_int && jso->o.c_int64 == arr->o.c_packed->data.i64[i];
+	return jso->o_type == fjson_type_double && jso->o.c_double.value == arr->o.c_packed->data.d[i];
+}
+
+static int
+jso_array_equal(struct fjson_object *const a, struct fjson_object *const b)
+{
+	const int len = fjson_object_array_length(a);
+	int i;
+
+	if (len != fjson_object_array_length(b))
+		return 0;
+	if (a->_flags.packed && b->_flags.packed) {
+		if (a->_flags.packed != b->_flags.packed)
+			return len == 0;
+		if (a->_flags.packed == JSO_PACKED_INT64)
+			return memcmp(a->o.c_packed->data.i64, b->o.c_packed->data.i64,
+				len * sizeof(int64_t)) == 0;
+		for (i = 0 ; i < len ; ++i) {
+			if (a->o.c_packed->data.d[i] != b->o.c_packed->data.d[i])
+				return 0;
+		}
+		return 1;
+	}
+	for (i = 0 ; i < len ; ++i) {
+		const int eq = a->_flags.packed
+			? jso_packed_elem_equal(a, i, array_list_get_idx(b->o.c_array, i))
+			: b->_flags.packed
+			? jso_packed_elem_equal(b, i, array_list_get_idx(a->o.c_array, i))
+			: jso_equal(array_list_get_idx(a->o.c_array, i),
+				array_list_get_idx(b->o.c_array, i));
+		if (!eq)
+			return 0;
+	}
+	return 1;
+}
+
+static int
+jso_object_equal(struct fjson_object *const a, struct fjson_object *const b)
+{
+	const struct _fjson_child_pg *pg;
+	int i;
+
+	if (a->o.c_obj.nelem != b->o.c_obj.nelem)
+		return 0;
+	if (a->o.c_obj.hash != 0 && b->o.c_obj.hash != 0 && a->o.c_obj.hash != b->o.c_obj.hash)
+		return 0;
+	for (pg = &a->o.c_obj.pg ; pg != NULL ; pg = pg->next) {
+		for (i = 0 ; i < pg->size ; ++i) {
+			const struct _fjson_child *const chld = &pg->children[i];
+			const struct _fjson_child *other;
+			if (chld->k == NULL)
+				continue;
+			other = _fjson_find_child(b, chld->k, chld->hash, chld->klen);
+			if (other == NULL || !jso_equal(chld->v, other->v))
+				return 0;
+		}
+	}
+	return 1;
+}
+
+static int
+jso_equal(struct fjson_object *const a, struct fjson_object *const b)
+{
+	if (a == b)
+		return 1;
+	if (a == NULL || b == NULL || a->o_type != b->o_type)
+		return 0;
+	switch(a->o_type) {
+	case fjson_type_boolean:
+		return !a->o.c_boolean == !b->o.c_boolean;
+	case fjson_type_int:
+		return a->o.c_int64 == b->o.c_int64;
+	case fjson_type_double:
+		return a->o.c_double.value == b->o.c_double.value;
+	case fjson_type_string:
+		return a->o.c_string.len == b->o.c_string.len
+			&& memcmp(get_string_component(a), get_string_component(b),
+				a->o.c_string.len) == 0;
+	case fjson_type_array:
+		return jso_array_equal(a, b);
+	case fjson_type_object:
+		return jso_object_equal(a, b);
+	case fjson_type_null:
+	default:
+		return 1;
+	}
+}
+
+int fjson_object_equal(struct fjson_object *const a, struct fjson_object *const b)
+{
+	return jso_equal(a, b);
+}
@@ -28,14 +28,21 @@ extern "C" {
 #endif
 
 #define FJSON_OBJECT_DEF_HASH_ENTRIES 16
-/* number of subjects within a children page. One page is allocated
- * with each json object, and extensions are alwas done in page
- * size increments. The size should be a compromise between not
- * wasting too much space but also not doing too frequent mallocs.
- * note: each page *entry* currently needs ~20 Bytes (x64). If this
+/* number of subjects within the first children page, which is part of
+ * each json object. Each further page is twice as large as the one
+ * before, up to FJSON_OBJECT_CHLD_PG_MAX entries, so wide objects need
+ * only few mallocs.
+ * note: each page *entry* currently needs 24 Bytes (x64). If this
  * is important, check the actual number (sizeof(struct _fjson_child)).
  */
 #define FJSON_OBJECT_CHLD_PG_SIZE 8
+#define FJSON_OBJECT_CHLD_PG_MAX 1024
+/* number of members an object must have before we build a hash index
+ * for key lookups. Below that, a linear scan of the children pages is
+ * cheaper than hashing. The index is built when a member is added that
+ * takes the object beyond this size.
+ */
+#define FJSON_OBJECT_HASH_THRESHOLD 16
 
 /**
  * A flag for the fjson_object_to_json_string_ext() and
@@ -100,6 +107,14 @@ extern "C" {
  *       FJSON_OBJECT_KEY_IS_CONSTANT);
  */
 #define FJSON_OBJECT_KEY_IS_CONSTANT (1<<2)
+/**
+ * A flag for the fjson_object_object_add_ex function which
+ * flags the key as returned by fjson_keydict_intern(). The key is
+ * not copied (as with FJSON_OBJECT_KEY_IS_CONSTANT), and its hash
+ * need not be computed again. The dictionary must live longer than
+ * the json object.
+ */
+#define FJSON_OBJECT_KEY_IS_INTERNED (1<<3)
 
 #undef FALSE
 #define FALSE ((fjson_bool)0)
@@ -127,12 +142,33 @@ typedef struct array_list array_list;
 typedef struct fjson_object fjson_object;
 typedef struct fjson_object_iter fjson_object_iter;
 typedef struct fjson_tokener fjson_tokener;
+typedef struct fjson_ctx fjson_ctx;
 
 /**
  * Type for a user-supplied write function
  */
 typedef size_t (fjson_write_fn)(void *ptr, const char *buffer, size_t size);
 
+struct iovec;
+
+/**
+ * Type for a user-supplied write function that receives an iovec array,
+ * see fjson_object_dump_iov(). The array holds at most 64 entries (and
+ * never more than IOV_MAX), so it can be passed to writev() unchanged.
+ */
+typedef size_t (fjson_writev_fn)(void *ptr, const struct iovec *iov, int iovcnt);
+
+/**
+ * Types for a user-supplied executor, which lets the library spread
+ * work over the caller's threads (see fjson_tokener_parse_records_parallel()).
+ * The executor must call fn(args[i]) for each i in [0, ntasks), in any
+ * order and from any thread, and must return only after all calls have
+ * completed. A NULL executor means that the tasks are run one after
+ * the other in the calling thread.
+ */
+typedef void (fjson_task_fn)(void *arg);
+typedef void (fjson_executor_fn)(void *exec_ctx, fjson_task_fn *fn, void *const *args, int ntasks);
+
 /* supported object types */
 
 typedef enum fjson_type {
@@ -146,6 +182,51 @@ typedef enum fjson_type {
 	fjson_type_string
 } fjson_type;
 
+/* contexts */
+
+/**
+ * Create a context. A context carries settings that otherwise are
+ * process-wide (see fjson_global_do_case_sensitive_comparison() and
+ * fjson_global_set_printbuf_initial_size()), so that different parts of
+ * an application can use different ones without affecting each other.
+ * It is passed to fjson_object_new_object_ctx() and fjson_tokener_new_ctx().
+ * Objects and tokeners take over the settings when they are created, so
+ * changing or freeing the context later does not affect them.
+ * A new context follows the process-wide settings until told otherwise.
+ * @returns the new context or NULL on malloc error
+ */
+extern struct fjson_ctx* fjson_ctx_new(void);
+
+/**
+ * Free a context.
+ * @param ctx the context, may be NULL
+ */
+extern void fjson_ctx_free(struct fjson_ctx *ctx);
+
+/**
+ * Set case sensitive (newval != 0) or insensitive (newval == 0)
+ * comparison of keys for objects created with this context. See
+ * fjson_global_do_case_sensitive_comparison() for the implications.
+ */
+extern void fjson_ctx_set_case_sensitive(struct fjson_ctx *ctx, int newval);
+
+/**
+ * Set the initial size of the buffers tokeners created with this context
+ * collect strings and numbers in. 0 means the process-wide default, see
+ * fjson_global_set_printbuf_initial_size().
+ */
+extern void fjson_ctx_set_printbuf_initial_size(struct fjson_ctx *ctx, int size);
+
+struct fjson_keydict;
+/**
+ * Make tokeners created with this context intern object keys in dict
+ * (see json_keydict.h) instead of giving each object its own copies.
+ * Keys that do not fit into the dictionary any longer are copied as
+ * usual. The dictionary must live longer than all objects created by
+ * these tokeners. NULL (the default) disables interning.
+ */
+extern void fjson_ctx_set_keydict(struct fjson_ctx *ctx, struct fjson_keydict *dict);
+
 /* reference counting functions */
 
 /**
@@ -166,6 +247,101 @@ extern struct fjson_object* fjson_object_get(struct fjson_object *obj);
  */
 int fjson_object_put(struct fjson_object *obj);
 
+/**
+ * Switch obj and all its descendants to atomic reference counting, so
+ * that multiple threads can hold references concurrently. This is only
+ * needed for trees parsed with FJSON_TOKENER_LOCAL_REFCOUNT; all other
+ * objects count atomically anyway. Call it while the tree is still used
+ * by one thread only, e.g. right before publishing it. Children added
+ * afterwards keep their own mode.
+ *
+ * @param obj the fjson_object instance
+ */
+extern void fjson_object_share(struct fjson_object *obj);
+
+/**
+ * Create a copy of obj and all its descendants. The copy is completely
+ * independent of obj; in particular, it never is part of an arena, so
+ * this can also be used to keep a tree beyond the life of its arena.
+ * The booleans, small integers and the empty string are not copied (see
+ * fjson_object_new_int()), nor are the keys, as they never change.
+ *
+ * @param obj the fjson_object instance (may be NULL)
+ * @param dst receives the copy, with a reference count of one
+ * @returns 0 on success, -1 if out of memory (errno is set to ENOMEM)
+ */
+extern int fjson_object_deep_copy(struct fjson_object *obj, struct fjson_object **dst);
+
+/**
+ * Create a copy of obj that shares everything but the containers.
+ *
+ * The objects and arrays are copied, while the scalars and keys are
+ * shared with obj, as they are never modified in place. So both trees
+ * can be modified independently, and looking up or iterating over
+ * either of them never writes to the other. Compared to
+ * fjson_object_deep_copy(), this saves a node for every scalar, which
+ * usually makes up most of a tree, and all key copies. For a scalar
+ * obj, this just returns another reference.
+ *
+ * This is not a lazy copy-on-write copy, as lookups and iterators
+ * hand out the nodes themselves: all containers are copied right away,
+ * so the cost still grows with the size of obj. Also, the shared
+ * scalars keep their own output cache (see
+ * fjson_object_to_json_string()), so the two trees must not be used by
+ * different threads at the same time. Use fjson_object_deep_copy() to
+ * hand a tree to another thread.
+ *
+ * Strings referencing the parser input (FJSON_TOKENER_ZERO_COPY) are
+ * shared as well, so call fjson_object_materialize() before the copy.
+ * Trees allocated in an arena are copied via fjson_object_deep_copy().
+ *
+ * @param obj the fjson_object instance (may be NULL)
+ * @param dst receives the copy, with a reference count of one
+ * @returns 0 on success, -1 if out of memory (errno is set to ENOMEM)
+ */
+extern int fjson_object_copy_containers(struct fjson_object *obj, struct fjson_object **dst);
+
+/**
+ * Check if two trees are equal.
+ *
+ * Values of different types are never equal, so 1 and 1.0 differ,
+ * while numbers of the same type are compared by value (1.5 equals
+ * 1.50). Arrays are equal if their elements are equal in the same order,
+ * and objects if they have equal members, in whatever order. Keys are
+ * looked up in obj2, so they are compared case-insensitively if it does
+ * so.
+ *
+ * This is much faster than comparing the serialized trees: it stops at
+ * the first difference, at identical nodes and at mismatching member
+ * counts or lengths, and objects whose fjson_object_hash() is known
+ * differ if their hashes do.
+ *
+ * @param obj1 the first tree (may be NULL)
+ * @param obj2 the second tree (may be NULL)
+ * @returns 1 if they are equal, 0 otherwise
+ */
+extern int fjson_object_equal(struct fjson_object *obj1, struct fjson_object *obj2);
+
+/**
+ * Compute a hash over a whole tree.
+ *
+ * Trees that are equal as by fjson_object_equal() have the same hash,
+ * so members are hashed regardless of their order, and keys regardless
+ * of case. The hash does not depend on the process or the platform, so
+ * it can be stored and compared with hashes from elsewhere.
+ *
+ * Objects keep their hash until they or one of their descendants are
+ * modified, so hashing a tree again after a small change only
+ * recomputes the objects on the path to it (arrays and scalars are
+ * always hashed anew). This does not apply to objects
+ * holding a node that is held elsewhere as well (e.g. via
+ * fjson_object_get()), as their modifications cannot be tracked.
+ *
+ * @param obj the fjson_object instance (may be NULL)
+ * @returns the hash
+ */
+extern uint64_t fjson_object_hash(struct fjson_object *obj);
+
 /**
  * Check if the fjson_object is of a given type
  * @param obj the fjson_object instance
@@ -213,6 +389,22 @@ extern size_t fjson_object_size(struct fjson_object *obj);
  */
 extern size_t fjson_object_size_ext(struct fjson_object *obj, int flags);
 
+/**
+ * Stringify object into a buffer supplied by the caller, so that nothing
+ * needs to be allocated. Works like snprintf(): at most cap - 1 bytes are
+ * written plus a terminating NUL, and the return value is the length of
+ * the complete output. So if it is cap or more, the output has been
+ * truncated (and fjson_object_size_ext() would have told how much room
+ * is needed).
+ * @param obj the fjson_object instance
+ * @param flags formatting options, see FJSON_TO_STRING_PRETTY and other constants
+ * @param buf the buffer to write to
+ * @param cap size of buf
+ * @returns length of the JSON text, not counting the NUL
+ */
+extern size_t fjson_object_to_json_string_into(struct fjson_object *obj, int flags,
+	char *buf, size_t cap);
+
 /**
  * Dump object to a user-supplied function.
  * Equivalent to fjson_object_write_ext(obj, FJSON_TO_STRING_SPACED, func, ptr)
@@ -256,6 +448,56 @@ extern size_t fjson_object_dump_ext(struct fjson_object *obj, int flags, fjson_w
 extern size_t fjson_object_dump_buffered(struct fjson_object *obj, int flags, char *temp,
 size_t size, fjson_write_fn *func, void *ptr);
 
+/**
+ * Dump function for writers that use writev() or sendmsg(). Short
+ * fragments are grouped in a 1k buffer on the stack as with
+ * fjson_object_dump_ext(), but long string bodies that need no escaping,
+ * original double text, and output cached by
+ * fjson_object_to_json_string_ext() are not copied: the iovec entries
+ * point right into the object. They are only valid until func returns.
+ * @param obj object to be written
+ * @param flags extra flags
+ * @param func your function that will be called to write the data
+ * @param ptr pointer that will be passed as first argument to your function
+ * @returns number of bytes written (the sum of all return values of calls to func)
+ */
+extern size_t fjson_object_dump_iov(struct fjson_object *obj, int flags,
+	fjson_writev_fn *func, void *ptr);
+
+/**
+ * Same as fjson_object_dump_iov(), but with a user-supplied temporary
+ * buffer, see fjson_object_dump_buffered().
+ * @param obj object to be written
+ * @param flags extra flags
+ * @param temp your temporary buffer that is used to group calls
+ * @param size size of your temporary buffer
+ * @param func your function that will be called to write the data
+ * @param ptr pointer that will be passed as first argument to your function
+ */
+extern size_t fjson_object_dump_iov_buffered(struct fjson_object *obj, int flags, char *temp,
+size_t size, fjson_writev_fn *func, void *ptr);
+
+/**
+ * Dump function that serializes the top-level children of a large array
+ * or object in parallel. The children are split into nparts ranges of
+ * about the same size, each of which is written into a buffer of its own
+ * by one of the executor's tasks (see fjson_executor_fn). The buffers are
+ * then passed to func in order from the calling thread, so the output is
+ * the same as with fjson_object_dump_ext(), for all flags. Values with
+ * too few children are not split. The tree must not be modified while
+ * this function runs.
+ * @param obj object to be written
+ * @param flags extra flags
+ * @param nparts the number of parts to split into, e.g. the thread count
+ * @param exec the executor, or NULL to run the tasks in the calling thread
+ * @param exec_ctx passed to exec
+ * @param func your function that will be called to write the data
+ * @param ptr pointer that will be passed as first argument to your function
+ * @returns number of bytes written (the sum of all return values of calls to func)
+ */
+extern size_t fjson_object_dump_parallel(struct fjson_object *obj, int flags, int nparts,
+	fjson_executor_fn *exec, void *exec_ctx, fjson_write_fn *func, void *ptr);
+
 /**
  * Write the json tree to a file
  * Equivalent to fjson_object_write_ext(obj, FJSON_TO_STRING_SPACED, fp)
@@ -294,6 +536,54 @@ extern const char* fjson_object_to_json_string(struct fjson_object *obj);
 extern const char* fjson_object_to_json_string_ext(struct fjson_object *obj, int
 flags);
 
+/** Stringify object to json format, serializing the top-level children
+ * in parallel. The result is the same as with
+ * fjson_object_to_json_string_ext(), see fjson_object_dump_parallel() for
+ * how the work is split.
+ * @see fjson_object_to_json_string() for details on how to free string.
+ * @param obj the fjson_object instance
+ * @param flags formatting options, see FJSON_TO_STRING_PRETTY and other constants
+ * @param nparts the number of parts to split into, e.g. the thread count
+ * @param exec the executor, or NULL to run the tasks in the calling thread
+ * @param exec_ctx passed to exec
+ * @returns a string in JSON format
+ */
+extern const char* fjson_object_to_json_string_parallel(struct fjson_object *obj, int flags,
+	int nparts, fjson_executor_fn *exec, void *exec_ctx);
+
+struct fjson_print_ctx;
+/**
+ * Create a serialization context for fjson_object_to_json_string_ctx().
+ * It holds an output buffer that is reused by all calls, so once it has
+ * grown large enough, serializing needs no memory allocation at all. A
+ * context must only be used by one thread at a time; the usual setup is
+ * one per worker thread.
+ * @returns the new context or NULL on malloc error
+ */
+extern struct fjson_print_ctx* fjson_print_ctx_new(void);
+
+/**
+ * Free a serialization context and its buffer.
+ * @param pctx the context, may be NULL
+ */
+extern void fjson_print_ctx_free(struct fjson_print_ctx *pctx);
+
+/** Stringify object to json format into the buffer of a serialization
+ * context. Unlike fjson_object_to_json_string_ext(), this does not keep
+ * the output in the object, so no object ends up owning an output
+ * buffer and the same tree may be serialized by several threads at once
+ * (each with its own context), as long as no one modifies it.
+ * @param obj the fjson_object instance
+ * @param flags formatting options, see FJSON_TO_STRING_PRETTY and other constants
+ * @param pctx the serialization context
+ * @param len if not NULL, receives the length of the string
+ * @returns a string in JSON format, which is valid until the next call
+ *   with the same context or until the context is freed, or NULL if the
+ *   tree is nested too deeply (see fjson_global_set_max_print_depth())
+ */
+extern const char* fjson_object_to_json_string_ctx(struct fjson_object *obj, int flags,
+	struct fjson_print_ctx *pctx, size_t *len);
+
 
 /* object type methods */
 
@@ -309,6 +599,14 @@ flags);
  */
 extern struct fjson_object* fjson_object_new_object(void);
 
+/**
+ * Create a new empty object that uses the settings of a context instead
+ * of the process-wide ones (see fjson_ctx_new()).
+ * @param ctx the context, NULL means the same as fjson_object_new_object()
+ * @returns a fjson_object of type fjson_type_object
+ */
+extern struct fjson_object* fjson_object_new_object_ctx(const struct fjson_ctx *ctx);
+
 /** Get the size of an object in terms of the number of fields it has.
  * @param obj the fjson_object whose length to return
  */
@@ -391,17 +689,132 @@ extern fjson_bool fjson_object_object_get_ex(struct fjson_object* obj,
 	const char *key,
 	struct fjson_object **value);
 
+/** Compute the hash of an object key, for fjson_object_object_get_ex_len().
+ *
+ * The hash does not depend on the object or the comparison mode, so
+ * callers that look up the same key names over and over can compute it
+ * once at startup.
+ *
+ * @param key the object field name
+ * @param keylen length of key, or -1 if it is NUL-terminated
+ * @returns the hash
+ */
+extern uint32_t fjson_object_key_hash(const char *key, int keylen);
+
+/** Get the fjson_object associated with a given object field, with the
+ * length and hash of the key supplied by the caller.
+ *
+ * This is identical to fjson_object_object_get_ex(), but saves computing
+ * the hash of the key on each call. Also, the key need not be
+ * NUL-terminated.
+ *
+ * @param obj the fjson_object instance
+ * @param key the object field name
+ * @param keylen length of key, or -1 if it is NUL-terminated
+ * @param hash hash of key, as returned by fjson_object_key_hash()
+ * @param value a pointer where to store a reference to the fjson_object
+ *              associated with the given field name. May be NULL.
+ * @returns whether or not the key exists
+ */
+extern fjson_bool fjson_object_object_get_ex_len(struct fjson_object *obj,
+	const char *key,
+	int keylen,
+	uint32_t hash,
+	struct fjson_object **value);
+
 /** Delete the given fjson_object field
  *
  * The reference count will be decremented for the deleted object.  If there
  * are no more owners of the value represented by this key, then the value is
  * freed.  Otherwise, the reference to the value will remain in memory.
  *
+ * The other fields are not moved, so it is fine to delete the field an
+ * iterator has just moved past. The slot of a deleted field is reused by
+ * the next add. Once deleted slots outnumber the members, adding a new
+ * field compacts the object first, which invalidates iterators over obj.
+ *
  * @param obj the fjson_object instance
  * @param key the object field name
  */
 extern void fjson_object_object_del(struct fjson_object* obj, const char *key);
 
+/** Compact a fjson_object of type fjson_type_object
+ *
+ * Moves the fields to the slots left by deleted ones, keeping their
+ * order, and releases the memory no longer needed. Iterators over obj
+ * must not be used after this call. Does nothing for other types.
+ *
+ * @param obj the fjson_object instance
+ */
+extern void fjson_object_object_compact(struct fjson_object* obj);
+
+/**
+ * A flag for fjson_object_object_merge(): the caller passes its
+ * reference to src, which is released in any case. If nothing else
+ * holds src, its values and keys are moved over instead of shared
+ * or copied.
+ */
+#define FJSON_OBJECT_MERGE_CONSUME (1<<0)
+/**
+ * A flag for fjson_object_object_merge(): members that dst already has
+ * are left alone rather than replaced. Along with
+ * FJSON_OBJECT_MERGE_RECURSIVE, this applies to the members of objects
+ * that are merged as well.
+ */
+#define FJSON_OBJECT_MERGE_KEEP_EXISTING (1<<1)
+/**
+ * A flag for fjson_object_object_merge(): if a member is an object in
+ * both dst and src, the one of src is merged into the one of dst rather
+ * than replacing it.
+ */
+#define FJSON_OBJECT_MERGE_RECURSIVE (1<<2)
+
+/** Add all members of an object to another one
+ *
+ * This is the same as iterating over src and adding each member to dst
+ * with fjson_object_object_add() and an additional reference to the
+ * value, but considerably faster: keys are looked up by the hash src
+ * already has, keys are shared instead of copied, and the room
+ * for the new members is allocated at once. With
+ * FJSON_OBJECT_MERGE_CONSUME, values are even moved over. Otherwise dst
+ * shares them with src, so a modification via one of the objects is
+ * visible in the other. Create src with fjson_object_copy_containers() if this
+ * is not desired.
+ *
+ * Values of a src allocated in an arena are copied, as the arena may go
+ * away before dst.
+ *
+ * @param dst the object to add the members to
+ * @param src the object to take them from
+ * @param flags a combination of FJSON_OBJECT_MERGE_CONSUME,
+ *   FJSON_OBJECT_MERGE_KEEP_EXISTING and FJSON_OBJECT_MERGE_RECURSIVE
+ * @returns 0 on success, or -1 with errno set to EINVAL if dst or src is
+ *   not an object, or to ENOMEM. If out of memory, dst holds the members
+ *   merged so far.
+ */
+extern int fjson_object_object_merge(struct fjson_object *dst, struct fjson_object *src,
+	unsigned flags);
+
+/** Apply a JSON Merge Patch (RFC 7396)
+ *
+ * If patch is an object, its members are merged into *target (which is
+ * replaced by an empty object if it is none): members with a null value
+ * are removed from target, objects are patched into the respective
+ * member recursively, and other values replace it. If patch is not an
+ * object, it becomes the new target.
+ *
+ * *target is modified in place, while patch is not modified and stays
+ * owned by the caller. Values are shared with patch as by
+ * fjson_object_object_merge(); patch must not be part of *target, though.
+ *
+ * @param target points to the fjson_object instance to patch, which is
+ *   replaced if needed (the old one is then released)
+ * @param patch the patch (may be NULL)
+ * @returns 0 on success, or -1 with errno set to ENOMEM, in which case
+ *   *target holds the changes made so far
+ */
+extern int fjson_object_merge_patch(struct fjson_object **target, struct fjson_object *patch);
+
 
 /* Array type methods */
 
@@ -410,6 +823,15 @@ extern void fjson_object_object_del(struct fjson_object* obj, const char *key);
  */
 extern struct fjson_object* fjson_object_new_array(void);
 
+/** Create a new empty fjson_object of type fjson_type_array with room
+ * for a given number of elements, so that adding up to that many does
+ * not need to grow the array.
+ * @param initial_size number of elements to make room for, a value
+ *        of 0 or less means the default
+ * @returns a fjson_object of type fjson_type_array
+ */
+extern struct fjson_object* fjson_object_new_array_ex(int initial_size);
+
 /** Get the arraylist of a fjson_object of type fjson_type_array
  * @param obj the fjson_object instance
  * @returns an arraylist
@@ -463,6 +885,39 @@ extern struct fjson_object* fjson_object_array_bsearch(
 extern int fjson_object_array_add(struct fjson_object *obj,
 				 struct fjson_object *val);
 
+/** Add count elements to the end of a fjson_object of type fjson_type_array
+ *
+ * This is equivalent to calling fjson_object_array_add() for each of
+ * them, but grows the array only once. As with fjson_object_array_add(),
+ * the reference counts are *not* incremented. On error, nothing is
+ * added and the caller keeps ownership of all elements.
+ *
+ * @param obj the fjson_object instance
+ * @param vals the fjson_objects to be added
+ * @param count the number of elements in vals
+ * @returns 0 on success, -1 on error
+ */
+extern int fjson_object_array_add_many(struct fjson_object *obj,
+				 struct fjson_object *const *vals, int count);
+
+/** Make room for size elements in total in a fjson_object of type
+ * fjson_type_array. The length of the array is not changed.
+ *
+ * @param obj the fjson_object instance
+ * @param size the number of elements to make room for
+ * @returns 0 on success, -1 on error
+ */
+extern int fjson_object_array_reserve(struct fjson_object *obj, int size);
+
+/** Release the room of a fjson_object of type fjson_type_array that is
+ * not used by its elements, e.g. once the array is fully built. Arrays
+ * allocated from an arena are not changed.
+ *
+ * @param obj the fjson_object instance
+ * @returns 0 on success, -1 on error
+ */
+extern int fjson_object_array_shrink_to_fit(struct fjson_object *obj);
+
 /** Insert or replace an element at a specified index in an array (a fjson_object of type fjson_type_array)
  *
  * The reference count will *not* be incremented. This is to make adding
@@ -491,6 +946,87 @@ extern struct fjson_object* fjson_object_array_get_idx(struct fjson_object *obj,
 
 extern void fjson_object_array_del_idx(struct fjson_object *jso, int idx);
 
+/** Delete count elements starting at idx from a fjson_object of type
+ * fjson_type_array. The reference counts of the deleted elements are
+ * decremented and the following ones are moved down in one step.
+ *
+ * @param obj the fjson_object instance
+ * @param idx the index of the first element to delete
+ * @param count the number of elements to delete
+ * @returns 0 on success, -1 if the range is not fully inside the array
+ *          (nothing is deleted then)
+ */
+extern int fjson_object_array_del_range(struct fjson_object *obj, int idx, int count);
+
+/** Create a packed array of integers
+ *
+ * A packed array stores the values themselves in a contiguous block
+ * instead of one fjson_object per element, which takes a fraction of
+ * the memory and is serialized without creating any nodes. It is of
+ * type fjson_type_array and can be used with all array functions.
+ * fjson_object_array_get_idx() creates the node for an element when
+ * it is first asked for; the array owns it, as usual. Modifications
+ * that do not add values of the packed type (e.g.
+ * fjson_object_array_put_idx(), fjson_object_array_sort() or
+ * fjson_object_get_array()) convert it into a regular array first.
+ *
+ * @param vals the initial values, copied into the array
+ * @param count the number of elements in vals
+ * @returns a fjson_object of type fjson_type_array
+ */
+extern struct fjson_object* fjson_object_new_array_int64(const int64_t *vals, int count);
+
+/** Create a packed array of doubles
+ *
+ * @see fjson_object_new_array_int64()
+ *
+ * @param vals the initial values, copied into the array
+ * @param count the number of elements in vals
+ * @returns a fjson_object of type fjson_type_array
+ */
+extern struct fjson_object* fjson_object_new_array_double(const double *vals, int count);
+
+/** Add an integer to the end of a fjson_object of type fjson_type_array
+ *
+ * Packed integer arrays store the value directly, all other arrays get
+ * a new fjson_object for it.
+ *
+ * @param obj the fjson_object instance
+ * @param val the value to add
+ * @returns 0 on success, -1 on error
+ */
+extern int fjson_object_array_add_int64(struct fjson_object *obj, int64_t val);
+
+/** Add a double to the end of a fjson_object of type fjson_type_array
+ *
+ * @see fjson_object_array_add_int64()
+ *
+ * @param obj the fjson_object instance
+ * @param val the value to add
+ * @returns 0 on success, -1 on error
+ */
+extern int fjson_object_array_add_double(struct fjson_object *obj, double val);
+
+/** Get the values of a packed integer array without copying them
+ *
+ * The data stays valid until the array is modified or freed.
+ *
+ * @param obj the fjson_object instance
+ * @param count if not NULL, receives the number of values
+ * @returns the values, or NULL if obj is not a packed integer array
+ */
+extern const int64_t* fjson_object_array_get_int64_data(struct fjson_object *obj, int *count);
+
+/** Get the values of a packed double array without copying them
+ *
+ * @see fjson_object_array_get_int64_data()
+ *
+ * @param obj the fjson_object instance
+ * @param count if not NULL, receives the number of values
+ * @returns the values, or NULL if obj is not a packed double array
+ */
+extern const double* fjson_object_array_get_double_data(struct fjson_object *obj, int *count);
+
 /* fjson_bool type methods */
 
 /** Create a new empty fjson_object of type fjson_type_boolean
@@ -650,8 +1186,11 @@ extern struct fjson_object* fjson_object_new_string_len(const char *s, int len);
  * The returned string memory is managed by the fjson_object and will
  * be freed when the reference count of the fjson_object drops to zero.
  *
+ * If the string references the parser input (see FJSON_TOKENER_ZERO_COPY),
+ * it is copied on this call, as the input is not NUL-terminated.
+ *
  * @param obj the fjson_object instance
- * @returns a string
+ * @returns a string, or NULL if out of memory
  */
 extern const char* fjson_object_get_string(struct fjson_object *obj);
 
@@ -665,6 +1204,20 @@ extern const char* fjson_object_get_string(struct fjson_object *obj);
  */
 extern int fjson_object_get_string_len(struct fjson_object *obj);
 
+/** Copy all strings that reference the parser input into memory owned
+ * by the objects.
+ *
+ * Objects created by a tokener with FJSON_TOKENER_ZERO_COPY set may point
+ * into the buffer that was passed to fjson_tokener_parse_ex(). This must
+ * be called for all such objects that are still in use before the buffer
+ * is modified or released. obj may be of any type; containers are
+ * processed recursively.
+ *
+ * @param obj the fjson_object instance
+ * @returns 0 on success, -1 if out of memory (errno is set to ENOMEM)
+ */
+extern int fjson_object_materialize(struct fjson_object *obj);
+
 
 /** Get the number of direct members inside a json object.
  *
@@ -674,6 +1227,42 @@ extern int fjson_object_get_string_len(struct fjson_object *obj);
 int fjson_object_get_member_count(struct fjson_object *jso);
 
 
+/* arena memory management
+ *
+ * An arena provides the memory for all objects created by a tokener it
+ * is bound to (see fjson_tokener_set_arena()). This includes the nodes
+ * themselves as well as keys, strings, children pages and array storage.
+ * Memory is handed out by bump allocation from large blocks and released
+ * all at once by fjson_arena_reset() or fjson_arena_free(), without
+ * walking the object tree. An arena is not thread-safe; use one per
+ * thread.
+ *
+ * Objects living inside an arena can be used with all regular API
+ * functions, including fjson_object_put(), but their memory is only
+ * freed when the arena is reset. It is invalid to use them (or keep
+ * references to them in objects outside the arena) after that point.
+ * If heap-allocated objects were added to an arena tree, the root
+ * object must be put before the arena is reset, else they leak.
+ */
+struct fjson_arena;
+
+/** Create a new arena.
+ *
+ * @param blksize size of the memory blocks the arena allocates in one
+ *        step; 0 selects a default suitable for typical log events
+ * @returns the new arena or NULL on malloc error
+ */
+extern struct fjson_arena* fjson_arena_new(size_t blksize);
+
+/** Release all objects inside an arena at once. The arena itself
+ * stays usable and keeps one block of memory for re-use.
+ */
+extern void fjson_arena_reset(struct fjson_arena *arena);
+
+/** Release all objects inside the arena as well as the arena itself. */
+extern void fjson_arena_free(struct fjson_arena *arena);
+
+
 /* The following is a source code compatibility layer
  * in regard to json-c.
  * It currently is aimed at the rsyslog family of projects,
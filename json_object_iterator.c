@@ -110,16 +110,14 @@ fjson_object_iter_next(struct fjson_object_iterator *const __restrict__ iter)
 	if(iter->objs_remain > 0) {
 		--iter->objs_remain;
 		if(iter->objs_remain > 0) {
-			++iter->curr_idx;
-			if(iter->curr_idx == FJSON_OBJECT_CHLD_PG_SIZE) {
-				iter->pg = iter->pg->next;
-				iter->curr_idx = 0;
-			}
-			/* check empty slots; TODO: recurse or iterate? */
-			if(iter->pg->children[iter->curr_idx].k == NULL) {
-				++iter->objs_remain; /* correct */
-				fjson_object_iter_next(iter);
-			}
+			/* skip empty slots */
+			do {
+				++iter->curr_idx;
+				if(iter->curr_idx == iter->pg->size) {
+					iter->pg = iter->pg->next;
+					iter->curr_idx = 0;
+				}
+			} while(iter->pg->children[iter->curr_idx].k == NULL);
 		}
 	}
 }
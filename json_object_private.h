@@ -11,6 +11,8 @@
 #ifndef _fj_json_object_private_h_
 #define _fj_json_object_private_h_
 
+#include <stddef.h>
+#include <stdint.h>
 #include "atomic.h"
 
 #ifdef __cplusplus
@@ -27,9 +29,8 @@ extern "C" {
 #define LEN_DIRECT_STRING_DATA 32 /**< how many bytes are directly stored in fjson_object for strings? */
 
 /**
- *  Type of the delete and serialization functions.
+ *  Type of the serialization functions.
  */
-typedef void (fjson_object_private_delete_fn)(struct fjson_object *o);
 typedef int (fjson_object_to_json_string_fn)(struct fjson_object *jso,
 						struct printbuf *pb,
 						int level,
@@ -40,28 +41,96 @@ struct _fjson_child {
 	 * The key.
 	 */
 	const char *k;
-	int k_is_constant;
-	struct {
-		unsigned k_is_constant : 1;
-	} flags;
 	/**
 	 * The value.
 	 */
 	struct fjson_object *v;
+	/**
+	 * Hash and length of the key, so that lookups can reject almost all
+	 * mismatches without touching the key itself.
+	 */
+	uint32_t hash;
+	unsigned klen : 30;
+	unsigned k_is_constant : 1;
+	unsigned k_no_escape : 1; /**< key can be written without escaping */
 };
 
+/**
+ * A page of children. The first page is part of the object, further
+ * ones are allocated with their entries and free map directly behind
+ * the header.
+ */
 struct _fjson_child_pg {
-	struct _fjson_child children[FJSON_OBJECT_CHLD_PG_SIZE];
 	struct _fjson_child_pg *next;
+	struct _fjson_child *children;
+	uint64_t *freemap;	/**< one bit per deleted entry */
+	int size;	/**< number of entries */
+	int nfree;	/**< bits set in freemap */
+};
+
+/* number of free map words a page of given size needs */
+#define JSO_FREEMAP_WORDS(size) (((size) + 63) / 64)
+
+/**
+ * Hash index over the children of a large object. It only holds
+ * pointers to the entries inside the children pages (which only move
+ * when the object is compacted, and then the index is rebuilt), so the
+ * insertion order kept in the pages is not affected.
+ */
+struct _fjson_child_idx {
+	int size;	/**< number of slots, always a power of two */
+	int nused;	/**< slots holding a live entry */
+	int ntomb;	/**< slots holding a deleted-entry marker */
+	struct _fjson_child_idx_slot {
+		uint32_t hash;
+		struct _fjson_child *chld;
+	} slots[];
+};
+
+/**
+ * Storage of a packed numeric array, which holds its values directly
+ * instead of nodes. Nodes are only created when someone asks for an
+ * element via fjson_object_array_get_idx(); they are kept in boxed, so
+ * that the same element always yields the same node.
+ */
+struct _fjson_packed {
+	int length;
+	int size;	/**< room in data and boxed */
+	union {
+		int64_t *i64;
+		double *d;
+	} data;
+	struct fjson_object *volatile *boxed; /**< NULL until first needed */
+	int lock;	/**< for creating boxed nodes */
+	DEF_ATOMIC_HELPER_MUT(mut)
 };
 
+/**
+ * A node. Only the union member for its type is allocated (see
+ * jso_node_size() in json_object.c), so scalar nodes take just a few
+ * bytes on top of the 24 byte header (x64). Never copy or access a
+ * node as a whole.
+ */
 struct fjson_object
 {
-	enum fjson_type o_type;
-	fjson_object_private_delete_fn *_delete;
-	fjson_object_to_json_string_fn *_to_json_string;
 	int _ref_count;
+	enum fjson_type o_type : 8;
+	unsigned char _pb_flags; /**< flags _pb was created with */
+	struct {
+		unsigned short in_arena : 1; /**< memory is owned by a struct fjson_arena */
+		unsigned short str_ref : 1; /**< c_string.str.ptr points into the parser input */
+		unsigned short str_nul : 1; /**< str_ref string is NUL-terminated there */
+		unsigned short pb_valid : 1; /**< _pb holds the current output for _pb_flags */
+		unsigned short shared : 1; /**< held by more than one container (or twice by one) */
+		unsigned short nocache : 1; /**< do not cache output, a descendant is shared */
+		unsigned short local_ref : 1; /**< _ref_count is not updated atomically */
+		unsigned short key_cmp : 2; /**< JSO_KEY_CMP_*, for objects */
+		unsigned short immortal : 1; /**< static singleton, never changed or freed */
+		unsigned short packed : 2; /**< JSO_PACKED_*, for arrays */
+	} _flags;
 	struct printbuf *_pb;
+	struct fjson_object *_parent; /**< the container holding us, if not shared */
+	DEF_ATOMIC_HELPER_MUT(_mut_ref_count)
 	union data {
 		fjson_bool c_boolean;
 		struct {
@@ -72,24 +141,137 @@ struct fjson_object
 		struct {
 			int nelem;
 			int ndeleted;
+			int lastpg_used; /**< entries of lastpg handed out so far */
 			struct _fjson_child_pg pg;
 			struct _fjson_child_pg *lastpg;
+			struct _fjson_child_idx *idx; /**< NULL until object grows large */
+			uint64_t hash; /**< cached fjson_object_hash(), 0 if not known */
+			struct _fjson_child first[FJSON_OBJECT_CHLD_PG_SIZE]; /**< entries of pg */
+			uint64_t firstmap[JSO_FREEMAP_WORDS(FJSON_OBJECT_CHLD_PG_SIZE)];
 		} c_obj;
 		struct array_list *c_array;
+		struct _fjson_packed *c_packed; /**< if _flags.packed is set */
 		struct {
+			int len;
 			union {
 			/* optimize: if we have small strings, we can store them
 			 * directly. This saves considerable CPU cycles AND memory.
+			 * The node is only as large as the string needs.
 			 */
 			char *ptr;
 			char data[LEN_DIRECT_STRING_DATA];
 			} str;
-		int len;
 		} c_string;
 	} o;
-	DEF_ATOMIC_HELPER_MUT(_mut_ref_count)
 };
 
+/* what a packed array holds */
+#define JSO_PACKED_NONE   0 /**< a regular array (c_array) */
+#define JSO_PACKED_INT64  1
+#define JSO_PACKED_DOUBLE 2
+
+/* how an object compares its keys */
+#define JSO_KEY_CMP_GLOBAL 0 /**< as set by fjson_global_do_case_sensitive_comparison() */
+#define JSO_KEY_CMP_CASE   1
+#define JSO_KEY_CMP_NOCASE 2
+
+struct fjson_ctx {
+	int key_cmp;		/**< JSO_KEY_CMP_* for new objects */
+	int printbuf_initial_size; /**< 0 means the global default */
+	struct fjson_keydict *keys; /**< for interning keys, may be NULL */
+};
+
+/* the key length as stored in the child entry */
+#define KLEN(len) ((unsigned) (len) & 0x3fffffff)
+
+/* the hash of a key as used for objects: FNV-1a over case-folded
+ * characters, so it serves both comparison modes. Also returns the
+ * key length in *klen.
+ */
+static inline uint32_t
+_fjson_key_hash(const char *const key, unsigned *const klen)
+{
+	uint32_t h = 2166136261u;
+	const char *p;
+	for (p = key ; *p ; ++p) {
+		unsigned char c = (unsigned char) *p;
+		if (c >= 'A' && c <= 'Z')
+			c |= 0x20;
+		h = (h ^ c) * 16777619u;
+	}
+	*klen = KLEN(p - key);
+	return h;
+}
+
+/* same for a key of given length, which need not be NUL-terminated */
+static inline uint32_t
+_fjson_key_hash_len(const char *const key, const size_t len)
+{
+	uint32_t h = 2166136261u;
+	size_t i;
+	for (i = 0 ; i < len ; ++i) {
+		unsigned char c = (unsigned char) key[i];
+		if (c >= 'A' && c <= 'Z')
+			c |= 0x20;
+		h = (h ^ c) * 16777619u;
+	}
+	return h;
+}
+
+/* an interned key (see json_keydict.h); str is what users get to see */
+struct _fjson_key {
+	struct _fjson_key *next;
+	uint32_t hash;
+	unsigned len : 30;	/**< as KLEN() */
+	unsigned no_escape : 1;	/**< as k_no_escape in struct _fjson_child */
+	char str[];
+};
+
+static inline const struct _fjson_key *
+_fjson_key_of(const char *const str)
+{
+	return (const struct _fjson_key *) (str - offsetof(struct _fjson_key, str));
+}
+
+/* fjson_object_object_add() for a NUL-terminated key whose length and
+ * hash (as by _fjson_key_hash()) are known. Returns -1 if out of memory,
+ * in which case val is not added.
+ */
+extern int _fjson_object_object_add_hashed(struct fjson_object *jso, const char *key,
+	unsigned klen, uint32_t hash, struct fjson_object *val);
+
+/* for other modules that compare keys themselves */
+extern int _fjson_keys_case_sensitive(void);
+
+/* serialize into pb, as fjson_object_dump_ext() would write it.
+ * Returns 0 on success, or -1 with errno set if serializing had to stop
+ * (see fjson_global_set_max_print_depth()).
+ */
+extern int _fjson_object_write_printbuf(struct fjson_object *jso, int flags, struct printbuf *pb);
+
+/* constructors used by the tokener. They allocate from the given arena,
+ * or from the heap if it is NULL.
+ */
+extern struct fjson_object* _fjson_object_new_object_a(struct fjson_arena *arena);
+extern struct fjson_object* _fjson_object_new_array_a(struct fjson_arena *arena);
+extern struct fjson_object* _fjson_object_new_boolean_a(struct fjson_arena *arena, fjson_bool b);
+extern struct fjson_object* _fjson_object_new_int64_a(struct fjson_arena *arena, int64_t i);
+extern struct fjson_object* _fjson_object_new_double_a(struct fjson_arena *arena, double d);
+extern struct fjson_object* _fjson_object_new_double_s_a(struct fjson_arena *arena,
+	double d, const char *ds, size_t len);
+extern struct fjson_object* _fjson_object_new_string_len_a(struct fjson_arena *arena,
+	const char *s, int len);
+/* creates a string that references s instead of copying it (see
+ * FJSON_TOKENER_ZERO_COPY). s is not NUL-terminated, but must be followed
+ * by a character that ends a number (the closing quote, in practice).
+ * Strings that fit into the object itself are always copied.
+ */
+extern struct fjson_object* _fjson_object_new_string_ref_a(struct fjson_arena *arena,
+	const char *s, int len);
+/* same, but s is NUL-terminated (see fjson_tokener_parse_inplace()) */
+extern struct fjson_object* _fjson_object_new_string_inplace_a(struct fjson_arena *arena,
+	const char *s, int len);
+
 #ifdef __cplusplus
 }
 #endif
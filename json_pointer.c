@@ -0,0 +1,293 @@
+/*
+ * Copyright (c) 2026 Adiscon GmbH
+ * Rainer Gerhards <rgerhards@adiscon.com>
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See COPYING for details.
+ *
+ */
+
+/* JSON Pointer (RFC 6901)
+ *
+ * A compiled path is a single block: the component array, followed by
+ * the unescaped keys, each NUL-terminated. Along with each key, we keep
+ * its length and hash as the objects store them, and the array index
+ * it denotes, so following a path does no string processing at all.
+ * The one-shot functions compile into a buffer on the stack if the path
+ * fits, so they do not allocate either.
+ */
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+
+#include "alloc.h"
+#include "json_object.h"
+#include "json_object_private.h"
+#include "json_pointer.h"
+
+/* the component is no array index, or the "-" past the last element */
+#define PATH_IDX_NONE -1
+#define PATH_IDX_END -2
+
+/* room for the usual paths in the one-shot functions, in uint64_t's */
+#define PATH_LOCAL_WORDS 64
+
+struct path_comp {
+	const char *key;
+	unsigned klen;
+	uint32_t hash;
+	int idx;
+};
+
+struct fjson_path {
+	int ncomps;
+	struct path_comp comps[];
+};
+
+/* check the syntax and count the components. Returns -1 if invalid. */
+static int
+path_count(const char *const path, int *const ncomps)
+{
+	const char *p;
+
+	*ncomps = 0;
+	if (path[0] == '$' && path[1] == '!') {
+		if (path[2] == '\0')
+			return 0;
+		for (p = path + 2, *ncomps = 1 ; *p ; ++p)
+			*ncomps += (*p == '!');
+		return 0;
+	}
+	if (path[0] != '/' && path[0] != '\0')
+		return -1;
+	for (p = path ; *p ; ++p) {
+		if (*p == '/') {
+			++*ncomps;
+		} else if (*p == '~') {
+			if (p[1] != '0' && p[1] != '1')
+				return -1;
+			++p;
+		}
+	}
+	return 0;
+}
+
+/* the array index denoted by key: decimal, without leading zeros */
+static int
+path_index(const char *const key, const unsigned klen)
+{
+	int idx = 0;
+	unsigned i;
+
+	if (klen == 1 && key[0] == '-')
+		return PATH_IDX_END;
+	if (klen == 0 || klen > 10 || (key[0] == '0' && klen > 1))
+		return PATH_IDX_NONE;
+	for (i = 0 ; i < klen ; ++i) {
+		const int d = key[i] - '0';
+		if (d < 0 || d > 9 || idx > (INT_MAX - d) / 10)
+			return PATH_IDX_NONE;
+		idx = idx * 10 + d;
+	}
+	return idx;
+}
+
+/* compile into buf if it has size bytes or more, else into new memory.
+ * Returns NULL with errno set on failure.
+ */
+static struct fjson_path *
+path_compile(const char *path, void *const buf, const size_t size)
+{
+	struct fjson_path *cp;
+	const char sep = (path[0] == '$') ? '!' : '/';
+	size_t bytes;
+	char *out;
+	int ncomps, i;
+
+	if (path_count(path, &ncomps) != 0) {
+		errno = EINVAL;
+		return NULL;
+	}
+	bytes = sizeof(struct fjson_path) + ncomps * sizeof(struct path_comp) + strlen(path) + 1;
+	if (bytes <= size) {
+		cp = buf;
+	} else if ((cp = _fjson_malloc(bytes)) == NULL) {
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	cp->ncomps = ncomps;
+	out = (char *) (cp->comps + ncomps);
+	if (sep == '!')
+		++path;		/* at the '!', like at the '/' of a pointer */
+	for (i = 0 ; i < ncomps ; ++i) {
+		struct path_comp *const c = &cp->comps[i];
+		c->key = out;
+		for (++path ; *path != '\0' && *path != sep ; ++path) {
+			if (*path == '~' && sep == '/') {
+				*out++ = (*++path == '1') ? '/' : '~';
+			} else {
+				*out++ = *path;
+			}
+		}
+		*out++ = '\0';
+		c->klen = KLEN(out - 1 - c->key);
+		c->hash = _fjson_key_hash_len(c->key, c->klen);
+		c->idx = path_index(c->key, c->klen);
+	}
+	return cp;
+}
+
+struct fjson_path*
+fjson_path_compile(const char *const path)
+{
+	return path_compile(path, NULL, 0);
+}
+
+void
+fjson_path_free(struct fjson_path *const path)
+{
+	_fjson_free(path);
+}
+
+fjson_bool
+fjson_path_get(struct fjson_object *jso, const struct fjson_path *const path,
+	struct fjson_object **const value)
+{
+	int i;
+
+	if (value != NULL)
+		*value = NULL;
+	for (i = 0 ; i < path->ncomps ; ++i) {
+		const struct path_comp *const c = &path->comps[i];
+		if (jso != NULL && jso->o_type == fjson_type_array) {
+			if (c->idx < 0 || c->idx >= fjson_object_array_length(jso))
+				return FALSE;
+			jso = fjson_object_array_get_idx(jso, c->idx);
+		} else if (!fjson_object_object_get_ex_len(jso, c->key, (int) c->klen, c->hash, &jso)) {
+			return FALSE;
+		}
+	}
+	if (value != NULL)
+		*value = jso;
+	return TRUE;
+}
+
+/* an empty object is created for a missing member along the path; the
+ * first one of them is removed again if setting fails later on
+ */
+int
+fjson_path_set(struct fjson_object *jso, const struct fjson_path *const path,
+	struct fjson_object *const value)
+{
+	struct fjson_object *created_in = NULL;
+	const char *created_key = NULL;
+	const struct path_comp *c;
+	int err, i;
+
+	if (path->ncomps == 0) {
+		errno = EINVAL;
+		return -1;
+	}
+	for (i = 0 ; i < path->ncomps - 1 ; ++i) {
+		struct fjson_object *child;
+		c = &path->comps[i];
+		if (jso == NULL) {
+			err = EINVAL;
+			goto fail;
+		}
+		if (jso->o_type == fjson_type_array) {
+			if (c->idx < 0 || c->idx >= fjson_object_array_length(jso)) {
+				err = ENOENT;
+				goto fail;
+			}
+			child = fjson_object_array_get_idx(jso, c->idx);
+		} else if (jso->o_type != fjson_type_object) {
+			err = EINVAL;
+			goto fail;
+		} else if (!fjson_object_object_get_ex_len(jso, c->key, (int) c->klen, c->hash, &child)) {
+			if ((child = fjson_object_new_object()) == NULL) {
+				err = ENOMEM;
+				goto fail;
+			}
+			if (_fjson_object_object_add_hashed(jso, c->key, c->klen, c->hash, child) != 0) {
+				fjson_object_put(child);
+				err = ENOMEM;
+				goto fail;
+			}
+			if (created_in == NULL) {
+				created_in = jso;
+				created_key = c->key;
+			}
+		}
+		jso = child;
+	}
+
+	c = &path->comps[path->ncomps - 1];
+	if (jso != NULL && jso->o_type == fjson_type_object) {
+		if (_fjson_object_object_add_hashed(jso, c->key, c->klen, c->hash, value) == 0)
+			return 0;
+		err = ENOMEM;
+	} else if (jso != NULL && jso->o_type == fjson_type_array) {
+		const int len = fjson_object_array_length(jso);
+		if (c->idx == PATH_IDX_END || c->idx == len) {
+			if (fjson_object_array_add(jso, value) == 0)
+				return 0;
+			err = ENOMEM;
+		} else if (c->idx >= 0 && c->idx < len) {
+			if (fjson_object_array_put_idx(jso, c->idx, value) == 0)
+				return 0;
+			err = ENOMEM;
+		} else {
+			err = ENOENT;
+		}
+	} else {
+		err = EINVAL;
+	}
+
+fail:
+	if (created_in != NULL)
+		fjson_object_object_del(created_in, created_key);
+	errno = err;
+	return -1;
+}
+
+fjson_bool
+fjson_object_get_path(struct fjson_object *const jso, const char *const path,
+	struct fjson_object **const value)
+{
+	uint64_t local[PATH_LOCAL_WORDS];
+	struct fjson_path *const cp = path_compile(path, local, sizeof(local));
+	fjson_bool found;
+
+	if (cp == NULL) {
+		if (value != NULL)
+			*value = NULL;
+		return FALSE;
+	}
+	found = fjson_path_get(jso, cp, value);
+	if (cp != (struct fjson_path *) local)
+		_fjson_free(cp);
+	return found;
+}
+
+int
+fjson_object_set_path(struct fjson_object *const jso, const char *const path,
+	struct fjson_object *const value)
+{
+	uint64_t local[PATH_LOCAL_WORDS];
+	struct fjson_path *const cp = path_compile(path, local, sizeof(local));
+	int r, err;
+
+	if (cp == NULL)
+		return -1;
+	r = fjson_path_set(jso, cp, value);
+	err = errno;
+	if (cp != (struct fjson_path *) local)
+		_fjson_free(cp);
+	errno = err;
+	return r;
+}
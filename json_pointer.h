@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2026 Adiscon GmbH
+ * Rainer Gerhards <rgerhards@adiscon.com>
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See COPYING for details.
+ *
+ */
+
+#ifndef _fj_json_pointer_h_
+#define _fj_json_pointer_h_
+
+#include "json_object.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * A compiled path into a tree of objects and arrays.
+ *
+ * Paths are JSON Pointers as of RFC 6901, like "/a/b/0", where "~1"
+ * stands for a '/' and "~0" for a '~' within a key, and the empty path
+ * denotes the root itself. For convenience, rsyslog notation like
+ * "$!a!b!c" is accepted as well; it has no escapes, and "$!" is the
+ * root.
+ *
+ * Compiling splits the path into its components once and computes the
+ * hashes of the keys, so that following it only takes one lookup per
+ * component. Applications that access the same properties for every
+ * message should compile their paths at startup. A compiled path is
+ * not modified when used, so it can be shared by multiple threads.
+ */
+typedef struct fjson_path fjson_path;
+
+/**
+ * Compile a path.
+ * @param path the path, see above
+ * @returns the compiled path, or NULL with errno set to EINVAL if path
+ *   is invalid, or to ENOMEM on malloc error
+ */
+extern struct fjson_path* fjson_path_compile(const char *path);
+
+/**
+ * Free a compiled path.
+ * @param path the compiled path, may be NULL
+ */
+extern void fjson_path_free(struct fjson_path *path);
+
+/**
+ * Get the value a compiled path points to.
+ *
+ * A component is looked up as a key in objects and as an index in
+ * arrays; there, it must be a decimal number without leading zeros.
+ * The "-" of RFC 6901 never points to an existing element.
+ *
+ * As with fjson_object_object_get_ex(), no reference counts are changed.
+ *
+ * @param obj the root of the tree
+ * @param path the compiled path
+ * @param value receives the value, or NULL if it does not exist. May be
+ *   NULL.
+ * @returns whether the value exists
+ */
+extern fjson_bool fjson_path_get(struct fjson_object *obj, const struct fjson_path *path,
+	struct fjson_object **value);
+
+/**
+ * Set the value a compiled path points to.
+ *
+ * If the last component names a member of an object, the member is
+ * added or replaced. In an array, it must be the index of an existing
+ * element, which is replaced, or "-" or the array length to append.
+ * Missing objects along the path are created as empty objects, but
+ * arrays are not extended.
+ *
+ * As with fjson_object_object_add(), the reference count of value is
+ * not incremented: on success, it is owned by the tree. On failure, it
+ * stays with the caller.
+ *
+ * @param obj the root of the tree
+ * @param path the compiled path, which must not be the root itself
+ * @param value the new value, may be NULL for a JSON null
+ * @returns 0 on success, or -1 with errno set to EINVAL if a component
+ *   along the path is neither an object nor an array or path is the
+ *   root, to ENOENT if an array index is out of range, or to ENOMEM
+ */
+extern int fjson_path_set(struct fjson_object *obj, const struct fjson_path *path,
+	struct fjson_object *value);
+
+/**
+ * Same as fjson_path_get(), but with a path that is not compiled. It is
+ * compiled on the fly, usually without allocating memory.
+ * @returns whether the value exists; FALSE with errno set to EINVAL if
+ *   path is invalid
+ */
+extern fjson_bool fjson_object_get_path(struct fjson_object *obj, const char *path,
+	struct fjson_object **value);
+
+/**
+ * Same as fjson_path_set(), but with a path that is not compiled. It is
+ * compiled on the fly, usually without allocating memory.
+ * @returns 0 on success, or -1 with errno set, see fjson_path_set() and
+ *   fjson_path_compile()
+ */
+extern int fjson_object_set_path(struct fjson_object *obj, const char *path,
+	struct fjson_object *value);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
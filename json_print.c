@@ -21,66 +21,46 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <limits.h>
+#include <errno.h>
+#include <sys/uio.h>
 
-#ifdef HAVE_STDARG_H
-# include <stdarg.h>
-#else /* !HAVE_STDARG_H */
-# error Not enough var arg support!
-#endif /* HAVE_STDARG_H */
-
+#include "json.h"
 #include "json_object.h"
 #include "json_object_private.h"
 #include "json_object_iterator.h"
+#include "printbuf.h"
+#include "alloc.h"
+#include "simd_scan.h"
+#include "numconv.h"
 
 
-#if !defined(HAVE_SNPRINTF)
-# error You do not have snprintf on your system.
-#endif /* HAVE_SNPRINTF */
-
-#if !defined(HAVE_VASPRINTF)
-/* CAW: compliant version of vasprintf */
-/* Note: on OpenCSW, we have vasprintf() inside the headers, but not inside the lib.
- * So we need to use a different name, else we get issues with redefinitions. We
- * we solve this by using the macro below, which just renames the function BUT
- * does not affect the (variadic) arguments.
- * rgerhards, 2017-04-11
- */
-#define  vasprintf rs_vasprintf
-#ifndef _AIX
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wformat-nonliteral"
-#endif
-static int rs_vasprintf(char **buf, const char *fmt, va_list ap)
-{
-	int chars;
-	char *b;
-	static char _T_emptybuffer = '\0';
-
-	if(!buf) { return -1; }
-
-	/* CAW: RAWR! We have to hope to god here that vsnprintf doesn't overwrite
-	   our buffer like on some 64bit sun systems.... but hey, its time to move on */
-	chars = vsnprintf(&_T_emptybuffer, 0, fmt, ap)+1;
-	if(chars < 0) { chars *= -1; } /* CAW: old glibc versions have this problem */
-
-	b = (char*)malloc(sizeof(char)*chars);
-	if(!b) { return -1; }
+/* iovec mode: fragments at least this long are referenced, not copied */
+#define IOV_MIN_REF 128
 
-	if((chars = vsprintf(b, fmt, ap)) < 0) {
-		free(b);
-	} else {
-		*buf = b;
-	}
-
-	return chars;
-}
-#ifndef _AIX
-#pragma GCC diagnostic pop
+/* number of entries handed to the writev callback at most */
+#if defined(IOV_MAX) && IOV_MAX < 64
+#	define DUMP_IOV_MAX IOV_MAX
+#else
+#	define DUMP_IOV_MAX 64
 #endif
-#endif /* !HAVE_VASPRINTF */
 
 /**
  *  Internal structure that we use for buffering the print output
+ *
+ *  If overflow is NULL, buffer is a fixed-size target: data is copied
+ *  as long as it fits and everything else is only counted in filled.
+ *  With a size of 0, this just calculates the output length.
+ *
+ *  If writev is set, we are in iovec mode: small fragments are still
+ *  copied to the buffer, but long ones that stay valid until the dump
+ *  is done (string bodies, cached output) only get an iov entry. The
+ *  buffer contents between seg and filled are not yet covered by one.
+ *
+ *  If pb is set, data goes straight to that printbuf instead (this is
+ *  how fjson_object_to_json_string_ext() and friends serialize).
+ *
+ *  error is set to an errno value if writing had to be stopped.
  */
 struct buffer {
 	char *buffer;
@@ -88,8 +68,46 @@ struct buffer {
 	size_t filled;
 	fjson_write_fn *overflow;
 	void *ptr;
+	fjson_writev_fn *writev;
+	struct iovec *iov;
+	int iovcnt;
+	size_t seg;
+	struct printbuf *pb;
+	int error;
 };
 
+/**
+ *  Internal method to add an iov entry for the not yet covered part
+ *  of the buffer. There must be room for one more entry.
+ *  @param  buffer
+ */
+static void iov_close_segment(struct buffer *buffer)
+{
+	if (buffer->filled == buffer->seg) return;
+	buffer->iov[buffer->iovcnt].iov_base = buffer->buffer + buffer->seg;
+	buffer->iov[buffer->iovcnt].iov_len = buffer->filled - buffer->seg;
+	++buffer->iovcnt;
+	buffer->seg = buffer->filled;
+}
+
+/**
+ *  Internal method to pass all collected iov entries to the callback
+ *  @param  buffer
+ *  @return size_t
+ */
+static size_t iov_flush(struct buffer *buffer)
+{
+	size_t result = 0;
+	iov_close_segment(buffer);
+	if (buffer->iovcnt > 0) result = buffer->writev(buffer->ptr, buffer->iov, buffer->iovcnt);
+
+	// everything is handed over, the buffer can be reused
+	buffer->iovcnt = 0;
+	buffer->filled = 0;
+	buffer->seg = 0;
+	return result;
+}
+
 /**
  *  Internal method to flush the buffer
  *  @param  buffer
@@ -97,6 +115,9 @@ struct buffer {
  */
 static size_t buffer_flush(struct buffer *buffer)
 {
+	// iovec mode has its own bookkeeping
+	if (buffer->writev != NULL) return iov_flush(buffer);
+
 	// call the user-supplied overflow function
 	size_t result = buffer->overflow(buffer->ptr, buffer->buffer, buffer->filled);
 
@@ -108,25 +129,49 @@ static size_t buffer_flush(struct buffer *buffer)
 }
 
 /**
- *  Internal method to append data to the buffer
+ *  Internal method to append data that did not simply fit, see below
  *  @param  buffer
  *  @param  data
  *  @param  size
  *  @return size_t
  */
-static size_t buffer_append(struct buffer *buffer, const char *data, size_t size)
+static size_t buffer_append_slow(struct buffer *buffer, const char *data, size_t size)
 {
 	// return value
 	size_t result = 0;
 
+	// printbuf that needs to grow?
+	if (buffer->pb != NULL)
+	{
+		printbuf_memappend_no_nul(buffer->pb, data, (int) size);
+		return size;
+	}
+
+	// fixed-size target?
+	if (buffer->overflow == NULL && buffer->writev == NULL)
+	{
+		if (buffer->filled < buffer->size)
+			memcpy(buffer->buffer + buffer->filled, data,
+				(size < buffer->size - buffer->filled) ? size : buffer->size - buffer->filled);
+		buffer->filled += size;
+		return size;
+	}
+
 	// is the data to big to fit in the buffer?
 	if (buffer->filled + size > buffer->size)
 	{
 		// flush current buffer
-		if (buffer->filled > 0) result += buffer_flush(buffer);
+		if (buffer->filled > 0 || buffer->iovcnt > 0) result += buffer_flush(buffer);
 
 		// does it still not fit? then we pass it to the callback immediately
-		if (size > buffer->size) return result + buffer->overflow(buffer->ptr, data, size);
+		if (size > buffer->size)
+		{
+			if (buffer->writev == NULL) return result + buffer->overflow(buffer->ptr, data, size);
+			struct iovec iov;
+			iov.iov_base = (void *) data;
+			iov.iov_len = size;
+			return result + buffer->writev(buffer->ptr, &iov, 1);
+		}
 	}
 
 	// append to the buffer
@@ -140,88 +185,64 @@ static size_t buffer_append(struct buffer *buffer, const char *data, size_t size
 }
 
 /**
- *  Internal method to printf() into the buffer
+ *  Internal method to append data to the buffer
+ *
+ *  Most fragments are a few bytes that fit right in, so that case is
+ *  kept small enough to be inlined everywhere.
  *  @param  buffer
- *  @param  format
- *  @param ...
+ *  @param  data
+ *  @param  size
  *  @return size_t
  */
-__attribute__((__format__(__printf__, 2, 3)))
-static size_t buffer_printf(struct buffer *buffer, const char *format, ...)
+static inline size_t buffer_append(struct buffer *buffer, const char *data, size_t size)
 {
-	// return value
-	size_t result = 0;
-
-	// variables used in this function
-	va_list arguments;
-	char *tmp;
-	int size;
-
-	// make sure we have sufficient room in our buffer
-	if (buffer->size - buffer->filled < 32) result += buffer_flush(buffer);
-
-	// initialize varargs
-	va_start(arguments, format);
-
-	// write to the buffer (note the extra char for the extra null that is written by vsnprintf())
-	size = vsnprintf(buffer->buffer + buffer->filled, buffer->size - buffer->filled - 1, format, arguments);
-
-	// clean up varargs (it is not possible to reuse the vararg arguments later on,
-	// the have to be reset and possible reinitialized later on)
-	va_end(arguments);
-
-	// was this all successful?
-	if (size >= 0 && size < (int)(buffer->size - buffer->filled))
+	struct printbuf *const pb = buffer->pb;
+	if (pb != NULL)
 	{
-		// this was a major success
-		buffer->filled += size;
+		if ((size_t) (pb->size - pb->bpos) > size)
+		{
+			memcpy(pb->buf + pb->bpos, data, size);
+			pb->bpos += (int) size;
+			return size;
+		}
 	}
-	else if (size > 0 && size < (int)buffer->size)
+	else if ((buffer->overflow != NULL || buffer->writev != NULL) && buffer->filled + size <= buffer->size)
 	{
-		// there was not enough room in the buffer, but it would have been enough if
-		// we would have been able to use the entire buffer, so we reset the buffer,
-		// and retry the whole procedure
-		result += buffer_flush(buffer);
-
-		// buffer is empty now, we can retry, start with the vararg initialization
-		va_start(arguments, format);
-
-		// format into the buffer, again
-		buffer->size += vsnprintf(buffer->buffer + buffer->filled,
-			buffer->size - buffer->filled - 1, format, arguments);
-
-		// clean up varargs
-		va_end(arguments);
+		memcpy(buffer->buffer + buffer->filled, data, size);
+		buffer->filled += size;
+		return 0;
 	}
-	else
-	{
-		// initialize varargs
-		va_start(arguments, format);
-
-		// our own buffer is not big enough to fit the text, we are going to use
-		// a dynamically allocated buffer using vasprintf(), init varargs first
-		va_start(arguments, format);
-
-		// use dynamically allocated vasprintf() call
-		size = vasprintf(&tmp, format, arguments);
+	return buffer_append_slow(buffer, data, size);
+}
 
-		// clean up varargs
-		va_end(arguments);
+/**
+ *  Internal method to append data that stays valid until the dump is
+ *  done. In iovec mode, long fragments are referenced instead of copied.
+ *  @param  buffer
+ *  @param  data
+ *  @param  size
+ *  @return size_t
+ */
+static size_t buffer_append_ref(struct buffer *buffer, const char *data, size_t size)
+{
+	// return value
+	size_t result = 0;
 
-		// was this a success?
-		if (size > 0) result += buffer_append(buffer, tmp, size);
+	// copying is cheaper than an extra iov entry for short fragments
+	if (buffer->writev == NULL || size < IOV_MIN_REF) return buffer_append(buffer, data, size);
 
-		// deallocate the memory
-		if (size >= 0) free(tmp);
-	}
+	// we need room for the pending segment, the reference, and the
+	// segment that iov_flush() may need to close later on
+	if (buffer->iovcnt > DUMP_IOV_MAX - 3) result += iov_flush(buffer);
+	iov_close_segment(buffer);
+	buffer->iov[buffer->iovcnt].iov_base = (void *) data;
+	buffer->iov[buffer->iovcnt].iov_len = size;
+	++buffer->iovcnt;
 
 	// done
 	return result;
 }
 
-/* Forward declaration of the write function */
-static size_t write(struct fjson_object *jso, int level, int flags, struct buffer *buffer);
-
 /**
  *  helper for accessing the optimized string data component in fjson_object
  *  @param  jso
@@ -263,42 +284,43 @@ static const char *get_string_component(struct fjson_object *jso)
  *  do the lookups).
  *  rgerhards@adiscon.com, 2015-11-18
  *  using now external char_needsEscape array. -- rgerhards, 2016-11-30
+ *  The table lookup is now replaced by _fjson_scan_escape(), which
+ *  checks a full vector of bytes per step (see simd_scan.c).
  */
-extern const char char_needsEscape[256];
 
 /**
  *  Function to escape a string
  *  @param  str     the string to be escaped
+ *  @param  len     length of str
  *  @param  buffer  the internal buffer to write to
  *  @return size_t  number of bytes written
  */
-static size_t escape(const char *str, struct buffer *buffer)
+static size_t escape(const char *str, size_t len, struct buffer *buffer)
 {
 	size_t result = 0;
-	const char *start_offset = str;
-	while(1) { /* broken below on 0-byte */
-		if(char_needsEscape[*((unsigned char*)str)]) {
-			if(*str == '\0') break;
-			if(str != start_offset) result += buffer_append(buffer, start_offset, str - start_offset);
-			switch(*str) {
-			case '\b':  result += buffer_append(buffer, "\\b", 2); break;
-			case '\n':  result += buffer_append(buffer, "\\n", 2); break;
-			case '\r':  result += buffer_append(buffer, "\\r", 2); break;
-			case '\t':  result += buffer_append(buffer, "\\t", 2); break;
-			case '\f':  result += buffer_append(buffer, "\\f", 2); break;
-			case '"':   result += buffer_append(buffer, "\\\"", 2); break;
-			case '\\':  result += buffer_append(buffer, "\\\\", 2); break;
-			case '/':   result += buffer_append(buffer, "\\/", 2); break;
-			default:
-				result += buffer_printf(buffer, "\\u00%c%c",
-					fjson_hex_chars[*str >> 4], fjson_hex_chars[*str & 0xf]);
-				break;
-			}
-			start_offset = ++str;
-		} else
-			++str;
+	const char *const end = str + len;
+	char ctl[6] = { '\\', 'u', '0', '0', 0, 0 };
+	while(1) {
+		const char *const esc = _fjson_scan_escape(str, end);
+		if(esc != str) result += buffer_append_ref(buffer, str, esc - str);
+		if(esc == end || *esc == '\0') break;
+		switch(*esc) {
+		case '\b':  result += buffer_append(buffer, "\\b", 2); break;
+		case '\n':  result += buffer_append(buffer, "\\n", 2); break;
+		case '\r':  result += buffer_append(buffer, "\\r", 2); break;
+		case '\t':  result += buffer_append(buffer, "\\t", 2); break;
+		case '\f':  result += buffer_append(buffer, "\\f", 2); break;
+		case '"':   result += buffer_append(buffer, "\\\"", 2); break;
+		case '\\':  result += buffer_append(buffer, "\\\\", 2); break;
+		case '/':   result += buffer_append(buffer, "\\/", 2); break;
+		default:
+			ctl[4] = fjson_hex_chars[(unsigned char)*esc >> 4];
+			ctl[5] = fjson_hex_chars[*esc & 0xf];
+			result += buffer_append(buffer, ctl, 6);
+			break;
+		}
+		str = esc + 1;
 	}
-	if(str != start_offset) result += buffer_append(buffer, start_offset, str - start_offset);
 	return result;
 }
 
@@ -325,41 +347,41 @@ static size_t indent(int level, int flags, struct buffer *buffer)
 	return result;
 }
 
-/* write a json object */
+/* write the opening bracket of a container */
 
-static size_t write_object(struct fjson_object* jso, int level, int flags, struct buffer *buffer)
+static size_t write_open(char bracket, int flags, struct buffer *buffer)
 {
-	int had_children = 0;
-	size_t result = 0;
-
-	result += buffer_append(buffer, "{" /*}*/, 1);
+	size_t result = buffer_append(buffer, &bracket, 1);
 	if (flags & FJSON_TO_STRING_PRETTY) result += buffer_append(buffer, "\n", 1);
-	struct fjson_object_iterator it = fjson_object_iter_begin(jso);
-	struct fjson_object_iterator itEnd = fjson_object_iter_end(jso);
-	while (!fjson_object_iter_equal(&it, &itEnd)) {
-		if (had_children)
-		{
-			result += buffer_append(buffer, ",", 1);
-			if (flags & FJSON_TO_STRING_PRETTY) result += buffer_append(buffer, "\n", 1);
-		}
-		had_children = 1;
-		if (flags & FJSON_TO_STRING_SPACED) result += buffer_append(buffer, " ", 1);
-		result += indent(level+1, flags, buffer);
-		result += buffer_append(buffer, "\"", 1);
-		result += escape(fjson_object_iter_peek_name(&it), buffer);
-		if (flags & FJSON_TO_STRING_SPACED) result += buffer_append(buffer, "\": ", 3);
-		else result += buffer_append(buffer, "\":", 2);
-		result += write(fjson_object_iter_peek_value(&it), level+1, flags, buffer);
-		fjson_object_iter_next(&it);
-	}
+	return result;
+}
+
+/* write the closing bracket of a container */
+
+static size_t write_close(char bracket, int had_children, int level, int flags, struct buffer *buffer)
+{
+	size_t result = 0;
 	if (flags & FJSON_TO_STRING_PRETTY)
 	{
 		if (had_children) result += buffer_append(buffer, "\n", 1);
 		result += indent(level, flags, buffer);
 	}
-	if (flags & FJSON_TO_STRING_SPACED) result += buffer_append(buffer, /*{*/ " }", 2);
-	else result += buffer_append(buffer, /*{*/ "}", 1);
-	return result;
+	if (flags & FJSON_TO_STRING_SPACED) result += buffer_append(buffer, " ", 1);
+	return result + buffer_append(buffer, &bracket, 1);
+}
+
+/* write the separator and indentation in front of a member or element */
+
+static size_t write_sep(int had_children, int level, int flags, struct buffer *buffer)
+{
+	size_t result = 0;
+	if (had_children)
+	{
+		result += buffer_append(buffer, ",", 1);
+		if (flags & FJSON_TO_STRING_PRETTY) result += buffer_append(buffer, "\n", 1);
+	}
+	if (flags & FJSON_TO_STRING_SPACED) result += buffer_append(buffer, " ", 1);
+	return result + indent(level+1, flags, buffer);
 }
 
 /* write a json boolean */
@@ -374,138 +396,333 @@ static size_t write_boolean(struct fjson_object* jso, struct buffer *buffer)
 
 static size_t write_int(struct fjson_object* jso, struct buffer *buffer)
 {
-	// printf into the buffer
-	return buffer_printf(buffer, "%" PRId64, jso->o.c_int64);
+	char buf[FJSON_NUMCONV_BUFSIZE];
+	return buffer_append(buffer, buf, _fjson_i64toa(jso->o.c_int64, buf));
 }
 
 /* write a json floating point */
 
-static size_t write_double(struct fjson_object* jso, int flags, struct buffer *buffer)
+static size_t write_double(struct fjson_object* jso, int __attribute__((unused)) flags,
+	struct buffer *buffer)
 {
-	// return value for the function
-	size_t result = 0;
-
-	// helper functions to fix the output
-	char *buf, *p, *q;
-
-	// needed for modf()
-	double dummy;
+	char buf[FJSON_NUMCONV_BUFSIZE];
 
 	// if the original value is set, we reuse that
-	if (jso->o.c_double.source) return buffer_append(buffer, jso->o.c_double.source, strlen(jso->o.c_double.source));
+	if (jso->o.c_double.source) return buffer_append_ref(buffer, jso->o.c_double.source, strlen(jso->o.c_double.source));
 
 	/* Although JSON RFC does not support
 	 * NaN or Infinity as numeric values
 	 * ECMA 262 section 9.8.1 defines
 	 * how to handle these cases as strings
+	 * This is done by _fjson_dtoa(), which also writes the shortest
+	 * round-trip representation. As such, there are no trailing zeroes
+	 * to remove for FJSON_TO_STRING_NOZERO.
 	 */
-	if(isnan(jso->o.c_double.value)) return buffer_append(buffer, "NaN", 3);
-	if(isinf(jso->o.c_double.value)) return buffer_printf(buffer, jso->o.c_double.value > 0 ? "Infinity" : "-Infinity");
+	return buffer_append(buffer, buf, _fjson_dtoa(jso->o.c_double.value, buf));
+}
 
-	// store the beginning of the buffer (this is where buffer_printf() will most likely write)
-	buf = buffer->buffer + buffer->filled;
+/* write a json string */
 
-	// write to the buffer
-	result = buffer_printf(buffer, (modf(jso->o.c_double.value, &dummy)==0)?"%.17g.0":"%.17g", jso->o.c_double.value);
+static size_t write_string(struct fjson_object* jso, struct buffer *buffer)
+{
+	// the order of evaluation of the + operands is unspecified, so spell it out
+	size_t result = buffer_append(buffer, "\"", 1);
+	result += escape(get_string_component(jso), jso->o.c_string.len, buffer);
+	return result + buffer_append(buffer, "\"", 1);
+}
 
-	// if the buffer got flushed
-	if (buffer->buffer + buffer->filled < buf) buf = buffer->buffer;
+/* write a value that needs no frame of its own (see below) */
 
-	// if localization stuff caused "," to be generated instead of "."
-	// @todo is there not a nicer way to work around that???
-	p = strchr(buf, ',');
-	if (p) {
-		*p = '.';
-	} else {
-		p = strchr(buf, '.');
-	}
+static size_t write_leaf(struct fjson_object *jso, int flags, struct buffer *buffer)
+{
+	// if object is not set
+	if (!jso) return buffer_append(buffer, "null", 4);
 
-	// remove trailing zero's
-	if (p && (flags & FJSON_TO_STRING_NOZERO)) {
-		/* last useful digit, always keep 1 zero */
-		p++;
-		for (q=p ; *q ; q++) {
-			if (*q!='0') p=q;
-		}
-		/* drop trailing zeroes */
-		buffer->filled = p - buffer->buffer;
+	// reuse output cached by fjson_object_to_json_string_ext(), unless it depends on the level
+	if (jso->_flags.pb_valid && jso->_pb_flags == flags && !(flags & FJSON_TO_STRING_PRETTY))
+		return buffer_append_ref(buffer, jso->_pb->buf, jso->_pb->bpos);
+
+	// check type
+	switch(jso->o_type) {
+	case fjson_type_null:       return buffer_append(buffer, "null", 4);
+	case fjson_type_boolean:    return write_boolean(jso, buffer);
+	case fjson_type_double:     return write_double(jso, flags, buffer);
+	case fjson_type_int:        return write_int(jso, buffer);
+	case fjson_type_string:     return write_string(jso, buffer);
+	case fjson_type_object:
+	case fjson_type_array:
+	default:                    return 0;
 	}
+}
 
-	// done
+static int is_leaf(const struct fjson_object *jso, int flags)
+{
+	return jso == NULL
+		|| (jso->o_type != fjson_type_object && jso->o_type != fjson_type_array)
+		|| (jso->_flags.pb_valid && jso->_pb_flags == flags && !(flags & FJSON_TO_STRING_PRETTY));
+}
+
+/* write the elements [begin, end) of a packed array; they are written
+ * without creating nodes
+ */
+
+static size_t write_packed(struct fjson_object *jso, int begin, int end,
+	int level, int flags, struct buffer *buffer)
+{
+	size_t result = 0;
+	const int64_t *const i64 = fjson_object_array_get_int64_data(jso, NULL);
+	const double *const d = fjson_object_array_get_double_data(jso, NULL);
+	char buf[FJSON_NUMCONV_BUFSIZE];
+	int ii;
+	for (ii = begin; ii < end; ii++)
+	{
+		result += write_sep(ii > 0, level, flags, buffer);
+		if (i64 != NULL) result += buffer_append(buffer, buf, _fjson_i64toa(i64[ii], buf));
+		else result += buffer_append(buffer, buf, _fjson_dtoa(d[ii], buf));
+	}
 	return result;
 }
 
-/* write a json string */
+/* containers
+ *
+ * Objects and arrays are written without recursion: each open container
+ * has a frame on an explicit stack, which lives on the C stack for the
+ * usual nesting depths and moves to the heap for deeper ones. So deep
+ * trees cannot exhaust the C stack, and the nesting can be limited with
+ * fjson_global_set_max_print_depth().
+ *
+ * Siblings are usually spread over the heap, and fetching each of them
+ * only when it is its turn means a cache miss per value. So while one
+ * child is written, the node and key of the next one are prefetched,
+ * and so is the out-of-line data of a string before its key is written.
+ */
 
-static size_t write_string(struct fjson_object* jso, struct buffer *buffer)
+#if defined(__GNUC__)
+#	define PREFETCH(p) __builtin_prefetch(p)
+#else
+#	define PREFETCH(p) ((void) (p))
+#endif
+
+/* 0 means no limit */
+static int max_print_depth = 0;
+
+void fjson_global_set_max_print_depth(int depth)
 {
-	return buffer_append(buffer, "\"", 1) + escape(get_string_component(jso), buffer) + buffer_append(buffer, "\"", 1);
+	max_print_depth = (depth > 0) ? depth : 0;
 }
 
-/* write a json array */
+/* frames that fit on the C stack */
+#define WRITE_STACK_LOCAL 32
+
+struct write_frame {
+	struct fjson_object *jso;
+	struct fjson_object_iterator it;	/* next member, for objects */
+	int idx;				/* next element or number of members written */
+	int end;				/* where to stop */
+	int had_children;
+	char close;				/* bracket to write when done, 0 for none */
+};
+
+struct write_stack {
+	struct write_frame *frames;
+	int depth;
+	int size;
+	struct write_frame local[WRITE_STACK_LOCAL];
+};
 
-static size_t write_array(struct fjson_object* jso, int level, int flags, struct buffer *buffer)
+static void write_stack_init(struct write_stack *st)
 {
-	int had_children = 0;
-	int ii;
-	size_t result = 0;
-	result += buffer_append(buffer, "[", 1);
-	if (flags & FJSON_TO_STRING_PRETTY) result += buffer_append(buffer, "\n", 1);
-	for(ii=0; ii < fjson_object_array_length(jso); ii++)
+	st->frames = st->local;
+	st->depth = 0;
+	st->size = WRITE_STACK_LOCAL;
+}
+
+static void write_stack_free(struct write_stack *st)
+{
+	if (st->frames != st->local) _fjson_free(st->frames);
+}
+
+/* push a frame for the children [begin, end) of jso; for objects, it
+ * points to member begin (NULL if that is the first one). Sets the error
+ * of the buffer and returns NULL if this is not possible.
+ */
+
+static struct write_frame *push_frame(struct write_stack *st, struct fjson_object *jso,
+	const struct fjson_object_iterator *it, int begin, int end, struct buffer *buffer)
+{
+	struct write_frame *f;
+
+	if (max_print_depth > 0 && st->depth >= max_print_depth)
+	{
+		buffer->error = ELOOP;
+		return NULL;
+	}
+	if (st->depth == st->size)
 	{
-		if (had_children)
+		const size_t bytes = 2 * st->size * sizeof(struct write_frame);
+		if (st->frames == st->local)
 		{
-			result += buffer_append(buffer, ",", 1);
-			if (flags & FJSON_TO_STRING_PRETTY) result += buffer_append(buffer, "\n", 1);
+			if ((f = _fjson_malloc(bytes)) != NULL) memcpy(f, st->local, sizeof(st->local));
 		}
-		had_children = 1;
-		if (flags & FJSON_TO_STRING_SPACED) result += buffer_append(buffer, " ", 1);
-		result += indent(level + 1, flags, buffer);
-		result += write(fjson_object_array_get_idx(jso, ii), level+1, flags, buffer);
+		else
+		{
+			f = _fjson_realloc(st->frames, bytes);
+		}
+		if (f == NULL)
+		{
+			buffer->error = ENOMEM;
+			return NULL;
+		}
+		st->frames = f;
+		st->size *= 2;
 	}
-	if (flags & FJSON_TO_STRING_PRETTY)
+	f = &st->frames[st->depth++];
+	f->jso = jso;
+	f->idx = begin;
+	f->end = end;
+	f->had_children = begin > 0;
+	f->close = 0;
+	if (jso->o_type == fjson_type_object)
 	{
-		if (had_children) result += buffer_append(buffer, "\n", 1);
-		result += indent(level, flags, buffer);
+		// objects count the members written instead
+		f->it = (it != NULL) ? *it : fjson_object_iter_begin(jso);
+		f->idx = 0;
+		f->end = end - begin;
 	}
+	return f;
+}
 
-	if (flags & FJSON_TO_STRING_SPACED) result += buffer_append(buffer, " ]", 2);
-	else result += buffer_append(buffer, "]", 1);
+/* open a container at the given level. Packed arrays have no child
+ * nodes, so they are written right away; otherwise a frame is pushed.
+ * Returns -1 on error.
+ */
+
+static int open_container(struct write_stack *st, struct fjson_object *jso,
+	int level, int flags, struct buffer *buffer, size_t *result)
+{
+	const int is_object = jso->o_type == fjson_type_object;
+	const int n = is_object ? fjson_object_object_length(jso) : fjson_object_array_length(jso);
+	struct write_frame *f;
+
+	if (!is_object && jso->_flags.packed)
+	{
+		*result += write_open('[', flags, buffer);
+		*result += write_packed(jso, 0, n, level, flags, buffer);
+		*result += write_close(']', n > 0, level, flags, buffer);
+		return 0;
+	}
+	if ((f = push_frame(st, jso, NULL, 0, n, buffer)) == NULL) return -1;
+	f->close = is_object ? '}' : ']';
+	*result += write_open(is_object ? '{' : '[', flags, buffer);
+	return 0;
+}
+
+/* write the children of all frames, until the stack is empty. The
+ * bottom frame is at the given level.
+ */
+
+static size_t write_frames(struct write_stack *st, int level, int flags, struct buffer *buffer)
+{
+	size_t result = 0;
+
+	while (st->depth > 0)
+	{
+		struct write_frame *const f = &st->frames[st->depth - 1];
+		const int flevel = level + st->depth - 1;
+		struct fjson_object *val;
+
+		// container done?
+		if (f->idx == f->end)
+		{
+			if (f->close) result += write_close(f->close, f->had_children, flevel, flags, buffer);
+			--st->depth;
+			continue;
+		}
+
+		if (f->jso->o_type == fjson_type_object)
+		{
+			const struct _fjson_child *const chld = _fjson_object_iter_peek_child(&f->it);
+			val = chld->v;
+			if (val != NULL && val->o_type == fjson_type_string
+			    && val->o.c_string.len >= LEN_DIRECT_STRING_DATA)
+				PREFETCH(val->o.c_string.str.ptr);
+			result += write_sep(f->had_children, flevel, flags, buffer);
+			result += buffer_append(buffer, "\"", 1);
+			if (chld->k_no_escape) result += buffer_append(buffer, chld->k, chld->klen);
+			else result += escape(chld->k, chld->klen, buffer);
+			if (flags & FJSON_TO_STRING_SPACED) result += buffer_append(buffer, "\": ", 3);
+			else result += buffer_append(buffer, "\":", 2);
+			if (++f->idx < f->end)
+			{
+				fjson_object_iter_next(&f->it);
+				const struct _fjson_child *const next = _fjson_object_iter_peek_child(&f->it);
+				PREFETCH(next->v);
+				PREFETCH(next->k);
+			}
+		}
+		else
+		{
+			val = fjson_object_array_get_idx(f->jso, f->idx);
+			if (++f->idx < f->end) PREFETCH(fjson_object_array_get_idx(f->jso, f->idx));
+			result += write_sep(f->had_children, flevel, flags, buffer);
+		}
+		f->had_children = 1;
+
+		if (is_leaf(val, flags)) result += write_leaf(val, flags, buffer);
+		else if (open_container(st, val, flevel + 1, flags, buffer, &result) != 0) break;
+	}
 	return result;
 }
 
 /* write a json value */
 
-static size_t write(struct fjson_object *jso, int level, int flags, struct buffer *buffer)
+static size_t write(struct fjson_object *jso, int flags, struct buffer *buffer)
 {
-	// if object is not set
-	if (!jso) return buffer_append(buffer, "null", 4);
+	struct write_stack st;
+	size_t result = 0;
 
-	// check type
-	switch(jso->o_type) {
-	case fjson_type_null:       return buffer_append(buffer, "null", 4);
-	case fjson_type_boolean:    return write_boolean(jso, buffer);
-	case fjson_type_double:     return write_double(jso, flags, buffer);
-	case fjson_type_int:        return write_int(jso, buffer);
-	case fjson_type_object:     return write_object(jso, level, flags, buffer);
-	case fjson_type_array:      return write_array(jso, level, flags, buffer);
-	case fjson_type_string:     return write_string(jso, buffer);
-	default:                    return 0;
-	}
+	if (is_leaf(jso, flags)) return write_leaf(jso, flags, buffer);
+	write_stack_init(&st);
+	if (open_container(&st, jso, 0, flags, buffer, &result) == 0)
+		result += write_frames(&st, 0, flags, buffer);
+	write_stack_free(&st);
+	return result;
 }
 
-/* wrapper around fwrite() that has the same signature as fjson_write_fn */
+/* write the children [begin, end) of a container at level 0, without
+ * its brackets; see push_frame() for it
+ */
 
-static size_t fwrite_wrapper(void *ptr, const char *buffer, size_t size)
+static size_t write_children(struct fjson_object *jso, const struct fjson_object_iterator *it,
+	int begin, int end, int flags, struct buffer *buffer)
 {
-	return fwrite(buffer, 1, size, ptr);
+	struct write_stack st;
+	size_t result = 0;
+
+	if (jso->_flags.packed) return write_packed(jso, begin, end, 0, flags, buffer);
+	write_stack_init(&st);
+	if (push_frame(&st, jso, it, begin, end, buffer) != NULL)
+		result = write_frames(&st, 0, flags, buffer);
+	write_stack_free(&st);
+	return result;
+}
+
+/* serialize into a printbuf, for fjson_object_to_json_string_ext() */
+
+int _fjson_object_write_printbuf(struct fjson_object *jso, int flags, struct printbuf *pb)
+{
+	struct buffer object = { NULL, 0, 0, NULL, NULL, NULL, NULL, 0, 0, pb, 0 };
+	write(jso, flags, &object);
+	if (object.error == 0) return 0;
+	errno = object.error;
+	return -1;
 }
 
-/* dummy output function that does not output, but is used to calculate the size */
+/* wrapper around fwrite() that has the same signature as fjson_write_fn */
 
-static size_t calculate(void __attribute__((unused)) *ptr, const char __attribute__((unused)) *buffer, size_t size)
+static size_t fwrite_wrapper(void *ptr, const char *buffer, size_t size)
 {
-	return size;
+	return fwrite(buffer, 1, size, ptr);
 }
 
 /* extended dump to which the helper buffer can be passed */
@@ -522,9 +739,13 @@ size_t size, fjson_write_fn *func, void *ptr)
 	object.filled = 0;
 	object.overflow = func;
 	object.ptr = ptr;
+	object.writev = NULL;
+	object.pb = NULL;
+	object.error = 0;
 
 	// write the value
-	size_t result = write(jso, 0, flags, &object);
+	size_t result = write(jso, flags, &object);
+	if (object.error) errno = object.error;
 
 	// ready if buffer is now empty
 	if (object.size == 0) return result;
@@ -556,18 +777,160 @@ size_t fjson_object_dump(struct fjson_object *jso, fjson_write_fn *func, void *p
 
 size_t fjson_object_size_ext(struct fjson_object *jso, int flags)
 {
-	// write the value with a dummy function (this is a simple implementation that
-	// can later be optimized in a pure size-calculating function)
-	return fjson_object_dump_ext(jso, flags, &calculate, NULL);
+	// a fixed-size target without room only counts, nothing is copied
+	struct buffer object = { NULL, 0, 0, NULL, NULL, NULL, NULL, 0, 0, NULL, 0 };
+	size_t result = write(jso, flags, &object);
+	if (object.error) errno = object.error;
+	return result;
+}
+
+/* dump to a callback that receives iov arrays */
+
+size_t fjson_object_dump_iov_buffered(struct fjson_object *jso, int flags, char *temp,
+size_t size, fjson_writev_fn *func, void *ptr)
+{
+	struct iovec iov[DUMP_IOV_MAX];
+	struct buffer object = { temp, size, 0, NULL, ptr, func, iov, 0, 0, NULL, 0 };
+
+	// write the value and hand over what is left
+	size_t result = write(jso, flags, &object);
+	if (object.error) errno = object.error;
+	return result + iov_flush(&object);
+}
+
+size_t fjson_object_dump_iov(struct fjson_object *jso, int flags, fjson_writev_fn *func, void *ptr)
+{
+	// create a local 1k buffer on the stack
+	char buffer[1024];
+
+	// pass on to the other function
+	return fjson_object_dump_iov_buffered(jso, flags, buffer, 1024, func, ptr);
+}
+
+/* parallel dump
+ *
+ * The top-level children are split into ranges, and each task writes
+ * its range into a printbuf of its own. As the separators in front of
+ * each child are part of that child's output, the results only need to
+ * be concatenated, between the container's brackets. The write functions
+ * only read the tree, so running them concurrently is safe as long as
+ * nobody modifies it.
+ */
+
+/* containers with fewer children per part are not worth splitting */
+#define PARALLEL_MIN_CHILDREN 8
+
+struct dump_part {
+	struct fjson_object *jso;
+	struct fjson_object_iterator it;	/* first member, for objects */
+	int begin;				/* first element/member index */
+	int end;
+	int flags;
+	struct printbuf *pb;			/* NULL if the task failed */
+};
+
+static size_t write_part(struct dump_part *part, struct buffer *buffer)
+{
+	return write_children(part->jso, &part->it, part->begin, part->end, part->flags, buffer);
+}
+
+static void dump_part_task(void *arg)
+{
+	struct dump_part *const part = arg;
+	struct buffer object = { NULL, 0, 0, NULL, NULL, NULL, NULL, 0, 0, NULL, 0 };
+
+	if ((object.pb = part->pb = printbuf_new()) == NULL) return;
+	write_part(part, &object);
+	if (object.error)
+	{
+		// leave it to the calling thread, which reports the error
+		printbuf_free(part->pb);
+		part->pb = NULL;
+	}
+}
+
+size_t fjson_object_dump_parallel(struct fjson_object *jso, int flags, int nparts,
+	fjson_executor_fn *exec, void *exec_ctx, fjson_write_fn *func, void *ptr)
+{
+	const int is_object = fjson_object_is_type(jso, fjson_type_object);
+	const int n = is_object ? fjson_object_object_length(jso)
+		: fjson_object_is_type(jso, fjson_type_array) ? fjson_object_array_length(jso) : 0;
+	struct dump_part *parts;
+	void **args;
+	int i;
+
+	if (nparts > n / PARALLEL_MIN_CHILDREN) nparts = n / PARALLEL_MIN_CHILDREN;
+	if (nparts <= 1
+	    || (jso->_flags.pb_valid && jso->_pb_flags == flags && !(flags & FJSON_TO_STRING_PRETTY)))
+		return fjson_object_dump_ext(jso, flags, func, ptr);
+	parts = _fjson_calloc(nparts, sizeof(struct dump_part));
+	args = _fjson_malloc(nparts * sizeof(void *));
+	if (parts == NULL || args == NULL)
+	{
+		_fjson_free(parts);
+		_fjson_free(args);
+		return fjson_object_dump_ext(jso, flags, func, ptr);
+	}
+
+	// split the children into ranges of about the same size
+	struct fjson_object_iterator it = is_object ? fjson_object_iter_begin(jso) : fjson_object_iter_end(NULL);
+	int idx = 0;
+	for (i = 0; i < nparts; i++)
+	{
+		parts[i].jso = jso;
+		parts[i].flags = flags;
+		parts[i].begin = idx;
+		parts[i].end = (i == nparts - 1) ? n : (int) ((int64_t) n * (i + 1) / nparts);
+		parts[i].it = it;
+		if (is_object)
+			for ( ; idx < parts[i].end; idx++) fjson_object_iter_next(&it);
+		idx = parts[i].end;
+		args[i] = &parts[i];
+	}
+
+	if (exec == NULL)
+		for (i = 0; i < nparts; i++) dump_part_task(args[i]);
+	else
+		exec(exec_ctx, dump_part_task, args, nparts);
+
+	// concatenate; parts whose task failed are written here
+	char temp[1024];
+	struct buffer object = { temp, sizeof(temp), 0, func, ptr, NULL, NULL, 0, 0, NULL, 0 };
+	size_t result = write_open(is_object ? '{' : '[', flags, &object);
+	for (i = 0; i < nparts; i++)
+	{
+		if (object.error == 0)
+		{
+			if (parts[i].pb == NULL) result += write_part(&parts[i], &object);
+			else result += buffer_append(&object, parts[i].pb->buf, parts[i].pb->bpos);
+		}
+		printbuf_free(parts[i].pb);
+	}
+	if (object.error) errno = object.error;
+	else result += write_close(is_object ? '}' : ']', 1, 0, flags, &object);
+	result += buffer_flush(&object);
+	_fjson_free(parts);
+	_fjson_free(args);
+	return result;
 }
 
 /* function to calculate the size */
 
 size_t fjson_object_size(struct fjson_object *jso)
 {
-	// write the value with a dummy function (this is a simple implementation that
-	// can later be optimized in a pure size-calculating function)
-	return fjson_object_dump(jso, &calculate, NULL);
+	return fjson_object_size_ext(jso, FJSON_TO_STRING_SPACED);
+}
+
+/* serialize into a caller-provided buffer */
+
+size_t fjson_object_to_json_string_into(struct fjson_object *jso, int flags, char *buf, size_t cap)
+{
+	// leave room for the terminating NUL
+	struct buffer object = { buf, (cap > 0) ? cap - 1 : 0, 0, NULL, NULL, NULL, NULL, 0, 0, NULL, 0 };
+	size_t result = write(jso, flags, &object);
+	if (object.error) errno = object.error;
+	if (cap > 0) buf[(result < cap) ? result : cap - 1] = '\0';
+	return result;
 }
 
 /* write to a file* */
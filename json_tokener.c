@@ -29,16 +29,32 @@
 #include <inttypes.h>
 
 #include "debug.h"
+#include "alloc.h"
 #include "printbuf.h"
 #include "arraylist.h"
+#include "arena.h"
+#include "simd_scan.h"
+#include "numconv.h"
 #include "json_object.h"
 #include "json_object_private.h"
 #include "json_tokener.h"
 #include "json_util.h"
+#include "json_keydict.h"
 
-#ifdef HAVE_LOCALE_H
-#include <locale.h>
-#endif				/* HAVE_LOCALE_H */
+/* apply the tokener's settings to a node it has created: a plain
+ * reference count if FJSON_TOKENER_LOCAL_REFCOUNT is set, and the key
+ * comparison mode of its context. Singletons are left alone.
+ */
+static inline struct fjson_object *
+new_node(const struct fjson_tokener *const tok, struct fjson_object *const jso)
+{
+	if (jso != NULL && !jso->_flags.immortal) {
+		if (tok->flags & FJSON_TOKENER_LOCAL_REFCOUNT)
+			jso->_flags.local_ref = 1;
+		jso->_flags.key_cmp = tok->key_cmp;
+	}
+	return jso;
+}
 
 #define jt_hexdigit(x) (((x) <= '9') ? (x) - '0' : ((x) & 7) + 9)
 
@@ -87,6 +103,11 @@ const char *fjson_tokener_errors[15] = {
 const char *fjson_tokener_error_desc(enum fjson_tokener_error jerr)
 {
 	int jerr_int = (int)jerr;
+	/* not in fjson_tokener_errors, whose size is part of the ABI */
+	if (jerr == fjson_tokener_error_callback)
+		return "aborted by callback";
+	if (jerr == fjson_tokener_error_memory)
+		return "out of memory";
 	if (jerr_int < 0 || jerr_int >= (int)(sizeof(fjson_tokener_errors) / sizeof(fjson_tokener_errors[0])))
 		return "Unknown error, invalid fjson_tokener_error value passed to fjson_tokener_error_desc()";
 	return fjson_tokener_errors[jerr];
@@ -104,19 +125,26 @@ enum fjson_tokener_error fjson_tokener_get_error(fjson_tokener * tok)
 static unsigned char utf8_replacement_char[3] = { 0xEF, 0xBF, 0xBD };
 
 struct fjson_tokener *fjson_tokener_new_ex(int depth)
+{
+	return fjson_tokener_new_ctx(depth, NULL);
+}
+
+struct fjson_tokener *fjson_tokener_new_ctx(int depth, const struct fjson_ctx *ctx)
 {
 	struct fjson_tokener *tok;
 
-	tok = (struct fjson_tokener *)calloc(1, sizeof(struct fjson_tokener));
+	tok = (struct fjson_tokener *)_fjson_calloc(1, sizeof(struct fjson_tokener));
 	if (!tok)
 		return NULL;
-	tok->stack = (struct fjson_tokener_srec *)calloc(depth, sizeof(struct fjson_tokener_srec));
+	tok->stack = (struct fjson_tokener_srec *)_fjson_calloc(depth, sizeof(struct fjson_tokener_srec));
 	if (!tok->stack) {
-		free(tok);
+		_fjson_free(tok);
 		return NULL;
 	}
-	tok->pb = printbuf_new();
+	tok->pb = printbuf_new_size((ctx != NULL) ? ctx->printbuf_initial_size : 0);
 	tok->max_depth = depth;
+	tok->key_cmp = (ctx != NULL) ? ctx->key_cmp : JSO_KEY_CMP_GLOBAL;
+	tok->keys = (ctx != NULL) ? ctx->keys : NULL;
 	fjson_tokener_reset(tok);
 	return tok;
 }
@@ -132,8 +160,8 @@ void fjson_tokener_free(struct fjson_tokener *tok)
 	if (tok->pb)
 		printbuf_free(tok->pb);
 	if (tok->stack)
-		free(tok->stack);
-	free(tok);
+		_fjson_free(tok->stack);
+	_fjson_free(tok);
 }
 
 static void __attribute__((nonnull(1)))
@@ -143,8 +171,25 @@ fjson_tokener_reset_level(struct fjson_tokener *const tok, const int depth)
 	tok->stack[depth].saved_state = fjson_tokener_state_start;
 	fjson_object_put(tok->stack[depth].current);
 	tok->stack[depth].current = NULL;
-	free(tok->stack[depth].obj_field_name);
+	if (tok->arena == NULL && !tok->stack[depth].obj_field_interned)
+		_fjson_free(tok->stack[depth].obj_field_name);
 	tok->stack[depth].obj_field_name = NULL;
+	tok->stack[depth].obj_field_interned = 0;
+}
+
+void fjson_tokener_set_arena(struct fjson_tokener *const tok, struct fjson_arena *const arena)
+{
+	fjson_tokener_reset(tok);
+	tok->arena = arena;
+}
+
+void fjson_tokener_set_callbacks(struct fjson_tokener *const tok,
+	const struct fjson_tokener_callbacks *const cb,
+	void *const ctx)
+{
+	fjson_tokener_reset(tok);
+	tok->cb = cb;
+	tok->cb_ctx = ctx;
 }
 
 void fjson_tokener_reset(struct fjson_tokener *const tok)
@@ -194,6 +239,7 @@ fjson_tokener_parse_verbose(const char *const str,
 #define saved_state  tok->stack[tok->depth].saved_state
 #define current tok->stack[tok->depth].current
 #define obj_field_name tok->stack[tok->depth].obj_field_name
+#define obj_field_interned tok->stack[tok->depth].obj_field_interned
 
 /* Optimization:
  * fjson_tokener_parse_ex() consumed a lot of CPU in its main loop,
@@ -231,35 +277,65 @@ fjson_tokener_parse_verbose(const char *const str,
 #define ADVANCE_CHAR(str, tok) \
 	( ++(str), ((tok)->char_offset)++, c)
 
+/* EMIT(handler, args) macro:
+ *   In callback mode, calls the given event handler (if there is one)
+ *   and aborts parsing if it asks us to.
+ */
+#define EMIT(handler, args) \
+	if (tok->cb->handler != NULL && tok->cb->handler args != 0) { \
+		tok->err = fjson_tokener_error_callback; \
+		goto out; \
+	}
+
+/* APPEND_STR(p, n) macro:
+ *   Appends to the string or key being collected in tok->pb. Nothing
+ *   is collected by fjson_tokener_validate().
+ */
+#define APPEND_STR(p, n) \
+	do { \
+		if (!tok->validate) \
+			printbuf_memappend_fast(tok->pb, (p), (n)); \
+	} while (0)
+
 /* End optimization macro defs */
 
-struct fjson_object *fjson_tokener_parse_ex(struct fjson_tokener *tok, const char *str, int len)
+struct fjson_object *fjson_tokener_parse_inplace(struct fjson_tokener *tok, char *str, int len)
+{
+	struct fjson_object *obj;
+	tok->inplace = 1;
+	obj = fjson_tokener_parse_ex(tok, str, len);
+	tok->inplace = 0;
+	return obj;
+}
+
+static struct fjson_object *
+tokener_parse(struct fjson_tokener *tok, const char *str, int len)
 {
 	struct fjson_object *obj = NULL;
+	const char *end; /* end of input for the bulk scanners */
 	char c = '\1';
-#ifdef HAVE_SETLOCALE
-	char *oldlocale = NULL, *tmplocale;
-
-	tmplocale = setlocale(LC_NUMERIC, NULL);
-	if (tmplocale)
-		oldlocale = strdup(tmplocale);
-	setlocale(LC_NUMERIC, "C");
-#endif
-
 	tok->char_offset = 0;
 	tok->err = fjson_tokener_success;
+	tok->str_start = NULL; /* strings from earlier calls are not in str */
 
 	/* this interface is presently not 64-bit clean due to the int len argument
 	   and the internal printbuf interface that takes 32-bit int len arguments
 	   so the function limits the maximum string size to INT32_MAX (2GB).
 	   If the function is called with len == -1 then strlen is called to check
 	   the string length is less than INT32_MAX (2GB) */
-	if ((len < -1) || (len == -1 && strlen(str) > INT32_MAX)) {
+	if (len == -1) {
+		const size_t slen = strlen(str);
+		if (slen > INT32_MAX) {
+			tok->err = fjson_tokener_error_size;
+			return NULL;
+		}
+		/* the terminating NUL is part of the input in this case */
+		end = str + slen + 1;
+	} else if (len < -1) {
 		tok->err = fjson_tokener_error_size;
-#		ifdef HAVE_SETLOCALE
-		free(oldlocale);
-#		endif
 		return NULL;
+	} else {
+		end = str + len;
 	}
 
 	while (PEEK_CHAR(c, tok)) {
@@ -269,8 +345,11 @@ redo_char:
 
 		case fjson_tokener_state_eatws:
 			/* Advance until we change state */
-			while (isspace((int)c)) {
-				if ((!ADVANCE_CHAR(str, tok)) || (!PEEK_CHAR(c, tok)))
+			if (FJSON_IS_WS(c)) {
+				const char *const next = _fjson_skip_ws(str + 1, end);
+				tok->char_offset += next - str;
+				str = next;
+				if (!PEEK_CHAR(c, tok))
 					goto out;
 			}
 			if (c == '/' && !(tok->flags & FJSON_TOKENER_STRICT)) {
@@ -288,12 +367,20 @@ redo_char:
 			case '{':
 				state = fjson_tokener_state_eatws;
 				saved_state = fjson_tokener_state_object_field_start;
-				current = fjson_object_new_object();
+				if (tok->cb != NULL) {
+					EMIT(start_object, (tok->cb_ctx));
+				} else {
+					current = new_node(tok, _fjson_object_new_object_a(tok->arena));
+				}
 				break;
 			case '[':
 				state = fjson_tokener_state_eatws;
 				saved_state = fjson_tokener_state_array;
-				current = fjson_object_new_array();
+				if (tok->cb != NULL) {
+					EMIT(start_array, (tok->cb_ctx));
+				} else {
+					current = new_node(tok, _fjson_object_new_array_a(tok->arena));
+				}
 				break;
 			case 'I':
 			case 'i':
@@ -319,6 +406,7 @@ redo_char:
 				state = fjson_tokener_state_string;
 				printbuf_reset(tok->pb);
 				tok->quote_char = c;
+				tok->str_start = str + 1;
 				break;
 			case 'T':
 			case 't':
@@ -378,7 +466,12 @@ redo_char:
 				    (strncmp(fjson_inf_str, infbuf, size_inf) == 0)
 				    ) {
 					if (tok->st_pos == fjson_inf_str_len) {
-						current = fjson_object_new_double((double) (is_negative ? -INFINITY : INFINITY));
+						const double d = is_negative ? -INFINITY : INFINITY;
+						if (tok->cb != NULL) {
+							EMIT(dbl, (tok->cb_ctx, d, tok->pb->buf, tok->pb->bpos - 1));
+						} else {
+							current = new_node(tok, _fjson_object_new_double_a(tok->arena, d));
+						}
 						saved_state = fjson_tokener_state_finish;
 						state = fjson_tokener_state_eatws;
 						goto redo_char;
@@ -403,6 +496,8 @@ redo_char:
 				    ) {
 					if (tok->st_pos == fjson_null_str_len) {
 						current = NULL;
+						if (tok->cb != NULL)
+							EMIT(null, (tok->cb_ctx));
 						saved_state = fjson_tokener_state_finish;
 						state = fjson_tokener_state_eatws;
 						goto redo_char;
@@ -412,7 +507,11 @@ redo_char:
 					   (strncmp(fjson_nan_str, tok->pb->buf, size_nan) == 0)
 				    ) {
 					if (tok->st_pos == fjson_nan_str_len) {
-						current = fjson_object_new_double((double)NAN);
+						if (tok->cb != NULL) {
+							EMIT(dbl, (tok->cb_ctx, (double)NAN, tok->pb->buf, tok->pb->bpos - 1));
+						} else {
+							current = new_node(tok, _fjson_object_new_double_a(tok->arena, (double)NAN));
+						}
 						saved_state = fjson_tokener_state_finish;
 						state = fjson_tokener_state_eatws;
 						goto redo_char;
@@ -484,19 +583,60 @@ redo_char:
 				const char *case_start = str;
 				while (1) {
 					if (c == tok->quote_char) {
-						printbuf_memappend_fast(tok->pb, case_start, str - case_start);
-						current = fjson_object_new_string_len(tok->pb->buf, tok->pb->bpos);
+						if (tok->cb != NULL) {
+							/* report straight from the input if it is all there */
+							if (tok->pb->bpos == 0) {
+								EMIT(string, (tok->cb_ctx, case_start, str - case_start));
+							} else {
+								APPEND_STR(case_start, str - case_start);
+								EMIT(string, (tok->cb_ctx, tok->pb->buf, tok->pb->bpos));
+							}
+						} else if (tok->inplace && tok->str_start != NULL) {
+							/* the string fits where it was, as unescaping
+							 * never makes it longer. Our caller allows us
+							 * to write there, so dropping const is fine.
+							 */
+							char *const s = (char *) tok->str_start;
+							int slen = str - case_start;
+							if (tok->pb->bpos > 0) {
+								printbuf_memappend_fast(tok->pb, case_start, slen);
+								slen = tok->pb->bpos;
+								memcpy(s, tok->pb->buf, slen);
+							}
+							s[slen] = '\0';
+							current = new_node(tok, _fjson_object_new_string_inplace_a(tok->arena,
+								s, slen));
+						} else if ((tok->flags & FJSON_TOKENER_ZERO_COPY) && tok->pb->bpos == 0) {
+							/* all of the string is in the caller's buffer */
+							current = new_node(tok, _fjson_object_new_string_ref_a(tok->arena,
+								case_start, str - case_start));
+						} else {
+							printbuf_memappend_fast(tok->pb, case_start, str - case_start);
+							current = new_node(tok, _fjson_object_new_string_len_a(tok->arena,
+								tok->pb->buf, tok->pb->bpos));
+						}
 						saved_state = fjson_tokener_state_finish;
 						state = fjson_tokener_state_eatws;
 						break;
 					} else if (c == '\\') {
-						printbuf_memappend_fast(tok->pb, case_start, str - case_start);
+						APPEND_STR(case_start, str - case_start);
 						saved_state = fjson_tokener_state_string;
 						state = fjson_tokener_state_string_escape;
 						break;
+					} else if (c == '\0') {
+						++str;
+						++tok->char_offset;
+						APPEND_STR(case_start, str - case_start);
+						goto out;
 					}
-					if (!ADVANCE_CHAR(str, tok) || !PEEK_CHAR(c, tok)) {
-						printbuf_memappend_fast(tok->pb, case_start, str - case_start);
+					/* skip the run of regular characters in bulk */
+					{
+						const char *const next = _fjson_scan_str(str + 1, end, tok->quote_char);
+						tok->char_offset += next - str;
+						str = next;
+					}
+					if (!PEEK_CHAR(c, tok)) {
+						APPEND_STR(case_start, str - case_start);
 						goto out;
 					}
 				}
@@ -508,7 +648,7 @@ redo_char:
 			case '"':
 			case '\\':
 			case '/':
-				printbuf_memappend_fast(tok->pb, &c, 1);
+				APPEND_STR(&c, 1);
 				state = saved_state;
 				break;
 			case 'b':
@@ -517,15 +657,15 @@ redo_char:
 			case 't':
 			case 'f':
 				if (c == 'b')
-					printbuf_memappend_fast(tok->pb, "\b", 1);
+					APPEND_STR("\b", 1);
 				else if (c == 'n')
-					printbuf_memappend_fast(tok->pb, "\n", 1);
+					APPEND_STR("\n", 1);
 				else if (c == 'r')
-					printbuf_memappend_fast(tok->pb, "\r", 1);
+					APPEND_STR("\r", 1);
 				else if (c == 't')
-					printbuf_memappend_fast(tok->pb, "\t", 1);
+					APPEND_STR("\t", 1);
 				else if (c == 'f')
-					printbuf_memappend_fast(tok->pb, "\f", 1);
+					APPEND_STR("\f", 1);
 				state = saved_state;
 				break;
 			case 'u':
@@ -562,7 +702,7 @@ redo_char:
 									/* Hi surrogate was not followed by a low
 									 * surrogate */
 									/* Replace the hi and process the rest normally */
-									printbuf_memappend_fast(tok->pb,
+									APPEND_STR(
 												(char *)
 												utf8_replacement_char,
 												3);
@@ -580,12 +720,12 @@ redo_char:
 
 							if (tok->ucs_char < 0x80) {
 								unescaped_utf[0] = tok->ucs_char;
-								printbuf_memappend_fast(tok->pb, (char *)unescaped_utf,
+								APPEND_STR((char *)unescaped_utf,
 											1);
 							} else if (tok->ucs_char < 0x800) {
 								unescaped_utf[0] = 0xc0 | (tok->ucs_char >> 6);
 								unescaped_utf[1] = 0x80 | (tok->ucs_char & 0x3f);
-								printbuf_memappend_fast(tok->pb, (char *)unescaped_utf,
+								APPEND_STR((char *)unescaped_utf,
 											2);
 							} else if (IS_HIGH_SURROGATE(tok->ucs_char)) {
 								/* Got a high surrogate.  Remember it and look for the
@@ -604,7 +744,7 @@ redo_char:
 									 */
 									if (!ADVANCE_CHAR(str, tok)
 									    || !ADVANCE_CHAR(str, tok)) {
-										printbuf_memappend_fast(tok->pb,
+										APPEND_STR(
 													(char *)
 													utf8_replacement_char,
 													3);
@@ -614,7 +754,7 @@ redo_char:
 									 */
 									if (!ADVANCE_CHAR(str, tok)
 									    || !PEEK_CHAR(c, tok)) {
-										printbuf_memappend_fast(tok->pb,
+										APPEND_STR(
 													(char *)
 													utf8_replacement_char,
 													3);
@@ -628,21 +768,21 @@ redo_char:
 									 * following it.  Put a replacement char in for
 									 * the hi surrogate and pretend we finished.
 									 */
-									printbuf_memappend_fast(tok->pb,
+									APPEND_STR(
 												(char *)
 												utf8_replacement_char,
 												3);
 								}
 							} else if (IS_LOW_SURROGATE(tok->ucs_char)) {
 								/* Got a low surrogate not preceded by a high */
-								printbuf_memappend_fast(tok->pb,
+								APPEND_STR(
 											(char *)utf8_replacement_char,
 											3);
 							} else if (tok->ucs_char < 0x10000) {
 								unescaped_utf[0] = 0xe0 | (tok->ucs_char >> 12);
 								unescaped_utf[1] = 0x80 | ((tok->ucs_char >> 6) & 0x3f);
 								unescaped_utf[2] = 0x80 | (tok->ucs_char & 0x3f);
-								printbuf_memappend_fast(tok->pb, (char *)unescaped_utf,
+								APPEND_STR((char *)unescaped_utf,
 											3);
 							} else if (tok->ucs_char < 0x110000) {
 								unescaped_utf[0] =
@@ -651,11 +791,11 @@ redo_char:
 								    0x80 | ((tok->ucs_char >> 12) & 0x3f);
 								unescaped_utf[2] = 0x80 | ((tok->ucs_char >> 6) & 0x3f);
 								unescaped_utf[3] = 0x80 | (tok->ucs_char & 0x3f);
-								printbuf_memappend_fast(tok->pb, (char *)unescaped_utf,
+								APPEND_STR((char *)unescaped_utf,
 											4);
 							} else {
 								/* Don't know what we got--insert the replacement char */
-								printbuf_memappend_fast(tok->pb,
+								APPEND_STR(
 											(char *)utf8_replacement_char,
 											3);
 							}
@@ -668,7 +808,7 @@ redo_char:
 					}
 					if (!ADVANCE_CHAR(str, tok) || !PEEK_CHAR(c, tok)) {
 						if (got_hi_surrogate)	/* Clean up any pending chars */
-							printbuf_memappend_fast(tok->pb, (char *)utf8_replacement_char,
+							APPEND_STR((char *)utf8_replacement_char,
 										3);
 						goto out;
 					}
@@ -687,7 +827,11 @@ redo_char:
 				    || (strncmp(fjson_true_str, tok->pb->buf, size1) == 0)
 				    ) {
 					if (tok->st_pos == fjson_true_str_len) {
-						current = fjson_object_new_boolean(1);
+						if (tok->cb != NULL) {
+							EMIT(boolean, (tok->cb_ctx, 1));
+						} else {
+							current = new_node(tok, _fjson_object_new_boolean_a(tok->arena, 1));
+						}
 						saved_state = fjson_tokener_state_finish;
 						state = fjson_tokener_state_eatws;
 						goto redo_char;
@@ -696,7 +840,11 @@ redo_char:
 					    strncasecmp(fjson_false_str, tok->pb->buf, size2) == 0)
 					   || (strncmp(fjson_false_str, tok->pb->buf, size2) == 0)) {
 					if (tok->st_pos == fjson_false_str_len) {
-						current = fjson_object_new_boolean(0);
+						if (tok->cb != NULL) {
+							EMIT(boolean, (tok->cb_ctx, 0));
+						} else {
+							current = new_node(tok, _fjson_object_new_boolean_a(tok->arena, 0));
+						}
 						saved_state = fjson_tokener_state_finish;
 						state = fjson_tokener_state_eatws;
 						goto redo_char;
@@ -710,6 +858,37 @@ redo_char:
 			break;
 
 		case fjson_tokener_state_number:
+			if (printbuf_length(tok->pb) == 0) {
+				/* fast path for numbers that are complete in this
+				 * chunk: convert them right from the input
+				 */
+				int64_t num64;
+				double numd;
+				int is_double;
+				const int n = _fjson_scan_number(str, end, &num64, &numd, &is_double);
+				if (n > 0) {
+					if (!is_double) {
+						if (tok->cb != NULL) {
+							EMIT(int64, (tok->cb_ctx, num64));
+						} else {
+							current = new_node(tok, _fjson_object_new_int64_a(tok->arena, num64));
+						}
+					} else {
+						if (tok->cb != NULL) {
+							EMIT(dbl, (tok->cb_ctx, numd, str, n));
+						} else {
+							current = new_node(tok, _fjson_object_new_double_s_a(tok->arena,
+								numd, str, n));
+						}
+					}
+					tok->char_offset += n;
+					str += n;
+					c = *str; /* the character that ended the number */
+					saved_state = fjson_tokener_state_finish;
+					state = fjson_tokener_state_eatws;
+					goto redo_char;
+				}
+			}
 			{
 				/* Advance until we change state */
 				const char *case_start = str;
@@ -762,8 +941,9 @@ redo_char:
 					printbuf_memappend_fast(tok->pb, case_start, case_len);
 
 				// Check for -Infinity
-				if (tok->pb->buf[0] == '-' && case_len == 1 && (c == 'i' || c == 'I')) {
+				if (tok->pb->buf[0] == '-' && tok->pb->bpos == 1 && (c == 'i' || c == 'I')) {
 					state = fjson_tokener_state_inf;
+					tok->st_pos = 0;
 					goto redo_char;
 				}
 			}
@@ -776,9 +956,18 @@ redo_char:
 						tok->err = fjson_tokener_error_parse_number;
 						goto out;
 					}
-					current = fjson_object_new_int64(num64);
+					if (tok->cb != NULL) {
+						EMIT(int64, (tok->cb_ctx, num64));
+					} else {
+						current = new_node(tok, _fjson_object_new_int64_a(tok->arena, num64));
+					}
 				} else if (tok->is_double && fjson_parse_double(tok->pb->buf, &numd) == 0) {
-					current = fjson_object_new_double_s(numd, tok->pb->buf);
+					if (tok->cb != NULL) {
+						EMIT(dbl, (tok->cb_ctx, numd, tok->pb->buf, tok->pb->bpos));
+					} else {
+						current = new_node(tok, _fjson_object_new_double_s_a(tok->arena, numd,
+							tok->pb->buf, tok->pb->bpos));
+					}
 				} else {
 					tok->err = fjson_tokener_error_parse_number;
 					goto out;
@@ -796,6 +985,8 @@ redo_char:
 					tok->err = fjson_tokener_error_parse_unexpected;
 					goto out;
 				}
+				if (tok->cb != NULL)
+					EMIT(end_array, (tok->cb_ctx));
 				saved_state = fjson_tokener_state_finish;
 				state = fjson_tokener_state_eatws;
 			} else {
@@ -811,13 +1002,16 @@ redo_char:
 			break;
 
 		case fjson_tokener_state_array_add:
-			fjson_object_array_add(current, obj);
+			if (tok->cb == NULL)
+				fjson_object_array_add(current, obj);
 			saved_state = fjson_tokener_state_array_sep;
 			state = fjson_tokener_state_eatws;
 			goto redo_char;
 
 		case fjson_tokener_state_array_sep:
 			if (c == ']') {
+				if (tok->cb != NULL)
+					EMIT(end_array, (tok->cb_ctx));
 				saved_state = fjson_tokener_state_finish;
 				state = fjson_tokener_state_eatws;
 			} else if (c == ',') {
@@ -837,6 +1031,8 @@ redo_char:
 					tok->err = fjson_tokener_error_parse_unexpected;
 					goto out;
 				}
+				if (tok->cb != NULL)
+					EMIT(end_object, (tok->cb_ctx));
 				saved_state = fjson_tokener_state_finish;
 				state = fjson_tokener_state_eatws;
 			} else if (c == '"' || c == '\'') {
@@ -855,19 +1051,27 @@ redo_char:
 				const char *case_start = str;
 				while (1) {
 					if (c == tok->quote_char) {
-						printbuf_memappend_fast(tok->pb, case_start, str - case_start);
-						obj_field_name = strdup(tok->pb->buf);
+						APPEND_STR(case_start, str - case_start);
+						if (tok->cb != NULL) {
+							EMIT(key, (tok->cb_ctx, tok->pb->buf, tok->pb->bpos));
+						} else if (tok->keys != NULL && (obj_field_name = (char *)
+							   fjson_keydict_intern(tok->keys, tok->pb->buf)) != NULL) {
+							obj_field_interned = 1;
+						} else {
+							obj_field_name = (tok->arena == NULL) ? _fjson_strdup(tok->pb->buf)
+								: _fjson_arena_memdup(tok->arena, tok->pb->buf, tok->pb->bpos);
+						}
 						saved_state = fjson_tokener_state_object_field_end;
 						state = fjson_tokener_state_eatws;
 						break;
 					} else if (c == '\\') {
-						printbuf_memappend_fast(tok->pb, case_start, str - case_start);
+						APPEND_STR(case_start, str - case_start);
 						saved_state = fjson_tokener_state_object_field;
 						state = fjson_tokener_state_string_escape;
 						break;
 					}
 					if (!ADVANCE_CHAR(str, tok) || !PEEK_CHAR(c, tok)) {
-						printbuf_memappend_fast(tok->pb, case_start, str - case_start);
+						APPEND_STR(case_start, str - case_start);
 						goto out;
 					}
 				}
@@ -895,8 +1099,20 @@ redo_char:
 			goto redo_char;
 
 		case fjson_tokener_state_object_value_add:
-			fjson_object_object_add(current, obj_field_name, obj);
-			free(obj_field_name);
+			if (tok->cb != NULL) {
+				/* nothing to add, the value has already been reported */
+			} else if (obj_field_interned) {
+				fjson_object_object_add_ex(current, obj_field_name, obj,
+					FJSON_OBJECT_KEY_IS_INTERNED);
+				obj_field_interned = 0;
+			} else if (tok->arena == NULL) {
+				fjson_object_object_add(current, obj_field_name, obj);
+				_fjson_free(obj_field_name);
+			} else {
+				/* the key already lives in the arena, no need to copy it again */
+				fjson_object_object_add_ex(current, obj_field_name, obj,
+					FJSON_OBJECT_KEY_IS_CONSTANT);
+			}
 			obj_field_name = NULL;
 			saved_state = fjson_tokener_state_object_sep;
 			state = fjson_tokener_state_eatws;
@@ -904,6 +1120,8 @@ redo_char:
 
 		case fjson_tokener_state_object_sep:
 			if (c == '}') {
+				if (tok->cb != NULL)
+					EMIT(end_object, (tok->cb_ctx));
 				saved_state = fjson_tokener_state_finish;
 				state = fjson_tokener_state_eatws;
 			} else if (c == ',') {
@@ -932,12 +1150,6 @@ out:
 		if (state != fjson_tokener_state_finish && saved_state != fjson_tokener_state_finish)
 			tok->err = fjson_tokener_error_parse_eof;
 	}
-#ifdef HAVE_SETLOCALE
-	setlocale(LC_NUMERIC, oldlocale);
-	if (oldlocale)
-		free(oldlocale);
-#endif
-
 	if (tok->err == fjson_tokener_success) {
 		fjson_object *ret = fjson_object_get(current);
 		int ii;
@@ -948,11 +1160,1072 @@ out:
 		return ret;
 	}
 
-	MC_DEBUG("fjson_tokener_parse_ex: error %s at offset %d\n", fjson_tokener_errors[tok->err], tok->char_offset);
+	MC_DEBUG("fjson_tokener_parse_ex: error %s at offset %d\n", fjson_tokener_error_desc(tok->err), tok->char_offset);
 	return NULL;
 }
 
+struct fjson_object *fjson_tokener_parse_ex(struct fjson_tokener *tok, const char *str, int len)
+{
+#ifdef ENABLE_STATS
+	const uint64_t start = _fjson_stats_now();
+	struct fjson_object *const obj = tokener_parse(tok, str, len);
+	FJSON_STAT_ADD(parse_ns, _fjson_stats_now() - start);
+	FJSON_STAT_ADD(bytes_parsed, tok->char_offset);
+	return obj;
+#else
+	return tokener_parse(tok, str, len);
+#endif
+}
+
+/* validating is parsing in callback mode, without handlers */
+static const struct fjson_tokener_callbacks no_callbacks;
+
+enum fjson_tokener_error
+fjson_tokener_validate(struct fjson_tokener *const tok, const char *const str, const int len)
+{
+	const struct fjson_tokener_callbacks *const cb = tok->cb;
+	tok->cb = &no_callbacks;
+	tok->validate = 1;
+	tokener_parse(tok, str, len);
+	tok->validate = 0;
+	tok->cb = cb;
+	return tok->err;
+}
+
 void fjson_tokener_set_flags(struct fjson_tokener *tok, int flags)
 {
 	tok->flags = flags;
 }
+
+
+/* record batches
+ *
+ * The sequential case just runs a tokener over the buffer, one record
+ * after the other. For the parallel case, each task collects the objects
+ * of its chunk in a list, and these lists are handed to the user's
+ * callback in order once all tasks are done. This keeps the callback
+ * single-threaded and the record order intact.
+ */
+
+/* the tokener takes an int length, so huge records are fed in parts */
+#define MAX_FEED (1 << 30)
+
+/* parse the value at *pp, which ends at end at the latest, and advance
+ * *pp behind what the tokener consumed
+ */
+static struct fjson_object *
+parse_value(struct fjson_tokener *const tok, const char **const pp, const char *const end)
+{
+	const char *p = *pp;
+	struct fjson_object *obj;
+
+	fjson_tokener_reset(tok);
+	do {
+		const int n = (end - p > MAX_FEED) ? MAX_FEED : (int) (end - p);
+		if (n == 0) {
+			/* end of buffer: terminate a trailing number */
+			obj = fjson_tokener_parse_ex(tok, "", 1);
+			break;
+		}
+		obj = fjson_tokener_parse_ex(tok, p, n);
+		p += (tok->err == fjson_tokener_continue) ? n : tok->char_offset;
+	} while (tok->err == fjson_tokener_continue);
+	*pp = p;
+	return obj;
+}
+
+/* parse the records in [p, end); base is the offset of p within the
+ * user's buffer. Returns the number of records or -1 on error.
+ */
+static int
+parse_range(struct fjson_tokener *const tok, const char *p, const char *const end,
+	const size_t base, fjson_tokener_record_fn *const cb, void *const ctx)
+{
+	const char *const buf = p;
+	int nrecs = 0;
+
+	while ((p = _fjson_skip_ws(p, end)) != end) {
+		const char *const start = p;
+		struct fjson_object *const obj = parse_value(tok, &p, end);
+		if (tok->err != fjson_tokener_success) {
+			fjson_object_put(obj);
+			return -1;
+		}
+		/* the tokener also consumes whitespace behind the value */
+		const char *rec_end = p;
+		while (rec_end > start && FJSON_IS_WS(rec_end[-1]))
+			--rec_end;
+		if (cb(ctx, obj, base + (start - buf), rec_end - start) != 0)
+			return nrecs + 1;
+		++nrecs;
+	}
+	return nrecs;
+}
+
+int
+fjson_tokener_parse_records(struct fjson_tokener *const tok, const char *const buf,
+	const size_t len, fjson_tokener_record_fn *const cb, void *const ctx)
+{
+	return parse_range(tok, buf, buf + len, 0, cb, ctx);
+}
+
+struct record {
+	struct fjson_object *obj;
+	size_t offset;
+	size_t len;
+};
+
+struct records_chunk {
+	const char *start;
+	const char *end;
+	size_t base;
+	int max_depth;
+	int flags;
+	int key_cmp;
+	struct fjson_keydict *keys;
+	enum fjson_tokener_error err;
+	int nrecs;
+	int size;
+	struct record *recs;
+};
+
+static int
+collect_record(void *const ctx, struct fjson_object *const obj,
+	const size_t offset, const size_t len)
+{
+	struct records_chunk *const chunk = ctx;
+	if (chunk->nrecs == chunk->size) {
+		const int size = (chunk->size == 0) ? 64 : chunk->size * 2;
+		struct record *const recs = _fjson_realloc(chunk->recs, size * sizeof(struct record));
+		if (recs == NULL) {
+			fjson_object_put(obj);
+			chunk->err = fjson_tokener_error_memory;
+			return 1;
+		}
+		chunk->recs = recs;
+		chunk->size = size;
+	}
+	chunk->recs[chunk->nrecs].obj = obj;
+	chunk->recs[chunk->nrecs].offset = offset;
+	chunk->recs[chunk->nrecs].len = len;
+	++chunk->nrecs;
+	return 0;
+}
+
+static void
+parse_chunk(void *const arg)
+{
+	struct records_chunk *const chunk = arg;
+	struct fjson_tokener *const tok = fjson_tokener_new_ex(chunk->max_depth);
+	if (tok == NULL) {
+		chunk->err = fjson_tokener_error_memory;
+		return;
+	}
+	fjson_tokener_set_flags(tok, chunk->flags);
+	tok->key_cmp = chunk->key_cmp;
+	tok->keys = chunk->keys;
+	if (parse_range(tok, chunk->start, chunk->end, chunk->base, collect_record, chunk) == -1)
+		chunk->err = tok->err;
+	fjson_tokener_free(tok);
+}
+
+int
+fjson_tokener_parse_records_parallel(struct fjson_tokener *const tok,
+	const char *const buf, const size_t len, int nchunks,
+	fjson_executor_fn *const exec, void *const exec_ctx,
+	fjson_tokener_record_fn *const cb, void *const ctx)
+{
+	struct records_chunk *chunks;
+	void **args;
+	const char *p = buf;
+	int i, j, nrecs = 0, stop = 0;
+
+	if (nchunks <= 1 || len < (size_t) nchunks)
+		return fjson_tokener_parse_records(tok, buf, len, cb, ctx);
+
+	chunks = _fjson_calloc(nchunks, sizeof(struct records_chunk));
+	args = _fjson_malloc(nchunks * sizeof(void *));
+	if (chunks == NULL || args == NULL) {
+		_fjson_free(chunks);
+		_fjson_free(args);
+		tok->err = fjson_tokener_error_memory;
+		return -1;
+	}
+	/* each chunk ends behind the first newline after its share of buf */
+	for (i = 0 ; i < nchunks ; ++i) {
+		const char *end = buf + len;
+		if (i < nchunks - 1) {
+			const char *const share = buf + len / nchunks * (i + 1);
+			if (share < p) {
+				end = p; /* the previous chunk already covers ours */
+			} else if ((end = memchr(share, '\n', buf + len - share)) == NULL) {
+				end = buf + len;
+			} else {
+				++end;
+			}
+		}
+		chunks[i].start = p;
+		chunks[i].end = end;
+		chunks[i].base = p - buf;
+		chunks[i].max_depth = tok->max_depth;
+		chunks[i].flags = tok->flags;
+		chunks[i].key_cmp = tok->key_cmp;
+		chunks[i].keys = tok->keys;
+		chunks[i].err = fjson_tokener_success;
+		args[i] = &chunks[i];
+		p = end;
+	}
+
+	if (exec == NULL) {
+		for (i = 0 ; i < nchunks ; ++i)
+			parse_chunk(args[i]);
+	} else {
+		exec(exec_ctx, parse_chunk, args, nchunks);
+	}
+
+	tok->err = fjson_tokener_success;
+	for (i = 0 ; i < nchunks ; ++i) {
+		for (j = 0 ; j < chunks[i].nrecs ; ++j) {
+			if (stop) {
+				fjson_object_put(chunks[i].recs[j].obj);
+				continue;
+			}
+			++nrecs;
+			stop = cb(ctx, chunks[i].recs[j].obj, chunks[i].recs[j].offset,
+				chunks[i].recs[j].len) != 0;
+		}
+		if (!stop && chunks[i].err != fjson_tokener_success
+		    && chunks[i].err != fjson_tokener_error_memory && i < nchunks - 1) {
+			/* the broken record may just be cut off by the end of the
+			 * chunk, which then reports a different error than the
+			 * sequential parse. So the rest of buf is parsed in one go
+			 * from that record on, which yields the very same records
+			 * and error as the sequential parse, and replaces the
+			 * remaining chunks.
+			 */
+			struct records_chunk *const rest = &chunks[i + 1];
+			const char *from = chunks[i].start;
+			int k;
+			if (chunks[i].nrecs > 0) {
+				const struct record *const last = &chunks[i].recs[chunks[i].nrecs - 1];
+				from = buf + last->offset + last->len;
+			}
+			for (k = i + 1 ; k < nchunks ; ++k) {
+				for (j = 0 ; j < chunks[k].nrecs ; ++j)
+					fjson_object_put(chunks[k].recs[j].obj);
+				_fjson_free(chunks[k].recs);
+			}
+			rest->start = from;
+			rest->end = buf + len;
+			rest->base = from - buf;
+			rest->err = fjson_tokener_success;
+			rest->nrecs = 0;
+			rest->size = 0;
+			rest->recs = NULL;
+			parse_chunk(rest);
+			nchunks = i + 2;
+			chunks[i].err = fjson_tokener_success;
+		}
+		if (!stop && chunks[i].err != fjson_tokener_success) {
+			tok->err = chunks[i].err;
+			nrecs = -1;
+			stop = 1;
+		}
+		_fjson_free(chunks[i].recs);
+	}
+	_fjson_free(chunks);
+	_fjson_free(args);
+	return nrecs;
+}
+
+
+/* two-stage parsing
+ *
+ * Stage one (_fjson_index_range()) records where the strings and the
+ * structural characters are. Stage two builds the tree by walking that
+ * index: the extent of each string is known up front, and only strings
+ * with escapes and numbers are looked at byte by byte. So that the tree
+ * is the very same the tokener builds, we use the same constructors and
+ * conversions. Only RFC 8259 JSON is handled here; for anything else,
+ * including all errors, we let the tokener decide what the input is.
+ *
+ * Stage one can be run in parts. A part cannot know whether it starts
+ * inside of a string, so a first pass only counts the quotes in each.
+ * In stage two, the elements of a top-level array are independent of
+ * each other, so they can be built in parts, too.
+ */
+
+/* parts of stage one are at least this large */
+#define IX_MIN_PART (64 * 1024)
+
+#define IX_IS_DIGIT(c) ((unsigned)((unsigned char)(c) - '0') <= 9)
+
+enum ix_result {
+	IX_OK,
+	IX_UNHANDLED,	/**< not for us, the tokener has to decide */
+	IX_NOMEM
+};
+
+struct ix_parser {
+	const struct fjson_tokener *tok;
+	const char *buf;
+	const char *end;
+	const uint32_t *pos;	/**< the index, terminated by the length of buf */
+	struct printbuf *pb;	/**< for string values and numbers */
+	struct printbuf *kb;	/**< for keys */
+	struct fjson_object **stack;	/**< the open containers */
+};
+
+static void
+run_tasks(fjson_executor_fn *const exec, void *const exec_ctx, fjson_task_fn *const fn,
+	void *const *const args, const int ntasks)
+{
+	int i;
+	if (exec == NULL) {
+		for (i = 0 ; i < ntasks ; ++i)
+			fn(args[i]);
+	} else {
+		exec(exec_ctx, fn, args, ntasks);
+	}
+}
+
+static int
+ix_init(struct ix_parser *const ix, const struct fjson_tokener *const tok,
+	const char *const buf, const char *const end, const uint32_t *const pos)
+{
+	ix->tok = tok;
+	ix->buf = buf;
+	ix->end = end;
+	ix->pos = pos;
+	ix->pb = printbuf_new();
+	ix->kb = printbuf_new();
+	ix->stack = _fjson_malloc((tok->max_depth + 1) * sizeof(struct fjson_object *));
+	return (ix->pb == NULL || ix->kb == NULL || ix->stack == NULL) ? -1 : 0;
+}
+
+static void
+ix_exit(struct ix_parser *const ix)
+{
+	printbuf_free(ix->pb);
+	printbuf_free(ix->kb);
+	_fjson_free(ix->stack);
+}
+
+/* decode the escape sequence(s) whose hex digits start at p, exactly as
+ * the tokener does it. Returns the position behind them, or NULL if
+ * they are invalid.
+ */
+static const char *
+ix_unicode(struct printbuf *const pb, const char *p, const char *const end)
+{
+	unsigned int hi = 0;
+
+	for (;;) {
+		unsigned char utf[4];
+		unsigned int uc = 0;
+		int i;
+		if (end - p < 4)
+			return NULL;
+		for (i = 0 ; i < 4 ; ++i) {
+			if (p[i] == '\0' || strchr(fjson_hex_chars, p[i]) == NULL)
+				return NULL;
+			uc += (unsigned int) jt_hexdigit(p[i]) << ((3 - i) * 4);
+		}
+		p += 4;
+		if (hi != 0) {
+			if (IS_LOW_SURROGATE(uc))
+				uc = DECODE_SURROGATE_PAIR(hi, uc);
+			else
+				printbuf_memappend_fast(pb, (char *) utf8_replacement_char, 3);
+			hi = 0;
+		}
+		if (uc < 0x80) {
+			utf[0] = uc;
+			printbuf_memappend_fast(pb, (char *) utf, 1);
+		} else if (uc < 0x800) {
+			utf[0] = 0xc0 | (uc >> 6);
+			utf[1] = 0x80 | (uc & 0x3f);
+			printbuf_memappend_fast(pb, (char *) utf, 2);
+		} else if (IS_HIGH_SURROGATE(uc)) {
+			if (end - p >= 2 && p[0] == '\\' && p[1] == 'u') {
+				hi = uc;
+				p += 2;
+				continue;
+			}
+			printbuf_memappend_fast(pb, (char *) utf8_replacement_char, 3);
+		} else if (IS_LOW_SURROGATE(uc)) {
+			printbuf_memappend_fast(pb, (char *) utf8_replacement_char, 3);
+		} else if (uc < 0x10000) {
+			utf[0] = 0xe0 | (uc >> 12);
+			utf[1] = 0x80 | ((uc >> 6) & 0x3f);
+			utf[2] = 0x80 | (uc & 0x3f);
+			printbuf_memappend_fast(pb, (char *) utf, 3);
+		} else if (uc < 0x110000) {
+			utf[0] = 0xf0 | ((uc >> 18) & 0x07);
+			utf[1] = 0x80 | ((uc >> 12) & 0x3f);
+			utf[2] = 0x80 | ((uc >> 6) & 0x3f);
+			utf[3] = 0x80 | (uc & 0x3f);
+			printbuf_memappend_fast(pb, (char *) utf, 4);
+		} else {
+			printbuf_memappend_fast(pb, (char *) utf8_replacement_char, 3);
+		}
+		return p;
+	}
+}
+
+/* append the unescaped string content [s, e) to pb */
+static enum ix_result
+ix_unescape(struct printbuf *const pb, const char *s, const char *const e)
+{
+	while (s != e) {
+		const char *q = _fjson_scan_str(s, e, '"');
+		printbuf_memappend_fast(pb, s, (int) (q - s));
+		if (q == e)
+			break;
+		if (*q != '\\') {
+			/* control characters are kept, as by the tokener */
+			if (*q == '\0' || *q == '"')
+				return IX_UNHANDLED;
+			printbuf_memappend_fast(pb, q, 1);
+			s = q + 1;
+			continue;
+		}
+		if (++q == e)
+			return IX_UNHANDLED;
+		s = q + 1;
+		switch (*q) {
+		case '"':
+		case '\\':
+		case '/':
+			printbuf_memappend_fast(pb, q, 1);
+			break;
+		case 'b':
+			printbuf_memappend_fast(pb, "\b", 1);
+			break;
+		case 'n':
+			printbuf_memappend_fast(pb, "\n", 1);
+			break;
+		case 'r':
+			printbuf_memappend_fast(pb, "\r", 1);
+			break;
+		case 't':
+			printbuf_memappend_fast(pb, "\t", 1);
+			break;
+		case 'f':
+			printbuf_memappend_fast(pb, "\f", 1);
+			break;
+		case 'u':
+			if ((s = ix_unicode(pb, q + 1, e)) == NULL)
+				return IX_UNHANDLED;
+			break;
+		default:
+			return IX_UNHANDLED;
+		}
+	}
+	return IX_OK;
+}
+
+/* the string value with content [s, e) */
+static enum ix_result
+ix_string(struct ix_parser *const ix, const char *const s, const char *const e,
+	struct fjson_object **const out)
+{
+	const struct fjson_tokener *const tok = ix->tok;
+	const char *q = _fjson_scan_str(s, e, '"');
+
+	if (e - s > INT32_MAX)
+		return IX_UNHANDLED;
+	while (q != e && *q != '\\') {
+		if (*q == '\0' || *q == '"')
+			return IX_UNHANDLED;
+		q = _fjson_scan_str(q + 1, e, '"');
+	}
+	if (q == e) {
+		*out = new_node(tok, (tok->flags & FJSON_TOKENER_ZERO_COPY)
+			? _fjson_object_new_string_ref_a(tok->arena, s, (int) (e - s))
+			: _fjson_object_new_string_len_a(tok->arena, s, (int) (e - s)));
+	} else {
+		enum ix_result r;
+		printbuf_reset(ix->pb);
+		printbuf_memappend_fast(ix->pb, s, (int) (q - s));
+		if ((r = ix_unescape(ix->pb, q, e)) != IX_OK)
+			return r;
+		*out = new_node(tok, _fjson_object_new_string_len_a(tok->arena,
+			ix->pb->buf, ix->pb->bpos));
+	}
+	return (*out == NULL) ? IX_NOMEM : IX_OK;
+}
+
+/* the number at *pp, which is advanced behind it */
+static enum ix_result
+ix_number(struct ix_parser *const ix, const char **const pp, struct fjson_object **const out)
+{
+	const struct fjson_tokener *const tok = ix->tok;
+	const char *const s = *pp;
+	const char *text = s;
+	int64_t num64;
+	double numd;
+	int is_double;
+	int n = _fjson_scan_number(s, ix->end, &num64, &numd, &is_double);
+
+	if (n == 0) {
+		/* the general path: check the syntax, then convert the
+		 * number as the tokener does
+		 */
+		const char *const end = ix->end;
+		const char *p = s;
+		if (p != end && *p == '-')
+			++p;
+		if (p == end || !IX_IS_DIGIT(*p))
+			return IX_UNHANDLED;
+		if (*p++ != '0') {
+			while (p != end && IX_IS_DIGIT(*p))
+				++p;
+		}
+		is_double = 0;
+		if (p != end && *p == '.') {
+			is_double = 1;
+			if (++p == end || !IX_IS_DIGIT(*p))
+				return IX_UNHANDLED;
+			while (p != end && IX_IS_DIGIT(*p))
+				++p;
+		}
+		if (p != end && (*p == 'e' || *p == 'E')) {
+			is_double = 1;
+			if (++p != end && (*p == '+' || *p == '-'))
+				++p;
+			if (p == end || !IX_IS_DIGIT(*p))
+				return IX_UNHANDLED;
+			while (p != end && IX_IS_DIGIT(*p))
+				++p;
+		}
+		if (p - s > INT32_MAX)
+			return IX_UNHANDLED;
+		n = (int) (p - s);
+		printbuf_reset(ix->pb);
+		printbuf_memappend_fast(ix->pb, s, n);
+		text = ix->pb->buf;
+		if (is_double ? fjson_parse_double(text, &numd) != 0
+			      : fjson_parse_int64(text, &num64) != 0)
+			return IX_UNHANDLED;
+	}
+	*out = new_node(tok, is_double ? _fjson_object_new_double_s_a(tok->arena, numd, text, n)
+		: _fjson_object_new_int64_a(tok->arena, num64));
+	if (*out == NULL)
+		return IX_NOMEM;
+	*pp = s + n;
+	return IX_OK;
+}
+
+/* add jso to the innermost open container, whose key (if it is an
+ * object) is in ix->kb, or make it the root. Takes ownership of jso,
+ * also on failure.
+ */
+static enum ix_result
+ix_attach(struct ix_parser *const ix, const int sp, struct fjson_object **const root,
+	struct fjson_object *const jso)
+{
+	const struct fjson_tokener *const tok = ix->tok;
+	struct fjson_object *parent;
+	const char *key;
+
+	if (sp == 0) {
+		*root = jso;
+		return IX_OK;
+	}
+	parent = ix->stack[sp - 1];
+	if (parent->o_type == fjson_type_array) {
+		if (fjson_object_array_add(parent, jso) == 0)
+			return IX_OK;
+	} else if (tok->keys != NULL && (key = fjson_keydict_intern(tok->keys, ix->kb->buf)) != NULL) {
+		fjson_object_object_add_ex(parent, key, jso, FJSON_OBJECT_KEY_IS_INTERNED);
+		return IX_OK;
+	} else if (tok->arena == NULL) {
+		unsigned klen;
+		const uint32_t hash = _fjson_key_hash(ix->kb->buf, &klen);
+		if (_fjson_object_object_add_hashed(parent, ix->kb->buf, klen, hash, jso) == 0)
+			return IX_OK;
+	} else if ((key = _fjson_arena_memdup(tok->arena, ix->kb->buf, ix->kb->bpos)) != NULL) {
+		fjson_object_object_add_ex(parent, key, jso, FJSON_OBJECT_KEY_IS_CONSTANT);
+		return IX_OK;
+	}
+	fjson_object_put(jso);
+	return IX_NOMEM;
+}
+
+/* build the value that starts at *pp, at nesting level depth, and
+ * whose index entries start at pos[*pi]. On success, *pp and *pi are
+ * advanced behind it. Containers are added to their parent before they
+ * are filled, so only the root needs to be freed on failure.
+ */
+static enum ix_result
+ix_value(struct ix_parser *const ix, const char **const pp, size_t *const pi,
+	const int depth, struct fjson_object **const out)
+{
+	const struct fjson_tokener *const tok = ix->tok;
+	const char *const buf = ix->buf;
+	const char *const end = ix->end;
+	const uint32_t *const pos = ix->pos;
+	const char *p = *pp;
+	size_t i = *pi;
+	struct fjson_object *root = NULL;
+	struct fjson_object *jso;
+	enum ix_result r;
+	int sp = 0;		/* number of open containers */
+	int first = 0;		/* the innermost one has just been opened */
+
+	for (;;) {
+		/* a value starts at p; the tokener limits the depth of all */
+		if (depth + sp > 0 && depth + sp >= tok->max_depth)
+			goto unhandled;
+		if (p == end)
+			goto unhandled;
+		switch (*p) {
+		case '{':
+		case '[':
+			if (p != buf + pos[i])
+				goto unhandled;
+			jso = new_node(tok, (*p == '{') ? _fjson_object_new_object_a(tok->arena)
+				: _fjson_object_new_array_a(tok->arena));
+			if (jso == NULL) {
+				r = IX_NOMEM;
+				goto fail;
+			}
+			if ((r = ix_attach(ix, sp, &root, jso)) != IX_OK)
+				goto fail;
+			ix->stack[sp++] = jso;
+			++i;
+			++p;
+			first = 1;
+			goto next;
+		case '"':
+			{
+				const char *close;
+				if (p != buf + pos[i])
+					goto unhandled;
+				close = buf + pos[i + 1];
+				if (close == end || *close != '"')
+					goto unhandled;
+				if ((r = ix_string(ix, p + 1, close, &jso)) != IX_OK)
+					goto fail;
+				i += 2;
+				p = close + 1;
+			}
+			break;
+		case 't':
+		case 'f':
+			{
+				const int b = (*p == 't');
+				const int len = b ? fjson_true_str_len : fjson_false_str_len;
+				if (end - p < len || memcmp(p, b ? fjson_true_str : fjson_false_str, len) != 0)
+					goto unhandled;
+				if ((jso = new_node(tok, _fjson_object_new_boolean_a(tok->arena, b))) == NULL) {
+					r = IX_NOMEM;
+					goto fail;
+				}
+				p += len;
+			}
+			break;
+		case 'n':
+			if (end - p < fjson_null_str_len || memcmp(p, fjson_null_str, fjson_null_str_len) != 0)
+				goto unhandled;
+			jso = NULL;
+			p += fjson_null_str_len;
+			break;
+		default:
+			if (*p != '-' && !IX_IS_DIGIT(*p))
+				goto unhandled;
+			if ((r = ix_number(ix, &p, &jso)) != IX_OK)
+				goto fail;
+			break;
+		}
+		if ((r = ix_attach(ix, sp, &root, jso)) != IX_OK)
+			goto fail;
+		first = 0;
+
+next:
+		/* behind a value or an opening bracket */
+		for (;;) {
+			struct fjson_object *cur;
+			char close;
+			if (sp == 0)
+				goto done;
+			cur = ix->stack[sp - 1];
+			close = (cur->o_type == fjson_type_object) ? '}' : ']';
+			p = _fjson_skip_ws(p, end);
+			if (p == end)
+				goto unhandled;
+			if (*p == close) {
+				if (p != buf + pos[i])
+					goto unhandled;
+				++i;
+				++p;
+				--sp;
+				first = 0;
+				continue;
+			}
+			if (!first) {
+				if (*p != ',' || p != buf + pos[i])
+					goto unhandled;
+				++i;
+				p = _fjson_skip_ws(p + 1, end);
+			}
+			first = 0;
+			if (close == '}') {
+				const char *kclose;
+				if (p == end || *p != '"' || p != buf + pos[i])
+					goto unhandled;
+				kclose = buf + pos[i + 1];
+				if (kclose == end || *kclose != '"')
+					goto unhandled;
+				printbuf_reset(ix->kb);
+				if ((r = ix_unescape(ix->kb, p + 1, kclose)) != IX_OK)
+					goto fail;
+				i += 2;
+				p = _fjson_skip_ws(kclose + 1, end);
+				if (p == end || *p != ':' || p != buf + pos[i])
+					goto unhandled;
+				++i;
+				p = _fjson_skip_ws(p + 1, end);
+			}
+			break;
+		}
+	}
+
+done:
+	*pp = p;
+	*pi = i;
+	*out = root;
+	return IX_OK;
+unhandled:
+	r = IX_UNHANDLED;
+fail:
+	fjson_object_put(root);
+	return r;
+}
+
+/* find the elements of the array whose '[' is at pos[i]: *seps receives
+ * the index entries of the ',' behind each element but the last, and of
+ * the closing ']'
+ */
+static enum ix_result
+ix_find_elements(const struct ix_parser *const ix, const size_t i, const size_t n,
+	size_t **const seps, int *const nelem)
+{
+	size_t *s = NULL;
+	int size = 0, k = 0;
+	int level = 0;
+	size_t j;
+
+	for (j = i ; j < n ; ++j) {
+		const char c = ix->buf[ix->pos[j]];
+		if (c == '[' || c == '{') {
+			++level;
+			continue;
+		}
+		if (!((c == ',' && level == 1) || ((c == ']' || c == '}') && --level == 0)))
+			continue;
+		if (level == 0 && c != ']')
+			break;
+		if (k == size) {
+			size_t *ns;
+			if (size > INT_MAX / 2
+			    || (ns = _fjson_realloc(s, (size = (size == 0) ? 1024 : size * 2)
+				* sizeof(size_t))) == NULL) {
+				_fjson_free(s);
+				return IX_NOMEM;
+			}
+			s = ns;
+		}
+		s[k++] = j;
+		if (level == 0) {
+			*seps = s;
+			*nelem = k;
+			return IX_OK;
+		}
+	}
+	_fjson_free(s);
+	return IX_UNHANDLED;
+}
+
+struct ix_part {
+	struct ix_parser ix;
+	const char *p;		/**< where the first element starts */
+	size_t i;		/**< its first index entry */
+	const size_t *seps;	/**< the separators behind the elements */
+	struct fjson_object **objs;
+	int nelem;
+	enum ix_result r;
+};
+
+#define IX_ELEM_START(e) (((e) == 0) ? start : ix->pos[seps[(e) - 1]] + (size_t) 1)
+
+static void
+ix_build_part(void *const arg)
+{
+	struct ix_part *const part = arg;
+	struct ix_parser *const ix = &part->ix;
+	const char *p = part->p;
+	size_t i = part->i;
+	int e;
+
+	part->r = IX_OK;
+	for (e = 0 ; e < part->nelem ; ++e) {
+		p = _fjson_skip_ws(p, ix->end);
+		if ((part->r = ix_value(ix, &p, &i, 1, &part->objs[e])) != IX_OK)
+			return;
+		p = _fjson_skip_ws(p, ix->end);
+		if (i != part->seps[e] || p != ix->buf + ix->pos[i]) {
+			part->r = IX_UNHANDLED;
+			return;
+		}
+		++p;
+		++i;
+	}
+}
+
+/* build the top-level array whose '[' is at pos[*pi] and whose nelem
+ * elements are delimited by seps, in nparts parts of about the same size
+ */
+static enum ix_result
+ix_array_parts(const struct ix_parser *const ix, const char **const pp, size_t *const pi,
+	const size_t *const seps, const int nelem, const int nparts,
+	fjson_executor_fn *const exec, void *const exec_ctx, struct fjson_object **const out)
+{
+	const size_t start = ix->pos[*pi] + (size_t) 1;
+	const size_t span = ix->pos[seps[nelem - 1]] - start;
+	struct ix_part *const parts = _fjson_calloc(nparts, sizeof(struct ix_part));
+	void **const args = _fjson_malloc(nparts * sizeof(void *));
+	struct fjson_object **const objs = _fjson_calloc(nelem, sizeof(struct fjson_object *));
+	struct fjson_object *root = NULL;
+	enum ix_result r = IX_OK;
+	int t, e;
+
+	if (parts == NULL || args == NULL || objs == NULL) {
+		r = IX_NOMEM;
+		goto done;
+	}
+	for (t = 0, e = 0 ; t < nparts ; ++t) {
+		const size_t target = start + span / nparts * t;
+		while (e < nelem && IX_ELEM_START(e) < target)
+			++e;
+		parts[t].p = ix->buf + IX_ELEM_START(e);
+		parts[t].i = (e == 0) ? *pi + 1 : seps[e - 1] + 1;
+		parts[t].seps = seps + e;
+		parts[t].objs = objs + e;
+		parts[t].nelem = e;	/* the first element, for now */
+		args[t] = &parts[t];
+		if (ix_init(&parts[t].ix, ix->tok, ix->buf, ix->end, ix->pos) != 0)
+			r = IX_NOMEM;
+	}
+	for (t = 0 ; t < nparts ; ++t)
+		parts[t].nelem = ((t < nparts - 1) ? parts[t + 1].nelem : nelem) - parts[t].nelem;
+	if (r != IX_OK)
+		goto done;
+
+	run_tasks(exec, exec_ctx, ix_build_part, args, nparts);
+
+	for (t = 0 ; t < nparts && r == IX_OK ; ++t)
+		r = parts[t].r;
+	if (r == IX_OK) {
+		root = new_node(ix->tok, _fjson_object_new_array_a(NULL));
+		if (root == NULL || fjson_object_array_add_many(root, objs, nelem) != 0) {
+			fjson_object_put(root);
+			root = NULL;
+			r = IX_NOMEM;
+		}
+	}
+	if (r == IX_OK) {
+		*pp = ix->buf + ix->pos[seps[nelem - 1]] + 1;
+		*pi = seps[nelem - 1] + 1;
+		*out = root;
+	} else {
+		for (e = 0 ; e < nelem ; ++e)
+			fjson_object_put(objs[e]);
+	}
+
+done:
+	if (parts != NULL) {
+		for (t = 0 ; t < nparts ; ++t)
+			ix_exit(&parts[t].ix);
+	}
+	_fjson_free(parts);
+	_fjson_free(args);
+	_fjson_free(objs);
+	return r;
+}
+
+struct ix_index_part {
+	const char *buf;
+	size_t start;
+	size_t stop;
+	int in_str;
+	int err;
+	struct _fjson_index index;
+};
+
+static void
+ix_parity_part(void *const arg)
+{
+	struct ix_index_part *const part = arg;
+	part->in_str = _fjson_index_quote_parity(part->buf, part->start, part->stop);
+}
+
+static void
+ix_index_part(void *const arg)
+{
+	struct ix_index_part *const part = arg;
+	part->err = _fjson_index_range(part->buf, part->start, part->stop, &part->in_str, &part->index);
+}
+
+/* stage one, in up to nparts parts. The index is terminated by len. */
+static enum ix_result
+ix_index(const char *const buf, const size_t len, int nparts,
+	fjson_executor_fn *const exec, void *const exec_ctx, struct _fjson_index *const index)
+{
+	int in_str = 0;
+
+	if (nparts > (int) (len / IX_MIN_PART))
+		nparts = (int) (len / IX_MIN_PART);
+	if (nparts <= 1) {
+		if (_fjson_index_range(buf, 0, len, &in_str, index) != 0)
+			return IX_NOMEM;
+	} else {
+		/* parts start at multiples of 64, like the blocks do */
+		const size_t share = (len / nparts) & ~(size_t) 63;
+		struct ix_index_part *const parts = _fjson_calloc(nparts, sizeof(struct ix_index_part));
+		void **const args = _fjson_malloc(nparts * sizeof(void *));
+		size_t n = 0;
+		int k, err = 0;
+
+		if (parts == NULL || args == NULL) {
+			_fjson_free(parts);
+			_fjson_free(args);
+			return IX_NOMEM;
+		}
+		for (k = 0 ; k < nparts ; ++k) {
+			parts[k].buf = buf;
+			parts[k].start = share * k;
+			parts[k].stop = (k < nparts - 1) ? share * (k + 1) : len;
+			args[k] = &parts[k];
+		}
+		run_tasks(exec, exec_ctx, ix_parity_part, args, nparts);
+		/* turn the parities into the state at the start of each part */
+		for (k = 0 ; k < nparts ; ++k) {
+			const int parity = parts[k].in_str;
+			parts[k].in_str = in_str;
+			in_str ^= parity;
+		}
+		run_tasks(exec, exec_ctx, ix_index_part, args, nparts);
+		for (k = 0 ; k < nparts ; ++k) {
+			err |= parts[k].err;
+			n += parts[k].index.n;
+		}
+		if (err == 0 && (index->pos = _fjson_malloc((n + 1) * sizeof(uint32_t))) != NULL) {
+			index->size = n + 1;
+			for (k = 0 ; k < nparts ; ++k) {
+				memcpy(index->pos + index->n, parts[k].index.pos,
+					parts[k].index.n * sizeof(uint32_t));
+				index->n += parts[k].index.n;
+			}
+		}
+		in_str = parts[nparts - 1].in_str;
+		for (k = 0 ; k < nparts ; ++k)
+			_fjson_free(parts[k].index.pos);
+		_fjson_free(parts);
+		_fjson_free(args);
+		if (index->pos == NULL)
+			return IX_NOMEM;
+	}
+	if (in_str)
+		return IX_UNHANDLED;
+	if (index->n == index->size) {
+		uint32_t *const pos = _fjson_realloc(index->pos, (index->n + 1) * sizeof(uint32_t));
+		if (pos == NULL)
+			return IX_NOMEM;
+		index->pos = pos;
+		index->size = index->n + 1;
+	}
+	index->pos[index->n] = (uint32_t) len;
+	return IX_OK;
+}
+
+static enum ix_result
+ix_parse(const struct fjson_tokener *const tok, const char *const buf, const size_t len,
+	const int nparts, fjson_executor_fn *const exec, void *const exec_ctx,
+	struct fjson_object **const out)
+{
+	struct _fjson_index index = { NULL, 0, 0 };
+	struct ix_parser ix;
+	const char *const end = buf + len;
+	const char *p;
+	size_t i = 0;
+	enum ix_result r;
+
+	if (tok->cb != NULL || len == 0 || len >= UINT32_MAX)
+		return IX_UNHANDLED;
+	if ((r = ix_index(buf, len, nparts, exec, exec_ctx, &index)) != IX_OK)
+		goto done;
+	if (ix_init(&ix, tok, buf, end, index.pos) != 0) {
+		ix_exit(&ix);
+		r = IX_NOMEM;
+		goto done;
+	}
+
+	p = _fjson_skip_ws(buf, end);
+	if (p != end && *p == '[' && nparts > 1 && tok->arena == NULL) {
+		size_t *seps;
+		int nelem;
+		if ((r = ix_find_elements(&ix, i, index.n, &seps, &nelem)) == IX_OK) {
+			if (nelem >= nparts)
+				r = ix_array_parts(&ix, &p, &i, seps, nelem, nparts, exec, exec_ctx, out);
+			else
+				r = ix_value(&ix, &p, &i, 0, out);
+			_fjson_free(seps);
+		}
+	} else {
+		r = ix_value(&ix, &p, &i, 0, out);
+	}
+	if (r == IX_OK && _fjson_skip_ws(p, end) != end) {
+		fjson_object_put(*out);
+		r = IX_UNHANDLED;
+	}
+	ix_exit(&ix);
+
+done:
+	_fjson_free(index.pos);
+	return r;
+}
+
+struct fjson_object *
+fjson_tokener_parse_indexed(struct fjson_tokener *const tok, const char *const buf,
+	const size_t len, const int nparts, fjson_executor_fn *const exec, void *const exec_ctx)
+{
+	struct fjson_object *obj = NULL;
+	const char *p = buf;
+#ifdef ENABLE_STATS
+	const uint64_t start = _fjson_stats_now();
+#endif
+
+	fjson_tokener_reset(tok);
+	switch (ix_parse(tok, buf, len, nparts, exec, exec_ctx, &obj)) {
+	case IX_OK:
+#ifdef ENABLE_STATS
+		FJSON_STAT_ADD(parse_ns, _fjson_stats_now() - start);
+		FJSON_STAT_ADD(bytes_parsed, len);
+#endif
+		tok->char_offset = (len > INT_MAX) ? INT_MAX : (int) len;
+		return obj;
+	case IX_NOMEM:
+		tok->err = fjson_tokener_error_memory;
+		return NULL;
+	case IX_UNHANDLED:
+	default:
+		obj = parse_value(tok, &p, buf + len);
+		if (tok->err != fjson_tokener_success) {
+			fjson_object_put(obj);
+			obj = NULL;
+		}
+		return obj;
+	}
+}
@@ -32,7 +32,9 @@ enum fjson_tokener_error {
 	fjson_tokener_error_parse_object_value_sep,
 	fjson_tokener_error_parse_string,
 	fjson_tokener_error_parse_comment,
-	fjson_tokener_error_size
+	fjson_tokener_error_size,
+	fjson_tokener_error_callback,
+	fjson_tokener_error_memory
 };
 
 enum fjson_tokener_state {
@@ -69,6 +71,7 @@ struct fjson_tokener_srec
 	struct fjson_object *obj;
 	struct fjson_object *current;
 	char *obj_field_name;
+	int obj_field_interned;	/**< obj_field_name belongs to the key dictionary */
 };
 
 #define FJSON_TOKENER_DEFAULT_DEPTH 32
@@ -83,6 +86,38 @@ struct fjson_tokener
 	char quote_char;
 	struct fjson_tokener_srec *stack;
 	int flags;
+	struct fjson_arena *arena;
+	const struct fjson_tokener_callbacks *cb;
+	void *cb_ctx;
+	int key_cmp;	/**< how objects created compare keys, from the fjson_ctx */
+	struct fjson_keydict *keys; /**< for interning keys, from the fjson_ctx */
+	int inplace;	/**< set while fjson_tokener_parse_inplace() runs */
+	const char *str_start; /**< start of the current string, if in this chunk */
+	int validate;	/**< set while fjson_tokener_validate() runs */
+};
+
+/**
+ * Event handlers for callback-driven parsing, see
+ * fjson_tokener_set_callbacks(). Each one receives the ctx pointer given
+ * there. Handlers may be NULL if the event is not of interest. Returning
+ * non-zero aborts parsing with fjson_tokener_error_callback.
+ *
+ * String data (keys, string values, number text) is NOT NUL-terminated
+ * and only valid during the call.
+ */
+struct fjson_tokener_callbacks
+{
+	int (*start_object)(void *ctx);
+	int (*end_object)(void *ctx);
+	int (*start_array)(void *ctx);
+	int (*end_array)(void *ctx);
+	int (*key)(void *ctx, const char *key, int len);
+	int (*string)(void *ctx, const char *s, int len);
+	int (*int64)(void *ctx, int64_t i);
+	/** s is the number as written in the input (NaN/Infinity included) */
+	int (*dbl)(void *ctx, double d, const char *s, int len);
+	int (*boolean)(void *ctx, fjson_bool b);
+	int (*null)(void *ctx);
 };
 
 /**
@@ -97,6 +132,38 @@ struct fjson_tokener
  */
 #define FJSON_TOKENER_STRICT  0x01
 
+/**
+ * Do not copy string values, but let them reference the input buffer.
+ *
+ * This applies to strings that contain no escape sequences, are passed
+ * in a single fjson_tokener_parse_ex() call and are too long to be
+ * stored inside the object. All others are copied as usual. The caller
+ * guarantees that the buffer stays unmodified until all objects created
+ * from it are freed or fjson_object_materialize() has been called on
+ * them. This saves copying each field of a message that lives in a
+ * long-lived buffer anyway.
+ *
+ * This flag is not set by default.
+ *
+ * @see fjson_tokener_set_flags()
+ */
+#define FJSON_TOKENER_ZERO_COPY  0x02
+
+/**
+ * Give all objects the tokener creates a plain, non-atomic reference
+ * count. This saves a locked operation on each fjson_object_get() and
+ * fjson_object_put(), which the tokener itself and the final free do
+ * for every node. Such a tree may be used by only one thread at a time;
+ * handing it over to another thread (with proper synchronization, e.g.
+ * through a mutex-protected queue) is fine. Before multiple threads can
+ * hold references concurrently, call fjson_object_share() on it.
+ *
+ * This flag is not set by default.
+ *
+ * @see fjson_tokener_set_flags()
+ */
+#define FJSON_TOKENER_LOCAL_REFCOUNT  0x04
+
 /**
  * Given an error previously returned by fjson_tokener_get_error(),
  * return a human readable description of the error.
@@ -118,6 +185,15 @@ enum fjson_tokener_error fjson_tokener_get_error(struct fjson_tokener *tok);
 
 extern struct fjson_tokener* fjson_tokener_new(void);
 extern struct fjson_tokener* fjson_tokener_new_ex(int depth);
+
+/**
+ * Create a tokener that uses the settings of a context instead of the
+ * process-wide ones. All objects it creates compare keys as configured
+ * in ctx.
+ * @param depth maximum nesting depth, e.g. FJSON_TOKENER_DEFAULT_DEPTH
+ * @param ctx the context, NULL means the same as fjson_tokener_new_ex()
+ */
+extern struct fjson_tokener* fjson_tokener_new_ctx(int depth, const struct fjson_ctx *ctx);
 extern void fjson_tokener_free(struct fjson_tokener *tok);
 extern void fjson_tokener_reset(struct fjson_tokener *tok);
 extern struct fjson_object* fjson_tokener_parse(const char *str);
@@ -128,6 +204,57 @@ extern struct fjson_object* fjson_tokener_parse_verbose(const char *str, enum fj
  */
 extern void fjson_tokener_set_flags(struct fjson_tokener *tok, int flags);
 
+/**
+ * Make the tokener allocate all objects it creates from the given arena
+ * instead of the heap. The tokener is reset by this call. A NULL arena
+ * switches back to heap allocation. The arena must live longer than the
+ * tokener uses it and all objects it returns; see fjson_arena_new() for
+ * details on the ownership of arena objects.
+ *
+ * Example:
+ * @code
+struct fjson_arena *arena = fjson_arena_new(0);
+fjson_tokener_set_arena(tok, arena);
+while(have_messages()) {
+	jobj = fjson_tokener_parse_ex(tok, msg, msglen);
+	... process jobj ...
+	fjson_tokener_reset(tok);
+	fjson_arena_reset(arena); // frees jobj and everything in it
+}
+@endcode
+ */
+extern void fjson_tokener_set_arena(struct fjson_tokener *tok, struct fjson_arena *arena);
+
+/**
+ * Make the tokener report what it parses via event handlers instead of
+ * building fjson_object trees. No objects at all are allocated in this
+ * mode; fjson_tokener_parse_ex() always returns NULL, and its result is
+ * to be checked via fjson_tokener_get_error(). Input can be passed in
+ * pieces in the same way as when building objects: strings and numbers
+ * that are split across calls are collected and reported as a whole.
+ * The tokener is reset by this call; a NULL cb switches back to normal
+ * operation. cb must stay valid as long as it is in use.
+ *
+ * Example:
+ * @code
+static int on_key(void *ctx, const char *key, int len)
+{
+	... compare key, maybe set a flag in ctx ...
+	return 0;
+}
+static const struct fjson_tokener_callbacks cb = { .key = on_key, ... };
+
+fjson_tokener_set_callbacks(tok, &cb, &my_ctx);
+do {
+	fjson_tokener_parse_ex(tok, chunk, chunklen);
+} while (fjson_tokener_get_error(tok) == fjson_tokener_continue && next_chunk());
+if (fjson_tokener_get_error(tok) != fjson_tokener_success)
+	... handle error ...
+@endcode
+ */
+extern void fjson_tokener_set_callbacks(struct fjson_tokener *tok,
+	const struct fjson_tokener_callbacks *cb, void *ctx);
+
 /**
  * Parse a string and return a non-NULL fjson_object if a valid JSON value
  * is found.  The string does not need to be a JSON object or array;
@@ -199,6 +326,137 @@ if (tok->char_offset < stringlen) // XXX shouldn't access internal fields
 extern struct fjson_object* fjson_tokener_parse_ex(struct fjson_tokener *tok,
 						 const char *str, int len);
 
+/**
+ * Parse a buffer the caller owns and allows us to overwrite.
+ *
+ * This works like fjson_tokener_parse_ex(), but string values are
+ * unescaped and NUL-terminated inside str itself, and objects reference
+ * them there instead of copying them. Unlike with
+ * FJSON_TOKENER_ZERO_COPY, this includes strings with escape sequences,
+ * and fjson_object_get_string() returns pointers into str directly.
+ * Strings short enough to be stored inside the object, strings that
+ * span multiple calls and keys are still copied. Together with an arena
+ * (see fjson_tokener_set_arena()), parsing then needs next to no
+ * allocation or copying.
+ *
+ * The content of str is undefined afterwards; it must stay available
+ * until all objects created from it are freed or
+ * fjson_object_materialize() has been called on them.
+ *
+ * @param tok a fjson_tokener previously allocated with fjson_tokener_new()
+ * @param str the buffer to parse, which is modified
+ * @param len the length of str, -1 if it is NUL-terminated
+ */
+extern struct fjson_object* fjson_tokener_parse_inplace(struct fjson_tokener *tok,
+						 char *str, int len);
+
+/**
+ * Check whether str is well-formed JSON, without building anything.
+ *
+ * This runs the same state machine as fjson_tokener_parse_ex(), with
+ * the same flags (e.g. FJSON_TOKENER_STRICT) and depth limit, and it is
+ * fed the same way: it returns fjson_tokener_continue if the text is
+ * incomplete so far, and the position where parsing stopped (at an
+ * error, or behind the value) is in tok->char_offset. But no objects
+ * are created and string contents are not collected, so it neither
+ * allocates nor copies; any event handlers set are not called. A text
+ * must be fed to this function up to its end once it has been started
+ * with it.
+ *
+ * @param tok a fjson_tokener previously allocated with fjson_tokener_new()
+ * @param str the text, or the next portion of it
+ * @param len the length of str, -1 if it is NUL-terminated
+ * @returns the result, as also returned by fjson_tokener_get_error()
+ */
+extern enum fjson_tokener_error fjson_tokener_validate(struct fjson_tokener *tok,
+	const char *str, int len);
+
+/**
+ * Called by fjson_tokener_parse_records() for each record. The callee
+ * owns obj (which is NULL if event handlers are set, see
+ * fjson_tokener_set_callbacks()). offset and len describe the record's
+ * text within the buffer, without surrounding whitespace.
+ * @returns 0 to continue, anything else to stop parsing
+ */
+typedef int (fjson_tokener_record_fn)(void *ctx, struct fjson_object *obj,
+	size_t offset, size_t len);
+
+/**
+ * Parse a buffer holding a sequence of JSON values, e.g. newline-delimited
+ * JSON (NDJSON) or values that are simply concatenated, and call cb for
+ * each of them in order. The tokener (and with it its stack, printbuf,
+ * flags, arena and event handlers) is reused for all records; it is
+ * reset before each one. The buffer does not need to be NUL-terminated.
+ *
+ * @param tok the tokener to use
+ * @param buf the records
+ * @param len length of buf
+ * @param cb called for each record
+ * @param ctx passed to cb
+ * @returns the number of records passed to cb, or -1 if a record could
+ * not be parsed. fjson_tokener_get_error() tells why; all records
+ * before the broken one have been passed to cb.
+ */
+extern int fjson_tokener_parse_records(struct fjson_tokener *tok, const char *buf, size_t len,
+	fjson_tokener_record_fn *cb, void *ctx);
+
+/**
+ * Like fjson_tokener_parse_records(), but the buffer is split at newlines
+ * into nchunks parts of about the same size, which are parsed by the
+ * executor's tasks, each with a tokener of its own. So this requires one
+ * record per line (as in NDJSON); there must be no raw newlines inside a
+ * record, like there are in pretty-printed JSON. cb is called in the
+ * calling thread and in record order after all tasks are done. The
+ * tokener's depth, flags and context settings are used, but not its
+ * arena or event handlers, as these cannot be shared between threads.
+ * If a record is broken, the records before it and the error are the
+ * same as with fjson_tokener_parse_records().
+ *
+ * @param tok the tokener; used for the depth and flags, and to report errors
+ * @param buf the records
+ * @param len length of buf
+ * @param nchunks number of parts to parse in parallel
+ * @param exec the executor, or NULL to run the tasks in the calling thread
+ * @param exec_ctx passed to exec
+ * @param cb called for each record
+ * @param ctx passed to cb
+ * @returns see fjson_tokener_parse_records()
+ */
+extern int fjson_tokener_parse_records_parallel(struct fjson_tokener *tok,
+	const char *buf, size_t len, int nchunks, fjson_executor_fn *exec, void *exec_ctx,
+	fjson_tokener_record_fn *cb, void *ctx);
+
+/**
+ * Parse a complete JSON text in two stages, as simdjson does: first, an
+ * index of all strings and structural characters is built with SIMD
+ * instructions, then the tree is built from that index. This is faster
+ * than fjson_tokener_parse_ex() for large texts, and both stages can be
+ * split into parts for the executor's tasks: the index is built in
+ * nparts pieces of the text, and if the text is an array, its elements
+ * are built in nparts groups (unless an arena is set, which cannot be
+ * shared between threads).
+ *
+ * The result is exactly the tree fjson_tokener_parse_ex() would build
+ * with the tokener's flags, context settings and arena. Only RFC 8259
+ * JSON is parsed this way; other input (e.g. with comments or NaN) and
+ * all errors are handed to the tokener, so the result and the error
+ * reported via fjson_tokener_get_error() are the same, too. The tokener
+ * is reset first. With event handlers set, it just runs the tokener.
+ * Unlike fjson_tokener_parse_ex(), which waits for more input, this
+ * takes buf as all there is: a number at its end is complete.
+ *
+ * @param tok the tokener; used for its settings and to report errors
+ * @param buf the JSON text, which does not need to be NUL-terminated
+ * @param len length of buf
+ * @param nparts number of parts to work in, 1 for none
+ * @param exec the executor, or NULL to run the tasks in the calling thread
+ * @param exec_ctx passed to exec
+ * @returns the parsed value, or NULL (also for a JSON null; check
+ *   fjson_tokener_get_error())
+ */
+extern struct fjson_object* fjson_tokener_parse_indexed(struct fjson_tokener *tok,
+	const char *buf, size_t len, int nparts, fjson_executor_fn *exec, void *exec_ctx);
+
 #ifndef FJSON_NATIVE_API_ONLY
 #define json_tokener fjson_tokener
 #define json_tokener_error fjson_tokener_error
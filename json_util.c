@@ -37,12 +37,25 @@
 # include <unistd.h>
 #endif /* HAVE_UNISTD_H */
 
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_MMAP)
+# include <sys/mman.h>
+# define USE_MMAP 1
+#endif
+
+#ifdef HAVE_LOCALE_H
+# include <locale.h>
+#endif /* HAVE_LOCALE_H */
+
+#ifdef HAVE_XLOCALE_H
+# include <xlocale.h>
+#endif /* HAVE_XLOCALE_H */
+
 #if !defined(HAVE_SNPRINTF)
 # error You do not have snprintf on your system.
 #endif /* HAVE_SNPRINTF */
 
 #include "debug.h"
-#include "printbuf.h"
+#include "alloc.h"
 #include "json_object.h"
 #include "json_tokener.h"
 #include "json_util.h"
@@ -51,6 +64,78 @@ static int sscanf_is_broken = 0;
 static int sscanf_is_broken_testdone = 0;
 static void sscanf_is_broken_test(void);
 
+/* the tokener takes an int length, so huge inputs are fed in parts */
+#define MAX_FEED (1 << 30)
+
+/*
+ * Feed the next part of the input to the tokener. Returns 1 if parsing
+ * is complete (successfully or not), 0 if more input is needed.
+ */
+static int feed(struct fjson_tokener *tok, const char *p, size_t len, struct fjson_object **obj)
+{
+	while(len > 0) {
+		const int n = (len > MAX_FEED) ? MAX_FEED : (int) len;
+		*obj = fjson_tokener_parse_ex(tok, p, n);
+		if(fjson_tokener_get_error(tok) != fjson_tokener_continue)
+			return 1;
+		p += n;
+		len -= n;
+	}
+	return 0;
+}
+
+/*
+ * End of input: a NUL terminates a trailing number, just as it does
+ * for fjson_tokener_parse(). Returns the object or NULL on error.
+ */
+static struct fjson_object* finish(struct fjson_tokener *tok, int done, struct fjson_object *obj)
+{
+	if(!done)
+		feed(tok, "", 1, &obj);
+	if(fjson_tokener_get_error(tok) != fjson_tokener_success) {
+		fjson_object_put(obj);
+		obj = NULL;
+	}
+	return obj;
+}
+
+#ifdef USE_MMAP
+/*
+ * Regular files are parsed straight from a read-only mapping, so the
+ * data is neither copied nor buffered. Returns 0 if the fd cannot be
+ * mapped; the caller then falls back to read().
+ * Note: just as with any mapping, truncating the file while we parse
+ * it results in SIGBUS.
+ */
+static int from_mapped_fd(int fd, struct fjson_tokener *tok, struct fjson_object **obj)
+{
+	struct stat st;
+	off_t pos, start;
+	size_t maplen;
+	void *map;
+	int done;
+
+	if(fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+		return 0;
+	if((pos = lseek(fd, 0, SEEK_CUR)) < 0 || pos >= st.st_size)
+		return 0;
+	/* the offset of a mapping must be page aligned */
+	start = pos - pos % sysconf(_SC_PAGESIZE);
+	maplen = (size_t) (st.st_size - start);
+	if((map = mmap(NULL, maplen, PROT_READ, MAP_PRIVATE, fd, start)) == MAP_FAILED)
+		return 0;
+#ifdef HAVE_MADVISE
+	madvise(map, maplen, MADV_SEQUENTIAL);
+#endif
+	done = feed(tok, (const char *) map + (pos - start), (size_t) (st.st_size - pos), obj);
+	*obj = finish(tok, done, *obj);
+	munmap(map, maplen);
+	/* leave the position where read() would have left it */
+	lseek(fd, st.st_size, SEEK_SET);
+	return 1;
+}
+#endif
+
 /*
  * Create a JSON object from already opened file descriptor.
  *
@@ -58,28 +143,40 @@ static void sscanf_is_broken_test(void);
  * e.g. when you have a temp file.
  * Note, that the fd must be readable at the actual position, i.e.
  * use lseek(fd, 0, SEEK_SET) before.
+ *
+ * Regular files are mapped into memory (if the platform supports it).
+ * Other fds (pipes, sockets) are read in FJSON_FILE_BUF_SIZE chunks,
+ * which are fed to the tokener as they come in. We stop reading once
+ * a complete value has been parsed.
  */
 struct fjson_object* fjson_object_from_fd(int fd)
 {
-	struct printbuf *pb;
-	struct fjson_object *obj;
+	struct fjson_tokener *tok;
+	struct fjson_object *obj = NULL;
 	char buf[FJSON_FILE_BUF_SIZE];
-	int ret;
+	int done = 0;
+	int ret = 0;
 
-	if(!(pb = printbuf_new())) {
-		MC_ERROR("fjson_object_from_file: printbuf_new failed\n");
+	if(!(tok = fjson_tokener_new())) {
+		MC_ERROR("fjson_object_from_fd: fjson_tokener_new failed\n");
 		return NULL;
 	}
-	while((ret = read(fd, buf, FJSON_FILE_BUF_SIZE)) > 0) {
-		printbuf_memappend(pb, buf, ret);
+#ifdef USE_MMAP
+	if(from_mapped_fd(fd, tok, &obj)) {
+		fjson_tokener_free(tok);
+		return obj;
 	}
-	if(ret < 0) {
+#endif
+	while(!done && (ret = read(fd, buf, FJSON_FILE_BUF_SIZE)) > 0) {
+		done = feed(tok, buf, ret, &obj);
+	}
+	if(!done && ret < 0) {
 		MC_ERROR("fjson_object_from_fd: error reading fd %d: %s\n", fd, strerror(errno));
-		printbuf_free(pb);
+		fjson_tokener_free(tok);
 		return NULL;
 	}
-	obj = fjson_tokener_parse(pb->buf);
-	printbuf_free(pb);
+	obj = finish(tok, done, obj);
+	fjson_tokener_free(tok);
 	return obj;
 }
 
@@ -147,9 +244,85 @@ int fjson_object_to_file(const char *filename, struct fjson_object *obj)
 	return fjson_object_to_file_ext(filename, obj, FJSON_TO_STRING_PLAIN);
 }
 
+/* locale-independent number conversion
+ *
+ * JSON numbers always use '.' as decimal point, but strtod() and
+ * sscanf() honor LC_NUMERIC. We used to switch the global locale to "C"
+ * for each fjson_tokener_parse_ex() call. That costs a malloc per call
+ * and, worse, modifies process-global state, which is racy for
+ * threaded callers. Now we use strtod_l() with a private C locale
+ * object if the platform supports it. If not, we adapt the number to
+ * the decimal point of the current locale, which localeconv() tells us
+ * without changing anything.
+ */
+#if defined(HAVE_STRTOD_L) && defined(HAVE_NEWLOCALE) && defined(HAVE_ATOMIC_BUILTINS)
+#define USE_STRTOD_L 1
+static locale_t c_numeric_locale = (locale_t) 0;
+
+/* the locale object is created on first use and never freed; if two
+ * threads race, the loser frees its copy.
+ */
+static locale_t get_c_numeric_locale(void)
+{
+	locale_t loc = c_numeric_locale;
+	if (loc == (locale_t) 0) {
+		loc = newlocale(LC_NUMERIC_MASK, "C", (locale_t) 0);
+		if (loc == (locale_t) 0)
+			return loc;
+		if (!__sync_bool_compare_and_swap(&c_numeric_locale, (locale_t) 0, loc)) {
+			freelocale(loc);
+			loc = c_numeric_locale;
+		}
+	}
+	return loc;
+}
+#endif
+
+static int parse_double_locale_dp(const char *buf, double *retval)
+{
+	const char *dp = ".";
+	const char *p;
+	char numbuf[128];
+	char *tmp, *end;
+	size_t len, dplen;
+
+#ifdef HAVE_LOCALECONV
+	const struct lconv *const lc = localeconv();
+	if (lc != NULL && lc->decimal_point != NULL && *lc->decimal_point != '\0')
+		dp = lc->decimal_point;
+#endif
+	if ((p = strchr(buf, '.')) == NULL || !strcmp(dp, ".")) {
+		*retval = strtod(buf, &end);
+		return (end == buf) ? 1 : 0;
+	}
+
+	len = strlen(buf);
+	dplen = strlen(dp);
+	if (len + dplen < sizeof(numbuf)) {
+		tmp = numbuf;
+	} else if ((tmp = _fjson_malloc(len + dplen)) == NULL) {
+		return 1;
+	}
+	memcpy(tmp, buf, p - buf);
+	memcpy(tmp + (p - buf), dp, dplen);
+	strcpy(tmp + (p - buf) + dplen, p + 1);
+	*retval = strtod(tmp, &end);
+	if (tmp != numbuf)
+		_fjson_free(tmp);
+	return (end == tmp) ? 1 : 0;
+}
+
 int fjson_parse_double(const char *buf, double *retval)
 {
-	return (sscanf(buf, "%lf", retval)==1 ? 0 : 1);
+#ifdef USE_STRTOD_L
+	const locale_t loc = get_c_numeric_locale();
+	if (loc != (locale_t) 0) {
+		char *end;
+		*retval = strtod_l(buf, &end, loc);
+		return (end == buf) ? 1 : 0;
+	}
+#endif
+	return parse_double_locale_dp(buf, retval);
 }
 
 /*
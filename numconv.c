@@ -0,0 +1,563 @@
+/*
+ * Copyright (c) 2026 Adiscon GmbH
+ * Rainer Gerhards <rgerhards@adiscon.com>
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See COPYING for details.
+ *
+ */
+
+/* number to string conversion
+ *
+ * printf() is a general-purpose tool and as such very slow for what we
+ * need: it re-parses the format string on each call and, for doubles,
+ * needs 17 digits to guarantee a round-trip, which we then had to fix up
+ * (decimal comma in some locales, ".0" for integral values). This module
+ * contains specialised, locale-independent code instead.
+ *
+ * Doubles are converted with the Grisu2 algorithm by Florian Loitsch
+ * ("Printing Floating-Point Numbers Quickly and Accurately with
+ * Integers", PLDI 2010). It uses 64 bit integer arithmetic only and
+ * always produces a digit string that reads back to the same double;
+ * for the vast majority of values it is also the shortest such string.
+ * The structure of this implementation follows the one by Milo Yip.
+ *
+ * Integers are converted two digits at a time with the help of a table
+ * of all digit pairs, which halves the number of (slow) divisions.
+ */
+#include "config.h"
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+
+#include "numconv.h"
+
+/* "do it yourself floating point": f * 2^e */
+struct diy_fp {
+	uint64_t f;
+	int e;
+};
+
+#define DP_SIGNIFICAND_SIZE 52
+#define DP_EXPONENT_BIAS (0x3FF + DP_SIGNIFICAND_SIZE)
+#define DP_MIN_EXPONENT (-DP_EXPONENT_BIAS)
+#define DP_EXPONENT_MASK 0x7FF0000000000000ULL
+#define DP_SIGNIFICAND_MASK 0x000FFFFFFFFFFFFFULL
+#define DP_HIDDEN_BIT 0x0010000000000000ULL
+
+/* normalized 10^k for k = -348, -340, ..., 340 */
+static const struct diy_fp cached_powers[] = {
+	{ 0xfa8fd5a0081c0288ULL, -1220 },
+	{ 0xbaaee17fa23ebf76ULL, -1193 },
+	{ 0x8b16fb203055ac76ULL, -1166 },
+	{ 0xcf42894a5dce35eaULL, -1140 },
+	{ 0x9a6bb0aa55653b2dULL, -1113 },
+	{ 0xe61acf033d1a45dfULL, -1087 },
+	{ 0xab70fe17c79ac6caULL, -1060 },
+	{ 0xff77b1fcbebcdc4fULL, -1034 },
+	{ 0xbe5691ef416bd60cULL, -1007 },
+	{ 0x8dd01fad907ffc3cULL, -980 },
+	{ 0xd3515c2831559a83ULL, -954 },
+	{ 0x9d71ac8fada6c9b5ULL, -927 },
+	{ 0xea9c227723ee8bcbULL, -901 },
+	{ 0xaecc49914078536dULL, -874 },
+	{ 0x823c12795db6ce57ULL, -847 },
+	{ 0xc21094364dfb5637ULL, -821 },
+	{ 0x9096ea6f3848984fULL, -794 },
+	{ 0xd77485cb25823ac7ULL, -768 },
+	{ 0xa086cfcd97bf97f4ULL, -741 },
+	{ 0xef340a98172aace5ULL, -715 },
+	{ 0xb23867fb2a35b28eULL, -688 },
+	{ 0x84c8d4dfd2c63f3bULL, -661 },
+	{ 0xc5dd44271ad3cdbaULL, -635 },
+	{ 0x936b9fcebb25c996ULL, -608 },
+	{ 0xdbac6c247d62a584ULL, -582 },
+	{ 0xa3ab66580d5fdaf6ULL, -555 },
+	{ 0xf3e2f893dec3f126ULL, -529 },
+	{ 0xb5b5ada8aaff80b8ULL, -502 },
+	{ 0x87625f056c7c4a8bULL, -475 },
+	{ 0xc9bcff6034c13053ULL, -449 },
+	{ 0x964e858c91ba2655ULL, -422 },
+	{ 0xdff9772470297ebdULL, -396 },
+	{ 0xa6dfbd9fb8e5b88fULL, -369 },
+	{ 0xf8a95fcf88747d94ULL, -343 },
+	{ 0xb94470938fa89bcfULL, -316 },
+	{ 0x8a08f0f8bf0f156bULL, -289 },
+	{ 0xcdb02555653131b6ULL, -263 },
+	{ 0x993fe2c6d07b7facULL, -236 },
+	{ 0xe45c10c42a2b3b06ULL, -210 },
+	{ 0xaa242499697392d3ULL, -183 },
+	{ 0xfd87b5f28300ca0eULL, -157 },
+	{ 0xbce5086492111aebULL, -130 },
+	{ 0x8cbccc096f5088ccULL, -103 },
+	{ 0xd1b71758e219652cULL, -77 },
+	{ 0x9c40000000000000ULL, -50 },
+	{ 0xe8d4a51000000000ULL, -24 },
+	{ 0xad78ebc5ac620000ULL, 3 },
+	{ 0x813f3978f8940984ULL, 30 },
+	{ 0xc097ce7bc90715b3ULL, 56 },
+	{ 0x8f7e32ce7bea5c70ULL, 83 },
+	{ 0xd5d238a4abe98068ULL, 109 },
+	{ 0x9f4f2726179a2245ULL, 136 },
+	{ 0xed63a231d4c4fb27ULL, 162 },
+	{ 0xb0de65388cc8ada8ULL, 189 },
+	{ 0x83c7088e1aab65dbULL, 216 },
+	{ 0xc45d1df942711d9aULL, 242 },
+	{ 0x924d692ca61be758ULL, 269 },
+	{ 0xda01ee641a708deaULL, 295 },
+	{ 0xa26da3999aef774aULL, 322 },
+	{ 0xf209787bb47d6b85ULL, 348 },
+	{ 0xb454e4a179dd1877ULL, 375 },
+	{ 0x865b86925b9bc5c2ULL, 402 },
+	{ 0xc83553c5c8965d3dULL, 428 },
+	{ 0x952ab45cfa97a0b3ULL, 455 },
+	{ 0xde469fbd99a05fe3ULL, 481 },
+	{ 0xa59bc234db398c25ULL, 508 },
+	{ 0xf6c69a72a3989f5cULL, 534 },
+	{ 0xb7dcbf5354e9beceULL, 561 },
+	{ 0x88fcf317f22241e2ULL, 588 },
+	{ 0xcc20ce9bd35c78a5ULL, 614 },
+	{ 0x98165af37b2153dfULL, 641 },
+	{ 0xe2a0b5dc971f303aULL, 667 },
+	{ 0xa8d9d1535ce3b396ULL, 694 },
+	{ 0xfb9b7cd9a4a7443cULL, 720 },
+	{ 0xbb764c4ca7a44410ULL, 747 },
+	{ 0x8bab8eefb6409c1aULL, 774 },
+	{ 0xd01fef10a657842cULL, 800 },
+	{ 0x9b10a4e5e9913129ULL, 827 },
+	{ 0xe7109bfba19c0c9dULL, 853 },
+	{ 0xac2820d9623bf429ULL, 880 },
+	{ 0x80444b5e7aa7cf85ULL, 907 },
+	{ 0xbf21e44003acdd2dULL, 933 },
+	{ 0x8e679c2f5e44ff8fULL, 960 },
+	{ 0xd433179d9c8cb841ULL, 986 },
+	{ 0x9e19db92b4e31ba9ULL, 1013 },
+	{ 0xeb96bf6ebadf77d9ULL, 1039 },
+	{ 0xaf87023b9bf0ee6bULL, 1066 }
+};
+
+static const uint64_t pow10_tbl[] = {
+	1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL,
+	10000000ULL, 100000000ULL, 1000000000ULL, 10000000000ULL,
+	100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+	100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL,
+	100000000000000000ULL, 1000000000000000000ULL, 10000000000000000000ULL
+};
+
+static struct diy_fp
+diy_fp_from_double(const double d)
+{
+	struct diy_fp r;
+	uint64_t u;
+	int biased_e;
+
+	memcpy(&u, &d, sizeof(u));
+	biased_e = (int) ((u & DP_EXPONENT_MASK) >> DP_SIGNIFICAND_SIZE);
+	if (biased_e != 0) {
+		r.f = (u & DP_SIGNIFICAND_MASK) + DP_HIDDEN_BIT;
+		r.e = biased_e - DP_EXPONENT_BIAS;
+	} else { /* denormal */
+		r.f = u & DP_SIGNIFICAND_MASK;
+		r.e = DP_MIN_EXPONENT + 1;
+	}
+	return r;
+}
+
+static struct diy_fp
+diy_fp_mul(const struct diy_fp x, const struct diy_fp y)
+{
+	const uint64_t M32 = 0xFFFFFFFFULL;
+	const uint64_t a = x.f >> 32, b = x.f & M32;
+	const uint64_t c = y.f >> 32, d = y.f & M32;
+	const uint64_t ac = a * c, bc = b * c, ad = a * d, bd = b * d;
+	uint64_t tmp = (bd >> 32) + (ad & M32) + (bc & M32);
+	struct diy_fp r;
+
+	tmp += 1ULL << 31; /* round */
+	r.f = ac + (ad >> 32) + (bc >> 32) + (tmp >> 32);
+	r.e = x.e + y.e + 64;
+	return r;
+}
+
+static struct diy_fp
+diy_fp_normalize(struct diy_fp x)
+{
+	const int s = __builtin_clzll(x.f);
+	x.f <<= s;
+	x.e -= s;
+	return x;
+}
+
+/* compute the boundaries m- and m+ of the rounding interval of v, both
+ * with the exponent of the normalized m+
+ */
+static void
+normalized_boundaries(const struct diy_fp v, struct diy_fp *const minus, struct diy_fp *const plus)
+{
+	struct diy_fp pl, mi;
+
+	pl.f = (v.f << 1) + 1;
+	pl.e = v.e - 1;
+	while (!(pl.f & (DP_HIDDEN_BIT << 1))) {
+		pl.f <<= 1;
+		pl.e--;
+	}
+	pl.f <<= 64 - DP_SIGNIFICAND_SIZE - 2;
+	pl.e -= 64 - DP_SIGNIFICAND_SIZE - 2;
+
+	if (v.f == DP_HIDDEN_BIT) { /* lower boundary is closer */
+		mi.f = (v.f << 2) - 1;
+		mi.e = v.e - 2;
+	} else {
+		mi.f = (v.f << 1) - 1;
+		mi.e = v.e - 1;
+	}
+	mi.f <<= mi.e - pl.e;
+	mi.e = pl.e;
+	*minus = mi;
+	*plus = pl;
+}
+
+/* get a cached power c = 10^-K such that e + c.e is in [-60, -32] */
+static struct diy_fp
+get_cached_power(const int e, int *const K)
+{
+	const double dk = (-61 - e) * 0.30102999566398114 + 347;
+	int k = (int) dk;
+	unsigned idx;
+
+	if (dk - k > 0.0)
+		k++;
+	idx = (unsigned) ((k >> 3) + 1);
+	*K = -(-348 + (int) (idx << 3));
+	return cached_powers[idx];
+}
+
+static void
+grisu_round(char *const buf, const int len, const uint64_t delta, uint64_t rest,
+	const uint64_t ten_kappa, const uint64_t wp_w)
+{
+	while (rest < wp_w && delta - rest >= ten_kappa &&
+	       (rest + ten_kappa < wp_w || wp_w - rest > rest + ten_kappa - wp_w)) {
+		buf[len - 1]--;
+		rest += ten_kappa;
+	}
+}
+
+static int
+count_digits32(const uint32_t n)
+{
+	int i;
+	for (i = 1 ; i < 10 ; ++i) {
+		if (n < pow10_tbl[i])
+			return i;
+	}
+	return 10;
+}
+
+static void
+digit_gen(const struct diy_fp W, const struct diy_fp Mp, uint64_t delta,
+	char *const buf, int *const len, int *const K)
+{
+	const int shift = -Mp.e;
+	const uint64_t one_f = 1ULL << shift;
+	const uint64_t wp_w = Mp.f - W.f;
+	uint32_t p1 = (uint32_t) (Mp.f >> shift);
+	uint64_t p2 = Mp.f & (one_f - 1);
+	int kappa = count_digits32(p1);
+
+	*len = 0;
+	while (kappa > 0) {
+		const uint32_t div = (uint32_t) pow10_tbl[kappa - 1];
+		const uint32_t d = p1 / div;
+		uint64_t tmp;
+		p1 %= div;
+		if (d || *len)
+			buf[(*len)++] = (char) ('0' + d);
+		kappa--;
+		tmp = ((uint64_t) p1 << shift) + p2;
+		if (tmp <= delta) {
+			*K += kappa;
+			grisu_round(buf, *len, delta, tmp, pow10_tbl[kappa] << shift, wp_w);
+			return;
+		}
+	}
+
+	while (1) {
+		char d;
+		p2 *= 10;
+		delta *= 10;
+		d = (char) (p2 >> shift);
+		if (d || *len)
+			buf[(*len)++] = (char) ('0' + d);
+		p2 &= one_f - 1;
+		kappa--;
+		if (p2 < delta) {
+			*K += kappa;
+			grisu_round(buf, *len, delta, p2, one_f,
+				wp_w * (-kappa < 20 ? pow10_tbl[-kappa] : 0));
+			return;
+		}
+	}
+}
+
+/* generate the digits of a finite, positive v; value = digits * 10^K */
+static void
+grisu2(const double v, char *const buf, int *const len, int *const K)
+{
+	const struct diy_fp dv = diy_fp_from_double(v);
+	struct diy_fp w_m, w_p, c_mk, W, Wp, Wm;
+
+	normalized_boundaries(dv, &w_m, &w_p);
+	c_mk = get_cached_power(w_p.e, K);
+	W = diy_fp_mul(diy_fp_normalize(dv), c_mk);
+	Wp = diy_fp_mul(w_p, c_mk);
+	Wm = diy_fp_mul(w_m, c_mk);
+	Wm.f++;
+	Wp.f--;
+	digit_gen(W, Wp, Wp.f - Wm.f, buf, len, K);
+}
+
+/* write the decimal exponent in printf's "%g" style: sign and at least
+ * two digits.
+ */
+static char *
+write_exponent(int x, char *p)
+{
+	*p++ = 'e';
+	if (x < 0) {
+		*p++ = '-';
+		x = -x;
+	} else {
+		*p++ = '+';
+	}
+	if (x >= 100) {
+		*p++ = (char) ('0' + x / 100);
+		x %= 100;
+	}
+	*p++ = (char) ('0' + x / 10);
+	*p++ = (char) ('0' + x % 10);
+	return p;
+}
+
+int
+_fjson_dtoa(const double d, char *const buf)
+{
+	char digits[18];
+	char *p = buf;
+	int len, K, x;
+
+	if (isnan(d)) {
+		memcpy(buf, "NaN", 4);
+		return 3;
+	}
+	if (isinf(d)) {
+		if (d > 0) {
+			memcpy(buf, "Infinity", 9);
+			return 8;
+		}
+		memcpy(buf, "-Infinity", 10);
+		return 9;
+	}
+
+	if (signbit(d))
+		*p++ = '-';
+	if (d == 0) {
+		memcpy(p, "0.0", 4);
+		return (int) (p - buf) + 3;
+	}
+
+	grisu2(fabs(d), digits, &len, &K);
+	x = len + K - 1; /* decimal exponent of the first digit */
+
+	if (x < -4 || x >= 17) {
+		/* same switch-over points as "%.17g" */
+		*p++ = digits[0];
+		if (len > 1) {
+			*p++ = '.';
+			memcpy(p, digits + 1, len - 1);
+			p += len - 1;
+		}
+		p = write_exponent(x, p);
+	} else if (K >= 0) {
+		/* integral value */
+		memcpy(p, digits, len);
+		p += len;
+		memset(p, '0', K);
+		p += K;
+		*p++ = '.';
+		*p++ = '0';
+	} else if (x >= 0) {
+		memcpy(p, digits, x + 1);
+		p += x + 1;
+		*p++ = '.';
+		memcpy(p, digits + x + 1, len - x - 1);
+		p += len - x - 1;
+	} else {
+		*p++ = '0';
+		*p++ = '.';
+		memset(p, '0', -x - 1);
+		p += -x - 1;
+		memcpy(p, digits, len);
+		p += len;
+	}
+	*p = '\0';
+	return (int) (p - buf);
+}
+
+
+static const char digit_pairs[201] =
+	"00010203040506070809"
+	"10111213141516171819"
+	"20212223242526272829"
+	"30313233343536373839"
+	"40414243444546474849"
+	"50515253545556575859"
+	"60616263646566676869"
+	"70717273747576777879"
+	"80818283848586878889"
+	"90919293949596979899";
+
+int
+_fjson_i64toa(const int64_t i, char *const buf)
+{
+	char tmp[20];
+	char *p = tmp + sizeof(tmp);
+	char *out = buf;
+	/* negate as unsigned so that INT64_MIN works, too */
+	uint64_t u = (i < 0) ? -(uint64_t) i : (uint64_t) i;
+	int len;
+
+	while (u >= 100) {
+		const unsigned r = (unsigned) (u % 100);
+		u /= 100;
+		p -= 2;
+		memcpy(p, digit_pairs + 2 * r, 2);
+	}
+	if (u >= 10) {
+		p -= 2;
+		memcpy(p, digit_pairs + 2 * u, 2);
+	} else {
+		*--p = (char) ('0' + u);
+	}
+
+	if (i < 0)
+		*out++ = '-';
+	len = (int) (tmp + sizeof(tmp) - p);
+	memcpy(out, p, len);
+	out[len] = '\0';
+	return (int) (out - buf) + len;
+}
+
+
+/* string to number conversion
+ *
+ * The tokener's general number path collects the text in a printbuf and
+ * hands it to sscanf() or strtod(). Most numbers in practice are plain
+ * integers or short decimals, for which this is far more work than
+ * needed, so these are converted right from the input here.
+ *
+ * Decimals are only handled if this is exact: if the digits (without
+ * the dot) are at most 2^53 and the power of ten is at most 10^22, both
+ * are representable as doubles, and a single multiplication or division
+ * gives the correctly rounded result (Clinger's fast path). That covers
+ * the typical measurement values; all others, as well as everything
+ * that is not plain JSON number syntax, are left to the general path.
+ */
+
+static const double exact_pow10[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+#define IS_DIGIT(c) ((c) >= '0' && (c) <= '9')
+/* the characters the tokener takes as part of a number */
+#define IS_NUMBER_CHAR(c) (IS_DIGIT(c) || (c) == '.' || (c) == '+' || (c) == '-' \
+	|| (c) == 'e' || (c) == 'E')
+
+int
+_fjson_scan_number(const char *const s, const char *const end,
+	int64_t *const i, double *const d, int *const is_double)
+{
+	const char *p = s;
+	const int neg = (p < end && *p == '-');
+	uint64_t m = 0;
+	int ndigits = 0, nfrac = 0, exp = 0;
+
+	p += neg;
+	if (p == end || !IS_DIGIT(*p))
+		return 0;
+	if (*p == '0' && p + 1 < end && IS_DIGIT(p[1]))
+		return 0; /* leading zeros, which strict mode rejects */
+	/* up to 19 digits cannot overflow */
+	for ( ; p < end && IS_DIGIT(*p) ; ++p) {
+		if (++ndigits > 19)
+			return 0;
+		m = m * 10 + (*p - '0');
+	}
+
+	if (p < end && *p != '.' && *p != 'e' && *p != 'E') {
+		if (IS_NUMBER_CHAR(*p))
+			return 0;
+		if (neg) {
+			if (m > (uint64_t) INT64_MAX + 1)
+				return 0;
+			*i = (m == (uint64_t) INT64_MAX + 1) ? INT64_MIN : -(int64_t) m;
+		} else {
+			if (m > (uint64_t) INT64_MAX)
+				return 0;
+			*i = (int64_t) m;
+		}
+		*is_double = 0;
+		return (int) (p - s);
+	}
+
+	if (p < end && *p == '.') {
+		const char *const frac = ++p;
+		for ( ; p < end && IS_DIGIT(*p) ; ++p) {
+			if (++ndigits > 19)
+				return 0;
+			m = m * 10 + (*p - '0');
+		}
+		if ((nfrac = (int) (p - frac)) == 0)
+			return 0;
+	}
+	if (p < end && (*p == 'e' || *p == 'E')) {
+		const char *digits;
+		int exp_neg = 0;
+		if (++p < end && (*p == '+' || *p == '-'))
+			exp_neg = (*p++ == '-');
+		for (digits = p ; p < end && IS_DIGIT(*p) ; ++p) {
+			if (exp < 10000)
+				exp = exp * 10 + (*p - '0');
+		}
+		if (p == digits)
+			return 0;
+		if (exp_neg)
+			exp = -exp;
+	}
+	if (p == end || IS_NUMBER_CHAR(*p))
+		return 0;
+
+#if defined(FLT_EVAL_METHOD) && FLT_EVAL_METHOD == 0
+	{
+		/* without excess precision, so that the result is rounded once */
+		const int e = exp - nfrac;
+		double v;
+		if (m == 0) {
+			v = 0.0;
+		} else {
+			if (m > ((uint64_t) 1 << 53) || e < -22 || e > 22)
+				return 0;
+			v = (e < 0) ? (double) m / exact_pow10[-e] : (double) m * exact_pow10[e];
+		}
+		*d = neg ? -v : v;
+		*is_double = 1;
+		return (int) (p - s);
+	}
+#else
+	return 0;
+#endif
+}
@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) 2026 Adiscon GmbH
+ * Rainer Gerhards <rgerhards@adiscon.com>
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See COPYING for details.
+ *
+ */
+
+#ifndef _fj_numconv_h_
+#define _fj_numconv_h_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* buffer size sufficient for any number formatted by the functions
+ * below, including the terminating NUL
+ */
+#define FJSON_NUMCONV_BUFSIZE 32
+
+/* Format a double the way the serializers need it: the shortest digit
+ * string that converts back to the very same double, in fixed notation
+ * (with ".0" added for integral values) or, for very large and very
+ * small magnitudes, in exponent notation like "%g" does. NaN and
+ * infinite values are written as NaN, Infinity and -Infinity.
+ * The output does not depend on the locale. Returns the length of the
+ * NUL-terminated string written to buf.
+ */
+extern int _fjson_dtoa(double d, char *buf);
+
+/* Format an integer in decimal. Returns the length of the NUL-terminated
+ * string written to buf.
+ */
+extern int _fjson_i64toa(int64_t i, char *buf);
+
+/* Convert the number at s, which extends at most up to end, without
+ * copying it. Only plain integers that fit into int64 and decimals that
+ * convert exactly are handled, and only if the number is followed by a
+ * character that ends it (so that it is known to be complete). Returns
+ * the length of the number, with the value in *i (*is_double == 0) or
+ * *d (*is_double == 1), or 0 if the caller needs to take the general
+ * path, which includes all invalid input.
+ */
+extern int _fjson_scan_number(const char *s, const char *end,
+	int64_t *i, double *d, int *is_double);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2026 Adiscon GmbH
+ * Rainer Gerhards <rgerhards@adiscon.com>
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See COPYING for details.
+ *
+ */
+
+/* block pools
+ *
+ * Code that builds and frees trees piecemeal spends much of its time in
+ * malloc and free for blocks of a handful of different sizes. Here, each
+ * thread keeps freed blocks on lists by size and hands them out again,
+ * which needs neither locking nor atomic operations. The lists are
+ * thread-local, so a block freed by another thread than the one that
+ * allocated it simply moves to the other thread's pool.
+ *
+ * The limit applies to each thread. Blocks are not returned to the
+ * system automatically, so threads that end should call
+ * fjson_global_pool_trim() before.
+ */
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "json.h"
+#include "alloc.h"
+#include "pool.h"
+
+#ifdef HAVE_TLS
+#define POOL_NCLASSES 16
+
+struct pool_class {
+	size_t size;	/**< block size, 0 if unused */
+	void *head;	/**< first free block, holds pointer to next one */
+};
+
+static size_t pool_limit = 0;
+static __thread struct pool_class pool_classes[POOL_NCLASSES];
+static __thread size_t pool_bytes;
+#endif
+
+void *
+_fjson_pool_calloc(const size_t size)
+{
+#ifdef HAVE_TLS
+	if (pool_bytes > 0) {
+		for (int i = 0 ; i < POOL_NCLASSES && pool_classes[i].size != 0 ; ++i) {
+			if (pool_classes[i].size != size)
+				continue;
+			void *const ptr = pool_classes[i].head;
+			if (ptr == NULL)
+				break;
+			pool_classes[i].head = *(void **) ptr;
+			pool_bytes -= size;
+			memset(ptr, 0, size);
+			return ptr;
+		}
+	}
+#endif
+	return _fjson_calloc(1, size);
+}
+
+void
+_fjson_pool_free(void *const ptr, const size_t size)
+{
+	if (ptr == NULL)
+		return;
+#ifdef HAVE_TLS
+	if (pool_bytes + size <= pool_limit && size >= sizeof(void *)) {
+		for (int i = 0 ; i < POOL_NCLASSES ; ++i) {
+			if (pool_classes[i].size == 0)
+				pool_classes[i].size = size;
+			else if (pool_classes[i].size != size)
+				continue;
+			*(void **) ptr = pool_classes[i].head;
+			pool_classes[i].head = ptr;
+			pool_bytes += size;
+			return;
+		}
+	}
+#endif
+	_fjson_free(ptr);
+}
+
+void
+fjson_global_set_pool_limit(const size_t bytes)
+{
+#ifdef HAVE_TLS
+	pool_limit = bytes;
+#else
+	(void) bytes;
+#endif
+}
+
+void
+fjson_global_pool_trim(void)
+{
+#ifdef HAVE_TLS
+	for (int i = 0 ; i < POOL_NCLASSES ; ++i) {
+		void *ptr, *next;
+		for (ptr = pool_classes[i].head ; ptr != NULL ; ptr = next) {
+			next = *(void **) ptr;
+			_fjson_free(ptr);
+		}
+		pool_classes[i].head = NULL;
+		pool_classes[i].size = 0;
+	}
+	pool_bytes = 0;
+#endif
+}
+
+size_t
+fjson_global_pool_bytes(void)
+{
+#ifdef HAVE_TLS
+	return pool_bytes;
+#else
+	return 0;
+#endif
+}
@@ -0,0 +1,36 @@
+/*
+ * Copyright (c) 2026 Adiscon GmbH
+ * Rainer Gerhards <rgerhards@adiscon.com>
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See COPYING for details.
+ *
+ */
+
+#ifndef _fj_pool_h_
+#define _fj_pool_h_
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Per-thread free lists for the fixed-size blocks that make up trees
+ * (nodes, children pages, array storage). Blocks are kept by exact
+ * size, so everything obtained from _fjson_pool_calloc() can also be
+ * released with _fjson_free() and vice versa. Pooling is off until
+ * fjson_global_set_pool_limit() is called.
+ */
+
+/* like calloc(1, size) */
+extern void *_fjson_pool_calloc(size_t size);
+
+/* like free(ptr); size must be what ptr was allocated with */
+extern void _fjson_pool_free(void *ptr, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -26,6 +26,7 @@
 
 #include "json.h"
 #include "debug.h"
+#include "alloc.h"
 #include "printbuf.h"
 
 static int printbuf_initial_size = 32;
@@ -37,16 +38,21 @@ void fjson_global_set_printbuf_initial_size(int size)
 }
 
 struct printbuf* printbuf_new(void)
+{
+	return printbuf_new_size(0);
+}
+
+struct printbuf* printbuf_new_size(int size)
 {
 	struct printbuf *p;
 
-	p = (struct printbuf*)malloc(sizeof(struct printbuf));
+	p = (struct printbuf*)_fjson_malloc(sizeof(struct printbuf));
 	if(!p) return NULL;
 	/* note: *ALL* data items must be initialized! */
-	p->size = printbuf_initial_size;
+	p->size = (size > 0) ? size : printbuf_initial_size;
 	p->bpos = 0;
-	if(!(p->buf = (char*)malloc(p->size))) {
-		free(p);
+	if(!(p->buf = (char*)_fjson_malloc(p->size))) {
+		_fjson_free(p);
 		return NULL;
 	}
 	return p;
@@ -84,7 +90,8 @@ static int printbuf_extend(struct printbuf *p, int min_size)
 	  "bpos=%d min_size=%d old_size=%d new_size=%d\n",
 	  p->bpos, min_size, p->size, new_size);
 #endif /* PRINTBUF_DEBUG */
-	if(!(t = (char*)realloc(p->buf, new_size)))
+	FJSON_STAT_INC(printbuf_reallocs);
+	if(!(t = (char*)_fjson_realloc(p->buf, new_size)))
 		return -1;
 	p->size = new_size;
 	p->buf = t;
@@ -132,6 +139,11 @@ void printbuf_memappend_char(struct printbuf *p, const char c)
 	p->buf[p->bpos++]= c;
 }
 
+int printbuf_reserve(struct printbuf *const p, const int size)
+{
+	return printbuf_extend(p, size);
+}
+
 void printbuf_terminate_string(struct printbuf *const p)
 {
 	if (p->size <= p->bpos + 1) {
@@ -247,7 +259,7 @@ void printbuf_reset(struct printbuf *p)
 void printbuf_free(struct printbuf *p)
 {
 	if(p) {
-		free(p->buf);
-		free(p);
+		_fjson_free(p->buf);
+		_fjson_free(p);
 	}
 }
@@ -27,6 +27,10 @@ struct printbuf {
 extern struct printbuf*
 printbuf_new(void);
 
+/* same, but with the given initial size; 0 means the global default */
+extern struct printbuf*
+printbuf_new_size(int size);
+
 /* As an optimization, printbuf_memappend_fast is defined as a macro
  * that handles copying data if the buffer is large enough; otherwise
  * it invokes printbuf_memappend_real() which performs the heavy
@@ -58,6 +62,14 @@ void printbuf_terminate_string(struct printbuf *const p);
 
 #define printbuf_length(p) ((p)->bpos)
 
+/**
+ * Make sure the buffer can hold at least size bytes (including the
+ * terminating NUL), so that no reallocations are needed while it is
+ * filled. Returns -1 if out of memory.
+ */
+extern int
+printbuf_reserve(struct printbuf *p, int size);
+
 /**
  * Set len bytes of the buffer to charvalue, starting at offset offset.
  * Similar to calling memset(x, charvalue, len);
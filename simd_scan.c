@@ -0,0 +1,539 @@
+/*
+ * Copyright (c) 2026 Adiscon GmbH
+ * Rainer Gerhards <rgerhards@adiscon.com>
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See COPYING for details.
+ *
+ */
+
+/* SIMD byte scanners
+ *
+ * Long string values dominate typical log data, and looking at them one
+ * byte at a time is where most of the parse time goes. The kernels here
+ * check a full vector of bytes with a few compares and then use a
+ * bit mask to locate the first hit. We have SSE2 (always present on
+ * x86-64), AVX2 (selected at runtime if the CPU supports it) and NEON
+ * (always present on aarch64) versions. The scalar loops are used on
+ * all other platforms, if SIMD is disabled via --disable-simd, and to
+ * process the tail of a buffer that is too short for a full vector.
+ * All loads are unaligned ones, so we never touch memory outside the
+ * buffer.
+ */
+#include "config.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "alloc.h"
+#include "simd_scan.h"
+
+#if defined(ENABLE_SIMD) && defined(__SSE2__)
+#	define SCAN_SSE2 1
+#	include <emmintrin.h>
+#	if defined(HAVE_BUILTIN_CPU_SUPPORTS)
+#		define SCAN_AVX2 1
+#		include <immintrin.h>
+#	endif
+#elif defined(ENABLE_SIMD) && defined(__aarch64__) && defined(__ARM_NEON)
+#	define SCAN_NEON 1
+#	include <arm_neon.h>
+#endif
+
+typedef const char *(scan_str_fn)(const char *p, const char *end, char c1, char c2);
+typedef const char *(skip_ws_fn)(const char *p, const char *end);
+/* set bit n of the masks if p[n] is a quote, a backslash or one of
+ * "{}[]:,", for the 64 bytes at p
+ */
+typedef void (classify_fn)(const char *p, uint64_t *quote, uint64_t *bslash, uint64_t *op);
+
+
+/* portable versions */
+
+/* the string scanners check for c1, c2, backslash and control chars */
+static const char *
+scan_str_scalar(const char *p, const char *const end, const char c1, const char c2)
+{
+	for ( ; p < end ; ++p) {
+		const unsigned char c = (unsigned char) *p;
+		if (c == (unsigned char) c1 || c == (unsigned char) c2 || c == '\\' || c < 0x20)
+			break;
+	}
+	return p;
+}
+
+static const char *
+skip_ws_scalar(const char *p, const char *const end)
+{
+	while (p < end && FJSON_IS_WS(*p))
+		++p;
+	return p;
+}
+
+#if !defined(SCAN_SSE2) && !defined(SCAN_NEON)
+/* '[' and '{' as well as ']' and '}' only differ in bit 0x20 */
+static void
+classify_scalar(const char *const p, uint64_t *const quote, uint64_t *const bslash,
+	uint64_t *const op)
+{
+	uint64_t q = 0, b = 0, o = 0;
+	int i;
+	for (i = 0 ; i < 64 ; ++i) {
+		const unsigned char c = (unsigned char) p[i];
+		const uint64_t bit = (uint64_t) 1 << i;
+		if (c == '"')
+			q |= bit;
+		else if (c == '\\')
+			b |= bit;
+		else if ((c | 0x20) == '{' || (c | 0x20) == '}' || c == ':' || c == ',')
+			o |= bit;
+	}
+	*quote = q;
+	*bslash = b;
+	*op = o;
+}
+#endif
+
+
+#ifdef SCAN_SSE2
+static inline const char * __attribute__((always_inline))
+scan_str_sse2(const char *p, const char *const end, const char c1, const char c2)
+{
+	const __m128i vc1 = _mm_set1_epi8(c1);
+	const __m128i vc2 = _mm_set1_epi8(c2);
+	const __m128i vbslash = _mm_set1_epi8('\\');
+	const __m128i vctl = _mm_set1_epi8(0x1f);
+	while (end - p >= 16) {
+		const __m128i v = _mm_loadu_si128((const __m128i *) p);
+		/* unsigned v <= 0x1f is done as min(v, 0x1f) == v */
+		const __m128i hit = _mm_or_si128(
+			_mm_or_si128(_mm_cmpeq_epi8(v, vc1), _mm_cmpeq_epi8(v, vc2)),
+			_mm_or_si128(_mm_cmpeq_epi8(v, vbslash), _mm_cmpeq_epi8(_mm_min_epu8(v, vctl), v)));
+		const unsigned mask = (unsigned) _mm_movemask_epi8(hit);
+		if (mask != 0)
+			return p + __builtin_ctz(mask);
+		p += 16;
+	}
+	return scan_str_scalar(p, end, c1, c2);
+}
+
+static inline const char * __attribute__((always_inline))
+skip_ws_sse2(const char *p, const char *const end)
+{
+	const __m128i vspace = _mm_set1_epi8(' ');
+	const __m128i vtab = _mm_set1_epi8('\t');
+	const __m128i vrange = _mm_set1_epi8('\r' - '\t');
+	while (end - p >= 16) {
+		const __m128i v = _mm_loadu_si128((const __m128i *) p);
+		const __m128i d = _mm_sub_epi8(v, vtab);
+		const __m128i ws = _mm_or_si128(_mm_cmpeq_epi8(v, vspace),
+			_mm_cmpeq_epi8(_mm_min_epu8(d, vrange), d));
+		const unsigned mask = ~(unsigned) _mm_movemask_epi8(ws) & 0xffff;
+		if (mask != 0)
+			return p + __builtin_ctz(mask);
+		p += 16;
+	}
+	return skip_ws_scalar(p, end);
+}
+
+static void
+classify_sse2(const char *const p, uint64_t *const quote, uint64_t *const bslash,
+	uint64_t *const op)
+{
+	const __m128i vquote = _mm_set1_epi8('"');
+	const __m128i vbslash = _mm_set1_epi8('\\');
+	const __m128i vcase = _mm_set1_epi8(0x20);
+	const __m128i vopen = _mm_set1_epi8('{');
+	const __m128i vclose = _mm_set1_epi8('}');
+	const __m128i vcolon = _mm_set1_epi8(':');
+	const __m128i vcomma = _mm_set1_epi8(',');
+	uint64_t q = 0, b = 0, o = 0;
+	int i;
+	for (i = 0 ; i < 64 ; i += 16) {
+		const __m128i v = _mm_loadu_si128((const __m128i *) (p + i));
+		const __m128i vl = _mm_or_si128(v, vcase);
+		const __m128i ops = _mm_or_si128(
+			_mm_or_si128(_mm_cmpeq_epi8(vl, vopen), _mm_cmpeq_epi8(vl, vclose)),
+			_mm_or_si128(_mm_cmpeq_epi8(v, vcolon), _mm_cmpeq_epi8(v, vcomma)));
+		q |= (uint64_t) (unsigned) _mm_movemask_epi8(_mm_cmpeq_epi8(v, vquote)) << i;
+		b |= (uint64_t) (unsigned) _mm_movemask_epi8(_mm_cmpeq_epi8(v, vbslash)) << i;
+		o |= (uint64_t) (unsigned) _mm_movemask_epi8(ops) << i;
+	}
+	*quote = q;
+	*bslash = b;
+	*op = o;
+}
+#endif /* SCAN_SSE2 */
+
+
+#ifdef SCAN_AVX2
+static const char * __attribute__((target("avx2")))
+scan_str_avx2(const char *p, const char *const end, const char c1, const char c2)
+{
+	const __m256i vc1 = _mm256_set1_epi8(c1);
+	const __m256i vc2 = _mm256_set1_epi8(c2);
+	const __m256i vbslash = _mm256_set1_epi8('\\');
+	const __m256i vctl = _mm256_set1_epi8(0x1f);
+	while (end - p >= 32) {
+		const __m256i v = _mm256_loadu_si256((const __m256i *) p);
+		const __m256i hit = _mm256_or_si256(
+			_mm256_or_si256(_mm256_cmpeq_epi8(v, vc1), _mm256_cmpeq_epi8(v, vc2)),
+			_mm256_or_si256(_mm256_cmpeq_epi8(v, vbslash),
+				_mm256_cmpeq_epi8(_mm256_min_epu8(v, vctl), v)));
+		const unsigned mask = (unsigned) _mm256_movemask_epi8(hit);
+		if (mask != 0)
+			return p + __builtin_ctz(mask);
+		p += 32;
+	}
+	/* the SSE2 tail is inlined, so it is VEX-encoded as well and the
+	 * compiler clears the upper register halves on return. Called out
+	 * of line, it would run with them dirty: GCC does not emit
+	 * vzeroupper before a tail call.
+	 */
+	return scan_str_sse2(p, end, c1, c2);
+}
+
+static const char * __attribute__((target("avx2")))
+skip_ws_avx2(const char *p, const char *const end)
+{
+	const __m256i vspace = _mm256_set1_epi8(' ');
+	const __m256i vtab = _mm256_set1_epi8('\t');
+	const __m256i vrange = _mm256_set1_epi8('\r' - '\t');
+	while (end - p >= 32) {
+		const __m256i v = _mm256_loadu_si256((const __m256i *) p);
+		const __m256i d = _mm256_sub_epi8(v, vtab);
+		const __m256i ws = _mm256_or_si256(_mm256_cmpeq_epi8(v, vspace),
+			_mm256_cmpeq_epi8(_mm256_min_epu8(d, vrange), d));
+		const unsigned mask = ~(unsigned) _mm256_movemask_epi8(ws);
+		if (mask != 0)
+			return p + __builtin_ctz(mask);
+		p += 32;
+	}
+	return skip_ws_sse2(p, end);
+}
+
+static void __attribute__((target("avx2")))
+classify_avx2(const char *const p, uint64_t *const quote, uint64_t *const bslash,
+	uint64_t *const op)
+{
+	const __m256i vquote = _mm256_set1_epi8('"');
+	const __m256i vbslash = _mm256_set1_epi8('\\');
+	const __m256i vcase = _mm256_set1_epi8(0x20);
+	const __m256i vopen = _mm256_set1_epi8('{');
+	const __m256i vclose = _mm256_set1_epi8('}');
+	const __m256i vcolon = _mm256_set1_epi8(':');
+	const __m256i vcomma = _mm256_set1_epi8(',');
+	uint64_t q = 0, b = 0, o = 0;
+	int i;
+	for (i = 0 ; i < 64 ; i += 32) {
+		const __m256i v = _mm256_loadu_si256((const __m256i *) (p + i));
+		const __m256i vl = _mm256_or_si256(v, vcase);
+		const __m256i ops = _mm256_or_si256(
+			_mm256_or_si256(_mm256_cmpeq_epi8(vl, vopen), _mm256_cmpeq_epi8(vl, vclose)),
+			_mm256_or_si256(_mm256_cmpeq_epi8(v, vcolon), _mm256_cmpeq_epi8(v, vcomma)));
+		q |= (uint64_t) (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, vquote)) << i;
+		b |= (uint64_t) (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, vbslash)) << i;
+		o |= (uint64_t) (uint32_t) _mm256_movemask_epi8(ops) << i;
+	}
+	*quote = q;
+	*bslash = b;
+	*op = o;
+}
+#endif /* SCAN_AVX2 */
+
+
+#ifdef SCAN_NEON
+/* NEON has no movemask; narrowing each 16 bit lane by 4 bits gives
+ * a 64 bit value with one nibble per input byte.
+ */
+static inline uint64_t
+neon_nibble_mask(const uint8x16_t hit)
+{
+	return vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(hit), 4)), 0);
+}
+
+static const char *
+scan_str_neon(const char *p, const char *const end, const char c1, const char c2)
+{
+	const uint8x16_t vc1 = vdupq_n_u8((uint8_t) c1);
+	const uint8x16_t vc2 = vdupq_n_u8((uint8_t) c2);
+	const uint8x16_t vbslash = vdupq_n_u8('\\');
+	const uint8x16_t vctl = vdupq_n_u8(0x20);
+	while (end - p >= 16) {
+		const uint8x16_t v = vld1q_u8((const uint8_t *) p);
+		const uint8x16_t hit = vorrq_u8(vorrq_u8(vceqq_u8(v, vc1), vceqq_u8(v, vc2)),
+			vorrq_u8(vceqq_u8(v, vbslash), vcltq_u8(v, vctl)));
+		const uint64_t mask = neon_nibble_mask(hit);
+		if (mask != 0)
+			return p + (__builtin_ctzll(mask) >> 2);
+		p += 16;
+	}
+	return scan_str_scalar(p, end, c1, c2);
+}
+
+static const char *
+skip_ws_neon(const char *p, const char *const end)
+{
+	const uint8x16_t vspace = vdupq_n_u8(' ');
+	const uint8x16_t vtab = vdupq_n_u8('\t');
+	const uint8x16_t vrange = vdupq_n_u8('\r' - '\t');
+	while (end - p >= 16) {
+		const uint8x16_t v = vld1q_u8((const uint8_t *) p);
+		const uint8x16_t ws = vorrq_u8(vceqq_u8(v, vspace), vcleq_u8(vsubq_u8(v, vtab), vrange));
+		const uint64_t mask = ~neon_nibble_mask(ws);
+		if (mask != 0)
+			return p + (__builtin_ctzll(mask) >> 2);
+		p += 16;
+	}
+	return skip_ws_scalar(p, end);
+}
+
+/* one bit per byte for 64 bytes: weight the bytes of each vector by
+ * their position within 8 and add them up pairwise
+ */
+static inline uint64_t
+neon_bitmask64(const uint8x16_t m0, const uint8x16_t m1, const uint8x16_t m2, const uint8x16_t m3)
+{
+	static const uint8_t weights[16] = { 1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128 };
+	const uint8x16_t w = vld1q_u8(weights);
+	uint8x16_t sum = vpaddq_u8(vpaddq_u8(vandq_u8(m0, w), vandq_u8(m1, w)),
+		vpaddq_u8(vandq_u8(m2, w), vandq_u8(m3, w)));
+	sum = vpaddq_u8(sum, sum);
+	return vgetq_lane_u64(vreinterpretq_u64_u8(sum), 0);
+}
+
+static void
+classify_neon(const char *const p, uint64_t *const quote, uint64_t *const bslash,
+	uint64_t *const op)
+{
+	const uint8x16_t vquote = vdupq_n_u8('"');
+	const uint8x16_t vbslash = vdupq_n_u8('\\');
+	const uint8x16_t vcase = vdupq_n_u8(0x20);
+	const uint8x16_t vopen = vdupq_n_u8('{');
+	const uint8x16_t vclose = vdupq_n_u8('}');
+	const uint8x16_t vcolon = vdupq_n_u8(':');
+	const uint8x16_t vcomma = vdupq_n_u8(',');
+	uint8x16_t q[4], b[4], o[4];
+	int i;
+	for (i = 0 ; i < 4 ; ++i) {
+		const uint8x16_t v = vld1q_u8((const uint8_t *) p + 16 * i);
+		const uint8x16_t vl = vorrq_u8(v, vcase);
+		q[i] = vceqq_u8(v, vquote);
+		b[i] = vceqq_u8(v, vbslash);
+		o[i] = vorrq_u8(vorrq_u8(vceqq_u8(vl, vopen), vceqq_u8(vl, vclose)),
+			vorrq_u8(vceqq_u8(v, vcolon), vceqq_u8(v, vcomma)));
+	}
+	*quote = neon_bitmask64(q[0], q[1], q[2], q[3]);
+	*bslash = neon_bitmask64(b[0], b[1], b[2], b[3]);
+	*op = neon_bitmask64(o[0], o[1], o[2], o[3]);
+}
+#endif /* SCAN_NEON */
+
+
+/* runtime selection
+ *
+ * The function pointers initially point to resolvers, which select the
+ * best implementation on first call. If multiple threads do this
+ * concurrently, they all store the same value, so this is harmless.
+ */
+static scan_str_fn scan_str_resolve;
+static skip_ws_fn skip_ws_resolve;
+static classify_fn classify_resolve;
+static scan_str_fn *scan_str_impl = scan_str_resolve;
+static skip_ws_fn *skip_ws_impl = skip_ws_resolve;
+static classify_fn *classify_impl = classify_resolve;
+
+static void
+select_impl(void)
+{
+#if defined(SCAN_AVX2)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		scan_str_impl = scan_str_avx2;
+		skip_ws_impl = skip_ws_avx2;
+		classify_impl = classify_avx2;
+		return;
+	}
+#endif
+#if defined(SCAN_SSE2)
+	scan_str_impl = scan_str_sse2;
+	skip_ws_impl = skip_ws_sse2;
+	classify_impl = classify_sse2;
+#elif defined(SCAN_NEON)
+	scan_str_impl = scan_str_neon;
+	skip_ws_impl = skip_ws_neon;
+	classify_impl = classify_neon;
+#else
+	scan_str_impl = scan_str_scalar;
+	skip_ws_impl = skip_ws_scalar;
+	classify_impl = classify_scalar;
+#endif
+}
+
+static const char *
+scan_str_resolve(const char *const p, const char *const end, const char c1, const char c2)
+{
+	select_impl();
+	return scan_str_impl(p, end, c1, c2);
+}
+
+static const char *
+skip_ws_resolve(const char *const p, const char *const end)
+{
+	select_impl();
+	return skip_ws_impl(p, end);
+}
+
+static void
+classify_resolve(const char *const p, uint64_t *const quote, uint64_t *const bslash,
+	uint64_t *const op)
+{
+	select_impl();
+	classify_impl(p, quote, bslash, op);
+}
+
+const char *
+_fjson_scan_str(const char *const p, const char *const end, const char quote)
+{
+	return scan_str_impl(p, end, quote, quote);
+}
+
+const char *
+_fjson_scan_escape(const char *const p, const char *const end)
+{
+	return scan_str_impl(p, end, '"', '/');
+}
+
+const char *
+_fjson_simd_skip_ws(const char *const p, const char *const end)
+{
+	return skip_ws_impl(p, end);
+}
+
+
+/* structural index
+ *
+ * Like simdjson's stage one: we classify 64 bytes at a time into bit
+ * masks, drop the quotes that are escaped, and get the bytes inside of
+ * strings as the prefix XOR of the quote mask. Backslashes are rare, so
+ * we resolve their runs one by one rather than with carry arithmetic.
+ */
+
+struct index_state {
+	uint64_t esc_carry;	/**< bit 0: the next block starts with an escaped byte */
+	uint64_t in_str;	/**< all ones if the next block starts inside of a string */
+};
+
+/* the bytes escaped by a backslash */
+static inline uint64_t
+escaped_bytes(uint64_t bslash, struct index_state *const st)
+{
+	uint64_t escaped = st->esc_carry;
+	bslash &= ~escaped;
+	st->esc_carry = 0;
+	while (bslash != 0) {
+		const uint64_t bit = bslash & (~bslash + 1);
+		escaped |= bit << 1;
+		st->esc_carry |= bit >> 63;
+		bslash &= ~(bit | bit << 1);
+	}
+	return escaped;
+}
+
+/* bit n is set if there is an odd number of bits up to and including n */
+static inline uint64_t
+prefix_xor(uint64_t m)
+{
+	m ^= m << 1;
+	m ^= m << 2;
+	m ^= m << 4;
+	m ^= m << 8;
+	m ^= m << 16;
+	m ^= m << 32;
+	return m;
+}
+
+/* classify the block at buf + blk, of which only len bytes are data */
+static inline void
+index_classify(const char *const buf, const size_t blk, const size_t len,
+	uint64_t *const quote, uint64_t *const bslash, uint64_t *const op)
+{
+	if (len == 64) {
+		classify_impl(buf + blk, quote, bslash, op);
+	} else {
+		char tail[64];
+		memset(tail, ' ', sizeof(tail));
+		memcpy(tail, buf + blk, len);
+		classify_impl(tail, quote, bslash, op);
+	}
+}
+
+static void
+index_start(struct index_state *const st, const char *const buf, const size_t start,
+	const int in_str)
+{
+	size_t i = start;
+	while (i > 0 && buf[i - 1] == '\\')
+		--i;
+	st->esc_carry = (start - i) & 1;
+	st->in_str = in_str ? ~(uint64_t) 0 : 0;
+}
+
+int
+_fjson_index_range(const char *const buf, const size_t start, const size_t stop,
+	int *const in_str, struct _fjson_index *const ix)
+{
+	struct index_state st;
+	size_t blk;
+
+	index_start(&st, buf, start, *in_str);
+	for (blk = start ; blk < stop ; blk += 64) {
+		const size_t len = (stop - blk < 64) ? stop - blk : 64;
+		uint64_t quote, bslash, op, in, bits;
+		uint32_t *pos;
+		size_t n;
+
+		if (ix->size - ix->n < 64) {
+			const size_t size = (ix->size < 1024) ? 1024 : ix->size * 2;
+			uint32_t *const p = _fjson_realloc(ix->pos, size * sizeof(uint32_t));
+			if (p == NULL)
+				return -1;
+			ix->pos = p;
+			ix->size = size;
+		}
+		index_classify(buf, blk, len, &quote, &bslash, &op);
+		quote &= ~escaped_bytes(bslash, &st);
+		in = prefix_xor(quote) ^ st.in_str;
+		st.in_str = (uint64_t) ((int64_t) in >> 63);
+		bits = (op & ~in) | quote;
+
+		pos = ix->pos;
+		n = ix->n;
+		while (bits != 0) {
+			pos[n++] = (uint32_t) (blk + __builtin_ctzll(bits));
+			bits &= bits - 1;
+		}
+		ix->n = n;
+	}
+	*in_str = st.in_str != 0;
+	return 0;
+}
+
+int
+_fjson_index_quote_parity(const char *const buf, const size_t start, const size_t stop)
+{
+	struct index_state st;
+	uint64_t parity = 0;
+	size_t blk;
+
+	index_start(&st, buf, start, 0);
+	for (blk = start ; blk < stop ; blk += 64) {
+		const size_t len = (stop - blk < 64) ? stop - blk : 64;
+		uint64_t quote, bslash, op;
+		index_classify(buf, blk, len, &quote, &bslash, &op);
+		quote &= ~escaped_bytes(bslash, &st);
+		parity ^= quote;
+	}
+	return __builtin_popcountll(parity) & 1;
+}
@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 2026 Adiscon GmbH
+ * Rainer Gerhards <rgerhards@adiscon.com>
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See COPYING for details.
+ *
+ */
+
+#ifndef _fj_simd_scan_h_
+#define _fj_simd_scan_h_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* The scanners below search [p, end) and return a pointer to the first
+ * byte of interest, or end if there is none. They never read outside
+ * of the given range. Depending on the platform and CPU, they process
+ * 16 or 32 bytes at a time; which implementation is used is decided on
+ * first call.
+ */
+
+/* first byte that is quote, a backslash or a control character (< 0x20,
+ * this includes NUL)
+ */
+extern const char *_fjson_scan_str(const char *p, const char *end, char quote);
+
+/* first byte that must be escaped when serializing: '"', '\\', '/' or
+ * a control character
+ */
+extern const char *_fjson_scan_escape(const char *p, const char *end);
+
+/* first byte that is not JSON whitespace (as isspace() in the C locale) */
+extern const char *_fjson_simd_skip_ws(const char *p, const char *end);
+
+/* The structural index of a JSON text, as used by the two-stage parser:
+ * the offsets of all quotes that start or end a string, and of all of
+ * "{}[]:," outside of strings, in ascending order.
+ */
+struct _fjson_index {
+	uint32_t *pos;
+	size_t n;
+	size_t size;
+};
+
+/* Append the index entries for buf[start, stop) to ix, whose pos array
+ * is grown as needed. *in_str tells whether buf[start] is inside of a
+ * string and is updated for buf[stop]. Whether buf[start] is escaped is
+ * taken from the backslashes before it. Offsets must fit in 32 bits.
+ * Returns -1 if out of memory.
+ */
+extern int _fjson_index_range(const char *buf, size_t start, size_t stop,
+	int *in_str, struct _fjson_index *ix);
+
+/* the number of unescaped quotes in buf[start, stop), modulo 2; so if
+ * buf[start] is outside of a string, whether buf[stop] is inside of one
+ */
+extern int _fjson_index_quote_parity(const char *buf, size_t start, size_t stop);
+
+#define FJSON_IS_WS(c) ((c) == ' ' || (unsigned)((unsigned char)(c) - '\t') <= ('\r' - '\t'))
+
+/* most whitespace runs are a single space, so check inline first */
+static inline const char *
+_fjson_skip_ws(const char *const p, const char *const end)
+{
+	if (p == end || !FJSON_IS_WS(*p))
+		return p;
+	return _fjson_simd_skip_ws(p + 1, end);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2026 Adiscon GmbH
+ * Rainer Gerhards <rgerhards@adiscon.com>
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See COPYING for details.
+ *
+ */
+
+/* instrumentation counters
+ *
+ * Meant to find out where memory and time go, including in production:
+ * a thread can read its counters before and after handling a document
+ * and so spot pathological input. As this costs a little on the hot
+ * paths, the counters are only compiled in with --enable-stats.
+ */
+#include "config.h"
+
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#include "json.h"
+#include "stats.h"
+
+#ifdef ENABLE_STATS
+#	ifdef HAVE_TLS
+__thread struct fjson_stats _fjson_stats;
+#	else
+struct fjson_stats _fjson_stats;
+#	endif
+
+uint64_t
+_fjson_stats_now(void)
+{
+#ifdef HAVE_CLOCK_GETTIME
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000u + ts.tv_nsec;
+#else
+	return 0;
+#endif
+}
+#endif
+
+int
+fjson_global_get_stats(struct fjson_stats *const stats)
+{
+#ifdef ENABLE_STATS
+	*stats = _fjson_stats;
+	return 0;
+#else
+	memset(stats, 0, sizeof(*stats));
+	errno = ENOTSUP;
+	return -1;
+#endif
+}
+
+void
+fjson_global_reset_stats(void)
+{
+#ifdef ENABLE_STATS
+	memset(&_fjson_stats, 0, sizeof(_fjson_stats));
+#endif
+}
@@ -0,0 +1,48 @@
+/*
+ * Copyright (c) 2026 Adiscon GmbH
+ * Rainer Gerhards <rgerhards@adiscon.com>
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See COPYING for details.
+ *
+ */
+
+#ifndef _fj_stats_h_
+#define _fj_stats_h_
+
+#include <stdint.h>
+#include "json.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Counters for fjson_global_get_stats(). They only exist if configured
+ * with --enable-stats; otherwise, the macros below do nothing (but still
+ * evaluate their argument, so that variables that only feed counters do
+ * not cause warnings). The counters are per thread if the compiler
+ * supports thread-local storage, so updating them needs no atomics.
+ */
+#ifdef ENABLE_STATS
+#	ifdef HAVE_TLS
+extern __thread struct fjson_stats _fjson_stats;
+#	else
+extern struct fjson_stats _fjson_stats;
+#	endif
+#	define FJSON_STAT_INC(field) ((void) ++_fjson_stats.field)
+#	define FJSON_STAT_ADD(field, n) ((void) (_fjson_stats.field += (n)))
+#	define FJSON_STAT_MAX(field, n) ((void) (_fjson_stats.field < (uint64_t) (n) \
+		? (_fjson_stats.field = (n)) : 0))
+/* monotonic time in ns, for the timing counters */
+extern uint64_t _fjson_stats_now(void);
+#else
+#	define FJSON_STAT_INC(field) ((void) 0)
+#	define FJSON_STAT_ADD(field, n) ((void) (n))
+#	define FJSON_STAT_MAX(field, n) ((void) (n))
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
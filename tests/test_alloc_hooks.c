@@ -0,0 +1,179 @@
+/* libfastjson testbench tool
+ *
+ * checks fjson_global_set_allocator(): all memory of the library must
+ * come from the installed functions and be given back to them. Also
+ * checks fjson_global_get_stats() for whichever way the library has
+ * been configured.
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See COPYING for details.
+ *
+ */
+#include "config.h"
+
+#include "../json.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#define CHK(x) if (!(x)) { \
+	printf("%s:%d: unexpected result with '%s'\n", \
+		__FILE__, __LINE__, #x); \
+	exit(1); \
+}
+
+/* every block carries a header with a magic value, so that we notice
+ * memory that did not come from us
+ */
+#define MAGIC 0x666a736fu
+struct hdr {
+	unsigned magic;
+	size_t size;
+	long double align;
+};
+
+static long nmalloc;
+static long nrealloc;
+static long nfree;
+static long live;
+
+static void *
+t_malloc(const size_t size)
+{
+	struct hdr *const h = malloc(sizeof(struct hdr) + size);
+	if (h == NULL)
+		return NULL;
+	h->magic = MAGIC;
+	h->size = size;
+	++nmalloc;
+	++live;
+	return h + 1;
+}
+
+static void *
+t_realloc(void *const ptr, const size_t size)
+{
+	struct hdr *h;
+	if (ptr == NULL)
+		return t_malloc(size);
+	h = (struct hdr *) ptr - 1;
+	CHK(h->magic == MAGIC);
+	if ((h = realloc(h, sizeof(struct hdr) + size)) == NULL)
+		return NULL;
+	h->size = size;
+	++nrealloc;
+	return h + 1;
+}
+
+static void
+t_free(void *const ptr)
+{
+	struct hdr *h;
+	if (ptr == NULL)
+		return;
+	h = (struct hdr *) ptr - 1;
+	CHK(h->magic == MAGIC);
+	h->magic = 0;
+	++nfree;
+	--live;
+	free(h);
+}
+
+static void
+exercise(void)
+{
+	const char *const text = "{\"a\": [1, 2.50, \"a string long enough to be stored on its own\"],"
+		" \"b\": {\"c\": null, \"d\": true}, \"e\": \"\\u00e4\"}";
+	struct fjson_tokener *const tok = fjson_tokener_new();
+	struct fjson_object *jso, *copy, *v;
+	int i;
+
+	CHK(tok != NULL);
+	jso = fjson_tokener_parse_ex(tok, text, strlen(text));
+	CHK(jso != NULL);
+	fjson_tokener_free(tok);
+
+	for (i = 0 ; i < 100 ; ++i) {
+		char key[16];
+		snprintf(key, sizeof(key), "k%d", i);
+		fjson_object_object_add(jso, key, fjson_object_new_string(key));
+	}
+	CHK(fjson_object_object_get_ex(jso, "k42", &v));
+	CHK(strlen(fjson_object_to_json_string_ext(jso, FJSON_TO_STRING_PRETTY)) > 1000);
+	CHK(fjson_object_deep_copy(jso, &copy) == 0);
+	fjson_object_object_del(copy, "a");
+	CHK(fjson_object_to_json_string(copy) != NULL);
+	fjson_object_put(copy);
+	fjson_object_put(jso);
+}
+
+static void
+test_hooks(void)
+{
+	fjson_global_set_allocator(t_malloc, t_realloc, t_free);
+	exercise();
+	CHK(nmalloc > 0);
+	CHK(nrealloc > 0);
+	CHK(nfree > 0);
+	CHK(live == 0);
+
+	/* memory from the pool goes through the hooks, too */
+	fjson_global_set_pool_limit(1024 * 1024);
+	exercise();
+	CHK(live > 0);
+	fjson_global_pool_trim();
+	CHK(live == 0);
+	fjson_global_set_pool_limit(0);
+
+	/* back to libc */
+	fjson_global_set_allocator(NULL, NULL, NULL);
+	nmalloc = 0;
+	exercise();
+	CHK(nmalloc == 0);
+}
+
+static void
+test_stats(void)
+{
+	struct fjson_stats st;
+	struct fjson_object *jso;
+
+	fjson_global_reset_stats();
+	errno = 0;
+	if (fjson_global_get_stats(&st) != 0) {
+		/* built without --enable-stats */
+		CHK(errno == ENOTSUP);
+		CHK(st.allocs == 0 && st.nodes == 0);
+		return;
+	}
+	CHK(st.allocs == 0 && st.frees == 0 && st.nodes == 0 && st.lookups == 0);
+
+	jso = fjson_tokener_parse("{\"a\": 1, \"b\": [2, 3]}");
+	CHK(jso != NULL);
+	CHK(fjson_object_object_get_ex(jso, "b", NULL));
+	fjson_object_put(jso);
+	CHK(fjson_global_get_stats(&st) == 0);
+	CHK(st.nodes >= 2);	/* small ints may be shared or packed */
+	CHK(st.frees > 0 && st.allocs >= st.frees);
+	CHK(st.bytes_parsed >= 21);
+	CHK(st.lookups >= 3);
+	CHK(st.lookup_probes >= st.lookups - 1);
+	CHK(st.lookup_probes_max >= 2);
+
+	fjson_global_reset_stats();
+	jso = fjson_object_new_string("x");
+	CHK(fjson_global_get_stats(&st) == 0);
+	CHK(st.nodes == 1 && st.bytes_parsed == 0);
+	fjson_object_put(jso);
+}
+
+int
+main(int __attribute__((unused)) argc, char __attribute__((unused)) **argv)
+{
+	test_hooks();
+	test_stats();
+	printf("OK\n");
+	return 0;
+}
@@ -0,0 +1,96 @@
+/* libfastjson testbench tool
+ *
+ * checks parsing into an arena, including objects large enough to
+ * need extra pages and a hash index as well as growing arrays.
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See COPYING for details.
+ *
+ */
+#include "config.h"
+
+#include "../json.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CHK(x) if (!(x)) { \
+	printf("%s:%d: unexpected result with '%s'\n", \
+		__FILE__, __LINE__, #x); \
+	exit(1); \
+}
+
+static const char *input =
+	"{ \"msg\": \"a string which is too long to be stored directly\",\n"
+	"  \"num\": 42, \"dbl\": 1.50, \"t\": true, \"f\": false, \"n\": null,\n"
+	"  \"nested\": { \"a\": [ 1, 2, 3 ], \"b\": { } } }";
+
+int main(int __attribute__((unused)) argc, char __attribute__((unused)) **argv)
+{
+	struct fjson_arena *arena;
+	struct fjson_tokener *tok;
+	struct fjson_object *jso, *val;
+	char buf[8192];
+	size_t len;
+	int i, round;
+
+	CHK((arena = fjson_arena_new(0)) != NULL);
+	CHK((tok = fjson_tokener_new()) != NULL);
+	fjson_tokener_set_arena(tok, arena);
+
+	jso = fjson_tokener_parse_ex(tok, input, strlen(input));
+	CHK(jso != NULL);
+	printf("%s\n", fjson_object_to_json_string(jso));
+	CHK(fjson_object_object_get_ex(jso, "MSG", &val) == 0);
+	CHK(fjson_object_object_get_ex(jso, "msg", &val));
+	CHK(fjson_object_get_string_len(val) == 48);
+
+	/* objects added later on must also work and not leak */
+	fjson_object_object_add(jso, "added-later", fjson_object_new_string("heap"));
+	fjson_object_object_del(jso, "num");
+	printf("%s\n", fjson_object_to_json_string_ext(jso, FJSON_TO_STRING_PLAIN));
+	fjson_object_put(jso); /* needed because of the heap member */
+	fjson_tokener_reset(tok);
+	fjson_arena_reset(arena);
+
+	/* large objects and arrays, several rounds on the same arena */
+	len = 0;
+	len += snprintf(buf + len, sizeof(buf) - len, "{");
+	for (i = 0 ; i < 100 ; ++i)
+		len += snprintf(buf + len, sizeof(buf) - len, "\"key-%d\": %d, ", i, i);
+	len += snprintf(buf + len, sizeof(buf) - len, "\"arr\": [");
+	for (i = 0 ; i < 200 ; ++i)
+		len += snprintf(buf + len, sizeof(buf) - len, "%s\"elem-%d\"", i ? "," : "", i);
+	len += snprintf(buf + len, sizeof(buf) - len, "] }");
+	for (round = 0 ; round < 10 ; ++round) {
+		jso = fjson_tokener_parse_ex(tok, buf, len);
+		CHK(jso != NULL);
+		CHK(fjson_object_object_length(jso) == 101);
+		CHK(fjson_object_object_get_ex(jso, "key-77", &val));
+		CHK(fjson_object_get_int(val) == 77);
+		CHK(fjson_object_object_get_ex(jso, "arr", &val));
+		CHK(fjson_object_array_length(val) == 200);
+		CHK(!strcmp(fjson_object_get_string(fjson_object_array_get_idx(val, 199)), "elem-199"));
+		if (round % 2) { /* heap member, requires put below */
+			fjson_object_array_add(val, fjson_object_new_int(round));
+			CHK(fjson_object_array_length(val) == 201);
+		}
+		if (round == 0)
+			printf("%.60s...\n", fjson_object_to_json_string(jso));
+		fjson_tokener_reset(tok);
+		if (round % 2)
+			fjson_object_put(jso);
+		fjson_arena_reset(arena);
+	}
+
+	/* errors must not leave anything behind */
+	jso = fjson_tokener_parse_ex(tok, "{ \"a\": [ 1, 2, ", 15);
+	CHK(jso == NULL);
+	fjson_tokener_reset(tok);
+
+	fjson_tokener_free(tok);
+	fjson_arena_free(arena);
+	printf("OK\n");
+	return 0;
+}
@@ -0,0 +1,95 @@
+/* libfastjson testbench tool
+ *
+ * checks the bulk array functions: presized arrays, reserving room,
+ * adding many elements at once, shrinking and ranged deletes.
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See COPYING for details.
+ *
+ */
+#include "config.h"
+
+#include "../json.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CHK(x) if (!(x)) { \
+	printf("%s:%d: unexpected result with '%s'\n", \
+		__FILE__, __LINE__, #x); \
+	exit(1); \
+}
+
+#define NVALS 1000
+
+int
+main(int __attribute__((unused)) argc, char __attribute__((unused)) **argv)
+{
+	struct fjson_object *vals[NVALS];
+	struct fjson_object *arr, *obj, *held;
+	int i;
+
+	/* presized array, filled in one go */
+	arr = fjson_object_new_array_ex(NVALS);
+	CHK(arr != NULL);
+	CHK(fjson_object_array_length(arr) == 0);
+	for (i = 0 ; i < NVALS ; ++i)
+		vals[i] = fjson_object_new_int(1000 + i);
+	CHK(fjson_object_array_add_many(arr, vals, NVALS) == 0);
+	CHK(fjson_object_array_length(arr) == NVALS);
+	for (i = 0 ; i < NVALS ; ++i)
+		CHK(fjson_object_get_int(fjson_object_array_get_idx(arr, i)) == 1000 + i);
+	CHK(fjson_object_array_add_many(arr, vals, -1) == -1);
+	CHK(fjson_object_array_add_many(arr, vals, 0) == 0);
+	CHK(fjson_object_array_length(arr) == NVALS);
+
+	/* ranged deletes */
+	held = fjson_object_get(fjson_object_array_get_idx(arr, 10));
+	CHK(fjson_object_array_del_range(arr, 10, 980) == 0);
+	CHK(fjson_object_array_length(arr) == 20);
+	CHK(fjson_object_get_int(fjson_object_array_get_idx(arr, 9)) == 1009);
+	CHK(fjson_object_get_int(fjson_object_array_get_idx(arr, 10)) == 1990);
+	CHK(fjson_object_array_get_idx(arr, 20) == NULL);
+	CHK(fjson_object_get_int(held) == 1010);
+	fjson_object_put(held);
+	CHK(fjson_object_array_del_range(arr, 15, 6) == -1);
+	CHK(fjson_object_array_del_range(arr, -1, 2) == -1);
+	CHK(fjson_object_array_del_range(arr, 0, -1) == -1);
+	CHK(fjson_object_array_length(arr) == 20);
+	CHK(fjson_object_array_del_range(arr, 20, 0) == 0);
+	CHK(fjson_object_array_del_range(arr, 15, 5) == 0);
+	fjson_object_array_del_idx(arr, 0);
+	CHK(fjson_object_array_shrink_to_fit(arr) == 0);
+	printf("%s\n", fjson_object_to_json_string(arr));
+	CHK(fjson_object_array_add(arr, fjson_object_new_string("after shrink")) == 0);
+	CHK(fjson_object_array_del_range(arr, 0, fjson_object_array_length(arr) - 1) == 0);
+	printf("%s\n", fjson_object_to_json_string(arr));
+	CHK(fjson_object_array_del_range(arr, 0, 1) == 0);
+	CHK(fjson_object_array_shrink_to_fit(arr) == 0);
+	CHK(fjson_object_array_length(arr) == 0);
+	printf("%s\n", fjson_object_to_json_string(arr));
+	fjson_object_put(arr);
+
+	/* reserve, then grow past it; cached output must follow changes */
+	obj = fjson_object_new_object();
+	arr = fjson_object_new_array_ex(0);
+	fjson_object_object_add(obj, "a", arr);
+	CHK(fjson_object_array_reserve(arr, 3) == 0);
+	CHK(fjson_object_array_reserve(arr, 1) == 0);
+	vals[0] = fjson_object_new_string("x");
+	vals[1] = NULL;
+	vals[2] = fjson_object_new_boolean(1);
+	CHK(fjson_object_array_add_many(arr, vals, 3) == 0);
+	printf("%s\n", fjson_object_to_json_string(obj));
+	vals[0] = fjson_object_new_object();
+	vals[1] = fjson_object_new_double(2.5);
+	CHK(fjson_object_array_add_many(arr, vals, 2) == 0);
+	printf("%s\n", fjson_object_to_json_string(obj));
+	CHK(fjson_object_array_del_range(arr, 1, 3) == 0);
+	printf("%s\n", fjson_object_to_json_string(obj));
+	fjson_object_put(obj);
+
+	printf("OK\n");
+	return 0;
+}
@@ -0,0 +1,229 @@
+/* libfastjson testbench tool
+ *
+ * checks fjson_object_dump_cbor() and fjson_cbor_parse(): trees must
+ * survive a round trip unchanged (including the original text of
+ * doubles and packed arrays), known encodings must be produced and
+ * accepted, and malformed input must be rejected.
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See COPYING for details.
+ *
+ */
+#include "config.h"
+
+#include "../json.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#define CHK(x) if (!(x)) { \
+	printf("%s:%d: unexpected result with '%s'\n", \
+		__FILE__, __LINE__, #x); \
+	exit(1); \
+}
+
+struct sink {
+	unsigned char data[4096];
+	size_t len;
+};
+
+static size_t
+sink_write(void *const ptr, const char *const buffer, const size_t size)
+{
+	struct sink *const s = ptr;
+	CHK(s->len + size <= sizeof(s->data));
+	memcpy(s->data + s->len, buffer, size);
+	s->len += size;
+	return size;
+}
+
+/* encode jso and compare with the expected bytes */
+static void
+chk_encoding(struct fjson_object *const jso, const char *const expected, const size_t len)
+{
+	struct sink s;
+	s.len = 0;
+	CHK(fjson_object_dump_cbor(jso, sink_write, &s) == len);
+	CHK(s.len == len);
+	CHK(memcmp(s.data, expected, len) == 0);
+	fjson_object_put(jso);
+}
+
+/* decode the given bytes and compare the JSON text of the result */
+static void
+chk_decoding(const char *const cbor, const size_t len, const char *const json)
+{
+	struct fjson_object *jso = NULL;
+	size_t used = 0;
+	CHK(fjson_cbor_parse(cbor, len, &jso, &used) == 0);
+	CHK(used == len);
+	CHK(strcmp(fjson_object_to_json_string_ext(jso, FJSON_TO_STRING_PLAIN), json) == 0);
+	fjson_object_put(jso);
+}
+
+static void
+chk_invalid(const char *const cbor, const size_t len)
+{
+	struct fjson_object *jso = (struct fjson_object *) 1;
+	errno = 0;
+	CHK(fjson_cbor_parse(cbor, len, &jso, NULL) == -1);
+	CHK(errno == EINVAL);
+	CHK(jso == NULL);
+}
+
+static void
+test_roundtrip(void)
+{
+	static const int64_t ints[] = { 0, -1, 1000000, INT64_MIN, INT64_MAX };
+	static const double dbls[] = { 0.5, -2.25, 1e300 };
+	const char *const text = "{\"s\": \"short\", \"l\": \"a string that is long enough"
+		" to be stored outside of the node, with \\u00e4 and \\u0000 in it\","
+		" \"i\": [0, 23, 24, 255, 256, 65536, 4294967296, -1, -24, -25,"
+		" -9223372036854775808, 9223372036854775807], \"d\": [1.50, 0.1, -1e-3, 1.0e10],"
+		" \"b\": [true, false, null], \"o\": {\"\": {}, \"x\": []}}";
+	struct fjson_object *const src = fjson_tokener_parse(text);
+	struct fjson_object *jso = NULL, *v, *sv;
+	struct sink s;
+	size_t used;
+	int count;
+
+	CHK(src != NULL);
+	fjson_object_object_add(src, "pi", fjson_object_new_array_int64(ints, 5));
+	fjson_object_object_add(src, "pd", fjson_object_new_array_double(dbls, 3));
+	fjson_object_object_add(src, "pe", fjson_object_new_array_int64(NULL, 0));
+	fjson_object_object_add(src, "dn", fjson_object_new_double(0.1));
+
+	s.len = 0;
+	CHK(fjson_object_dump_cbor(src, sink_write, &s) == s.len);
+	CHK(fjson_cbor_parse(s.data, s.len, &jso, &used) == 0);
+	CHK(used == s.len);
+	CHK(strcmp(fjson_object_to_json_string(jso), fjson_object_to_json_string(src)) == 0);
+
+	/* 1.50 keeps its text */
+	CHK(fjson_object_object_get_ex(jso, "d", &v));
+	CHK(strcmp(fjson_object_to_json_string(fjson_object_array_get_idx(v, 0)), "1.50") == 0);
+	CHK(fjson_object_get_double(fjson_object_array_get_idx(v, 1)) == 0.1);
+	CHK(fjson_object_object_get_ex(jso, "dn", &v));
+	CHK(fjson_object_get_double(v) == 0.1);
+
+	/* the string with a NUL in it */
+	CHK(fjson_object_object_get_ex(jso, "l", &v));
+	CHK(fjson_object_object_get_ex(src, "l", &sv));
+	CHK(fjson_object_get_string_len(v) == fjson_object_get_string_len(sv));
+	CHK(memcmp(fjson_object_get_string(v), fjson_object_get_string(sv),
+		fjson_object_get_string_len(v)) == 0);
+
+	/* packed arrays stay packed */
+	CHK(fjson_object_object_get_ex(jso, "pi", &v));
+	CHK(fjson_object_array_get_int64_data(v, &count) != NULL);
+	CHK(count == 5 && memcmp(fjson_object_array_get_int64_data(v, NULL), ints, sizeof(ints)) == 0);
+	CHK(fjson_object_object_get_ex(jso, "pd", &v));
+	CHK(fjson_object_array_get_double_data(v, &count) != NULL);
+	CHK(count == 3 && memcmp(fjson_object_array_get_double_data(v, NULL), dbls, sizeof(dbls)) == 0);
+	CHK(fjson_object_object_get_ex(jso, "pe", &v));
+	CHK(fjson_object_array_length(v) == 0);
+
+	/* every truncated prefix is rejected */
+	for (used = 0 ; used < s.len ; ++used)
+		chk_invalid((const char *) s.data, used);
+
+	fjson_object_put(jso);
+	fjson_object_put(src);
+}
+
+static void
+test_encoding(void)
+{
+	static const int64_t ints[] = { 1, -2 };
+	chk_encoding(NULL, "\xf6", 1);
+	chk_encoding(fjson_object_new_boolean(1), "\xf5", 1);
+	chk_encoding(fjson_object_new_boolean(0), "\xf4", 1);
+	chk_encoding(fjson_object_new_int(0), "\x00", 1);
+	chk_encoding(fjson_object_new_int(23), "\x17", 1);
+	chk_encoding(fjson_object_new_int(24), "\x18\x18", 2);
+	chk_encoding(fjson_object_new_int(1000), "\x19\x03\xe8", 3);
+	chk_encoding(fjson_object_new_int(-1000), "\x39\x03\xe7", 3);
+	chk_encoding(fjson_object_new_int64(1000000000000), "\x1b\x00\x00\x00\xe8\xd4\xa5\x10\x00", 9);
+	chk_encoding(fjson_object_new_double(1.5), "\xfa\x3f\xc0\x00\x00", 5);
+	chk_encoding(fjson_object_new_double(1.1), "\xfb\x3f\xf1\x99\x99\x99\x99\x99\x9a", 9);
+	chk_encoding(fjson_object_new_double_s(1.5, "1.50"), "\xd9\x66\x6a\x82\xfa\x3f\xc0\x00\x00\x64" "1.50", 14);
+	chk_encoding(fjson_object_new_string("IETF"), "\x64IETF", 5);
+	chk_encoding(fjson_object_new_array(), "\x80", 1);
+	chk_encoding(fjson_tokener_parse("{\"a\": [1, \"b\"]}"), "\xa1\x61" "a\x82\x01\x61" "b", 7);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	chk_encoding(fjson_object_new_array_int64(ints, 2), "\xd8\x4b\x50"
+		"\x00\x00\x00\x00\x00\x00\x00\x01\xff\xff\xff\xff\xff\xff\xff\xfe", 19);
+#else
+	chk_encoding(fjson_object_new_array_int64(ints, 2), "\xd8\x4f\x50"
+		"\x01\x00\x00\x00\x00\x00\x00\x00\xfe\xff\xff\xff\xff\xff\xff\xff", 19);
+#endif
+}
+
+static void
+test_decoding(void)
+{
+	struct fjson_object *jso;
+	size_t used;
+
+	/* examples from RFC 8949, appendix A */
+	chk_decoding("\x3b\x7f\xff\xff\xff\xff\xff\xff\xff", 9, "-9223372036854775808");
+	chk_decoding("\xf9\x3c\x00", 3, "1.0");
+	chk_decoding("\xf9\x7b\xff", 3, "65504.0");
+	chk_decoding("\xf9\x00\x01", 3, "5.960464477539063e-08");
+	chk_decoding("\xf9\xc4\x00", 3, "-4.0");
+	chk_decoding("\xf7", 1, "null");
+	chk_decoding("\xc1\x1a\x51\x4b\x67\xb0", 6, "1363896240");
+	chk_decoding("\x44\x01\x02\x03\x04", 5, "\"\\u0001\\u0002\\u0003\\u0004\"");
+	chk_decoding("\x9f\x01\x82\x02\x03\x9f\x04\x05\xff\xff", 10, "[1,[2,3],[4,5]]");
+	chk_decoding("\xbf\x61" "a\x01\x61" "b\x9f\x02\x03\xff\xff", 11, "{\"a\":1,\"b\":[2,3]}");
+	/* duplicate keys: the last one wins */
+	chk_decoding("\xa2\x61" "a\x01\x61" "a\x02", 7, "{\"a\":2}");
+	/* big unsigned and negative numbers become doubles */
+	chk_decoding("\x1b\xff\xff\xff\xff\xff\xff\xff\xff", 9, "1.8446744073709552e+19");
+	/* typed arrays: uint8, sint16 big endian, float32 little endian */
+	chk_decoding("\xd8\x40\x43\x01\x02\xff", 6, "[1,2,255]");
+	chk_decoding("\xd8\x49\x44\xff\xfe\x01\x00", 7, "[-2,256]");
+	chk_decoding("\xd8\x55\x48\x00\x00\xc0\x3f\x00\x00\x20\xc1", 11, "[1.5,-10.0]");
+
+	/* a sequence of items */
+	CHK(fjson_cbor_parse("\x01\x02", 2, &jso, &used) == 0);
+	CHK(used == 1 && fjson_object_get_int(jso) == 1);
+	fjson_object_put(jso);
+	CHK(fjson_cbor_parse("\xf6", 1, &jso, &used) == 0);
+	CHK(jso == NULL && used == 1);
+
+	chk_invalid("", 0);
+	chk_invalid("\x1c", 1);			/* reserved additional info */
+	chk_invalid("\x1f", 1);			/* indefinite integer */
+	chk_invalid("\x7f\x61" "a\xff", 4);	/* indefinite string */
+	chk_invalid("\xff", 1);			/* lone break */
+	chk_invalid("\xf0", 1);			/* unassigned simple value */
+	chk_invalid("\xa1\x01\x02", 3);		/* key is not a string */
+	chk_invalid("\xa1\x61\x00\x01", 4);	/* key with NUL */
+	chk_invalid("\x9b\x7f\xff\xff\xff\xff\xff\xff\xff", 9); /* huge length */
+	chk_invalid("\xd8\x4f\x43\x01\x02\x03", 6); /* typed array with partial element */
+	chk_invalid("\xd8\x57\x50\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00", 19); /* float128 */
+	chk_invalid("\xd9\x66\x6a\x82\x01\x61" "1", 7); /* number text without double */
+	chk_invalid("\xd9\x66\x6a\xfa\x3f\xc0\x00\x00", 8); /* number text not an array */
+	{
+		/* nesting too deep */
+		char deep[2000];
+		memset(deep, 0x81, sizeof(deep) - 1);
+		deep[sizeof(deep) - 1] = 0x01;
+		chk_invalid(deep, sizeof(deep));
+		CHK(fjson_cbor_parse(deep + 1000, 1000, &jso, NULL) == 0);
+		fjson_object_put(jso);
+	}
+}
+
+int
+main(int __attribute__((unused)) argc, char __attribute__((unused)) **argv)
+{
+	test_roundtrip();
+	test_encoding();
+	test_decoding();
+	printf("OK\n");
+	return 0;
+}
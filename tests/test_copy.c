@@ -0,0 +1,164 @@
+/* libfastjson testbench tool
+ *
+ * checks fjson_object_deep_copy() and fjson_object_copy_containers(): copies
+ * must have the same content as the original, and modifications of one
+ * tree must never show up in the other. Run under valgrind or ASan to
+ * catch reference counting errors.
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See COPYING for details.
+ *
+ */
+#include "config.h"
+
+#include "../json.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CHK(x) if (!(x)) { \
+	printf("%s:%d: unexpected result with '%s'\n", \
+		__FILE__, __LINE__, #x); \
+	exit(1); \
+}
+
+static const char *const input =
+	"{\"host\": \"h1\", \"n\": 1234, \"d\": 0.10, \"t\": true, \"z\": null,"
+	" \"msg\": {\"a\": {\"b\": [1, \"x\", {\"c\": 3}]}, \"k\": \"v\"},"
+	" \"list\": [[1, 2], {\"e\": []}]}";
+
+/* member k of jso, which must exist */
+static struct fjson_object *
+member(struct fjson_object *const jso, const char *const k)
+{
+	struct fjson_object *v = NULL;
+	CHK(fjson_object_object_get_ex(jso, k, &v));
+	return v;
+}
+
+/* name of the first member of jso */
+static const char *
+first_key(struct fjson_object *const jso)
+{
+	const struct fjson_object_iterator it = fjson_object_iter_begin(jso);
+	return fjson_object_iter_peek_name(&it);
+}
+
+static void
+chk_same(struct fjson_object *const a, struct fjson_object *const b)
+{
+	CHK(!strcmp(fjson_object_to_json_string(a), fjson_object_to_json_string(b)));
+}
+
+int
+main(int __attribute__((unused)) argc, char __attribute__((unused)) **argv)
+{
+	struct fjson_object *orig, *copy, *copy2, *sub;
+	struct fjson_tokener *tok;
+	struct fjson_arena *arena;
+	char expected[512];
+	int64_t samples[] = { 5, 6, 7 };
+
+	/* deep copies */
+	orig = fjson_tokener_parse(input);
+	CHK(orig != NULL);
+	fjson_object_object_add(orig, "p", fjson_object_new_array_int64(samples, 3));
+	CHK(fjson_object_deep_copy(orig, &copy) == 0);
+	CHK(copy != orig);
+	chk_same(orig, copy);
+	CHK(member(orig, "msg") != member(copy, "msg"));
+	CHK(first_key(copy) == first_key(orig)); /* keys never change */
+	fjson_object_object_add(member(member(copy, "msg"), "a"), "new", fjson_object_new_int(1));
+	fjson_object_array_add_int64(member(copy, "p"), 8);
+	printf("%s\n", fjson_object_to_json_string(orig));
+	printf("%s\n", fjson_object_to_json_string(copy));
+	fjson_object_put(copy);
+	CHK(fjson_object_deep_copy(NULL, &copy) == 0 && copy == NULL);
+
+	/* copy-on-write: the copy is changed deep down */
+	strcpy(expected, fjson_object_to_json_string(orig));
+	sub = member(orig, "msg");
+	CHK(fjson_object_copy_containers(orig, &copy) == 0);
+	chk_same(orig, copy);
+	/* containers are private to each tree, scalars are shared, and
+	 * lookups in either tree do not change anything
+	 */
+	CHK(member(copy, "msg") != sub && member(orig, "msg") == sub);
+	CHK(member(copy, "host") == member(orig, "host"));
+	CHK(member(copy, "msg") == member(copy, "msg"));
+	CHK(first_key(copy) == first_key(orig));
+	CHK(first_key(member(copy, "msg")) == first_key(sub));
+	/* a shared scalar added elsewhere leaves the original alone */
+	fjson_object_object_add(member(copy, "msg"), "host",
+		fjson_object_get(member(copy, "host")));
+	CHK(!strcmp(fjson_object_to_json_string(orig), expected));
+	fjson_object_object_del(member(copy, "msg"), "host");
+	CHK(fjson_object_array_get_idx(member(copy, "list"), 0)
+		!= fjson_object_array_get_idx(member(orig, "list"), 0));
+	/* so values reached by iterating may be modified as well */
+	{
+		struct fjson_object_iterator it = fjson_object_iter_begin(copy);
+		const struct fjson_object_iterator end = fjson_object_iter_end(copy);
+		for ( ; !fjson_object_iter_equal(&it, &end) ; fjson_object_iter_next(&it)) {
+			if (strcmp(fjson_object_iter_peek_name(&it), "list") == 0)
+				fjson_object_array_add(fjson_object_iter_peek_value(&it), NULL);
+		}
+	}
+	CHK(fjson_object_array_length(member(copy, "list")) == 3);
+	CHK(!strcmp(fjson_object_to_json_string(orig), expected));
+	fjson_object_array_del_idx(member(copy, "list"), 2);
+	chk_same(orig, copy);
+	sub = member(member(member(copy, "msg"), "a"), "b");
+	fjson_object_array_put_idx(sub, 1, fjson_object_new_string("changed"));
+	fjson_object_object_add(fjson_object_array_get_idx(sub, 2), "d", NULL);
+	fjson_object_object_del(member(copy, "msg"), "k");
+	printf("%s\n", fjson_object_to_json_string(copy));
+	CHK(!strcmp(fjson_object_to_json_string(orig), expected));
+
+	/* ... and the original as well, with another copy around */
+	CHK(fjson_object_copy_containers(copy, &copy2) == 0);
+	fjson_object_array_add(member(orig, "list"), fjson_object_new_string("orig"));
+	fjson_object_array_add(member(fjson_object_array_get_idx(member(orig, "list"), 1), "e"),
+		fjson_object_new_string("orig e"));
+	fjson_object_array_add_int64(member(orig, "p"), 9);
+	printf("%s\n", fjson_object_to_json_string(orig));
+	printf("%s\n", fjson_object_to_json_string(copy));
+	chk_same(copy, copy2);
+
+	/* the copies do not depend on the original */
+	fjson_object_put(orig);
+	fjson_object_array_add(member(copy2, "list"), fjson_object_new_string("copy2"));
+	sub = fjson_object_array_get_idx(member(copy2, "list"), 0);
+	fjson_object_array_del_idx(sub, 0);
+	printf("%s\n", fjson_object_to_json_string(copy));
+	printf("%s\n", fjson_object_to_json_string(copy2));
+	CHK(fjson_object_get_array(member(copy, "list")) != NULL);
+	fjson_object_put(copy);
+	fjson_object_put(copy2);
+
+	/* scalars are just shared */
+	orig = fjson_object_new_string("s");
+	CHK(fjson_object_copy_containers(orig, &copy) == 0 && copy == orig);
+	fjson_object_put(copy);
+	fjson_object_put(orig);
+
+	/* trees in an arena are copied out of it */
+	CHK((arena = fjson_arena_new(0)) != NULL);
+	CHK((tok = fjson_tokener_new()) != NULL);
+	fjson_tokener_set_arena(tok, arena);
+	orig = fjson_tokener_parse_ex(tok, input, strlen(input));
+	CHK(orig != NULL);
+	CHK(fjson_object_copy_containers(orig, &copy) == 0);
+	CHK(fjson_object_deep_copy(orig, &copy2) == 0);
+	fjson_object_put(orig);
+	fjson_tokener_free(tok);
+	fjson_arena_free(arena);
+	chk_same(copy, copy2);
+	printf("%s\n", fjson_object_to_json_string(copy));
+	fjson_object_put(copy);
+	fjson_object_put(copy2);
+
+	printf("OK\n");
+	return 0;
+}
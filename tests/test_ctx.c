@@ -0,0 +1,95 @@
+/* libfastjson testbench tool
+ *
+ * checks contexts: objects and tokeners created with one must use its
+ * key comparison mode, independent of the process-wide setting, while
+ * all others keep following the latter.
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See COPYING for details.
+ *
+ */
+#include "config.h"
+
+#include "../json.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CHK(x) if (!(x)) { \
+	printf("%s:%d: unexpected result with '%s'\n", \
+		__FILE__, __LINE__, #x); \
+	exit(1); \
+}
+
+static int
+has(struct fjson_object *const jso, const char *const key)
+{
+	return fjson_object_object_get_ex(jso, key, NULL);
+}
+
+int main(int __attribute__((unused)) argc, char __attribute__((unused)) **argv)
+{
+	struct fjson_ctx *const nocase = fjson_ctx_new();
+	struct fjson_ctx *const dflt = fjson_ctx_new();
+	struct fjson_tokener *tok;
+	struct fjson_object *a, *b, *c, *parsed;
+	static const char input[] = "{ \"Key\": { \"Inner\": 1 } }";
+	char key[16];
+	int i;
+
+	CHK(nocase != NULL && dflt != NULL);
+	fjson_ctx_set_case_sensitive(nocase, 0);
+	fjson_ctx_set_printbuf_initial_size(nocase, 1024);
+
+	a = fjson_object_new_object_ctx(nocase);
+	b = fjson_object_new_object();
+	c = fjson_object_new_object_ctx(dflt);
+	fjson_object_object_add(a, "Key", fjson_object_new_int(1));
+	fjson_object_object_add(b, "Key", fjson_object_new_int(2));
+	fjson_object_object_add(c, "Key", fjson_object_new_int(3));
+	CHK(has(a, "key") && !has(b, "key") && !has(c, "key"));
+
+	/* the process-wide setting only affects objects without own setting */
+	fjson_global_do_case_sensitive_comparison(0);
+	CHK(has(a, "key") && has(b, "key") && has(c, "key"));
+	fjson_global_do_case_sensitive_comparison(1);
+	fjson_object_put(b);
+
+	/* replacing honors the mode, too */
+	fjson_object_object_add(a, "KEY", fjson_object_new_int(4));
+	CHK(fjson_object_object_length(a) == 1);
+	printf("%s\n", fjson_object_to_json_string(a));
+
+	/* same for large objects, which use the hash index */
+	for (i = 0 ; i < 100 ; ++i) {
+		snprintf(key, sizeof(key), "Member%d", i);
+		fjson_object_object_add(a, key, fjson_object_new_int(i));
+	}
+	CHK(has(a, "member42") && has(a, "MEMBER99") && !has(a, "member100"));
+
+	/* tokeners pass the mode on to all objects they create */
+	tok = fjson_tokener_new_ctx(FJSON_TOKENER_DEFAULT_DEPTH, nocase);
+	CHK(tok != NULL);
+	fjson_ctx_free(nocase); /* settings have been taken over */
+	parsed = fjson_tokener_parse_ex(tok, input, sizeof(input));
+	CHK(parsed != NULL);
+	CHK(has(parsed, "KEY"));
+	CHK(fjson_object_object_get_ex(parsed, "KEY", &b) && has(b, "inner"));
+	printf("%s\n", fjson_object_to_json_string(parsed));
+	fjson_object_put(parsed);
+	fjson_tokener_free(tok);
+
+	tok = fjson_tokener_new_ctx(FJSON_TOKENER_DEFAULT_DEPTH, NULL);
+	parsed = fjson_tokener_parse_ex(tok, input, sizeof(input));
+	CHK(parsed != NULL && !has(parsed, "key"));
+	fjson_object_put(parsed);
+	fjson_tokener_free(tok);
+
+	fjson_object_put(a);
+	fjson_object_put(c);
+	fjson_ctx_free(dflt);
+	fjson_ctx_free(NULL);
+	printf("OK\n");
+	return 0;
+}
@@ -0,0 +1,90 @@
+/* libfastjson testbench tool
+ *
+ * checks the double to string conversion: output format for a set
+ * of well-known values and round-trip correctness for a large number
+ * of random bit patterns.
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See COPYING for details.
+ *
+ */
+#include "config.h"
+
+#include "../json.h"
+#include "../numconv.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#define NUM_RANDOM 200000
+
+#define CHK(x) if (!(x)) { \
+	printf("%s:%d: unexpected result with '%s'\n", \
+		__FILE__, __LINE__, #x); \
+	exit(1); \
+}
+
+static const double values[] = {
+	0.0, 1.0, -1.0, 0.1, 0.3, 1.5, -2.25, 100.0, 1234.5678, 123456789.123,
+	1e15, 1e16, 9007199254740993.0, 1e17, 1.5e17, 1e21, 1e100, 1e-4, 1e-5,
+	0.00012345, 1.2345e-5, 5e-324, 2.2250738585072014e-308,
+	1.7976931348623157e308, 3.141592653589793, 2.718281828459045
+};
+
+static uint64_t rnd_state = 88172645463325252ULL;
+
+static uint64_t
+rnd(void)
+{
+	rnd_state ^= rnd_state << 13;
+	rnd_state ^= rnd_state >> 7;
+	rnd_state ^= rnd_state << 17;
+	return rnd_state;
+}
+
+int main(int __attribute__((unused)) argc, char __attribute__((unused)) **argv)
+{
+	char buf[FJSON_NUMCONV_BUFSIZE];
+	char ref[64];
+	struct fjson_object *jso;
+	size_t i;
+	double d, back;
+	uint64_t u;
+	int len;
+
+	for (i = 0 ; i < sizeof(values) / sizeof(values[0]) ; ++i) {
+		jso = fjson_object_new_double(values[i]);
+		printf("%s\n", fjson_object_to_json_string(jso));
+		fjson_object_put(jso);
+	}
+	jso = fjson_object_new_array();
+	fjson_object_array_add(jso, fjson_object_new_double(-0.0));
+	fjson_object_array_add(jso, fjson_object_new_double(NAN));
+	fjson_object_array_add(jso, fjson_object_new_double(INFINITY));
+	fjson_object_array_add(jso, fjson_object_new_double(-INFINITY));
+	printf("%s\n", fjson_object_to_json_string_ext(jso, FJSON_TO_STRING_NOZERO));
+	fjson_object_put(jso);
+
+	for (i = 0 ; i < NUM_RANDOM ; ++i) {
+		u = rnd();
+		memcpy(&d, &u, sizeof(d));
+		if (isnan(d) || isinf(d))
+			continue;
+		len = _fjson_dtoa(d, buf);
+		CHK(len == (int) strlen(buf));
+		back = strtod(buf, NULL);
+		if (memcmp(&back, &d, sizeof(d))) {
+			printf("round-trip failed: %.17g -> %s\n", d, buf);
+			return 1;
+		}
+		/* never longer than what printf needs */
+		snprintf(ref, sizeof(ref), "%.17g", d);
+		CHK(len <= (int) strlen(ref) + 2);
+	}
+
+	printf("OK\n");
+	return 0;
+}
@@ -0,0 +1,145 @@
+/* libfastjson testbench tool
+ *
+ * checks fjson_object_dump_iov(): the concatenated iov entries must be
+ * the same text as fjson_object_to_json_string_ext(), and long string
+ * bodies must be referenced in place instead of copied.
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See COPYING for details.
+ *
+ */
+#include "config.h"
+
+#include "../json.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+
+#define CHK(x) if (!(x)) { \
+	printf("%s:%d: unexpected result with '%s'\n", \
+		__FILE__, __LINE__, #x); \
+	exit(1); \
+}
+
+struct sink {
+	char buf[65536];
+	size_t len;
+	int ncalls;
+	int maxcnt;
+	const char *watch;	/* count entries pointing here */
+	int nwatch;
+};
+
+static size_t
+writev_sink(void *ptr, const struct iovec *iov, int iovcnt)
+{
+	struct sink *const s = ptr;
+	size_t n = 0;
+	int i;
+	CHK(iovcnt > 0 && iovcnt <= 64);
+	for (i = 0 ; i < iovcnt ; ++i) {
+		CHK(iov[i].iov_len > 0);
+		CHK(s->len + iov[i].iov_len <= sizeof(s->buf));
+		memcpy(s->buf + s->len, iov[i].iov_base, iov[i].iov_len);
+		s->len += iov[i].iov_len;
+		n += iov[i].iov_len;
+		if (iov[i].iov_base == s->watch)
+			++s->nwatch;
+	}
+	++s->ncalls;
+	if (iovcnt > s->maxcnt)
+		s->maxcnt = iovcnt;
+	return n;
+}
+
+static void
+check(struct fjson_object *const jso, const int flags, char *const temp, const size_t size,
+	struct sink *const s)
+{
+	/* not via fjson_object_to_json_string_ext(), that would cache jso */
+	static char expected[65536];
+	size_t r;
+	CHK(fjson_object_to_json_string_into(jso, flags, expected, sizeof(expected)) < sizeof(expected));
+	s->len = 0;
+	s->ncalls = 0;
+	s->maxcnt = 0;
+	s->nwatch = 0;
+	if (temp == NULL)
+		r = fjson_object_dump_iov(jso, flags, writev_sink, s);
+	else
+		r = fjson_object_dump_iov_buffered(jso, flags, temp, size, writev_sink, s);
+	CHK(r == strlen(expected));
+	CHK(s->len == r);
+	CHK(memcmp(s->buf, expected, r) == 0);
+}
+
+static struct fjson_object *
+long_value(struct fjson_object *const jso)
+{
+	struct fjson_object *v;
+	CHK(fjson_object_object_get_ex(jso, "long", &v));
+	return v;
+}
+
+int main(int __attribute__((unused)) argc, char __attribute__((unused)) **argv)
+{
+	static struct sink s;
+	char longstr[1000];
+	char small[8];
+	struct fjson_object *jso, *obj, *arr;
+	int i;
+
+	memset(longstr, 'a', sizeof(longstr) - 1);
+	longstr[sizeof(longstr) - 1] = '\0';
+	jso = fjson_object_new_object();
+	fjson_object_object_add(jso, "short", fjson_object_new_string("text with \"quotes\""));
+	fjson_object_object_add(jso, "long", fjson_object_new_string(longstr));
+	fjson_object_object_add(jso, "num", fjson_object_new_int(42));
+	s.watch = fjson_object_get_string(long_value(jso));
+
+	check(jso, FJSON_TO_STRING_PLAIN, NULL, 0, &s);
+	CHK(s.nwatch == 1);
+	printf("plain: %d bytes in %d call(s), long string referenced\n", (int) s.len, s.ncalls);
+	check(jso, FJSON_TO_STRING_PRETTY, NULL, 0, &s);
+	CHK(s.nwatch == 1);
+	check(jso, FJSON_TO_STRING_PLAIN, small, sizeof(small), &s);
+	CHK(s.nwatch == 1);
+	printf("small temp buffer: %d bytes OK\n", (int) s.len);
+	check(jso, FJSON_TO_STRING_PLAIN, small, 0, &s);
+	printf("no temp buffer: %d bytes OK\n", (int) s.len);
+
+	/* more references than fit into one iov array */
+	arr = fjson_object_new_array();
+	for (i = 0 ; i < 50 ; ++i)
+		fjson_object_array_add(arr, fjson_object_get(long_value(jso)));
+	check(arr, FJSON_TO_STRING_SPACED, NULL, 0, &s);
+	CHK(s.nwatch == 50);
+	CHK(s.ncalls > 1);
+	printf("array: %d bytes, at most %d entries per call\n", (int) s.len, s.maxcnt);
+	fjson_object_put(arr);
+
+	/* cached output is referenced as a whole (jso itself does no longer
+	 * cache, as the long string has been shared)
+	 */
+	obj = fjson_object_new_object();
+	fjson_object_object_add(obj, "long", fjson_object_new_string(longstr));
+	arr = fjson_object_new_array();
+	fjson_object_array_add(arr, obj);
+	s.watch = fjson_object_to_json_string_ext(obj, FJSON_TO_STRING_PLAIN);
+	check(arr, FJSON_TO_STRING_PLAIN, NULL, 0, &s);
+	CHK(s.nwatch == 1);
+	s.watch = fjson_object_to_json_string_ext(arr, FJSON_TO_STRING_PLAIN);
+	check(arr, FJSON_TO_STRING_PLAIN, NULL, 0, &s);
+	CHK(s.nwatch == 1 && s.maxcnt == 1);
+	printf("cached output referenced\n");
+	fjson_object_put(arr);
+
+	check(NULL, FJSON_TO_STRING_PLAIN, NULL, 0, &s);
+	CHK(s.len == 4 && memcmp(s.buf, "null", 4) == 0);
+	fjson_object_put(jso);
+
+	printf("OK\n");
+	return 0;
+}
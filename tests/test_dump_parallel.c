@@ -0,0 +1,123 @@
+/* libfastjson testbench tool
+ *
+ * checks parallel serialization: fjson_object_dump_parallel() and
+ * fjson_object_to_json_string_parallel() must produce exactly the same
+ * text as the sequential functions, for all formatting flags and part
+ * counts.
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See COPYING for details.
+ *
+ */
+#include "config.h"
+
+#include "../json.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CHK(x) if (!(x)) { \
+	printf("%s:%d: unexpected result with '%s'\n", \
+		__FILE__, __LINE__, #x); \
+	exit(1); \
+}
+
+#define BUFSIZE (1024 * 1024)
+
+struct sink {
+	char *buf;
+	size_t len;
+};
+
+static size_t
+write_sink(void *ptr, const char *data, size_t size)
+{
+	struct sink *const s = ptr;
+	CHK(s->len + size <= BUFSIZE);
+	memcpy(s->buf + s->len, data, size);
+	s->len += size;
+	return size;
+}
+
+/* an executor that runs the tasks backwards, to catch order dependencies */
+static void
+backwards(void *const ctx, fjson_task_fn *const fn, void *const *const args, const int ntasks)
+{
+	int i;
+	++*(int *) ctx;
+	for (i = ntasks - 1 ; i >= 0 ; --i)
+		fn(args[i]);
+}
+
+static const int flags[] = {
+	FJSON_TO_STRING_PLAIN,
+	FJSON_TO_STRING_SPACED,
+	FJSON_TO_STRING_PRETTY,
+	FJSON_TO_STRING_PRETTY | FJSON_TO_STRING_PRETTY_TAB,
+	FJSON_TO_STRING_PRETTY | FJSON_TO_STRING_SPACED
+};
+
+static void
+check(struct fjson_object *const jso, const char *const what, int *const ncalls)
+{
+	static char expected[BUFSIZE];
+	struct sink s;
+	size_t f, len;
+	int nparts;
+
+	s.buf = malloc(BUFSIZE);
+	CHK(s.buf != NULL);
+	for (f = 0 ; f < sizeof(flags) / sizeof(flags[0]) ; ++f) {
+		len = fjson_object_to_json_string_into(jso, flags[f], expected, sizeof(expected));
+		CHK(len < sizeof(expected));
+		for (nparts = 0 ; nparts <= 40 ; nparts += (nparts < 10) ? 1 : 15) {
+			s.len = 0;
+			CHK(fjson_object_dump_parallel(jso, flags[f], nparts,
+				(nparts % 2) ? backwards : NULL, ncalls, write_sink, &s) == len);
+			CHK(s.len == len && memcmp(s.buf, expected, len) == 0);
+		}
+		CHK(strcmp(fjson_object_to_json_string_parallel(jso, flags[f], 4, backwards, ncalls),
+			expected) == 0);
+	}
+	printf("%s: %d bytes OK\n", what, (int) len);
+	free(s.buf);
+}
+
+int main(int __attribute__((unused)) argc, char __attribute__((unused)) **argv)
+{
+	struct fjson_object *arr, *obj, *small;
+	char key[32];
+	int i, ncalls = 0;
+
+	arr = fjson_object_new_array();
+	obj = fjson_object_new_object();
+	for (i = 0 ; i < 500 ; ++i) {
+		struct fjson_object *const ev = fjson_object_new_object();
+		fjson_object_object_add(ev, "id", fjson_object_new_int(i));
+		fjson_object_object_add(ev, "msg", fjson_object_new_string("some \"event\" text"));
+		fjson_object_object_add(ev, "tags", fjson_tokener_parse("[ 1, [ ], { } ]"));
+		fjson_object_array_add(arr, ev);
+		snprintf(key, sizeof(key), "k%d", i);
+		fjson_object_object_add(obj, key, (i % 3) ? fjson_object_new_double(i / 4.0) : NULL);
+	}
+	/* deleted members must not show up in any part */
+	fjson_object_object_del(obj, "k0");
+	fjson_object_object_del(obj, "k250");
+	check(arr, "array", &ncalls);
+	check(obj, "object", &ncalls);
+	CHK(ncalls > 0);
+
+	/* too small to be split, and scalars */
+	small = fjson_tokener_parse("[ 1, 2 ]");
+	check(small, "small", &ncalls);
+	fjson_object_put(small);
+	small = fjson_object_new_string("str");
+	check(small, "scalar", &ncalls);
+	fjson_object_put(small);
+
+	fjson_object_put(arr);
+	fjson_object_put(obj);
+	printf("OK\n");
+	return 0;
+}
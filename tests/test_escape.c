@@ -0,0 +1,105 @@
+/* libfastjson testbench tool
+ *
+ * checks string escaping of both serializers (to_json_string and
+ * dump) for every ASCII character at every position of a string,
+ * so that all code paths of the vectorized scanner are exercised.
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See COPYING for details.
+ *
+ */
+#include "config.h"
+
+#include "../json.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define STRLEN 70
+
+#define CHK(x) if (!(x)) { \
+	printf("%s:%d: unexpected result with '%s'\n", \
+		__FILE__, __LINE__, #x); \
+	exit(1); \
+}
+
+struct membuf {
+	char buf[1024];
+	size_t len;
+};
+
+static size_t
+write_membuf(void *ptr, const char *buffer, size_t size)
+{
+	struct membuf *const mb = (struct membuf *) ptr;
+	memcpy(mb->buf + mb->len, buffer, size);
+	mb->len += size;
+	mb->buf[mb->len] = '\0';
+	return size;
+}
+
+static void
+ref_escape(char *dst, const char *src)
+{
+	*dst++ = '"';
+	for ( ; *src ; ++src) {
+		switch (*src) {
+		case '\b': dst += sprintf(dst, "\\b"); break;
+		case '\n': dst += sprintf(dst, "\\n"); break;
+		case '\r': dst += sprintf(dst, "\\r"); break;
+		case '\t': dst += sprintf(dst, "\\t"); break;
+		case '\f': dst += sprintf(dst, "\\f"); break;
+		case '"': dst += sprintf(dst, "\\\""); break;
+		case '\\': dst += sprintf(dst, "\\\\"); break;
+		case '/': dst += sprintf(dst, "\\/"); break;
+		default:
+			if ((unsigned char)*src < 0x20)
+				dst += sprintf(dst, "\\u%04x", *src);
+			else
+				*dst++ = *src;
+		}
+	}
+	*dst++ = '"';
+	*dst = '\0';
+}
+
+int main(int __attribute__((unused)) argc, char __attribute__((unused)) **argv)
+{
+	char str[STRLEN + 1];
+	char expected[STRLEN * 6 + 3];
+	struct membuf mb;
+	struct fjson_object *jso;
+	int c, pos, len;
+
+	for (c = 1 ; c < 128 ; ++c) {
+		for (len = 1 ; len <= STRLEN ; len += 23) {
+			for (pos = 0 ; pos < len ; ++pos) {
+				memset(str, 'a', len);
+				str[len] = '\0';
+				str[pos] = (char) c;
+				ref_escape(expected, str);
+				jso = fjson_object_new_string(str);
+				CHK(jso != NULL);
+				CHK(!strcmp(fjson_object_to_json_string(jso), expected));
+				mb.len = 0;
+				CHK(fjson_object_dump(jso, write_membuf, &mb) == strlen(expected));
+				CHK(!strcmp(mb.buf, expected));
+				CHK(fjson_object_size(jso) == strlen(expected));
+				fjson_object_put(jso);
+			}
+		}
+	}
+
+	/* keys are escaped as well */
+	jso = fjson_object_new_object();
+	fjson_object_object_add(jso, "k/\"\x01", fjson_object_new_string("v\\\x1f"));
+	printf("%s\n", fjson_object_to_json_string(jso));
+	mb.len = 0;
+	fjson_object_dump(jso, write_membuf, &mb);
+	printf("%s\n", mb.buf);
+	fjson_object_put(jso);
+
+	printf("OK\n");
+	return 0;
+}
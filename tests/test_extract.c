@@ -0,0 +1,82 @@
+/* libfastjson testbench tool
+ *
+ * checks path-targeted extraction: nested paths, both path notations,
+ * paths sharing a prefix, skipping of all kinds of values and error
+ * handling for invalid input.
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See COPYING for details.
+ *
+ */
+#include "config.h"
+
+#include "../json.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CHK(x) if (!(x)) { \
+	printf("%s:%d: unexpected result with '%s'\n", \
+		__FILE__, __LINE__, #x); \
+	exit(1); \
+}
+
+static const char *input =
+	"{ \"skip\": { \"deep\": [ 1, { \"a\": \"}]\\\"\" }, [ [ ] ] ], \"s\": \"x\" },\n"
+	"  \"msg\": \"hello\", \"n\": -1.5e3, \"t\": true, \"nul\": null,\n"
+	"  \"a\": { \"b\": { \"c\": 42, \"d\": [ 1, 2 ] }, \"x\": \"y\" },\n"
+	"  \"k\\u0065y\": \"escaped key\", \"dup\": 1, \"dup\": 2 }";
+
+static void
+run(const char *const title, const char *const buf, const char *const *const paths,
+	const int npaths)
+{
+	struct fjson_object *values[16];
+	int i;
+	const int r = fjson_extract_paths(buf, -1, paths, npaths, values);
+	printf("%s: %d found\n", title, r);
+	for (i = 0 ; i < npaths ; ++i) {
+		printf("  %s = %s\n", paths[i], values[i] == NULL ? "(none)"
+			: fjson_object_to_json_string(values[i]));
+		fjson_object_put(values[i]);
+	}
+}
+
+int main(int __attribute__((unused)) argc, char __attribute__((unused)) **argv)
+{
+	static const char *const paths[] = {
+		"msg", "a.b.c", "$!a!b!d", "a.b", "a.x", "n", "t", "nul", "key",
+		"dup", "missing", "a.missing", "msg.sub", "skip.s"
+	};
+	static const char *const root[] = { "$!", "a.x" };
+	static const char *const single[] = { "a.b.c" };
+	struct fjson_object *values[1];
+
+	run("all", input, paths, sizeof(paths) / sizeof(paths[0]));
+	run("root", input, root, 2);
+
+	/* partial length: the text ends before "msg" */
+	{
+		struct fjson_object *v[1];
+		static const char *const p[] = { "msg" };
+		CHK(fjson_extract_paths(input, 20, p, 1, v) == -1);
+		CHK(v[0] == NULL);
+	}
+
+	/* values are returned even if the rest of the text is broken */
+	run("truncated", "{ \"a\": { \"b\": { \"c\": 1 } }, \"z\": [ 1", single, 1);
+
+	/* errors in the path leading to the value */
+	CHK(fjson_extract_paths("{ \"a\" 1 }", -1, single, 1, values) == -1);
+	CHK(fjson_extract_paths("{ \"a\": { \"b\": { \"c\": x } } }", -1, single, 1, values) == -1);
+	CHK(fjson_extract_paths("{ \"a\": , \"b\": 1 }", -1, single, 1, values) == -1);
+	CHK(values[0] == NULL);
+
+	/* non-object roots */
+	run("array root", "[ 1, 2 ]", single, 1);
+	run("number root", "42", root, 1);
+
+	printf("OK\n");
+	return 0;
+}
@@ -0,0 +1,116 @@
+/* libfastjson testbench tool
+ *
+ * checks fjson_object_from_fd() for regular files (which are mapped)
+ * and pipes (which are read in chunks), including inputs larger than
+ * the read buffer, a trailing top-level number and a start position
+ * that is not page aligned.
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See COPYING for details.
+ *
+ */
+#include "config.h"
+
+#include "../json.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define CHK(x) if (!(x)) { \
+	printf("%s:%d: unexpected result with '%s'\n", \
+		__FILE__, __LINE__, #x); \
+	exit(1); \
+}
+
+/* writes data to a temporary file, skips the first skip bytes and parses */
+static struct fjson_object *
+from_file(const char *const data, const size_t len, const long skip)
+{
+	FILE *const fp = tmpfile();
+	struct fjson_object *obj;
+	CHK(fp != NULL);
+	CHK(fwrite(data, 1, len, fp) == len);
+	CHK(fflush(fp) == 0);
+	CHK(lseek(fileno(fp), skip, SEEK_SET) == skip);
+	obj = fjson_object_from_fd(fileno(fp));
+	CHK(lseek(fileno(fp), 0, SEEK_CUR) == (off_t) len);
+	fclose(fp);
+	return obj;
+}
+
+/* the data must fit into the pipe buffer */
+static struct fjson_object *
+from_pipe(const char *const data, const size_t len)
+{
+	struct fjson_object *obj;
+	int fds[2];
+	CHK(pipe(fds) == 0);
+	CHK(write(fds[1], data, len) == (ssize_t) len);
+	close(fds[1]);
+	obj = fjson_object_from_fd(fds[0]);
+	close(fds[0]);
+	return obj;
+}
+
+static void
+check(const char *const what, struct fjson_object *const obj, const char *const expected)
+{
+	if (expected == NULL) {
+		CHK(obj == NULL);
+		printf("%s: NULL\n", what);
+		return;
+	}
+	CHK(obj != NULL);
+	CHK(strcmp(fjson_object_to_json_string_ext(obj, FJSON_TO_STRING_PLAIN), expected) == 0);
+	printf("%s: %.60s\n", what, expected);
+	fjson_object_put(obj);
+}
+
+int main(int __attribute__((unused)) argc, char __attribute__((unused)) **argv)
+{
+	static const char obj[] = " { \"a\": [ 1, 2.5, \"x\" ], \"b\": null }\n";
+	static const char obj_plain[] = "{\"a\":[1,2.5,\"x\"],\"b\":null}";
+	const size_t nelem = 4000;
+	char *big, *big_plain;
+	size_t i, len;
+
+	check("file", from_file(obj, strlen(obj), 0), obj_plain);
+	check("pipe", from_pipe(obj, strlen(obj)), obj_plain);
+	check("file number", from_file("12345", 5, 0), "12345");
+	check("pipe number", from_pipe("12345", 5), "12345");
+	check("file offset", from_file("xyz[true]", 9, 3), "[true]");
+	check("file empty", from_file("", 0, 0), NULL);
+	check("file invalid", from_file("{ \"a\": ", 7, 0), NULL);
+	check("pipe invalid", from_pipe("{ \"a\" ] }", 9), NULL);
+
+	/* larger than the read buffer and than a page */
+	big = malloc(nelem * 8 + 16);
+	big_plain = malloc(nelem * 8 + 16);
+	CHK(big != NULL && big_plain != NULL);
+	len = 0;
+	big[len++] = '[';
+	for (i = 0 ; i < nelem ; ++i)
+		len += sprintf(big + len, "%s%d", (i == 0) ? " " : ", ", (int) i);
+	big[len++] = ']';
+	big[len] = '\0';
+	strcpy(big_plain, big);
+	for (i = 0, len = 0 ; big[i] != '\0' ; ++i)
+		if (big[i] != ' ')
+			big_plain[len++] = big[i];
+	big_plain[len] = '\0';
+	len = strlen(big);
+	check("big file", from_file(big, len, 0), big_plain);
+	check("big pipe", from_pipe(big, len), big_plain);
+	/* start in the second page */
+	memmove(big + 5000, big, len + 1);
+	memset(big, ' ', 5000);
+	memcpy(big + 4097, "\"s\" ", 4);
+	check("big file offset", from_file(big, len + 5000, 4097), "\"s\"");
+	free(big);
+	free(big_plain);
+
+	printf("OK\n");
+	return 0;
+}
@@ -0,0 +1,102 @@
+/* libfastjson testbench tool
+ *
+ * checks the integer to string conversion against printf for the
+ * edge cases (all powers of ten, INT64_MIN/MAX) and random values,
+ * as well as both serializer paths.
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See COPYING for details.
+ *
+ */
+#include "config.h"
+
+#include "../json.h"
+#include "../numconv.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+
+#define NUM_RANDOM 200000
+
+#define CHK(x) if (!(x)) { \
+	printf("%s:%d: unexpected result with '%s'\n", \
+		__FILE__, __LINE__, #x); \
+	exit(1); \
+}
+
+static uint64_t rnd_state = 88172645463325252ULL;
+
+static uint64_t
+rnd(void)
+{
+	rnd_state ^= rnd_state << 13;
+	rnd_state ^= rnd_state >> 7;
+	rnd_state ^= rnd_state << 17;
+	return rnd_state;
+}
+
+static void
+chk_value(const int64_t i)
+{
+	char buf[FJSON_NUMCONV_BUFSIZE];
+	char expected[FJSON_NUMCONV_BUFSIZE];
+	const int len = _fjson_i64toa(i, buf);
+	snprintf(expected, sizeof(expected), "%" PRId64, i);
+	if (len != (int) strlen(expected) || strcmp(buf, expected) != 0) {
+		printf("mismatch: expected %s, got %s (len %d)\n", expected, buf, len);
+		exit(1);
+	}
+}
+
+static size_t
+dump_to_buf(void *ptr, const char *data, size_t size)
+{
+	strncat((char *) ptr, data, size);
+	return size;
+}
+
+int
+main(void)
+{
+	int64_t p;
+	int i;
+	char dump[64];
+	fjson_object *arr;
+
+	chk_value(0);
+	chk_value(INT64_MAX);
+	chk_value(INT64_MIN);
+	chk_value(INT64_MIN + 1);
+	for (p = 1, i = 0 ; i < 19 ; ++i, p *= 10) {
+		chk_value(p);
+		chk_value(p - 1);
+		chk_value(p + 1);
+		chk_value(-p);
+		chk_value(-p + 1);
+	}
+	for (i = 0 ; i < NUM_RANDOM ; ++i) {
+		const uint64_t r = rnd();
+		/* vary magnitude so that all lengths are covered */
+		chk_value((int64_t) (r >> (r & 63)));
+		chk_value(-(int64_t) (r >> (r & 63)));
+	}
+	printf("random values OK\n");
+
+	arr = fjson_object_new_array();
+	fjson_object_array_add(arr, fjson_object_new_int64(INT64_MIN));
+	fjson_object_array_add(arr, fjson_object_new_int64(0));
+	fjson_object_array_add(arr, fjson_object_new_int64(42));
+	fjson_object_array_add(arr, fjson_object_new_int64(INT64_MAX));
+	printf("to_json_string: %s\n", fjson_object_to_json_string(arr));
+	dump[0] = '\0';
+	fjson_object_dump(arr, dump_to_buf, dump);
+	printf("dump: %s\n", dump);
+	CHK(strcmp(dump, fjson_object_to_json_string(arr)) == 0);
+	fjson_object_put(arr);
+
+	printf("OK\n");
+	return 0;
+}
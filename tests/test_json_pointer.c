@@ -0,0 +1,245 @@
+/* libfastjson testbench tool
+ *
+ * checks the JSON Pointer functions: the examples of RFC 6901, rsyslog
+ * notation, compiled paths used with several trees, and setting values
+ * with all the ways this can fail.
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See COPYING for details.
+ *
+ */
+#include "config.h"
+
+#include "../json.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#define CHK(x) if (!(x)) { \
+	printf("%s:%d: unexpected result with '%s'\n", \
+		__FILE__, __LINE__, #x); \
+	exit(1); \
+}
+
+/* the text of the value at path, or NULL if there is none */
+static const char *
+get(struct fjson_object *const jso, const char *const path)
+{
+	struct fjson_object *v;
+	struct fjson_path *const cp = fjson_path_compile(path);
+	fjson_bool found;
+
+	CHK(cp != NULL);
+	found = fjson_path_get(jso, cp, &v);
+	fjson_path_free(cp);
+	CHK(fjson_object_get_path(jso, path, NULL) == found);
+	if (!found) {
+		CHK(v == NULL);
+		return NULL;
+	}
+	return fjson_object_to_json_string_ext(v, FJSON_TO_STRING_PLAIN);
+}
+
+static void
+test_rfc6901(void)
+{
+	struct fjson_object *const doc = fjson_tokener_parse(
+		"{\"foo\": [\"bar\", \"baz\"], \"\": 0, \"a/b\": 1, \"c%d\": 2, \"e^f\": 3,"
+		" \"g|h\": 4, \"i\\\\j\": 5, \"k\\\"l\": 6, \" \": 7, \"m~n\": 8}");
+
+	CHK(doc != NULL);
+	CHK(strcmp(get(doc, ""), fjson_object_to_json_string_ext(doc, FJSON_TO_STRING_PLAIN)) == 0);
+	CHK(strcmp(get(doc, "/foo"), "[\"bar\",\"baz\"]") == 0);
+	CHK(strcmp(get(doc, "/foo/0"), "\"bar\"") == 0);
+	CHK(strcmp(get(doc, "/"), "0") == 0);
+	CHK(strcmp(get(doc, "/a~1b"), "1") == 0);
+	CHK(strcmp(get(doc, "/c%d"), "2") == 0);
+	CHK(strcmp(get(doc, "/e^f"), "3") == 0);
+	CHK(strcmp(get(doc, "/g|h"), "4") == 0);
+	CHK(strcmp(get(doc, "/i\\j"), "5") == 0);
+	CHK(strcmp(get(doc, "/k\"l"), "6") == 0);
+	CHK(strcmp(get(doc, "/ "), "7") == 0);
+	CHK(strcmp(get(doc, "/m~0n"), "8") == 0);
+
+	/* not there */
+	CHK(get(doc, "/foo/2") == NULL);
+	CHK(get(doc, "/foo/-") == NULL);
+	CHK(get(doc, "/foo/01") == NULL);
+	CHK(get(doc, "/foo/bar") == NULL);
+	CHK(get(doc, "/foo/99999999999") == NULL);
+	CHK(get(doc, "/a~1b/x") == NULL);
+	CHK(get(doc, "/x") == NULL);
+
+	/* invalid */
+	errno = 0;
+	CHK(fjson_path_compile("foo") == NULL && errno == EINVAL);
+	errno = 0;
+	CHK(fjson_path_compile("/a~2") == NULL && errno == EINVAL);
+	errno = 0;
+	CHK(fjson_path_compile("/a~") == NULL && errno == EINVAL);
+	errno = 0;
+	CHK(fjson_path_compile("/m~n") == NULL && errno == EINVAL);
+	errno = 0;
+	CHK(!fjson_object_get_path(doc, "a/b", NULL) && errno == EINVAL);
+
+	fjson_object_put(doc);
+}
+
+static void
+test_rsyslog(void)
+{
+	struct fjson_object *const msg = fjson_tokener_parse(
+		"{\"$!\": 1, \"a\": {\"b\": {\"c\": \"x\"}, \"l\": [10, 20]}}");
+
+	CHK(msg != NULL);
+	CHK(strcmp(get(msg, "$!a!b!c"), "\"x\"") == 0);
+	CHK(strcmp(get(msg, "$!a!l!1"), "20") == 0);
+	CHK(strcmp(get(msg, "$!a!b"), "{\"c\":\"x\"}") == 0);
+	CHK(get(msg, "$!a!b!c!d") == NULL);
+	/* the root, and the member that happens to have that name */
+	CHK(get(msg, "$!")[0] == '{');
+	CHK(strcmp(get(msg, "/$!"), "1") == 0);
+	fjson_object_put(msg);
+}
+
+/* one compiled path against many trees */
+static void
+test_compiled(void)
+{
+	struct fjson_path *const cp = fjson_path_compile("/$!/app/latency_ms");
+	char text[128];
+	int i;
+
+	CHK(cp != NULL);
+	for (i = 0 ; i < 100 ; ++i) {
+		struct fjson_object *jso, *v;
+		snprintf(text, sizeof(text), "{\"msg\": \"m\", \"$!\": {\"app\": {\"ok\": true,"
+			" \"latency_ms\": %d}}}", i);
+		CHK((jso = fjson_tokener_parse(text)) != NULL);
+		CHK(fjson_path_get(jso, cp, &v));
+		CHK(fjson_object_get_int(v) == i);
+		CHK(fjson_path_set(jso, cp, fjson_object_new_int(-i)) == 0);
+		CHK(fjson_path_get(jso, cp, &v) && fjson_object_get_int(v) == -i);
+		fjson_object_put(jso);
+	}
+	fjson_path_free(cp);
+	fjson_path_free(NULL);
+
+	/* long paths do not fit on the stack of the one-shot functions */
+	{
+		struct fjson_object *const jso = fjson_object_new_object();
+		char path[2048];
+		size_t len = 0;
+		struct fjson_object *v;
+		for (i = 0 ; i < 300 ; ++i)
+			len += (size_t) snprintf(path + len, sizeof(path) - len, "/k%d", i);
+		CHK(fjson_object_set_path(jso, path, fjson_object_new_string("deep")) == 0);
+		CHK(fjson_object_get_path(jso, path, &v));
+		CHK(strcmp(fjson_object_get_string(v), "deep") == 0);
+		CHK(fjson_object_get_path(jso, "/k0/k1/k2", &v));
+		CHK(fjson_object_object_length(v) == 1);
+		fjson_object_put(jso);
+	}
+}
+
+static void
+test_set(void)
+{
+	struct fjson_object *const doc = fjson_tokener_parse(
+		"{\"a\": [1, 2, {\"b\": null}], \"s\": \"str\"}");
+	struct fjson_object *const v = fjson_object_new_string("v");
+
+	CHK(doc != NULL && v != NULL);
+
+	/* replace and add members */
+	CHK(fjson_object_set_path(doc, "/s", fjson_object_new_int(5)) == 0);
+	CHK(fjson_object_set_path(doc, "/a/2/b", fjson_object_new_boolean(1)) == 0);
+	CHK(fjson_object_set_path(doc, "/a/2/c", NULL) == 0);
+	/* array elements */
+	CHK(fjson_object_set_path(doc, "/a/0", fjson_object_new_int(7)) == 0);
+	CHK(fjson_object_set_path(doc, "/a/-", fjson_object_new_int(8)) == 0);
+	CHK(fjson_object_set_path(doc, "/a/4", fjson_object_new_int(9)) == 0);
+	/* missing objects are created */
+	CHK(fjson_object_set_path(doc, "$!x!y!z", fjson_object_new_string("new")) == 0);
+	CHK(strcmp(fjson_object_to_json_string_ext(doc, FJSON_TO_STRING_PLAIN),
+		"{\"a\":[7,2,{\"b\":true,\"c\":null},8,9],\"s\":5,\"x\":{\"y\":{\"z\":\"new\"}}}") == 0);
+
+	/* failures leave the tree as it was, and v with us */
+	errno = 0;
+	CHK(fjson_object_set_path(doc, "/a/6", v) == -1 && errno == ENOENT);
+	errno = 0;
+	CHK(fjson_object_set_path(doc, "/a/x", v) == -1 && errno == ENOENT);
+	errno = 0;
+	CHK(fjson_object_set_path(doc, "/a/9/x", v) == -1 && errno == ENOENT);
+	errno = 0;
+	CHK(fjson_object_set_path(doc, "/s/x", v) == -1 && errno == EINVAL);
+	errno = 0;
+	CHK(fjson_object_set_path(doc, "/a/2/c/x", v) == -1 && errno == EINVAL);
+	errno = 0;
+	CHK(fjson_object_set_path(doc, "", v) == -1 && errno == EINVAL);
+	errno = 0;
+	CHK(fjson_object_set_path(doc, "/a~", v) == -1 && errno == EINVAL);
+	CHK(strcmp(fjson_object_to_json_string_ext(doc, FJSON_TO_STRING_PLAIN),
+		"{\"a\":[7,2,{\"b\":true,\"c\":null},8,9],\"s\":5,\"x\":{\"y\":{\"z\":\"new\"}}}") == 0);
+
+	fjson_object_put(v);
+	fjson_object_put(doc);
+}
+
+/* malloc fails after the given number of calls */
+static int mallocs_left;
+
+static void *
+t_malloc(const size_t size)
+{
+	return (mallocs_left-- > 0) ? malloc(size) : NULL;
+}
+
+static void *
+t_realloc(void *const ptr, const size_t size)
+{
+	return (mallocs_left-- > 0) ? realloc(ptr, size) : NULL;
+}
+
+/* objects created along the path are removed again if setting fails */
+static void
+test_set_nomem(void)
+{
+	struct fjson_object *const doc = fjson_tokener_parse("{\"a\": 1}");
+	struct fjson_object *const v = fjson_object_new_int(1234);
+	struct fjson_path *const cp = fjson_path_compile("/n/m/o/p");
+	int n, r;
+
+	CHK(doc != NULL && v != NULL && cp != NULL);
+	for (n = 0 ; ; ++n) {
+		mallocs_left = n;
+		fjson_global_set_allocator(t_malloc, t_realloc, free);
+		errno = 0;
+		r = fjson_path_set(doc, cp, v);
+		fjson_global_set_allocator(NULL, NULL, NULL);
+		if (r == 0)
+			break;
+		CHK(errno == ENOMEM);
+		CHK(strcmp(fjson_object_to_json_string_ext(doc, FJSON_TO_STRING_PLAIN),
+			"{\"a\":1}") == 0);
+	}
+	CHK(n > 0);
+	CHK(strcmp(fjson_object_to_json_string_ext(doc, FJSON_TO_STRING_PLAIN),
+		"{\"a\":1,\"n\":{\"m\":{\"o\":{\"p\":1234}}}}") == 0);
+	fjson_path_free(cp);
+	fjson_object_put(doc);
+}
+
+int
+main(int __attribute__((unused)) argc, char __attribute__((unused)) **argv)
+{
+	test_rfc6901();
+	test_rsyslog();
+	test_compiled();
+	test_set();
+	test_set_nomem();
+	printf("OK\n");
+	return 0;
+}
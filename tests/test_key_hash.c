@@ -0,0 +1,171 @@
+/* libfastjson testbench tool
+ *
+ * checks fjson_object_key_hash() and fjson_object_object_get_ex_len(),
+ * and that keys are written correctly whether or not they need escaping
+ * (the serializers copy keys that do not as they are).
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See COPYING for details.
+ *
+ */
+#include "config.h"
+
+#include "../json.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CHK(x) if (!(x)) { \
+	printf("%s:%d: unexpected result with '%s'\n", \
+		__FILE__, __LINE__, #x); \
+	exit(1); \
+}
+
+struct sink {
+	char data[1024];
+	size_t len;
+};
+
+static size_t
+sink_write(void *const ptr, const char *const buffer, const size_t size)
+{
+	struct sink *const s = ptr;
+	CHK(s->len + size < sizeof(s->data));
+	memcpy(s->data + s->len, buffer, size);
+	s->len += size;
+	s->data[s->len] = '\0';
+	return size;
+}
+
+/* both serializers must produce the expected text */
+static void
+chk_text(struct fjson_object *const jso, const char *const expected)
+{
+	struct sink s;
+	s.len = 0;
+	fjson_object_dump_ext(jso, FJSON_TO_STRING_PLAIN, sink_write, &s);
+	CHK(strcmp(s.data, expected) == 0);
+	CHK(strcmp(fjson_object_to_json_string_ext(jso, FJSON_TO_STRING_PLAIN), expected) == 0);
+}
+
+static void
+test_lookup(void)
+{
+	struct fjson_object *const jso = fjson_tokener_parse("{\"host\": 1, \"Host\": 2, \"h\": 3}");
+	const char *const path = "host.name";
+	const uint32_t h_host = fjson_object_key_hash(path, 4);
+	struct fjson_object *v;
+	char key[64];
+	int i;
+
+	CHK(jso != NULL);
+	/* the hash does not depend on case or on how the length is given */
+	CHK(h_host == fjson_object_key_hash("host", -1));
+	CHK(h_host == fjson_object_key_hash("HOST", 4));
+	CHK(h_host != fjson_object_key_hash("h", -1));
+
+	/* keys need not be NUL-terminated */
+	CHK(fjson_object_object_get_ex_len(jso, path, 4, h_host, &v));
+	CHK(fjson_object_get_int(v) == 1);
+	CHK(fjson_object_object_get_ex_len(jso, "Host", -1, h_host, &v));
+	CHK(fjson_object_get_int(v) == 2);
+	CHK(fjson_object_object_get_ex_len(jso, path, 1, fjson_object_key_hash(path, 1), &v));
+	CHK(fjson_object_get_int(v) == 3);
+	CHK(!fjson_object_object_get_ex_len(jso, path, 2, fjson_object_key_hash(path, 2), &v));
+	CHK(v == NULL);
+	CHK(!fjson_object_object_get_ex_len(jso, "HOST", 4, h_host, NULL));
+	CHK(!fjson_object_object_get_ex_len(NULL, "host", 4, h_host, &v));
+	CHK(!fjson_object_object_get_ex_len(v, "host", 4, h_host, &v));
+	fjson_object_put(jso);
+
+	/* case-insensitive objects use the same hash */
+	{
+		struct fjson_ctx *const ctx = fjson_ctx_new();
+		struct fjson_object *obj;
+		CHK(ctx != NULL);
+		fjson_ctx_set_case_sensitive(ctx, 0);
+		obj = fjson_object_new_object_ctx(ctx);
+		fjson_object_object_add(obj, "Host", fjson_object_new_int(4));
+		CHK(fjson_object_object_get_ex_len(obj, "HOST", 4, h_host, &v));
+		CHK(fjson_object_get_int(v) == 4);
+		fjson_object_put(obj);
+		fjson_ctx_free(ctx);
+	}
+
+	/* large objects are looked up via their hash index */
+	{
+		struct fjson_object *const obj = fjson_object_new_object();
+		for (i = 0 ; i < 1000 ; ++i) {
+			snprintf(key, sizeof(key), "key%d", i);
+			fjson_object_object_add(obj, key, fjson_object_new_int(i));
+		}
+		for (i = 0 ; i < 1000 ; ++i) {
+			const int len = snprintf(key, sizeof(key), "key%dxyz", i) - 3;
+			CHK(fjson_object_object_get_ex_len(obj, key, len,
+				fjson_object_key_hash(key, len), &v));
+			CHK(fjson_object_get_int(v) == i);
+		}
+		fjson_object_put(obj);
+	}
+}
+
+static void
+test_key_escaping(void)
+{
+	struct fjson_keydict *const dict = fjson_keydict_new(0);
+	struct fjson_ctx *const ctx = fjson_ctx_new();
+	struct fjson_tokener *tok;
+	struct fjson_object *jso;
+	const char *const text = "{\"plain\":1,\"q\\\"uote\":2,\"tab\\t\":3,\"sl/ash\":4,\"\\u00e4\":5}";
+	const char *const expected = "{\"plain\":1,\"q\\\"uote\":2,\"tab\\t\":3,\"sl\\/ash\":4,\"\xc3\xa4\":5}";
+
+	/* keys added via the API */
+	jso = fjson_object_new_object();
+	fjson_object_object_add(jso, "plain", fjson_object_new_int(1));
+	fjson_object_object_add(jso, "q\"uote", fjson_object_new_int(2));
+	fjson_object_object_add_ex(jso, "tab\t", fjson_object_new_int(3), FJSON_OBJECT_KEY_IS_CONSTANT);
+	fjson_object_object_add(jso, "sl/ash", fjson_object_new_int(4));
+	fjson_object_object_add(jso, "\xc3\xa4", fjson_object_new_int(5));
+	chk_text(jso, expected);
+	fjson_object_put(jso);
+
+	/* keys from the parser, both copied and interned */
+	jso = fjson_tokener_parse(text);
+	chk_text(jso, expected);
+	fjson_object_put(jso);
+
+	CHK(dict != NULL && ctx != NULL);
+	fjson_ctx_set_keydict(ctx, dict);
+	tok = fjson_tokener_new_ctx(FJSON_TOKENER_DEFAULT_DEPTH, ctx);
+	CHK(tok != NULL);
+	jso = fjson_tokener_parse_ex(tok, text, strlen(text));
+	chk_text(jso, expected);
+	fjson_object_put(jso);
+	/* now everything comes from the dictionary */
+	fjson_tokener_reset(tok);
+	jso = fjson_tokener_parse_ex(tok, text, strlen(text));
+	chk_text(jso, expected);
+
+	/* and copies */
+	{
+		struct fjson_object *copy;
+		CHK(fjson_object_deep_copy(jso, &copy) == 0);
+		chk_text(copy, expected);
+		fjson_object_put(copy);
+	}
+	fjson_object_put(jso);
+
+	fjson_tokener_free(tok);
+	fjson_ctx_free(ctx);
+	fjson_keydict_free(dict);
+}
+
+int
+main(int __attribute__((unused)) argc, char __attribute__((unused)) **argv)
+{
+	test_lookup();
+	test_key_escaping();
+	printf("OK\n");
+	return 0;
+}
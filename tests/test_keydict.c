@@ -0,0 +1,102 @@
+/* libfastjson testbench tool
+ *
+ * checks key interning: the dictionary must hand out one pointer per
+ * key, tokeners using it must share keys between the objects they
+ * create, and such objects must behave like all others.
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See COPYING for details.
+ *
+ */
+#include "config.h"
+
+#include "../json.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CHK(x) if (!(x)) { \
+	printf("%s:%d: unexpected result with '%s'\n", \
+		__FILE__, __LINE__, #x); \
+	exit(1); \
+}
+
+static const char *
+first_key(struct fjson_object *const jso)
+{
+	struct fjson_object_iterator it = fjson_object_iter_begin(jso);
+	return fjson_object_iter_peek_name(&it);
+}
+
+int
+main(int __attribute__((unused)) argc, char __attribute__((unused)) **argv)
+{
+	struct fjson_keydict *dict = fjson_keydict_new(8);
+	struct fjson_ctx *ctx = fjson_ctx_new();
+	struct fjson_tokener *tok;
+	struct fjson_object *a, *b, *v;
+	const char *host, *k;
+	char key[16];
+	int i;
+
+	CHK(dict != NULL && ctx != NULL);
+	/* pre-seed */
+	host = fjson_keydict_intern(dict, "host");
+	CHK(host != NULL && !strcmp(host, "host"));
+	CHK(fjson_keydict_intern(dict, "host") == host);
+	CHK(fjson_keydict_intern(dict, "Host") != host);
+	CHK(fjson_keydict_count(dict) == 2);
+
+	/* objects parsed share the keys */
+	fjson_ctx_set_keydict(ctx, dict);
+	tok = fjson_tokener_new_ctx(FJSON_TOKENER_DEFAULT_DEPTH, ctx);
+	CHK(tok != NULL);
+	a = fjson_tokener_parse_ex(tok, "{\"host\":\"h1\",\"msg\":{\"host\":1}}", -1);
+	CHK(a != NULL);
+	fjson_tokener_reset(tok);
+	b = fjson_tokener_parse_ex(tok, "{\"host\":\"h2\",\"msg\":\"m\"}", -1);
+	CHK(b != NULL);
+	CHK(first_key(a) == host);
+	CHK(first_key(b) == host);
+	CHK(fjson_object_object_get_ex(a, "msg", &v));
+	CHK(first_key(v) == host);
+	CHK(fjson_keydict_count(dict) == 3);
+	CHK(fjson_object_object_get_ex(b, "host", &v));
+	CHK(!strcmp(fjson_object_get_string(v), "h2"));
+	CHK(fjson_object_object_get_ex(b, host, &v));
+	printf("%s\n%s\n", fjson_object_to_json_string(a), fjson_object_to_json_string(b));
+
+	/* interned keys in add_ex and replacing values */
+	k = fjson_keydict_intern(dict, "msg");
+	fjson_object_object_add_ex(b, k, fjson_object_new_string("new"), FJSON_OBJECT_KEY_IS_INTERNED);
+	CHK(fjson_object_object_length(b) == 2);
+	fjson_object_object_add_ex(b, fjson_keydict_intern(dict, "pri"), fjson_object_new_int(13),
+		FJSON_OBJECT_KEY_IS_INTERNED);
+	CHK(fjson_object_object_get_ex(b, "pri", &v) && fjson_object_get_int(v) == 13);
+	fjson_object_object_del(b, "host");
+	printf("%s\n", fjson_object_to_json_string(b));
+
+	/* a full dictionary leaves further keys to the objects */
+	for (i = 0 ; i < 10 ; ++i) {
+		snprintf(key, sizeof(key), "f%d", i);
+		k = fjson_keydict_intern(dict, key);
+		CHK((k != NULL) == (i < 4));
+	}
+	CHK(fjson_keydict_count(dict) == 8);
+	fjson_tokener_reset(tok);
+	fjson_object_put(a);
+	a = fjson_tokener_parse_ex(tok, "{\"f0\":0,\"g0\":1,\"g1\":2}", -1);
+	CHK(a != NULL);
+	CHK(first_key(a) == fjson_keydict_intern(dict, "f0"));
+	CHK(fjson_object_object_get_ex(a, "g1", &v) && fjson_object_get_int(v) == 2);
+	printf("%s\n", fjson_object_to_json_string(a));
+
+	fjson_object_put(a);
+	fjson_object_put(b);
+	fjson_tokener_free(tok);
+	fjson_ctx_free(ctx);
+	fjson_keydict_free(dict);
+	printf("OK\n");
+	return 0;
+}
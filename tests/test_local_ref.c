@@ -0,0 +1,85 @@
+/* libfastjson testbench tool
+ *
+ * checks trees parsed with FJSON_TOKENER_LOCAL_REFCOUNT: reference
+ * counting must work as usual before and after fjson_object_share(),
+ * and mixing such nodes with atomically counted ones must be fine.
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See COPYING for details.
+ *
+ */
+#include "config.h"
+
+#include "../json.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CHK(x) if (!(x)) { \
+	printf("%s:%d: unexpected result with '%s'\n", \
+		__FILE__, __LINE__, #x); \
+	exit(1); \
+}
+
+static const char *input =
+	"{ \"a\": [ 1, 2, { \"b\": \"a string that is longer than the inline buffer\" } ],"
+	" \"c\": true, \"d\": null, \"e\": 1.5 }";
+
+static struct fjson_object *
+parse(const int flags)
+{
+	struct fjson_tokener *const tok = fjson_tokener_new();
+	struct fjson_object *jso;
+	CHK(tok != NULL);
+	fjson_tokener_set_flags(tok, flags);
+	jso = fjson_tokener_parse_ex(tok, input, strlen(input));
+	CHK(jso != NULL);
+	fjson_tokener_free(tok);
+	return jso;
+}
+
+int main(int __attribute__((unused)) argc, char __attribute__((unused)) **argv)
+{
+	struct fjson_object *jso, *arr, *mixed;
+	int i;
+
+	jso = parse(FJSON_TOKENER_LOCAL_REFCOUNT);
+	printf("%s\n", fjson_object_to_json_string(jso));
+	CHK(fjson_object_object_get_ex(jso, "a", &arr));
+	for (i = 0 ; i < 10 ; ++i)
+		fjson_object_get(arr);
+	for (i = 0 ; i < 10 ; ++i)
+		CHK(fjson_object_put(arr) == 0);
+
+	/* keep a child alive beyond its parent */
+	fjson_object_get(arr);
+	fjson_object_share(jso);
+	fjson_object_get(arr);
+	CHK(fjson_object_put(jso) == 1);
+	CHK(fjson_object_put(arr) == 0);
+	printf("%s\n", fjson_object_to_json_string(arr));
+	CHK(fjson_object_put(arr) == 1);
+
+	/* local nodes in an atomically counted tree and vice versa */
+	mixed = fjson_object_new_object();
+	jso = parse(FJSON_TOKENER_LOCAL_REFCOUNT | FJSON_TOKENER_ZERO_COPY);
+	fjson_object_object_add(mixed, "parsed", jso);
+	fjson_object_object_add(jso, "new", fjson_object_new_int(42));
+	fjson_object_get(jso);
+	fjson_object_object_del(mixed, "parsed");
+	printf("%s\n", fjson_object_to_json_string(mixed));
+	CHK(fjson_object_put(mixed) == 1);
+	fjson_object_share(jso);
+	printf("%s\n", fjson_object_to_json_string(jso));
+	CHK(fjson_object_put(jso) == 1);
+
+	/* the default still counts atomically */
+	jso = parse(0);
+	fjson_object_share(jso);
+	CHK(fjson_object_put(jso) == 1);
+	fjson_object_share(NULL);
+
+	printf("OK\n");
+	return 0;
+}
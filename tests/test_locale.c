@@ -16,7 +16,9 @@ int main(int __attribute__((unused)) argc, char __attribute__((unused)) **argv)
 {
 	fjson_object *new_obj;
 #ifdef HAVE_SETLOCALE
+	char before[64];
 	setlocale(LC_NUMERIC, "de_DE");
+	snprintf(before, sizeof(before), "%s", setlocale(LC_NUMERIC, NULL));
 #else
 	printf("No locale\n");
 #endif
@@ -27,6 +29,11 @@ int main(int __attribute__((unused)) argc, char __attribute__((unused)) **argv)
 	printf("new_obj.to_string()=%s\n", fjson_object_to_json_string(new_obj));
 	printf("new_obj.to_string()=%s\n", fjson_object_to_json_string_ext(new_obj,FJSON_TO_STRING_NOZERO));
 	fjson_object_put(new_obj);
+#ifdef HAVE_SETLOCALE
+	/* parsing must not touch the global locale */
+	if (strcmp(before, setlocale(LC_NUMERIC, NULL)))
+		printf("locale changed from %s to %s\n", before, setlocale(LC_NUMERIC, NULL));
+#endif
 	return 0;
 }
 
@@ -0,0 +1,84 @@
+/* libfastjson testbench tool
+ *
+ * checks nodes of all types, which are only as large as their type
+ * needs. Strings are checked around the length where they stop being
+ * stored inside the node; run under valgrind or ASan to catch
+ * accesses beyond a node.
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See COPYING for details.
+ *
+ */
+#include "config.h"
+
+#include "../json.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* member k of jso, which must exist */
+#define MEMBER(k) (fjson_object_object_get_ex(jso, (k), &m) ? m : NULL)
+
+#define CHK(x) if (!(x)) { \
+	printf("%s:%d: unexpected result with '%s'\n", \
+		__FILE__, __LINE__, #x); \
+	exit(1); \
+}
+
+int
+main(int __attribute__((unused)) argc, char __attribute__((unused)) **argv)
+{
+	struct fjson_object *arr = fjson_object_new_array();
+	struct fjson_object *jso, *parsed, *m;
+	char buf[80], json[96];
+	int len;
+
+	for (len = 0 ; len < 72 ; ++len) {
+		memset(buf, 'a' + len % 26, len);
+		buf[len] = '\0';
+		jso = fjson_object_new_string(buf);
+		CHK(fjson_object_get_string_len(jso) == len);
+		CHK(!strcmp(fjson_object_get_string(jso), buf));
+		fjson_object_put(jso);
+
+		jso = fjson_object_new_string_len(buf, len);
+		CHK(fjson_object_get_string_len(jso) == len);
+		CHK(!strcmp(fjson_object_get_string(jso), buf));
+		snprintf(json, sizeof(json), "\"%s\"", buf);
+		CHK(!strcmp(fjson_object_to_json_string(jso), json));
+		parsed = fjson_tokener_parse(json);
+		CHK(parsed != NULL && !strcmp(fjson_object_get_string(parsed), buf));
+		fjson_object_put(parsed);
+		fjson_object_array_add(arr, jso);
+	}
+	CHK(fjson_object_array_length(arr) == 72);
+	fjson_object_put(arr);
+
+	/* scalars */
+	jso = fjson_object_new_object();
+	fjson_object_object_add(jso, "b", fjson_object_new_boolean(1));
+	fjson_object_object_add(jso, "i", fjson_object_new_int(-42));
+	fjson_object_object_add(jso, "l", fjson_object_new_int64(INT64_C(1) << 40));
+	fjson_object_object_add(jso, "d", fjson_object_new_double(1.5));
+	fjson_object_object_add(jso, "ds", fjson_object_new_double_s(0.1, "0.10"));
+	fjson_object_object_add(jso, "a", fjson_object_new_array());
+	fjson_object_object_add(jso, "o", fjson_object_new_object());
+	fjson_object_object_add(jso, "n", NULL);
+	printf("%s\n", fjson_object_to_json_string(jso));
+	CHK(fjson_object_get_boolean(MEMBER("b")));
+	CHK(fjson_object_get_int(MEMBER("i")) == -42);
+	CHK(fjson_object_get_int(MEMBER("b")) == 1);
+	CHK(fjson_object_get_int64(MEMBER("l")) == INT64_C(1) << 40);
+	CHK(fjson_object_get_double(MEMBER("d")) == 1.5);
+	CHK(fjson_object_get_int(MEMBER("a")) == 0);
+	CHK(fjson_object_get_double(MEMBER("o")) == 0.0);
+	fjson_object_put(jso);
+
+	parsed = fjson_tokener_parse("[true, 1, 2.5, \"s\", {\"k\": [null]}]");
+	CHK(parsed != NULL);
+	printf("%s\n", fjson_object_to_json_string(parsed));
+	fjson_object_put(parsed);
+	printf("OK\n");
+	return 0;
+}
@@ -0,0 +1,207 @@
+/* libfastjson testbench tool
+ *
+ * checks the conversion of numbers by the tokener: integers and decimals
+ * that are converted right from the input must get the same values as
+ * with strtod(), keep their text, and behave the same as before when
+ * they are split across chunks or are out of range.
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See COPYING for details.
+ *
+ */
+#include "config.h"
+
+#include "../json.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#define CHK(x) if (!(x)) { \
+	printf("%s:%d: unexpected result with '%s'\n", \
+		__FILE__, __LINE__, #x); \
+	exit(1); \
+}
+
+/* parse text as a whole and, for all split points, in two chunks */
+static struct fjson_object *
+parse(const char *const text)
+{
+	struct fjson_tokener *const tok = fjson_tokener_new();
+	struct fjson_object *jso, *part;
+	const int len = (int) strlen(text);
+	int i;
+
+	CHK(tok != NULL);
+	jso = fjson_tokener_parse_ex(tok, text, -1);
+	CHK(fjson_tokener_get_error(tok) == fjson_tokener_success);
+	for (i = 1 ; i < len ; ++i) {
+		fjson_tokener_reset(tok);
+		part = fjson_tokener_parse_ex(tok, text, i);
+		CHK(part == NULL && fjson_tokener_get_error(tok) == fjson_tokener_continue);
+		part = fjson_tokener_parse_ex(tok, text + i, len - i + 1);
+		CHK(fjson_tokener_get_error(tok) == fjson_tokener_success);
+		CHK(strcmp(fjson_object_to_json_string(part), fjson_object_to_json_string(jso)) == 0);
+		fjson_object_put(part);
+	}
+	fjson_tokener_free(tok);
+	return jso;
+}
+
+static void
+chk_int(const char *const text, const int64_t expected)
+{
+	struct fjson_object *const jso = parse(text);
+	CHK(fjson_object_is_type(jso, fjson_type_int));
+	CHK(fjson_object_get_int64(jso) == expected);
+	fjson_object_put(jso);
+}
+
+static void
+chk_double(const char *const text)
+{
+	struct fjson_object *const jso = parse(text);
+	const double d = strtod(text, NULL);
+	CHK(fjson_object_is_type(jso, fjson_type_double));
+	CHK(memcmp(&d, &(double) { fjson_object_get_double(jso) }, sizeof(d)) == 0);
+	CHK(strcmp(fjson_object_to_json_string(jso), text) == 0);
+	fjson_object_put(jso);
+}
+
+static void
+test_values(void)
+{
+	static const char *const dbls[] = {
+		"0.0", "-0.0", "1.5", "-2.25", "0.1", "0.3", "123.456", "1e5", "1E-5",
+		"2.5e+3", "9007199254740993.0", "9007199254740992.0", "0.000001",
+		"1e22", "1e23", "1e-22", "1e-23", "4.9e-324", "1.7976931348623157e308",
+		"0e999", "12345678901234567890.5", "0.12345678901234567890",
+		"1.0000000000000002", "5e-1", "3.14159265358979",
+	};
+	size_t i;
+
+	chk_int("0", 0);
+	chk_int("-0", 0);
+	chk_int("7", 7);
+	chk_int("-1", -1);
+	chk_int("1234567890123", 1234567890123);
+	chk_int("9223372036854775807", INT64_MAX);
+	chk_int("-9223372036854775808", INT64_MIN);
+	/* out of range values are clamped as before */
+	chk_int("9223372036854775808", INT64_MAX);
+	chk_int("-9223372036854775809", INT64_MIN);
+	chk_int("123456789012345678901234", INT64_MAX);
+	/* leading zeros are accepted unless in strict mode */
+	chk_int("007", 7);
+
+	for (i = 0 ; i < sizeof(dbls) / sizeof(dbls[0]) ; ++i)
+		chk_double(dbls[i]);
+}
+
+/* random decimals, so that the exact and inexact cases all get hit */
+static void
+test_random(void)
+{
+	uint64_t rnd = 0x9e3779b97f4a7c15ULL;
+	char text[64], arr[128];
+	int i;
+
+	for (i = 0 ; i < 20000 ; ++i) {
+		uint64_t m;
+		int nfrac, e;
+		rnd ^= rnd << 13;
+		rnd ^= rnd >> 7;
+		rnd ^= rnd << 17;
+		m = rnd % ((i & 1) ? 100000000ULL : 100000000000000000ULL);
+		nfrac = (int) ((rnd >> 40) % 12) + 1;
+		e = (int) ((rnd >> 48) % 61) - 30;
+		snprintf(text, sizeof(text), "%s%llu.%0*llu", (rnd >> 63) ? "-" : "",
+			(unsigned long long) (m / 1000), nfrac,
+			(unsigned long long) (m % 1000));
+		if (i % 3 == 0) {
+			const size_t len = strlen(text);
+			snprintf(text + len, sizeof(text) - len, "e%d", e);
+		}
+		if (i % 100 == 0) {
+			chk_double(text);
+		} else {
+			/* the same, but just once and in an array */
+			struct fjson_object *const jso = fjson_tokener_parse(
+				(snprintf(arr, sizeof(arr), "[%s]", text), arr));
+			const double d = strtod(text, NULL);
+			struct fjson_object *const v = fjson_object_array_get_idx(jso, 0);
+			CHK(memcmp(&d, &(double) { fjson_object_get_double(v) }, sizeof(d)) == 0);
+			CHK(strcmp(fjson_object_to_json_string_ext(v, FJSON_TO_STRING_PLAIN), text) == 0);
+			fjson_object_put(jso);
+		}
+	}
+}
+
+static int ncb_int, ncb_dbl;
+
+static int
+cb_int64(void __attribute__((unused)) *ctx, int64_t i)
+{
+	CHK(i == -42);
+	++ncb_int;
+	return 0;
+}
+
+static int
+cb_dbl(void __attribute__((unused)) *ctx, double d, const char *s, int len)
+{
+	CHK(d == 2.5 && len == 3 && memcmp(s, "2.5", 3) == 0);
+	++ncb_dbl;
+	return 0;
+}
+
+static void
+test_syntax(void)
+{
+	static const char *const bad[] = {
+		"-", "--1", "1.2.3", "1e5e5", "-a", "1-2"
+	};
+	struct fjson_tokener *const tok = fjson_tokener_new();
+	struct fjson_tokener_callbacks cb;
+	size_t i;
+
+	CHK(tok != NULL);
+	for (i = 0 ; i < sizeof(bad) / sizeof(bad[0]) ; ++i) {
+		char text[32];
+		snprintf(text, sizeof(text), "[%s]", bad[i]);
+		CHK(fjson_tokener_parse(text) == NULL);
+	}
+
+	/* strict mode */
+	fjson_tokener_set_flags(tok, FJSON_TOKENER_STRICT);
+	CHK(fjson_tokener_parse_ex(tok, "[012]", 5) == NULL);
+	fjson_tokener_reset(tok);
+	{
+		struct fjson_object *const jso = fjson_tokener_parse_ex(tok, "[0, 1.5]", 8);
+		CHK(jso != NULL && fjson_object_array_length(jso) == 2);
+		fjson_object_put(jso);
+	}
+
+	/* callbacks get the numbers, too */
+	memset(&cb, 0, sizeof(cb));
+	cb.int64 = cb_int64;
+	cb.dbl = cb_dbl;
+	fjson_tokener_reset(tok);
+	fjson_tokener_set_flags(tok, 0);
+	fjson_tokener_set_callbacks(tok, &cb, NULL);
+	fjson_tokener_parse_ex(tok, "[-42, 2.5, -42]", 15);
+	CHK(fjson_tokener_get_error(tok) == fjson_tokener_success);
+	CHK(ncb_int == 2 && ncb_dbl == 1);
+	fjson_tokener_free(tok);
+}
+
+int
+main(int __attribute__((unused)) argc, char __attribute__((unused)) **argv)
+{
+	test_values();
+	test_random();
+	test_syntax();
+	printf("OK\n");
+	return 0;
+}
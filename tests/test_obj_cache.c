@@ -0,0 +1,124 @@
+/* libfastjson testbench tool
+ *
+ * checks that cached serializations are reused while nothing changes
+ * and are invalidated by all kinds of modifications of the node or its
+ * descendants, including nodes that are held in more than one place.
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See COPYING for details.
+ *
+ */
+#include "config.h"
+
+#include "../json.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CHK(x) if (!(x)) { \
+	printf("%s:%d: unexpected result with '%s'\n", \
+		__FILE__, __LINE__, #x); \
+	exit(1); \
+}
+
+static size_t
+dump_to_buf(void *ptr, const char *data, size_t size)
+{
+	strncat((char *) ptr, data, size);
+	return size;
+}
+
+/* print the object and check the other serializers agree */
+static void
+show(const char *const title, struct fjson_object *const jso)
+{
+	char dump[1024];
+	char into[1024];
+	const char *const str = fjson_object_to_json_string_ext(jso, FJSON_TO_STRING_PLAIN);
+	dump[0] = '\0';
+	fjson_object_dump_ext(jso, FJSON_TO_STRING_PLAIN, dump_to_buf, dump);
+	CHK(strcmp(str, dump) == 0);
+	fjson_object_to_json_string_into(jso, FJSON_TO_STRING_PLAIN, into, sizeof(into));
+	CHK(strcmp(str, into) == 0);
+	printf("%s: %s\n", title, str);
+}
+
+int main(int __attribute__((unused)) argc, char __attribute__((unused)) **argv)
+{
+	struct fjson_object *const root = fjson_tokener_parse(
+		"{ \"meta\": { \"a\": 1, \"list\": [ 3, 1, 2 ] }, \"msg\": \"hello\" }");
+	struct fjson_object *meta, *list, *shared;
+	const char *s1, *s2;
+
+	CHK(root != NULL);
+	CHK(fjson_object_object_get_ex(root, "meta", &meta));
+	CHK(fjson_object_object_get_ex(meta, "list", &list));
+
+	/* unchanged objects give the very same buffer */
+	s1 = fjson_object_to_json_string_ext(root, FJSON_TO_STRING_PLAIN);
+	s2 = fjson_object_to_json_string_ext(root, FJSON_TO_STRING_PLAIN);
+	CHK(s1 == s2);
+	show("initial", root);
+	printf("spaced: %s\n", fjson_object_to_json_string(root));
+	printf("pretty: %s\n", fjson_object_to_json_string_ext(root, FJSON_TO_STRING_PRETTY));
+
+	/* children serialized on their own are spliced into the parent */
+	show("meta", meta);
+	show("root with cached meta", root);
+
+	/* modifications deep down must reach the root */
+	fjson_object_object_add(meta, "b", fjson_object_new_string("new"));
+	show("object_add", root);
+	fjson_object_object_add(meta, "a", fjson_object_new_int(2));
+	show("object_add replace", root);
+	fjson_object_object_del(meta, "b");
+	show("object_del", root);
+	fjson_object_array_add(list, fjson_object_new_int(4));
+	show("array_add", root);
+	fjson_object_array_put_idx(list, 0, fjson_object_new_int(0));
+	show("array_put_idx", root);
+	fjson_object_array_del_idx(list, 1);
+	show("array_del_idx", root);
+
+	/* a node held by two containers */
+	shared = fjson_object_new_object();
+	fjson_object_object_add(root, "s1", shared);
+	fjson_object_object_add(meta, "s2", fjson_object_get(shared));
+	show("shared", root);
+	fjson_object_object_add(shared, "x", fjson_object_new_boolean(1));
+	show("shared modified", root);
+
+	/* and twice by the same one */
+	{
+		struct fjson_object *const twice = fjson_object_new_object();
+		fjson_object_array_add(list, twice);
+		fjson_object_array_add(list, fjson_object_get(twice));
+		show("twice", root);
+		fjson_object_array_del_idx(list, 3);
+		show("once again", root);
+		fjson_object_object_add(twice, "y", NULL);
+		show("twice modified", root);
+	}
+
+	/* a node that was removed must no longer affect its old parent */
+	{
+		struct fjson_object *const sub = fjson_object_new_object();
+		struct fjson_object *const tmp = fjson_object_new_array();
+		fjson_object_array_add(tmp, fjson_object_get(sub));
+		fjson_object_array_del_idx(tmp, 0);
+		fjson_object_put(tmp);
+		fjson_object_object_add(sub, "k", fjson_object_new_string("v"));
+
+		/* same if the parent is freed while the node lives on */
+		fjson_object_object_add(root, "sub", fjson_object_get(sub));
+		show("sub", root);
+		fjson_object_put(root);
+		fjson_object_object_add(sub, "k2", fjson_object_new_string("v2"));
+		show("sub after parent freed", sub);
+		fjson_object_put(sub);
+	}
+
+	printf("OK\n");
+	return 0;
+}
@@ -0,0 +1,152 @@
+/* libfastjson testbench tool
+ *
+ * checks objects that see many deletes: holes must be reused lowest
+ * first, compaction must keep the order of the remaining members,
+ * deletes must not move the members under an iterator and iteration
+ * must cope with long runs of deleted entries.
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See COPYING for details.
+ *
+ */
+#include "config.h"
+
+#include "../json.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CHK(x) if (!(x)) { \
+	printf("%s:%d: unexpected result with '%s'\n", \
+		__FILE__, __LINE__, #x); \
+	exit(1); \
+}
+
+static int
+count_members(struct fjson_object *const jso)
+{
+	struct fjson_object_iterator it = fjson_object_iter_begin(jso);
+	struct fjson_object_iterator itEnd = fjson_object_iter_end(jso);
+	int n = 0;
+	while (!fjson_object_iter_equal(&it, &itEnd)) {
+		++n;
+		fjson_object_iter_next(&it);
+	}
+	return n;
+}
+
+int
+main(int __attribute__((unused)) argc, char __attribute__((unused)) **argv)
+{
+	struct fjson_object *jso = fjson_object_new_object();
+	struct fjson_object *v;
+	char key[32];
+	int i, round;
+
+	/* a long run of holes in front of the only remaining member */
+	for (i = 0 ; i < 100000 ; ++i) {
+		snprintf(key, sizeof(key), "k%d", i);
+		fjson_object_object_add(jso, key, fjson_object_new_int(i));
+	}
+	for (i = 0 ; i < 99999 ; ++i) {
+		snprintf(key, sizeof(key), "k%d", i);
+		fjson_object_object_del(jso, key);
+	}
+	CHK(fjson_object_object_length(jso) == 1);
+	CHK(count_members(jso) == 1);
+	CHK(fjson_object_object_get_ex(jso, "k99999", &v));
+	CHK(fjson_object_get_int(v) == 99999);
+	printf("%s\n", fjson_object_to_json_string(jso));
+	fjson_object_put(jso);
+
+	/* compaction keeps the order of the remaining members */
+	jso = fjson_object_new_object();
+	for (i = 0 ; i < 40 ; ++i) {
+		snprintf(key, sizeof(key), "k%d", i);
+		fjson_object_object_add(jso, key, fjson_object_new_int(i));
+	}
+	for (i = 0 ; i < 40 ; ++i) {
+		if (i % 5 == 0)
+			continue;
+		snprintf(key, sizeof(key), "k%d", i);
+		fjson_object_object_del(jso, key);
+	}
+	fjson_object_object_add(jso, "new", fjson_object_new_int(40));
+	printf("%s\n", fjson_object_to_json_string(jso));
+	fjson_object_put(jso);
+
+	/* advance the iterator, then delete the member it was on; with
+	 * more members than fit a page, deletes must not move the rest
+	 */
+	jso = fjson_object_new_object();
+	for (i = 0 ; i < 200 ; ++i) {
+		snprintf(key, sizeof(key), "k%d", i);
+		fjson_object_object_add(jso, key, fjson_object_new_int(i));
+	}
+	{
+		struct fjson_object_iterator it = fjson_object_iter_begin(jso);
+		struct fjson_object_iterator itEnd = fjson_object_iter_end(jso);
+		int seen = 0;
+		while (!fjson_object_iter_equal(&it, &itEnd)) {
+			const char *const name = fjson_object_iter_peek_name(&it);
+			CHK(fjson_object_get_int(fjson_object_iter_peek_value(&it)) == seen);
+			fjson_object_iter_next(&it);
+			fjson_object_object_del(jso, name);
+			++seen;
+		}
+		printf("seen=%d left=%d\n", seen, fjson_object_object_length(jso));
+	}
+	fjson_object_object_add(jso, "new", fjson_object_new_int(200));
+	CHK(count_members(jso) == 1);
+	fjson_object_put(jso);
+
+	/* explicit compaction, with nothing added afterwards */
+	jso = fjson_object_new_object();
+	for (i = 0 ; i < 40 ; ++i) {
+		snprintf(key, sizeof(key), "k%d", i);
+		fjson_object_object_add(jso, key, fjson_object_new_int(i));
+	}
+	for (i = 0 ; i < 40 ; ++i) {
+		if (i % 10 == 0)
+			continue;
+		snprintf(key, sizeof(key), "k%d", i);
+		fjson_object_object_del(jso, key);
+	}
+	fjson_object_object_compact(jso);
+	CHK(count_members(jso) == 4);
+	CHK(fjson_object_object_get_ex(jso, "k30", &v));
+	CHK(fjson_object_get_int(v) == 30);
+	fjson_object_object_add(jso, "k1", fjson_object_new_int(1));
+	printf("%s\n", fjson_object_to_json_string(jso));
+	fjson_object_put(jso);
+
+	/* delete and re-add most members over and over, as a normalizer does */
+	jso = fjson_object_new_object();
+	for (i = 0 ; i < 50 ; ++i) {
+		snprintf(key, sizeof(key), "field%d", i);
+		fjson_object_object_add(jso, key, fjson_object_new_int(i));
+	}
+	for (round = 0 ; round < 1000 ; ++round) {
+		for (i = 0 ; i < 40 ; ++i) {
+			snprintf(key, sizeof(key), "field%d", (i * 7 + round) % 50);
+			fjson_object_object_del(jso, key);
+		}
+		for (i = 0 ; i < 50 ; ++i) {
+			snprintf(key, sizeof(key), "field%d", i);
+			if (!fjson_object_object_get_ex(jso, key, NULL))
+				fjson_object_object_add(jso, key, fjson_object_new_int(round));
+		}
+		CHK(fjson_object_object_length(jso) == 50);
+		CHK(count_members(jso) == 50);
+	}
+	for (i = 0 ; i < 50 ; ++i) {
+		snprintf(key, sizeof(key), "field%d", i);
+		CHK(fjson_object_object_get_ex(jso, key, NULL));
+	}
+	printf("%d members after churn\n", count_members(jso));
+	fjson_object_put(jso);
+
+	printf("OK\n");
+	return 0;
+}
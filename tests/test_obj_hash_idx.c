@@ -0,0 +1,181 @@
+/* libfastjson testbench tool
+ *
+ * checks key lookups of objects which are large enough to
+ * use the hash index, including deletes and re-adds. Lookups must
+ * never allocate, however the object came about, as several threads
+ * may read it at once.
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See COPYING for details.
+ *
+ */
+#include "config.h"
+
+#include "../json.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NUM_KEYS 1000
+
+#define CHK(x) if (!(x)) { \
+	printf("%s:%d: unexpected result with '%s'\n", \
+		__FILE__, __LINE__, #x); \
+	exit(1); \
+}
+
+static int nallocs;
+
+static void *
+t_malloc(const size_t size)
+{
+	++nallocs;
+	return malloc(size);
+}
+
+static void *
+t_realloc(void *const ptr, const size_t size)
+{
+	++nallocs;
+	return realloc(ptr, size);
+}
+
+/* keys key-<first> to key-<last> (at step) must be found without allocating */
+static void
+chk_lookups(struct fjson_object *const json, const int first, const int last, const int step)
+{
+	struct fjson_object *val;
+	char key[64];
+	int i;
+
+	nallocs = 0;
+	fjson_global_set_allocator(t_malloc, t_realloc, free);
+	for (i = first ; i <= last ; i += step) {
+		snprintf(key, sizeof(key), "key-%d", i);
+		CHK(fjson_object_object_get_ex(json, key, &val));
+		CHK(fjson_object_get_int(val) == i);
+	}
+	CHK(!fjson_object_object_get_ex(json, "key-x", NULL));
+	fjson_global_set_allocator(NULL, NULL, NULL);
+	CHK(nallocs == 0);
+}
+
+static void
+test_pure_lookups(void)
+{
+	struct fjson_object *const json = fjson_object_new_object();
+	struct fjson_object *copy;
+	char key[64];
+	int i;
+
+	CHK(json != NULL);
+	for (i = 0 ; i < 100 ; ++i) {
+		snprintf(key, sizeof(key), "key-%d", i);
+		fjson_object_object_add_ex(json, key, fjson_object_new_int(i),
+			FJSON_OBJECT_ADD_KEY_IS_NEW);
+	}
+	chk_lookups(json, 0, 99, 1);
+	CHK(fjson_object_deep_copy(json, &copy) == 0);
+	chk_lookups(copy, 0, 99, 1);
+	fjson_object_put(copy);
+	CHK(fjson_object_copy_containers(json, &copy) == 0);
+	chk_lookups(copy, 0, 99, 1);
+	fjson_object_put(copy);
+
+	/* deleting most members leaves holes, compaction rebuilds the index */
+	for (i = 0 ; i < 100 ; ++i) {
+		snprintf(key, sizeof(key), "key-%d", i);
+		if (i % 4 != 0)
+			fjson_object_object_del(json, key);
+	}
+	CHK(fjson_object_object_length(json) == 25);
+	chk_lookups(json, 0, 96, 4);
+	fjson_object_object_compact(json);
+	CHK(fjson_object_object_length(json) == 25);
+	chk_lookups(json, 0, 96, 4);
+	fjson_object_put(json);
+}
+
+int main(int __attribute__((unused)) argc, char __attribute__((unused)) **argv)
+{
+	int i;
+	char key[64];
+	struct fjson_object *val;
+	struct fjson_object *json = fjson_object_new_object();
+	if (json == NULL) {
+		perror("malloc ptr table failed:");
+		exit(1);
+	}
+
+	for (i = 0 ; i < NUM_KEYS ; ++i) {
+		snprintf(key, sizeof(key), "key-%d", i);
+		fjson_object_object_add(json, key, fjson_object_new_int(i));
+	}
+	CHK(fjson_object_object_length(json) == NUM_KEYS);
+	for (i = 0 ; i < NUM_KEYS ; ++i) {
+		snprintf(key, sizeof(key), "key-%d", i);
+		CHK(fjson_object_object_get_ex(json, key, &val));
+		CHK(fjson_object_get_int(val) == i);
+	}
+	CHK(!fjson_object_object_get_ex(json, "KEY-1", NULL));
+
+	/* case-insensitive mode must find keys via the very same index */
+	fjson_global_do_case_sensitive_comparison(0);
+	CHK(fjson_object_object_get_ex(json, "KEY-1", &val));
+	CHK(fjson_object_get_int(val) == 1);
+	fjson_global_do_case_sensitive_comparison(1);
+
+	/* replace values of existing keys */
+	for (i = 0 ; i < NUM_KEYS ; i += 3) {
+		snprintf(key, sizeof(key), "key-%d", i);
+		fjson_object_object_add(json, key, fjson_object_new_int(-i));
+	}
+	CHK(fjson_object_object_length(json) == NUM_KEYS);
+
+	/* delete every other key */
+	for (i = 0 ; i < NUM_KEYS ; i += 2) {
+		snprintf(key, sizeof(key), "key-%d", i);
+		fjson_object_object_del(json, key);
+	}
+	CHK(fjson_object_object_length(json) == NUM_KEYS / 2);
+	for (i = 0 ; i < NUM_KEYS ; ++i) {
+		snprintf(key, sizeof(key), "key-%d", i);
+		if (i % 2 == 0) {
+			CHK(!fjson_object_object_get_ex(json, key, NULL));
+		} else {
+			CHK(fjson_object_object_get_ex(json, key, &val));
+			CHK(fjson_object_get_int(val) == ((i % 3 == 0) ? -i : i));
+		}
+	}
+
+	/* re-add deleted keys under new names, they fill the holes */
+	for (i = 0 ; i < NUM_KEYS ; i += 2) {
+		snprintf(key, sizeof(key), "new-%d", i);
+		fjson_object_object_add(json, key, fjson_object_new_int(i));
+	}
+	CHK(fjson_object_object_length(json) == NUM_KEYS);
+	for (i = 0 ; i < NUM_KEYS ; i += 2) {
+		snprintf(key, sizeof(key), "new-%d", i);
+		CHK(fjson_object_object_get_ex(json, key, &val));
+		CHK(fjson_object_get_int(val) == i);
+	}
+
+	/* iteration order must still be the page order */
+	i = 0;
+	struct fjson_object_iterator it = fjson_object_iter_begin(json);
+	struct fjson_object_iterator itEnd = fjson_object_iter_end(json);
+	while (!fjson_object_iter_equal(&it, &itEnd)) {
+		if (i < 6)
+			printf("%s: %s\n", fjson_object_iter_peek_name(&it),
+				fjson_object_to_json_string(fjson_object_iter_peek_value(&it)));
+		++i;
+		fjson_object_iter_next(&it);
+	}
+	CHK(i == NUM_KEYS);
+
+	fjson_object_put(json);
+	test_pure_lookups();
+	printf("OK\n");
+	return 0;
+}
@@ -0,0 +1,113 @@
+/* libfastjson testbench tool
+ *
+ * checks lookups, deletes and iteration on wide objects, whose children
+ * span several pages of different size. Keys are chosen to share
+ * prefixes and lengths, so that the hash and length checks cannot be
+ * the only thing that tells them apart.
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See COPYING for details.
+ *
+ */
+#include "config.h"
+
+#include "../json.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CHK(x) if (!(x)) { \
+	printf("%s:%d: unexpected result with '%s'\n", \
+		__FILE__, __LINE__, #x); \
+	exit(1); \
+}
+
+#define NKEYS 3000
+
+static void
+check_order(struct fjson_object *const jso, const int step)
+{
+	struct fjson_object_iterator it = fjson_object_iter_begin(jso);
+	struct fjson_object_iterator itEnd = fjson_object_iter_end(jso);
+	int n = 0, prev = -1;
+	while (!fjson_object_iter_equal(&it, &itEnd)) {
+		const int v = fjson_object_get_int(fjson_object_iter_peek_value(&it));
+		CHK(v > prev);
+		CHK(v % step == 0);
+		prev = v;
+		++n;
+		fjson_object_iter_next(&it);
+	}
+	CHK(n == fjson_object_object_length(jso));
+}
+
+int
+main(int __attribute__((unused)) argc, char __attribute__((unused)) **argv)
+{
+	struct fjson_object *jso = fjson_object_new_object();
+	struct fjson_object *v;
+	char key[32];
+	int i;
+
+	for (i = 0 ; i < NKEYS ; ++i) {
+		snprintf(key, sizeof(key), "key%04d", i);
+		fjson_object_object_add(jso, key, fjson_object_new_int(i));
+	}
+	CHK(fjson_object_object_length(jso) == NKEYS);
+	check_order(jso, 1);
+	for (i = 0 ; i < NKEYS ; ++i) {
+		snprintf(key, sizeof(key), "key%04d", i);
+		CHK(fjson_object_object_get_ex(jso, key, &v));
+		CHK(fjson_object_get_int(v) == i);
+	}
+	/* prefixes and extensions of existing keys */
+	CHK(!fjson_object_object_get_ex(jso, "key", NULL));
+	CHK(!fjson_object_object_get_ex(jso, "key000", NULL));
+	CHK(!fjson_object_object_get_ex(jso, "key00000", NULL));
+	CHK(!fjson_object_object_get_ex(jso, "", NULL));
+	printf("%d keys found\n", NKEYS);
+
+	/* delete every odd key, the holes must be skipped by the iterator */
+	for (i = 1 ; i < NKEYS ; i += 2) {
+		snprintf(key, sizeof(key), "key%04d", i);
+		fjson_object_object_del(jso, key);
+	}
+	CHK(fjson_object_object_length(jso) == NKEYS / 2);
+	check_order(jso, 2);
+	CHK(!fjson_object_object_get_ex(jso, "key0001", NULL));
+	CHK(fjson_object_object_get_ex(jso, "key0002", NULL));
+
+	/* re-adding fills the holes again */
+	for (i = 1 ; i < NKEYS ; i += 2) {
+		snprintf(key, sizeof(key), "KEY%04d", i);
+		fjson_object_object_add(jso, key, fjson_object_new_int(i));
+	}
+	CHK(fjson_object_object_length(jso) == NKEYS);
+	CHK(fjson_object_object_get_ex(jso, "KEY0001", &v));
+	CHK(fjson_object_get_int(v) == 1);
+	printf("%d keys after delete and re-add\n", fjson_object_object_length(jso));
+	fjson_object_put(jso);
+
+	/* small objects live in the first page only */
+	jso = fjson_object_new_object();
+	fjson_object_object_add(jso, "ab", fjson_object_new_int(1));
+	fjson_object_object_add(jso, "ba", fjson_object_new_int(2));
+	fjson_object_object_add(jso, "abc", fjson_object_new_int(3));
+	CHK(fjson_object_object_get_ex(jso, "ba", &v));
+	CHK(fjson_object_get_int(v) == 2);
+	CHK(!fjson_object_object_get_ex(jso, "b", NULL));
+	printf("%s\n", fjson_object_to_json_string(jso));
+
+	/* case-insensitive lookups need the same hash for both spellings */
+	fjson_global_do_case_sensitive_comparison(0);
+	CHK(fjson_object_object_get_ex(jso, "AB", &v));
+	CHK(fjson_object_get_int(v) == 1);
+	CHK(!fjson_object_object_get_ex(jso, "ABCD", NULL));
+	fjson_global_do_case_sensitive_comparison(1);
+	CHK(!fjson_object_object_get_ex(jso, "AB", NULL));
+	fjson_object_put(jso);
+
+	printf("OK\n");
+	return 0;
+}
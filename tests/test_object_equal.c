@@ -0,0 +1,223 @@
+/* libfastjson testbench tool
+ *
+ * checks fjson_object_equal() and fjson_object_hash(): equal trees must
+ * compare and hash the same regardless of member order and of how the
+ * values are stored, and the hash objects keep must follow modifications.
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See COPYING for details.
+ *
+ */
+#include "config.h"
+
+#include "../json.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#define CHK(x) if (!(x)) { \
+	printf("%s:%d: unexpected result with '%s'\n", \
+		__FILE__, __LINE__, #x); \
+	exit(1); \
+}
+
+static void
+chk_pair(const char *const a, const char *const b, const int expected)
+{
+	struct fjson_object *const ja = fjson_tokener_parse(a);
+	struct fjson_object *const jb = fjson_tokener_parse(b);
+
+	if (fjson_object_equal(ja, jb) != expected || fjson_object_equal(jb, ja) != expected) {
+		printf("%s and %s: expected %d\n", a, b, expected);
+		exit(1);
+	}
+	if (expected)
+		CHK(fjson_object_hash(ja) == fjson_object_hash(jb));
+	/* the hashes are known now, and must not change the result */
+	CHK(fjson_object_equal(ja, jb) == expected);
+	fjson_object_put(ja);
+	fjson_object_put(jb);
+}
+
+static void
+test_pairs(void)
+{
+	chk_pair("null", "null", 1);
+	chk_pair("null", "0", 0);
+	chk_pair("true", "true", 1);
+	chk_pair("true", "false", 0);
+	chk_pair("1", "1", 1);
+	chk_pair("1", "1.0", 0);
+	chk_pair("1.5", "1.50", 1);
+	chk_pair("0.0", "-0.0", 1);
+	chk_pair("\"abc\"", "\"abc\"", 1);
+	chk_pair("\"abc\"", "\"abd\"", 0);
+	chk_pair("\"abc\"", "\"ab\"", 0);
+	chk_pair("\"a string longer than a word\"", "\"a string longer than a word\"", 1);
+	chk_pair("[]", "[]", 1);
+	chk_pair("[1,2,3]", "[1,2,3]", 1);
+	chk_pair("[1,2,3]", "[1,3,2]", 0);
+	chk_pair("[1,2]", "[1,2,3]", 0);
+	chk_pair("{}", "{}", 1);
+	chk_pair("{}", "[]", 0);
+	chk_pair("{\"a\":1,\"b\":[true,null]}", "{\"b\":[true,null],\"a\":1}", 1);
+	chk_pair("{\"a\":1,\"b\":2}", "{\"a\":1,\"c\":2}", 0);
+	chk_pair("{\"a\":1,\"b\":2}", "{\"a\":1}", 0);
+	chk_pair("{\"a\":null}", "{\"b\":null}", 0);
+	chk_pair("{\"a\":{\"x\":[1,{\"y\":\"z\"}]}}", "{\"a\":{\"x\":[1,{\"y\":\"z\"}]}}", 1);
+	chk_pair("{\"a\":{\"x\":[1,{\"y\":\"z\"}]}}", "{\"a\":{\"x\":[1,{\"y\":\"Z\"}]}}", 0);
+}
+
+/* trees that differ should, in practice, hash differently */
+static void
+test_distinct(void)
+{
+	static const char *const texts[] = {
+		"null", "true", "false", "0", "1", "-1", "0.5", "\"\"", "\"0\"", "\"1\"",
+		"[]", "{}", "[null]", "[[]]", "[{}]", "{\"\":null}", "{\"a\":null}",
+		"{\"a\":[]}", "{\"a\":{}}", "[1,2]", "[2,1]", "{\"a\":1,\"b\":2}",
+		"{\"a\":2,\"b\":1}", "{\"ab\":1}", "{\"a\":{\"b\":1}}", "[\"a\",\"b\"]",
+		"[\"ab\"]", "\"12345678\"", "\"123456789\"", "\"12345678\\u0000\"",
+	};
+	uint64_t hashes[sizeof(texts) / sizeof(texts[0])];
+	size_t i, j;
+
+	for (i = 0 ; i < sizeof(texts) / sizeof(texts[0]) ; ++i) {
+		struct fjson_object *const jso = fjson_tokener_parse(texts[i]);
+		hashes[i] = fjson_object_hash(jso);
+		for (j = 0 ; j < i ; ++j) {
+			if (hashes[i] == hashes[j]) {
+				printf("%s and %s hash the same\n", texts[i], texts[j]);
+				exit(1);
+			}
+		}
+		fjson_object_put(jso);
+	}
+}
+
+static void
+test_storage(void)
+{
+	static const int64_t ivals[] = { 1, -2, 3 };
+	static const double dvals[] = { 0.5, -0.0 };
+	struct fjson_object *a, *b;
+	struct fjson_ctx *ctx;
+
+	/* packed arrays are the same as regular ones */
+	a = fjson_object_new_array_int64(ivals, 3);
+	b = fjson_tokener_parse("[1,-2,3]");
+	CHK(fjson_object_equal(a, b) && fjson_object_equal(b, a));
+	CHK(fjson_object_hash(a) == fjson_object_hash(b));
+	fjson_object_put(b);
+	b = fjson_object_new_array_int64(ivals, 3);
+	CHK(fjson_object_equal(a, b));
+	fjson_object_array_add_int64(b, 4);
+	CHK(!fjson_object_equal(a, b));
+	fjson_object_put(b);
+	b = fjson_object_new_array_double(dvals, 2);
+	CHK(!fjson_object_equal(a, b));
+	fjson_object_put(a);
+	a = fjson_tokener_parse("[0.5,0.0]");
+	CHK(fjson_object_equal(a, b) && fjson_object_equal(b, a));
+	CHK(fjson_object_hash(a) == fjson_object_hash(b));
+	fjson_object_put(a);
+	fjson_object_put(b);
+
+	/* strings referencing the parser input compare by content */
+	{
+		const char *const text = "{\"k\":\"a value that is too long to be stored in the node\"}";
+		struct fjson_tokener *const tok = fjson_tokener_new();
+		CHK(tok != NULL);
+		fjson_tokener_set_flags(tok, FJSON_TOKENER_ZERO_COPY);
+		a = fjson_tokener_parse_ex(tok, text, (int) strlen(text));
+		b = fjson_tokener_parse(text);
+		CHK(fjson_object_equal(a, b));
+		CHK(fjson_object_hash(a) == fjson_object_hash(b));
+		fjson_object_put(a);
+		fjson_object_put(b);
+		fjson_tokener_free(tok);
+	}
+
+	/* keys are compared as the second object does it */
+	CHK((ctx = fjson_ctx_new()) != NULL);
+	fjson_ctx_set_case_sensitive(ctx, 0);
+	a = fjson_object_new_object_ctx(ctx);
+	fjson_object_object_add(a, "Key", fjson_object_new_int(1));
+	b = fjson_tokener_parse("{\"kEY\":1}");
+	CHK(fjson_object_equal(b, a));
+	CHK(!fjson_object_equal(a, b));
+	CHK(fjson_object_hash(a) == fjson_object_hash(b));
+	fjson_object_put(a);
+	fjson_object_put(b);
+	fjson_ctx_free(ctx);
+}
+
+static void
+test_cached(void)
+{
+	struct fjson_object *const jso = fjson_tokener_parse("{\"a\":{\"b\":{\"c\":1}},\"d\":[{\"e\":2}]}");
+	struct fjson_object *b, *d, *e, *other;
+	uint64_t h;
+
+	CHK(fjson_object_object_get_ex(jso, "a", &b) && fjson_object_object_get_ex(b, "b", &b));
+	CHK(fjson_object_object_get_ex(jso, "d", &d));
+	e = fjson_object_array_get_idx(d, 0);
+	h = fjson_object_hash(jso);
+	CHK(fjson_object_hash(jso) == h);
+
+	/* modifications below an object change its hash */
+	fjson_object_object_add(b, "c", fjson_object_new_int(2));
+	CHK(fjson_object_hash(jso) != h);
+	other = fjson_tokener_parse("{\"a\":{\"b\":{\"c\":2}},\"d\":[{\"e\":2}]}");
+	CHK(fjson_object_hash(jso) == fjson_object_hash(other));
+	CHK(fjson_object_equal(jso, other));
+	fjson_object_object_add(b, "c", fjson_object_new_int(1));
+	CHK(fjson_object_hash(jso) == h);
+	CHK(!fjson_object_equal(jso, other));
+
+	/* also via arrays */
+	fjson_object_object_del(e, "e");
+	CHK(fjson_object_hash(jso) != h);
+	fjson_object_object_add(e, "e", fjson_object_new_int(2));
+	CHK(fjson_object_hash(jso) == h);
+
+	/* a node held twice cannot be tracked, so nothing above it is cached */
+	fjson_object_object_add(other, "shared", fjson_object_get(b));
+	fjson_object_object_add(jso, "shared", fjson_object_get(b));
+	h = fjson_object_hash(jso);
+	fjson_object_object_add(b, "new", NULL);
+	CHK(fjson_object_hash(jso) != h);
+	fjson_object_object_del(b, "new");
+	CHK(fjson_object_hash(jso) == h);
+
+	fjson_object_put(other);
+	fjson_object_put(jso);
+}
+
+/* the hash is the same everywhere, so it can be stored */
+static void
+test_stable(void)
+{
+	struct fjson_object *const jso = fjson_tokener_parse(
+		"{\"msg\":\"hello, world\",\"n\":[1,2.5,true,null],\"o\":{\"K\":\"v\"}}");
+	const uint64_t h = fjson_object_hash(jso);
+	if (h != 0xdae793418183c0deULL) {
+		printf("hash is %#llx\n", (unsigned long long) h);
+		exit(1);
+	}
+	fjson_object_put(jso);
+}
+
+int
+main(int __attribute__((unused)) argc, char __attribute__((unused)) **argv)
+{
+	test_pairs();
+	test_distinct();
+	test_storage();
+	test_cached();
+	test_stable();
+	printf("OK\n");
+	return 0;
+}
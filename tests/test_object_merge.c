@@ -0,0 +1,334 @@
+/* libfastjson testbench tool
+ *
+ * checks fjson_object_object_merge() and fjson_object_merge_patch():
+ * the results must be the same as with adding the members one by one,
+ * consumed objects must hand over their values, and running out of
+ * memory must leave valid objects behind.
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See COPYING for details.
+ *
+ */
+#include "config.h"
+
+#include "../json.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#define CHK(x) if (!(x)) { \
+	printf("%s:%d: unexpected result with '%s'\n", \
+		__FILE__, __LINE__, #x); \
+	exit(1); \
+}
+
+static const char *
+text(struct fjson_object *const jso)
+{
+	return fjson_object_to_json_string_ext(jso, FJSON_TO_STRING_PLAIN);
+}
+
+/* merge b into a, both given as text, and check the result */
+static void
+chk_merge(const char *const a, const char *const b, const unsigned flags,
+	const char *const expected)
+{
+	struct fjson_object *const dst = fjson_tokener_parse(a);
+	struct fjson_object *const src = fjson_tokener_parse(b);
+
+	CHK(dst != NULL && src != NULL);
+	CHK(fjson_object_object_merge(dst, src, flags) == 0);
+	if (strcmp(text(dst), expected) != 0) {
+		printf("merge of %s into %s: expected %s, got %s\n", b, a, expected, text(dst));
+		exit(1);
+	}
+	if (!(flags & FJSON_OBJECT_MERGE_CONSUME)) {
+		CHK(strcmp(text(src), b) == 0);
+		fjson_object_put(src);
+	}
+	fjson_object_put(dst);
+}
+
+static void
+test_merge(void)
+{
+	chk_merge("{\"a\":1,\"b\":2}", "{\"b\":3,\"c\":{\"d\":4}}", 0,
+		"{\"a\":1,\"b\":3,\"c\":{\"d\":4}}");
+	chk_merge("{\"a\":1,\"b\":2}", "{\"b\":3,\"c\":4}", FJSON_OBJECT_MERGE_KEEP_EXISTING,
+		"{\"a\":1,\"b\":2,\"c\":4}");
+	chk_merge("{}", "{\"a\":null,\"b\":[1]}", 0, "{\"a\":null,\"b\":[1]}");
+	chk_merge("{\"a\":1}", "{}", 0, "{\"a\":1}");
+	chk_merge("{\"x\":{\"a\":1,\"b\":{\"c\":1}},\"y\":2}",
+		"{\"x\":{\"b\":{\"d\":2},\"e\":3},\"y\":{\"z\":1}}", FJSON_OBJECT_MERGE_RECURSIVE,
+		"{\"x\":{\"a\":1,\"b\":{\"c\":1,\"d\":2},\"e\":3},\"y\":{\"z\":1}}");
+	chk_merge("{\"x\":{\"a\":1}}", "{\"x\":{\"b\":2}}", 0, "{\"x\":{\"b\":2}}");
+	chk_merge("{\"x\":{\"a\":1},\"b\":2}", "{\"x\":{\"a\":3,\"c\":4},\"b\":5}",
+		FJSON_OBJECT_MERGE_RECURSIVE | FJSON_OBJECT_MERGE_KEEP_EXISTING,
+		"{\"x\":{\"a\":1,\"c\":4},\"b\":2}");
+	chk_merge("{\"x\":{\"a\":1}}", "{\"x\":{\"b\":{\"c\":2}},\"y\":3}",
+		FJSON_OBJECT_MERGE_RECURSIVE | FJSON_OBJECT_MERGE_CONSUME,
+		"{\"x\":{\"a\":1,\"b\":{\"c\":2}},\"y\":3}");
+}
+
+static void
+test_shared_and_moved(void)
+{
+	struct fjson_object *dst = fjson_tokener_parse("{\"a\":1}");
+	struct fjson_object *src = fjson_tokener_parse("{\"b\":{\"c\":1},\"d\":\"text\"}");
+	struct fjson_object *b, *d, *v;
+
+	CHK(fjson_object_object_get_ex(src, "b", &b) && fjson_object_object_get_ex(src, "d", &d));
+
+	/* without consuming, values are shared */
+	CHK(fjson_object_object_merge(dst, src, 0) == 0);
+	CHK(fjson_object_object_get_ex(dst, "b", &v) && v == b);
+	fjson_object_object_add(b, "new", fjson_object_new_int(2));
+	CHK(strcmp(text(dst), "{\"a\":1,\"b\":{\"c\":1,\"new\":2},\"d\":\"text\"}") == 0);
+	fjson_object_put(dst);
+
+	/* consumed, but not held by us alone: just shared */
+	dst = fjson_object_new_object();
+	fjson_object_get(src);
+	CHK(fjson_object_object_merge(dst, src, FJSON_OBJECT_MERGE_CONSUME) == 0);
+	CHK(fjson_object_object_get_ex(dst, "b", &v) && v == b);
+	CHK(fjson_object_object_length(src) == 2);
+	CHK(fjson_object_object_get_ex(src, "d", &v) && v == d);
+	fjson_object_put(dst);
+
+	/* consumed and ours: moved */
+	dst = fjson_object_new_object();
+	CHK(fjson_object_object_merge(dst, src, FJSON_OBJECT_MERGE_CONSUME) == 0);
+	CHK(fjson_object_object_get_ex(dst, "b", &v) && v == b);
+	CHK(fjson_object_object_get_ex(dst, "d", &v) && v == d);
+	CHK(strcmp(text(dst), "{\"b\":{\"c\":1,\"new\":2},\"d\":\"text\"}") == 0);
+	/* and the cached output of dst follows b */
+	fjson_object_object_add(b, "more", NULL);
+	CHK(strcmp(text(dst), "{\"b\":{\"c\":1,\"new\":2,\"more\":null},\"d\":\"text\"}") == 0);
+	fjson_object_put(dst);
+
+	/* a container copy does not see modifications made via dst */
+	src = fjson_tokener_parse("{\"b\":{\"c\":1}}");
+	CHK(fjson_object_copy_containers(src, &v) == 0);
+	dst = fjson_object_new_object();
+	CHK(fjson_object_object_merge(dst, v, FJSON_OBJECT_MERGE_CONSUME) == 0);
+	CHK(fjson_object_object_get_ex(dst, "b", &b));
+	fjson_object_object_add(b, "d", fjson_object_new_int(2));
+	CHK(strcmp(text(dst), "{\"b\":{\"c\":1,\"d\":2}}") == 0);
+	CHK(strcmp(text(src), "{\"b\":{\"c\":1}}") == 0);
+	fjson_object_put(dst);
+	fjson_object_put(src);
+}
+
+/* a wide merge into an object with holes: same result as adding one by one */
+static void
+test_wide(void)
+{
+	struct fjson_object *const dst = fjson_object_new_object();
+	struct fjson_object *const ref = fjson_object_new_object();
+	struct fjson_object *const src = fjson_object_new_object();
+	char key[32];
+	int i;
+
+	CHK(dst != NULL && ref != NULL && src != NULL);
+	for (i = 0 ; i < 20 ; ++i) {
+		snprintf(key, sizeof(key), "k%d", i);
+		fjson_object_object_add(dst, key, fjson_object_new_int(i));
+		fjson_object_object_add(ref, key, fjson_object_new_int(i));
+	}
+	for (i = 0 ; i < 20 ; i += 3) {
+		snprintf(key, sizeof(key), "k%d", i);
+		fjson_object_object_del(dst, key);
+		fjson_object_object_del(ref, key);
+	}
+	fjson_object_object_add_ex(src, "constant", fjson_object_new_int(-1),
+		FJSON_OBJECT_KEY_IS_CONSTANT);
+	for (i = 10 ; i < 1500 ; ++i) {
+		snprintf(key, sizeof(key), "k%d", i);
+		fjson_object_object_add(src, key, fjson_object_new_int(-i));
+	}
+	{
+		struct fjson_object_iterator it = fjson_object_iter_begin(src);
+		struct fjson_object_iterator itEnd = fjson_object_iter_end(src);
+		while (!fjson_object_iter_equal(&it, &itEnd)) {
+			fjson_object_object_add(ref, fjson_object_iter_peek_name(&it),
+				fjson_object_get(fjson_object_iter_peek_value(&it)));
+			fjson_object_iter_next(&it);
+		}
+	}
+
+	CHK(fjson_object_object_merge(dst, src, FJSON_OBJECT_MERGE_CONSUME) == 0);
+	CHK(fjson_object_object_length(dst) == fjson_object_object_length(ref));
+	CHK(strcmp(text(dst), text(ref)) == 0);
+	for (i = 0 ; i < 1500 ; ++i) {
+		struct fjson_object *v;
+		snprintf(key, sizeof(key), "k%d", i);
+		CHK(fjson_object_object_get_ex(dst, key, &v) == (i < 10 ? i % 3 != 0 : 1));
+	}
+	fjson_object_put(dst);
+	fjson_object_put(ref);
+}
+
+static void
+test_errors(void)
+{
+	struct fjson_object *const obj = fjson_tokener_parse("{\"a\":1}");
+	struct fjson_object *const arr = fjson_object_new_array();
+	struct fjson_object *copy;
+	struct fjson_arena *arena;
+	struct fjson_tokener *tok;
+
+	errno = 0;
+	CHK(fjson_object_object_merge(obj, arr, 0) == -1 && errno == EINVAL);
+	errno = 0;
+	CHK(fjson_object_object_merge(arr, obj, 0) == -1 && errno == EINVAL);
+	errno = 0;
+	CHK(fjson_object_object_merge(obj, NULL, 0) == -1 && errno == EINVAL);
+	/* a consumed src is released in any case */
+	CHK(fjson_object_object_merge(obj, arr, FJSON_OBJECT_MERGE_CONSUME) == -1);
+	/* merging into itself changes nothing */
+	CHK(fjson_object_object_merge(obj, obj, 0) == 0);
+	CHK(strcmp(text(obj), "{\"a\":1}") == 0);
+
+	/* values of arena trees are copied out of it */
+	CHK((arena = fjson_arena_new(0)) != NULL);
+	CHK((tok = fjson_tokener_new()) != NULL);
+	fjson_tokener_set_arena(tok, arena);
+	copy = fjson_tokener_parse_ex(tok, "{\"b\":{\"c\":[1,\"x\"]},\"a\":2}", -1);
+	CHK(copy != NULL);
+	CHK(fjson_object_object_merge(obj, copy, FJSON_OBJECT_MERGE_CONSUME) == 0);
+	fjson_tokener_free(tok);
+	fjson_arena_free(arena);
+	CHK(strcmp(text(obj), "{\"a\":2,\"b\":{\"c\":[1,\"x\"]}}") == 0);
+	fjson_object_put(obj);
+}
+
+static long mallocs_left;
+
+static void *
+t_malloc(const size_t size)
+{
+	return (mallocs_left-- > 0) ? malloc(size) : NULL;
+}
+
+static void *
+t_realloc(void *const ptr, const size_t size)
+{
+	return (mallocs_left-- > 0) ? realloc(ptr, size) : NULL;
+}
+
+static void
+test_nomem(void)
+{
+	static const char *const src_text =
+		"{\"a\":{\"x\":1,\"y\":{\"z\":null}},\"b\":\"some text\",\"c\":[1,2],\"d\":null}";
+	static const char *const expected_merge =
+		"{\"a\":{\"p\":0,\"x\":1,\"y\":{\"z\":null}},\"q\":1,\"b\":\"some text\",\"c\":[1,2],\"d\":null}";
+	static const char *const expected_patch =
+		"{\"a\":{\"p\":0,\"x\":1,\"y\":{}},\"q\":1,\"b\":\"some text\",\"c\":[1,2]}";
+	struct fjson_object *const src = fjson_tokener_parse(src_text);
+	int n, r;
+
+	CHK(src != NULL);
+	for (n = 0 ; ; ++n) {
+		struct fjson_object *dst = fjson_tokener_parse("{\"a\":{\"p\":0},\"q\":1}");
+		CHK(dst != NULL);
+		mallocs_left = n;
+		fjson_global_set_allocator(t_malloc, t_realloc, free);
+		errno = 0;
+		r = fjson_object_object_merge(dst, src, FJSON_OBJECT_MERGE_RECURSIVE);
+		fjson_global_set_allocator(NULL, NULL, NULL);
+		CHK(r == 0 || errno == ENOMEM);
+		CHK(strcmp(text(src), src_text) == 0);
+		text(dst); /* whatever was merged, it is a valid object */
+		if (r == 0)
+			CHK(strcmp(text(dst), expected_merge) == 0);
+		fjson_object_put(dst);
+		if (r == 0)
+			break;
+	}
+	for (n = 0 ; ; ++n) {
+		struct fjson_object *dst = fjson_tokener_parse("{\"a\":{\"p\":0},\"q\":1,\"d\":5}");
+		CHK(dst != NULL);
+		mallocs_left = n;
+		fjson_global_set_allocator(t_malloc, t_realloc, free);
+		errno = 0;
+		r = fjson_object_merge_patch(&dst, src);
+		fjson_global_set_allocator(NULL, NULL, NULL);
+		CHK(r == 0 || errno == ENOMEM);
+		CHK(strcmp(text(src), src_text) == 0);
+		text(dst);
+		if (r == 0)
+			CHK(strcmp(text(dst), expected_patch) == 0);
+		fjson_object_put(dst);
+		if (r == 0)
+			break;
+	}
+	fjson_object_put(src);
+}
+
+/* the examples of RFC 7396, appendix A */
+static void
+test_patch(void)
+{
+	static const char *const cases[][3] = {
+		{ "{\"a\":\"b\"}", "{\"a\":\"c\"}", "{\"a\":\"c\"}" },
+		{ "{\"a\":\"b\"}", "{\"b\":\"c\"}", "{\"a\":\"b\",\"b\":\"c\"}" },
+		{ "{\"a\":\"b\"}", "{\"a\":null}", "{}" },
+		{ "{\"a\":\"b\",\"b\":\"c\"}", "{\"a\":null}", "{\"b\":\"c\"}" },
+		{ "{\"a\":[\"b\"]}", "{\"a\":\"c\"}", "{\"a\":\"c\"}" },
+		{ "{\"a\":\"c\"}", "{\"a\":[\"b\"]}", "{\"a\":[\"b\"]}" },
+		{ "{\"a\":{\"b\":\"c\"}}", "{\"a\":{\"b\":\"d\",\"c\":null}}", "{\"a\":{\"b\":\"d\"}}" },
+		{ "{\"a\":[{\"b\":\"c\"}]}", "{\"a\":[1]}", "{\"a\":[1]}" },
+		{ "[\"a\",\"b\"]", "[\"c\",\"d\"]", "[\"c\",\"d\"]" },
+		{ "{\"a\":\"b\"}", "[\"c\"]", "[\"c\"]" },
+		{ "{\"a\":\"foo\"}", "null", "null" },
+		{ "{\"a\":\"foo\"}", "\"bar\"", "\"bar\"" },
+		{ "{\"e\":null}", "{\"a\":1}", "{\"e\":null,\"a\":1}" },
+		{ "[1,2]", "{\"a\":\"b\",\"c\":null}", "{\"a\":\"b\"}" },
+		{ "{}", "{\"a\":{\"bb\":{\"ccc\":null}}}", "{\"a\":{\"bb\":{}}}" },
+	};
+	size_t i;
+
+	for (i = 0 ; i < sizeof(cases) / sizeof(cases[0]) ; ++i) {
+		struct fjson_object *target = fjson_tokener_parse(cases[i][0]);
+		struct fjson_object *const patch = fjson_tokener_parse(cases[i][1]);
+		CHK(fjson_object_merge_patch(&target, patch) == 0);
+		if (strcmp(text(target), cases[i][2]) != 0) {
+			printf("patch %s on %s: expected %s, got %s\n",
+				cases[i][1], cases[i][0], cases[i][2], text(target));
+			exit(1);
+		}
+		CHK(strcmp(text(patch), cases[i][1]) == 0);
+		fjson_object_put(target);
+		fjson_object_put(patch);
+	}
+
+	/* a container copy of the target is patched independently */
+	{
+		struct fjson_object *const orig = fjson_tokener_parse("{\"a\":{\"b\":1,\"c\":2}}");
+		struct fjson_object *const patch = fjson_tokener_parse("{\"a\":{\"b\":null}}");
+		struct fjson_object *copy;
+		CHK(fjson_object_copy_containers(orig, &copy) == 0);
+		CHK(fjson_object_merge_patch(&copy, patch) == 0);
+		CHK(strcmp(text(copy), "{\"a\":{\"c\":2}}") == 0);
+		CHK(strcmp(text(orig), "{\"a\":{\"b\":1,\"c\":2}}") == 0);
+		fjson_object_put(copy);
+		fjson_object_put(orig);
+		fjson_object_put(patch);
+	}
+}
+
+int
+main(int __attribute__((unused)) argc, char __attribute__((unused)) **argv)
+{
+	test_merge();
+	test_shared_and_moved();
+	test_wide();
+	test_errors();
+	test_nomem();
+	test_patch();
+	printf("OK\n");
+	return 0;
+}
@@ -0,0 +1,143 @@
+/* libfastjson testbench tool
+ *
+ * checks packed numeric arrays: they must behave like regular arrays
+ * of int and double nodes, in serialization as well as when elements
+ * are accessed, changed or deleted.
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See COPYING for details.
+ *
+ */
+#include "config.h"
+
+#include "../json.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CHK(x) if (!(x)) { \
+	printf("%s:%d: unexpected result with '%s'\n", \
+		__FILE__, __LINE__, #x); \
+	exit(1); \
+}
+
+#define NSAMPLES 10000
+
+static char dumped[1024];
+static size_t ndumped;
+
+static size_t
+str_sink(void __attribute__((unused)) *ptr, const char *buffer, size_t size)
+{
+	if (ndumped + size < sizeof(dumped)) {
+		memcpy(dumped + ndumped, buffer, size);
+		ndumped += size;
+		dumped[ndumped] = '\0';
+	}
+	return size;
+}
+
+/* the output of the regular serializer and of the dump functions must match */
+static void
+print(struct fjson_object *const jso, const int flags)
+{
+	const char *const s = fjson_object_to_json_string_ext(jso, flags);
+	ndumped = 0;
+	fjson_object_dump_ext(jso, flags, str_sink, NULL);
+	CHK(!strcmp(s, dumped));
+	printf("%s\n", s);
+}
+
+int
+main(int __attribute__((unused)) argc, char __attribute__((unused)) **argv)
+{
+	static const int64_t ivals[] = { 1, -1, 300, INT64_C(1) << 40 };
+	static const double dvals[] = { 0.5, -2.0, 1e100 };
+	struct fjson_object *arr, *obj, *elem, *held;
+	const int64_t *i64;
+	const double *d;
+	int i, n;
+
+	/* basics */
+	arr = fjson_object_new_array_int64(ivals, 4);
+	CHK(fjson_object_is_type(arr, fjson_type_array));
+	CHK(fjson_object_array_length(arr) == 4);
+	print(arr, FJSON_TO_STRING_SPACED);
+	print(arr, FJSON_TO_STRING_PRETTY);
+	i64 = fjson_object_array_get_int64_data(arr, &n);
+	CHK(i64 != NULL && n == 4 && i64[3] == INT64_C(1) << 40);
+	CHK(fjson_object_array_get_double_data(arr, NULL) == NULL);
+	elem = fjson_object_array_get_idx(arr, 2);
+	CHK(fjson_object_get_int64(elem) == 300);
+	CHK(fjson_object_array_get_idx(arr, 2) == elem);
+	CHK(fjson_object_array_get_idx(arr, 4) == NULL);
+	CHK(fjson_object_array_get_idx(arr, -1) == NULL);
+	held = fjson_object_get(elem);
+	fjson_object_put(arr);
+	CHK(fjson_object_get_int64(held) == 300);
+	fjson_object_put(held);
+
+	arr = fjson_object_new_array_double(dvals, 3);
+	print(arr, FJSON_TO_STRING_PLAIN);
+	CHK(fjson_object_get_double(fjson_object_array_get_idx(arr, 0)) == 0.5);
+	CHK(fjson_object_array_get_int64_data(arr, NULL) == NULL);
+	d = fjson_object_array_get_double_data(arr, &n);
+	CHK(d != NULL && n == 3 && d[2] == 1e100);
+	fjson_object_put(arr);
+
+	arr = fjson_object_new_array_double(NULL, 0);
+	print(arr, FJSON_TO_STRING_SPACED);
+	fjson_object_put(arr);
+
+	/* growing, with the output of the containing object cached */
+	obj = fjson_object_new_object();
+	arr = fjson_object_new_array_int64(NULL, 0);
+	fjson_object_object_add(obj, "samples", arr);
+	print(obj, FJSON_TO_STRING_PLAIN);
+	for (i = 0 ; i < NSAMPLES ; ++i)
+		CHK(fjson_object_array_add_int64(arr, i) == 0);
+	CHK(fjson_object_array_shrink_to_fit(arr) == 0);
+	i64 = fjson_object_array_get_int64_data(arr, &n);
+	CHK(n == NSAMPLES && i64[NSAMPLES - 1] == NSAMPLES - 1);
+	CHK(fjson_object_get_int(fjson_object_array_get_idx(arr, 5000)) == 5000);
+	CHK(fjson_object_array_del_range(arr, 3, NSAMPLES - 6) == 0);
+	CHK(fjson_object_get_int(fjson_object_array_get_idx(arr, 3)) == NSAMPLES - 3);
+	print(obj, FJSON_TO_STRING_PLAIN);
+	CHK(fjson_object_array_reserve(arr, 100) == 0);
+	CHK(fjson_object_array_add_int64(arr, -5) == 0);
+	print(obj, FJSON_TO_STRING_PLAIN);
+
+	/* changes that do not fit convert it into a regular array */
+	elem = fjson_object_array_get_idx(arr, 1);
+	CHK(fjson_object_array_add_double(arr, 2.5) == 0);
+	CHK(fjson_object_array_get_int64_data(arr, NULL) == NULL);
+	CHK(fjson_object_array_get_idx(arr, 1) == elem);
+	CHK(fjson_object_array_length(arr) == 8);
+	print(obj, FJSON_TO_STRING_PLAIN);
+	fjson_object_put(obj);
+
+	arr = fjson_object_new_array_int64(ivals, 4);
+	fjson_object_array_put_idx(arr, 1, fjson_object_new_string("x"));
+	print(arr, FJSON_TO_STRING_PLAIN);
+	fjson_object_put(arr);
+
+	arr = fjson_object_new_array_double(dvals, 3);
+	held = fjson_object_get(fjson_object_array_get_idx(arr, 2));
+	CHK(fjson_object_array_add_int64(arr, 7) == 0);
+	CHK(fjson_object_array_add(arr, fjson_object_get(held)) == 0);
+	print(arr, FJSON_TO_STRING_PLAIN);
+	fjson_object_put(held);
+	fjson_object_put(arr);
+
+	/* regular arrays take typed adds as well */
+	arr = fjson_object_new_array();
+	CHK(fjson_object_array_add_int64(arr, 42) == 0);
+	CHK(fjson_object_array_add_double(arr, 0.25) == 0);
+	CHK(fjson_object_array_get_int64_data(arr, NULL) == NULL);
+	print(arr, FJSON_TO_STRING_PLAIN);
+	fjson_object_put(arr);
+
+	printf("OK\n");
+	return 0;
+}
@@ -0,0 +1,341 @@
+/* libfastjson testbench tool
+ *
+ * checks fjson_tokener_parse_indexed(): the trees (and errors) must be
+ * what the tokener makes of the same text, for all kinds of input,
+ * settings and part counts.
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See COPYING for details.
+ *
+ */
+#include "config.h"
+
+#include "../json.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdint.h>
+
+#define CHK(x) if (!(x)) { \
+	printf("%s:%d: unexpected result with '%s'\n", \
+		__FILE__, __LINE__, #x); \
+	exit(1); \
+}
+
+static uint64_t rnd = 0x9e3779b97f4a7c15ull;
+
+static unsigned
+rand_next(void)
+{
+	rnd ^= rnd << 13;
+	rnd ^= rnd >> 7;
+	rnd ^= rnd << 17;
+	return (unsigned) (rnd >> 32);
+}
+
+/* an executor that runs the tasks backwards, to catch order dependencies */
+static void
+backwards(void *const ctx, fjson_task_fn *const fn, void *const *const args, const int ntasks)
+{
+	int i;
+	++*(int *) ctx;
+	for (i = ntasks - 1 ; i >= 0 ; --i)
+		fn(args[i]);
+}
+
+/* what the tokener makes of all of text */
+static struct fjson_object *
+ref_parse(struct fjson_tokener *const tok, const char *const text, const size_t len)
+{
+	struct fjson_object *obj;
+	fjson_tokener_reset(tok);
+	obj = fjson_tokener_parse_ex(tok, text, (int) len);
+	if (fjson_tokener_get_error(tok) == fjson_tokener_continue)
+		obj = fjson_tokener_parse_ex(tok, "", 1);
+	if (fjson_tokener_get_error(tok) != fjson_tokener_success) {
+		fjson_object_put(obj);
+		obj = NULL;
+	}
+	return obj;
+}
+
+static void
+chk_same(struct fjson_object *const a, struct fjson_object *const b, const char *const text)
+{
+	const char *const sa = fjson_object_to_json_string_ext(a, FJSON_TO_STRING_PLAIN);
+	const char *const sb = fjson_object_to_json_string_ext(b, FJSON_TO_STRING_PLAIN);
+	if (!fjson_object_equal(a, b) || strcmp(sa, sb) != 0) {
+		printf("different trees for %.200s:\n%.200s\n%.200s\n", text, sa, sb);
+		exit(1);
+	}
+}
+
+static int ncalls;
+
+/* parse text with the given settings and all part counts */
+static void
+check_ex(const char *const text, const size_t len, const int flags, const int depth,
+	const struct fjson_ctx *const ctx, struct fjson_arena *const arena)
+{
+	struct fjson_tokener *const tok = fjson_tokener_new_ctx(depth, ctx);
+	struct fjson_object *expected;
+	enum fjson_tokener_error err;
+	int nparts;
+
+	CHK(tok != NULL);
+	fjson_tokener_set_flags(tok, flags);
+	expected = ref_parse(tok, text, len);
+	err = fjson_tokener_get_error(tok);
+	fjson_tokener_set_arena(tok, arena);
+	for (nparts = 1 ; nparts <= 7 ; nparts += 3) {
+		struct fjson_object *const obj = fjson_tokener_parse_indexed(tok, text, len, nparts,
+			(nparts % 2) ? NULL : backwards, &ncalls);
+		if (fjson_tokener_get_error(tok) != err) {
+			printf("%.200s: error %d instead of %d\n", text,
+				(int) fjson_tokener_get_error(tok), (int) err);
+			exit(1);
+		}
+		chk_same(obj, expected, text);
+		if (arena == NULL)
+			fjson_object_put(obj);
+	}
+	fjson_object_put(expected);
+	fjson_tokener_free(tok);
+}
+
+static void
+check(const char *const text)
+{
+	static const int flags[] = {
+		0, FJSON_TOKENER_STRICT, FJSON_TOKENER_ZERO_COPY, FJSON_TOKENER_LOCAL_REFCOUNT
+	};
+	size_t f;
+	for (f = 0 ; f < sizeof(flags) / sizeof(flags[0]) ; ++f)
+		check_ex(text, strlen(text), flags[f], FJSON_TOKENER_DEFAULT_DEPTH, NULL, NULL);
+}
+
+static void
+test_values(void)
+{
+	static const char *const texts[] = {
+		/* RFC 8259 JSON, built by stage two */
+		"null", "true", "false", "0", "-0", "123", "-9223372036854775808",
+		"9223372036854775807", "1.5", "-0.25e-3", "1E400", "2.5e+10", "\"\"", "\"abc\"",
+		"  [ 1 , 2 ,\t3 ]\n", "[]", "{}", "[[],{},[[]],{\"a\":{}}]",
+		"{\"a\":1,\"b\":[true,false,null],\"c\":{\"d\":\"e\"}}",
+		"{\"a\":1,\"a\":2}", "{\"\":0}", "[\"a\\\"b\",\"\\\\\",\"\\/\\b\\f\\n\\r\\t\"]",
+		"[\"\\u00e4\\u20ac\\ud83d\\ude00\",\"\\u0000x\",\"\\ud800\",\"\\udc00\",\"\\ud800\\u0041\"]",
+		"[\"\\ud800\\ud800\\udc00\",\"\\ud83d\\ude00\\ud83d\"]",
+		"{\"k\\u00e4y\":1,\"tab\\tkey\":2,\"nul\\u0000key\":3}",
+		"[\"raw\tcontrol\x01chars\"]", "[12345678901234567890]", "[1.0,1.50,100e-2]",
+		"[\"a string that is too long to be stored inside of the object\"]",
+		"{\"nested\":[{\"deep\":[{\"deeper\":[1,2,{\"deepest\":\"x\"}]}]}]}",
+		/* left to the tokener */
+		"[1,2,]", "{\"a\":1,}", "[01]", "[1.]", "[.5]", "[-]", "[1e]", "[+1]",
+		"[Infinity,-Infinity]", "[TRUE,False,NULL]", "['single']", "{'a':1}",
+		"/* comment */ [1]", "[1] // comment", "[1] x", "[1]]", "{\"a\" 1}", "{\"a\":1 \"b\":2}",
+		"[1 2]", "{1:2}", "[\"\\x\"]", "[\"\\u12\"]", "[\"\\u12g4\"]", "[\"open",
+		"[1", "{\"a\":", "{\"a\"", "{", "[", "", "   ", "\"\\", "]", "}", ",", ":",
+		"[}", "{]", "[{]}", "[1}", "[\"a\"}", "nul", "tru", "-", "[\"x\\\"]",
+	};
+	size_t i;
+	for (i = 0 ; i < sizeof(texts) / sizeof(texts[0]) ; ++i)
+		check(texts[i]);
+	/* NUL bytes, in and outside of strings */
+	check_ex("[\"a\0b\"]", 7, 0, FJSON_TOKENER_DEFAULT_DEPTH, NULL, NULL);
+	check_ex("{\"a\0b\":1}", 9, 0, FJSON_TOKENER_DEFAULT_DEPTH, NULL, NULL);
+	check_ex("[1]\0", 4, 0, FJSON_TOKENER_DEFAULT_DEPTH, NULL, NULL);
+}
+
+static void
+test_settings(void)
+{
+	static const char *const texts[] = {
+		"1", "[1]", "[[1]]", "{\"a\":[1]}", "[[1],[2],[3]]", "[{\"a\":{\"b\":1}},{\"a\":2}]",
+	};
+	struct fjson_keydict *const keys = fjson_keydict_new(0);
+	struct fjson_ctx *const ctx = fjson_ctx_new();
+	struct fjson_arena *const arena = fjson_arena_new(0);
+	size_t i;
+	int depth;
+
+	CHK(keys != NULL && ctx != NULL && arena != NULL);
+	for (i = 0 ; i < sizeof(texts) / sizeof(texts[0]) ; ++i) {
+		for (depth = 1 ; depth <= 4 ; ++depth)
+			check_ex(texts[i], strlen(texts[i]), 0, depth, NULL, NULL);
+	}
+	check_ex("{\"Key\":1,\"kEY\":2,\"o\":{\"A\":1}}", 29, 0, FJSON_TOKENER_DEFAULT_DEPTH, NULL, arena);
+	fjson_ctx_set_case_sensitive(ctx, 0);
+	check_ex("{\"Key\":1,\"kEY\":2,\"o\":{\"A\":1}}", 29, 0, FJSON_TOKENER_DEFAULT_DEPTH, ctx, NULL);
+	fjson_ctx_set_case_sensitive(ctx, 1);
+	fjson_ctx_set_keydict(ctx, keys);
+	check_ex("[{\"k\":1,\"l\\u00e4\":2},{\"k\":3}]", 29, 0, FJSON_TOKENER_DEFAULT_DEPTH, ctx, NULL);
+	check_ex("[{\"k\":1,\"l\\u00e4\":2},{\"k\":3}]", 29, 0, FJSON_TOKENER_DEFAULT_DEPTH, ctx, arena);
+	fjson_arena_free(arena);
+	fjson_ctx_free(ctx);
+	fjson_keydict_free(keys);
+}
+
+/* large texts, so that stage one runs in parts */
+
+struct gen {
+	char *buf;
+	size_t len;
+	size_t size;
+};
+
+static void __attribute__((format(printf, 2, 3)))
+gen_add(struct gen *const g, const char *const fmt, ...)
+{
+	va_list ap;
+	int n;
+	if (g->size - g->len < 4096) {
+		g->size = (g->size == 0) ? 1 << 20 : g->size * 2;
+		CHK((g->buf = realloc(g->buf, g->size)) != NULL);
+	}
+	va_start(ap, fmt);
+	n = vsnprintf(g->buf + g->len, g->size - g->len, fmt, ap);
+	va_end(ap);
+	CHK(n >= 0 && (size_t) n < g->size - g->len);
+	g->len += n;
+}
+
+static void
+gen_value(struct gen *const g, const int depth)
+{
+	static const char *const strs[] = {
+		"plain", "with \\\"quotes\\\"", "back\\\\slash\\\\", "\\u00e4\\ud83d\\ude00",
+		"a longer string, so that it does not fit into the object itself", "", "\\\\\\\\\\\""
+	};
+	const unsigned r = rand_next();
+	int i, n;
+	switch ((depth > 3) ? r % 5 : r % 8) {
+	case 0: gen_add(g, "%d", (int) (r >> 8) - (1 << 23)); break;
+	case 1: gen_add(g, "%.*g", 1 + (int) (r >> 28), (double) (r >> 4) / 977.0); break;
+	case 2: gen_add(g, "\"%s\"", strs[(r >> 8) % 7]); break;
+	case 3: gen_add(g, "%s", (r & 0x100) ? "true" : (r & 0x200) ? "false" : "null"); break;
+	case 4: gen_add(g, "\"s%u\"", r >> 12); break;
+	case 5:
+	case 6:
+		n = (int) ((r >> 8) % 6);
+		gen_add(g, "[");
+		for (i = 0 ; i < n ; ++i) {
+			gen_add(g, (i > 0) ? ", " : "");
+			gen_value(g, depth + 1);
+		}
+		gen_add(g, "]");
+		break;
+	default:
+		n = (int) ((r >> 8) % 6);
+		gen_add(g, "{");
+		for (i = 0 ; i < n ; ++i) {
+			gen_add(g, "%s\"key%u\\tx\": ", (i > 0) ? ",\n" : "", (r >> (i + 10)) & 7);
+			gen_value(g, depth + 1);
+		}
+		gen_add(g, "}");
+		break;
+	}
+}
+
+static void
+test_large(void)
+{
+	struct fjson_arena *const arena = fjson_arena_new(0);
+	struct gen g = { NULL, 0, 0 };
+	size_t i;
+
+	CHK(arena != NULL);
+	/* an array of many elements */
+	gen_add(&g, "[");
+	for (i = 0 ; g.len < 400 * 1024 ; ++i) {
+		gen_add(&g, (i > 0) ? ",\n" : "");
+		gen_value(&g, 0);
+	}
+	gen_add(&g, "]");
+	check_ex(g.buf, g.len, 0, FJSON_TOKENER_DEFAULT_DEPTH, NULL, NULL);
+	check_ex(g.buf, g.len, FJSON_TOKENER_ZERO_COPY, FJSON_TOKENER_DEFAULT_DEPTH, NULL, arena);
+	fjson_arena_reset(arena);
+	/* broken at the very end */
+	g.buf[g.len - 1] = '}';
+	check_ex(g.buf, g.len, 0, FJSON_TOKENER_DEFAULT_DEPTH, NULL, NULL);
+
+	/* an object, with runs of escapes across the part boundaries */
+	g.len = 0;
+	gen_add(&g, "{\"start\":1");
+	for (i = 0 ; g.len < 300 * 1024 ; ++i) {
+		size_t k, n = rand_next() % 5000;
+		gen_add(&g, ",\"k%u\":\"", (unsigned) i);
+		for (k = 0 ; k < n ; k += 8)
+			gen_add(&g, (rand_next() & 1) ? "\\\\\\\\\\\\\\\\" : "\\\"\\\"\\n}],\"");
+		gen_add(&g, "\",\"v%u\":", (unsigned) i);
+		gen_value(&g, 0);
+	}
+	gen_add(&g, "}");
+	check_ex(g.buf, g.len, 0, FJSON_TOKENER_DEFAULT_DEPTH, NULL, NULL);
+
+	free(g.buf);
+	fjson_arena_free(arena);
+}
+
+/* allocation failures */
+
+static int mallocs_left;
+
+static void *
+t_malloc(const size_t size)
+{
+	return (mallocs_left-- > 0) ? malloc(size) : NULL;
+}
+
+static void *
+t_realloc(void *const ptr, const size_t size)
+{
+	return (mallocs_left-- > 0) ? realloc(ptr, size) : NULL;
+}
+
+static void
+test_nomem(void)
+{
+	/* the strings fit into the printbufs as they are when created */
+	static const char text[] = "[{\"a\":[1,2.5,\"x\\ty\"],\"b\":{\"c\":null}},{\"d\":\"e\"},[3],4]";
+	struct fjson_tokener *const tok = fjson_tokener_new();
+	struct fjson_object *const expected = fjson_tokener_parse(text);
+	int nparts, n;
+
+	CHK(tok != NULL && expected != NULL);
+	for (nparts = 1 ; nparts <= 3 ; nparts += 2) {
+		for (n = 0 ; ; ++n) {
+			struct fjson_object *obj;
+			mallocs_left = n;
+			fjson_global_set_allocator(t_malloc, t_realloc, free);
+			obj = fjson_tokener_parse_indexed(tok, text, strlen(text), nparts, NULL, NULL);
+			fjson_global_set_allocator(NULL, NULL, NULL);
+			if (obj == NULL) {
+				CHK(fjson_tokener_get_error(tok) == fjson_tokener_error_memory);
+				continue;
+			}
+			CHK(fjson_tokener_get_error(tok) == fjson_tokener_success);
+			chk_same(obj, expected, text);
+			fjson_object_put(obj);
+			break;
+		}
+		/* the index, the parser's buffers, and the tree */
+		CHK(n > 10);
+	}
+	fjson_object_put(expected);
+	fjson_tokener_free(tok);
+}
+
+int
+main(int __attribute__((unused)) argc, char __attribute__((unused)) **argv)
+{
+	test_values();
+	test_settings();
+	test_large();
+	test_nomem();
+	CHK(ncalls > 0);
+	printf("OK\n");
+	return 0;
+}
@@ -0,0 +1,119 @@
+/* libfastjson testbench tool
+ *
+ * checks fjson_tokener_parse_inplace(): string values must be unescaped
+ * into the input buffer and be referenced there, unless they are short
+ * or span multiple calls.
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See COPYING for details.
+ *
+ */
+#include "config.h"
+
+#include "../json.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CHK(x) if (!(x)) { \
+	printf("%s:%d: unexpected result with '%s'\n", \
+		__FILE__, __LINE__, #x); \
+	exit(1); \
+}
+
+static const char *const input =
+	"{\"long\": \"a string value that is too long for the node\","
+	" \"esc\": \"tab\\there, quote \\\" and \\u00e4\\ud83d\\ude00 in a long string\","
+	" \"short\": \"s\\n\", \"empty\": \"\", \"list\": [\"another value that is long enough\", 1]}";
+
+/* member k of jso, which must exist */
+static const char *
+member(struct fjson_object *const jso, const char *const k)
+{
+	struct fjson_object *v = NULL;
+	CHK(fjson_object_object_get_ex(jso, k, &v));
+	return fjson_object_get_string(v);
+}
+
+static struct fjson_object *
+list(struct fjson_object *const jso)
+{
+	struct fjson_object *v = NULL;
+	CHK(fjson_object_object_get_ex(jso, "list", &v));
+	return v;
+}
+
+static int
+in_buf(const char *const s, const char *const buf)
+{
+	return s >= buf && s < buf + strlen(input);
+}
+
+int
+main(int __attribute__((unused)) argc, char __attribute__((unused)) **argv)
+{
+	struct fjson_tokener *tok;
+	struct fjson_arena *arena;
+	struct fjson_object *jso, *reference;
+	char *buf;
+	const char *s;
+	const size_t len = strlen(input);
+
+	reference = fjson_tokener_parse(input);
+	CHK(reference != NULL);
+	CHK((tok = fjson_tokener_new()) != NULL);
+	CHK((buf = malloc(len + 1)) != NULL);
+
+	/* referenced in the buffer */
+	memcpy(buf, input, len + 1);
+	jso = fjson_tokener_parse_inplace(tok, buf, len);
+	CHK(jso != NULL);
+	CHK(!strcmp(fjson_object_to_json_string(jso), fjson_object_to_json_string(reference)));
+	printf("%s\n", fjson_object_to_json_string(jso));
+	CHK(in_buf(member(jso, "long"), buf));
+	CHK(in_buf(member(jso, "esc"), buf));
+	CHK(!in_buf(member(jso, "short"), buf));
+	CHK(!strcmp(member(jso, "esc"), "tab\there, quote \" and \xc3\xa4\xf0\x9f\x98\x80 in a long string"));
+	CHK(fjson_object_get_string_len(fjson_object_array_get_idx(list(jso), 0)) == 33);
+	CHK(in_buf(fjson_object_get_string(fjson_object_array_get_idx(list(jso), 0)), buf));
+
+	/* materialized strings do not depend on the buffer any longer */
+	CHK(fjson_object_materialize(jso) == 0);
+	s = member(jso, "esc");
+	CHK(!in_buf(s, buf));
+	memset(buf, 'x', len);
+	CHK(!strcmp(s, "tab\there, quote \" and \xc3\xa4\xf0\x9f\x98\x80 in a long string"));
+	printf("%s\n", fjson_object_to_json_string(jso));
+	fjson_object_put(jso);
+
+	/* in pieces, strings that span calls are copied */
+	memcpy(buf, input, len + 1);
+	fjson_tokener_reset(tok);
+	CHK(fjson_tokener_parse_inplace(tok, buf, 20) == NULL);
+	CHK(fjson_tokener_get_error(tok) == fjson_tokener_continue);
+	jso = fjson_tokener_parse_inplace(tok, buf + 20, len - 20);
+	CHK(jso != NULL);
+	CHK(!in_buf(member(jso, "long"), buf));
+	CHK(in_buf(member(jso, "esc"), buf));
+	printf("%s\n", fjson_object_to_json_string(jso));
+	fjson_object_put(jso);
+
+	/* with an arena, and NUL-terminated */
+	CHK((arena = fjson_arena_new(0)) != NULL);
+	fjson_tokener_reset(tok);
+	fjson_tokener_set_arena(tok, arena);
+	memcpy(buf, input, len + 1);
+	jso = fjson_tokener_parse_inplace(tok, buf, -1);
+	CHK(jso != NULL);
+	CHK(in_buf(member(jso, "esc"), buf));
+	printf("%s\n", fjson_object_to_json_string(jso));
+	fjson_object_put(jso);
+	fjson_tokener_free(tok);
+	fjson_arena_free(arena);
+
+	fjson_object_put(reference);
+	free(buf);
+	printf("OK\n");
+	return 0;
+}
@@ -0,0 +1,95 @@
+/* libfastjson testbench tool
+ *
+ * checks block pooling: freed nodes, pages and array storage must be
+ * reused without carrying over old content, the per-thread limit must
+ * be kept and trimming must release everything.
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See COPYING for details.
+ *
+ */
+#include "config.h"
+
+#include "../json.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CHK(x) if (!(x)) { \
+	printf("%s:%d: unexpected result with '%s'\n", \
+		__FILE__, __LINE__, #x); \
+	exit(1); \
+}
+
+/* pooling needs thread-local storage, without it nothing is pooled */
+#ifdef HAVE_TLS
+#define CHK_POOLED(x) CHK(x)
+#else
+#define CHK_POOLED(x)
+#endif
+
+static struct fjson_object *
+build(const int n)
+{
+	struct fjson_object *const obj = fjson_object_new_object();
+	struct fjson_object *const arr = fjson_object_new_array();
+	char key[16];
+	int i;
+	for (i = 0 ; i < n ; ++i) {
+		snprintf(key, sizeof(key), "k%d", i);
+		fjson_object_object_add(obj, key, fjson_object_new_int(i));
+		fjson_object_array_add(arr, fjson_object_new_string(key));
+	}
+	fjson_object_object_add(obj, "arr", arr);
+	return obj;
+}
+
+int
+main(int __attribute__((unused)) argc, char __attribute__((unused)) **argv)
+{
+	struct fjson_object *obj;
+	char *first;
+	int round;
+
+	/* without a limit, nothing is pooled */
+	fjson_object_put(build(50));
+	CHK(fjson_global_pool_bytes() == 0);
+
+	fjson_global_set_pool_limit(1024 * 1024);
+	obj = build(50);
+	first = strdup(fjson_object_to_json_string(obj));
+	fjson_object_put(obj);
+	CHK_POOLED(fjson_global_pool_bytes() > 0);
+	for (round = 0 ; round < 100 ; ++round) {
+		obj = build(50);
+		CHK(!strcmp(fjson_object_to_json_string(obj), first));
+		fjson_object_put(obj);
+	}
+	/* reused nodes must be clean */
+	obj = fjson_object_new_object();
+	CHK(fjson_object_object_length(obj) == 0);
+	CHK(!strcmp(fjson_object_to_json_string(obj), "{ }"));
+	fjson_object_put(obj);
+	obj = fjson_object_new_array();
+	CHK(fjson_object_array_length(obj) == 0);
+	fjson_object_put(obj);
+	printf("%s\n", first);
+	free(first);
+
+	fjson_global_pool_trim();
+	CHK(fjson_global_pool_bytes() == 0);
+
+	/* the limit is kept */
+	fjson_global_set_pool_limit(4096);
+	fjson_object_put(build(1000));
+	CHK_POOLED(fjson_global_pool_bytes() > 0);
+	CHK(fjson_global_pool_bytes() <= 4096);
+	printf("pool limit kept\n");
+
+	fjson_global_set_pool_limit(0);
+	fjson_global_pool_trim();
+	CHK(fjson_global_pool_bytes() == 0);
+	printf("OK\n");
+	return 0;
+}
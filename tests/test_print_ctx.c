@@ -0,0 +1,122 @@
+/* libfastjson testbench tool
+ *
+ * checks fjson_object_to_json_string_ctx(): the output must be the same
+ * as that of fjson_object_to_json_string_ext(), it must not be kept in
+ * the object, and once the buffer of the context is large enough, no
+ * memory must be allocated any longer.
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See COPYING for details.
+ *
+ */
+#include "config.h"
+
+#include "../json.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CHK(x) if (!(x)) { \
+	printf("%s:%d: unexpected result with '%s'\n", \
+		__FILE__, __LINE__, #x); \
+	exit(1); \
+}
+
+static long nalloc;
+
+static void *
+t_malloc(const size_t size)
+{
+	++nalloc;
+	return malloc(size);
+}
+
+static void *
+t_realloc(void *const ptr, const size_t size)
+{
+	++nalloc;
+	return realloc(ptr, size);
+}
+
+static const char *const texts[] = {
+	"{\"a\": [1, 2.50, \"x\\ty\"], \"b\": {\"c\": null, \"d\": true}, \"e\": \"\\u00e4\"}",
+	"[[], {}, [[[1]]], -17, 1e300]",
+	"\"just a string\"",
+	"42",
+	"null",
+};
+
+static const int flag_sets[] = {
+	FJSON_TO_STRING_PLAIN,
+	FJSON_TO_STRING_SPACED,
+	FJSON_TO_STRING_PRETTY,
+	FJSON_TO_STRING_PRETTY | FJSON_TO_STRING_PRETTY_TAB,
+};
+
+#define N(a) (sizeof(a) / sizeof((a)[0]))
+
+static void
+test_output(struct fjson_print_ctx *const pctx)
+{
+	size_t i, j, len;
+
+	for (i = 0 ; i < N(texts) ; ++i) {
+		for (j = 0 ; j < N(flag_sets) ; ++j) {
+			struct fjson_object *const jso = fjson_tokener_parse(texts[i]);
+			const char *s = fjson_object_to_json_string_ctx(jso, flag_sets[j], pctx, &len);
+			char *const copy = strdup(s);
+			CHK(copy != NULL);
+			CHK(strlen(s) == len);
+			/* the object did not keep it */
+			CHK(fjson_object_to_json_string_ext(jso, flag_sets[j]) != s);
+			CHK(strcmp(fjson_object_to_json_string_ext(jso, flag_sets[j]), copy) == 0);
+			/* and the cached output is used if there is some */
+			s = fjson_object_to_json_string_ctx(jso, flag_sets[j], pctx, NULL);
+			CHK(strcmp(s, copy) == 0);
+			free(copy);
+			fjson_object_put(jso);
+		}
+	}
+
+	/* the buffer is reused */
+	CHK(fjson_object_to_json_string_ctx(NULL, 0, pctx, &len)
+		== fjson_object_to_json_string_ctx(fjson_object_new_boolean(1), 0, pctx, NULL));
+	CHK(len == 4);
+}
+
+static void
+test_no_allocs(struct fjson_print_ctx *const pctx)
+{
+	struct fjson_object *const jso = fjson_object_new_array();
+	const char *s;
+	int i;
+
+	for (i = 0 ; i < 1000 ; ++i)
+		fjson_object_array_add(jso, fjson_object_new_string("a bit of text"));
+	s = fjson_object_to_json_string_ctx(jso, FJSON_TO_STRING_PLAIN, pctx, NULL);
+	CHK(strlen(s) == 1000 * 16 + 1);
+
+	fjson_global_set_allocator(t_malloc, t_realloc, free);
+	for (i = 0 ; i < 10 ; ++i)
+		fjson_object_to_json_string_ctx(jso, FJSON_TO_STRING_PLAIN, pctx, NULL);
+	CHK(nalloc == 0);
+	fjson_object_to_json_string_ext(jso, FJSON_TO_STRING_PLAIN);
+	CHK(nalloc > 0);
+	fjson_global_set_allocator(NULL, NULL, NULL);
+
+	fjson_object_put(jso);
+}
+
+int
+main(int __attribute__((unused)) argc, char __attribute__((unused)) **argv)
+{
+	struct fjson_print_ctx *const pctx = fjson_print_ctx_new();
+	CHK(pctx != NULL);
+	test_output(pctx);
+	test_no_allocs(pctx);
+	fjson_print_ctx_free(pctx);
+	fjson_print_ctx_free(NULL);
+	printf("OK\n");
+	return 0;
+}
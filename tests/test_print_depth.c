@@ -0,0 +1,231 @@
+/* libfastjson testbench tool
+ *
+ * checks that the serializers cope with deeply nested trees (they must
+ * not recurse) and that fjson_global_set_max_print_depth() stops them
+ * with ELOOP once the limit is exceeded.
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See COPYING for details.
+ *
+ */
+#include "config.h"
+
+#include "../json.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#define CHK(x) if (!(x)) { \
+	printf("%s:%d: unexpected result with '%s'\n", \
+		__FILE__, __LINE__, #x); \
+	exit(1); \
+}
+
+/* arrays and objects, alternating, with a string at the bottom. The
+ * expected plain output goes to *text.
+ */
+static struct fjson_object *
+chain(const int depth, char **const text)
+{
+	struct fjson_object *jso = fjson_object_new_string("x");
+	char *const s = malloc(4 * (size_t) depth + 4);
+	char *p = s;
+	int i;
+
+	CHK(jso != NULL && s != NULL);
+	for (i = 0 ; i < depth ; ++i) {
+		struct fjson_object *const parent = (i & 1) ? fjson_object_new_object()
+			: fjson_object_new_array();
+		CHK(parent != NULL);
+		if (i & 1) {
+			fjson_object_object_add(parent, "k", jso);
+		} else {
+			fjson_object_array_add(parent, jso);
+		}
+		jso = parent;
+	}
+	for (i = depth - 1 ; i >= 0 ; --i) {
+		if (i & 1) {
+			memcpy(p, "{\"k\":", 5);
+			p += 5;
+		} else {
+			*p++ = '[';
+		}
+	}
+	memcpy(p, "\"x\"", 3);
+	p += 3;
+	for (i = 0 ; i < depth ; ++i)
+		*p++ = (i & 1) ? '}' : ']';
+	*p = '\0';
+	*text = s;
+	return jso;
+}
+
+/* releasing the tree recurses, so take it apart from the top */
+static void
+unchain(struct fjson_object *jso)
+{
+	while (jso != NULL) {
+		struct fjson_object *child = NULL;
+		if (fjson_object_is_type(jso, fjson_type_array))
+			child = fjson_object_array_get_idx(jso, 0);
+		else if (fjson_object_is_type(jso, fjson_type_object))
+			fjson_object_object_get_ex(jso, "k", &child);
+		fjson_object_get(child);
+		fjson_object_put(jso);
+		jso = child;
+	}
+}
+
+static char dumped[1 << 20];
+static size_t ndumped;
+
+static size_t
+collect(void __attribute__((unused)) *ptr, const char *const buf, const size_t size)
+{
+	if (ndumped + size < sizeof(dumped))
+		memcpy(dumped + ndumped, buf, size);
+	ndumped += size;
+	return size;
+}
+
+static void
+test_deep(void)
+{
+	struct fjson_print_ctx *const pctx = fjson_print_ctx_new();
+	struct fjson_object *jso;
+	char *text, *buf;
+	const char *s;
+	size_t len;
+
+	CHK(pctx != NULL);
+	jso = chain(100000, &text);
+	len = strlen(text);
+
+	s = fjson_object_to_json_string_ext(jso, FJSON_TO_STRING_PLAIN);
+	CHK(s != NULL && strcmp(s, text) == 0);
+	s = fjson_object_to_json_string_ctx(jso, FJSON_TO_STRING_PLAIN, pctx, NULL);
+	CHK(s != NULL && strcmp(s, text) == 0);
+	CHK(fjson_object_size_ext(jso, FJSON_TO_STRING_PLAIN) == len);
+
+	ndumped = 0;
+	CHK(fjson_object_dump_ext(jso, FJSON_TO_STRING_PLAIN, collect, NULL) == len);
+	CHK(ndumped == len && memcmp(dumped, text, len) == 0);
+
+	CHK((buf = malloc(len + 1)) != NULL);
+	CHK(fjson_object_to_json_string_into(jso, FJSON_TO_STRING_PLAIN, buf, len + 1) == len);
+	CHK(strcmp(buf, text) == 0);
+	free(buf);
+
+	CHK(strlen(fjson_object_to_json_string_ext(jso, FJSON_TO_STRING_SPACED)) > len);
+	free(text);
+	unchain(jso);
+
+	/* pretty output grows with the square of the depth, so that is
+	 * just checked beyond the frames the serializer keeps on the stack
+	 */
+	jso = chain(200, &text);
+	s = fjson_object_to_json_string_ext(jso, FJSON_TO_STRING_PRETTY);
+	CHK(s != NULL && strlen(s) == fjson_object_size_ext(jso, FJSON_TO_STRING_PRETTY));
+	{
+		char indent[2 + 2 * 150];
+		memset(indent, ' ', sizeof(indent) - 1);
+		indent[0] = '\n';
+		indent[sizeof(indent) - 1] = '\0';
+		CHK(strstr(s, indent) != NULL);
+	}
+	free(text);
+	fjson_object_put(jso);
+
+	fjson_print_ctx_free(pctx);
+}
+
+static void
+test_limit(void)
+{
+	struct fjson_print_ctx *const pctx = fjson_print_ctx_new();
+	struct fjson_object *ok, *deep, *wide;
+	char *text_ok, *text_deep, *text_part;
+	int i;
+
+	CHK(pctx != NULL);
+	ok = chain(10, &text_ok);
+	deep = chain(11, &text_deep);
+	fjson_global_set_max_print_depth(10);
+
+	/* the limit itself is fine */
+	CHK(strcmp(fjson_object_to_json_string_ext(ok, FJSON_TO_STRING_PLAIN), text_ok) == 0);
+	CHK(strcmp(fjson_object_to_json_string_ctx(ok, FJSON_TO_STRING_PLAIN, pctx, NULL),
+		text_ok) == 0);
+
+	errno = 0;
+	CHK(fjson_object_to_json_string_ext(deep, FJSON_TO_STRING_PLAIN) == NULL);
+	CHK(errno == ELOOP);
+	errno = 0;
+	CHK(fjson_object_to_json_string_ctx(deep, FJSON_TO_STRING_PRETTY, pctx, NULL) == NULL);
+	CHK(errno == ELOOP);
+	errno = 0;
+	ndumped = 0;
+	CHK(fjson_object_dump_ext(deep, FJSON_TO_STRING_PLAIN, collect, NULL) < strlen(text_deep));
+	CHK(errno == ELOOP);
+	errno = 0;
+	CHK(fjson_object_size_ext(deep, FJSON_TO_STRING_PLAIN) < strlen(text_deep));
+	CHK(errno == ELOOP);
+
+	/* in parallel, the parts check the limit as well */
+	CHK((wide = fjson_object_new_array()) != NULL);
+	for (i = 0 ; i < 64 ; ++i)
+		fjson_object_array_add(wide, fjson_object_new_int(i));
+	/* ok has cached output by now, which would be used as it is */
+	fjson_object_array_add(wide, chain(10, &text_part));
+	errno = 0;
+	CHK(fjson_object_to_json_string_parallel(wide, FJSON_TO_STRING_PLAIN, 4, NULL, NULL) == NULL);
+	CHK(errno == ELOOP);
+
+	/* no limit any more */
+	fjson_global_set_max_print_depth(0);
+	CHK(strcmp(fjson_object_to_json_string_ext(deep, FJSON_TO_STRING_PLAIN), text_deep) == 0);
+	CHK(fjson_object_to_json_string_parallel(wide, FJSON_TO_STRING_PLAIN, 4, NULL, NULL) != NULL);
+
+	/* a failed write must not leave the output cached before behind, in
+	 * part overwritten
+	 */
+	{
+		static const char *const text = "{\"a\":[[[[[1]]]]],\"b\":\"tail\"}";
+		struct fjson_object *const jso = fjson_tokener_parse(text);
+		CHK(jso != NULL);
+		CHK(strcmp(fjson_object_to_json_string_ext(jso, FJSON_TO_STRING_PLAIN), text) == 0);
+		fjson_global_set_max_print_depth(3);
+		CHK(fjson_object_to_json_string_ext(jso, FJSON_TO_STRING_SPACED) == NULL);
+		CHK(fjson_object_to_json_string_parallel(jso, FJSON_TO_STRING_SPACED, 2, NULL, NULL)
+			== NULL);
+		fjson_global_set_max_print_depth(0);
+		CHK(strcmp(fjson_object_to_json_string_ext(jso, FJSON_TO_STRING_PLAIN), text) == 0);
+		fjson_global_set_max_print_depth(3);
+		CHK(fjson_object_to_json_string_parallel(jso, FJSON_TO_STRING_SPACED, 2, NULL, NULL)
+			== NULL);
+		fjson_global_set_max_print_depth(0);
+		CHK(strcmp(fjson_object_to_json_string_parallel(jso, FJSON_TO_STRING_PLAIN, 2,
+			NULL, NULL), text) == 0);
+		fjson_object_put(jso);
+	}
+
+	free(text_ok);
+	free(text_deep);
+	free(text_part);
+	fjson_object_put(ok);
+	fjson_object_put(deep);
+	fjson_object_put(wide);
+	fjson_print_ctx_free(pctx);
+}
+
+int
+main(int __attribute__((unused)) argc, char __attribute__((unused)) **argv)
+{
+	test_deep();
+	test_limit();
+	printf("OK\n");
+	return 0;
+}
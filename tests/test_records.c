@@ -0,0 +1,213 @@
+/* libfastjson testbench tool
+ *
+ * checks fjson_tokener_parse_records() and its parallel variant: all
+ * records must be reported once, in order and with the right offsets,
+ * for many chunk counts.
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See COPYING for details.
+ *
+ */
+#include "config.h"
+
+#include "../json.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CHK(x) if (!(x)) { \
+	printf("%s:%d: unexpected result with '%s'\n", \
+		__FILE__, __LINE__, #x); \
+	exit(1); \
+}
+
+struct result {
+	const char *buf;
+	char out[4096];
+	size_t outlen;
+	int nrecs;
+	int stop_at;
+};
+
+static int
+on_record(void *const ctx, struct fjson_object *const obj, const size_t offset, const size_t len)
+{
+	struct result *const r = ctx;
+	/* the record text must parse to the same value */
+	char text[256];
+	struct fjson_object *again;
+	const char *s;
+	CHK(len > 0 && len < sizeof(text));
+	memcpy(text, r->buf + offset, len);
+	text[len] = '\0';
+	CHK(text[0] != ' ' && text[0] != '\n' && text[len - 1] != ' ' && text[len - 1] != '\n');
+	again = fjson_tokener_parse(text);
+	s = fjson_object_to_json_string_ext(obj, FJSON_TO_STRING_PLAIN);
+	CHK(again != NULL);
+	CHK(strcmp(s, fjson_object_to_json_string_ext(again, FJSON_TO_STRING_PLAIN)) == 0);
+	fjson_object_put(again);
+	CHK(r->outlen + strlen(s) + 2 < sizeof(r->out));
+	r->outlen += sprintf(r->out + r->outlen, "%s|", s);
+	fjson_object_put(obj);
+	return ++r->nrecs == r->stop_at;
+}
+
+/* an executor that runs the tasks backwards, to catch order dependencies */
+static void
+backwards(void *const ctx, fjson_task_fn *const fn, void *const *const args, const int ntasks)
+{
+	int i;
+	++*(int *) ctx;
+	for (i = ntasks - 1 ; i >= 0 ; --i)
+		fn(args[i]);
+}
+
+/* just counts */
+static int
+count_record(void *const ctx, struct fjson_object *const obj,
+	const size_t __attribute__((unused)) offset, const size_t __attribute__((unused)) len)
+{
+	fjson_object_put(obj);
+	++*(int *) ctx;
+	return 0;
+}
+
+/* append a record of given nesting depth to buf */
+static int
+add_nested(char *const buf, int len, const int depth)
+{
+	int i;
+	for (i = 0 ; i < depth ; ++i)
+		buf[len++] = '[';
+	buf[len++] = '1';
+	for (i = 0 ; i < depth ; ++i)
+		buf[len++] = ']';
+	buf[len++] = '\n';
+	return len;
+}
+
+/* records nested deeper than the default depth allows: the chunks must
+ * be parsed with the depth of the caller's tokener
+ */
+static void
+test_depth(void)
+{
+	struct fjson_tokener *const tok = fjson_tokener_new_ex(64);
+	char buf[51 * 160];
+	int len = 0, i, n, ncalls = 0;
+
+	CHK(tok != NULL);
+	for (i = 0 ; i < 50 ; ++i)
+		len = add_nested(buf, len, 40);
+	n = 0;
+	CHK(fjson_tokener_parse_records(tok, buf, len, count_record, &n) == 50);
+	CHK(n == 50);
+	n = 0;
+	CHK(fjson_tokener_parse_records_parallel(tok, buf, len, 4, backwards, &ncalls,
+		count_record, &n) == 50);
+	CHK(n == 50);
+
+	/* one that is too deep for the tokener fails in both */
+	len = add_nested(buf, len, 70);
+	n = 0;
+	CHK(fjson_tokener_parse_records(tok, buf, len, count_record, &n) == -1);
+	CHK(n == 50 && fjson_tokener_get_error(tok) == fjson_tokener_error_depth);
+	n = 0;
+	CHK(fjson_tokener_parse_records_parallel(tok, buf, len, 4, backwards, &ncalls,
+		count_record, &n) == -1);
+	CHK(n == 50 && fjson_tokener_get_error(tok) == fjson_tokener_error_depth);
+	fjson_tokener_free(tok);
+}
+
+static const char *input =
+	"{\"a\":1}\n"
+	"  [1,2,3]\n"
+	"\n"
+	"\"str\"\n"
+	"{\"b\":{\"c\":[true,false,null]}}\r\n"
+	"42\n"
+	"3.5 17\n"
+	"{\"long\":\"0123456789012345678901234567890123456789\"}\n"
+	"-1";
+
+int main(int __attribute__((unused)) argc, char __attribute__((unused)) **argv)
+{
+	struct fjson_tokener *const tok = fjson_tokener_new();
+	struct result expected, r;
+	int n, ncalls = 0;
+
+	memset(&expected, 0, sizeof(expected));
+	expected.buf = input;
+	CHK(fjson_tokener_parse_records(tok, input, strlen(input), on_record, &expected) == 9);
+	CHK(expected.nrecs == 9);
+	printf("%s\n", expected.out);
+
+	for (n = 0 ; n <= (int) strlen(input) + 1 ; ++n) {
+		memset(&r, 0, sizeof(r));
+		r.buf = input;
+		CHK(fjson_tokener_parse_records_parallel(tok, input, strlen(input), n,
+			(n % 2) ? backwards : NULL, &ncalls, on_record, &r) == 9);
+		CHK(strcmp(r.out, expected.out) == 0);
+	}
+	printf("parallel OK, %d executor calls\n", ncalls);
+
+	/* stopping early */
+	memset(&r, 0, sizeof(r));
+	r.buf = input;
+	r.stop_at = 3;
+	CHK(fjson_tokener_parse_records(tok, input, strlen(input), on_record, &r) == 3);
+	memset(&r, 0, sizeof(r));
+	r.buf = input;
+	r.stop_at = 3;
+	CHK(fjson_tokener_parse_records_parallel(tok, input, strlen(input), 4, NULL, NULL,
+		on_record, &r) == 3);
+	printf("stop: %s\n", r.out);
+
+	/* a broken record: everything before it is reported */
+	{
+		static const char broken[] = "1\n2\n{\"x\": }\n4\n";
+		memset(&r, 0, sizeof(r));
+		r.buf = broken;
+		CHK(fjson_tokener_parse_records(tok, broken, strlen(broken), on_record, &r) == -1);
+		CHK(r.nrecs == 2);
+		printf("error: %s after %s\n", fjson_tokener_error_desc(fjson_tokener_get_error(tok)), r.out);
+		memset(&r, 0, sizeof(r));
+		r.buf = broken;
+		CHK(fjson_tokener_parse_records_parallel(tok, broken, strlen(broken), 3, NULL, NULL,
+			on_record, &r) == -1);
+		CHK(r.nrecs == 2);
+		CHK(fjson_tokener_get_error(tok) == fjson_tokener_error_parse_unexpected);
+	}
+
+	/* a broken record that a chunk boundary cuts off: still the error the
+	 * sequential parse reports, for any chunk count
+	 */
+	{
+		static const char cut[] = "{\"a\":1}\n{\"b\":2\n[3]\n[4]\n";
+		enum fjson_tokener_error err;
+		memset(&r, 0, sizeof(r));
+		r.buf = cut;
+		CHK(fjson_tokener_parse_records(tok, cut, strlen(cut), on_record, &r) == -1);
+		CHK(r.nrecs == 1);
+		err = fjson_tokener_get_error(tok);
+		for (n = 2 ; n <= (int) strlen(cut) ; ++n) {
+			memset(&r, 0, sizeof(r));
+			r.buf = cut;
+			CHK(fjson_tokener_parse_records_parallel(tok, cut, strlen(cut), n,
+				(n % 2) ? backwards : NULL, &ncalls, on_record, &r) == -1);
+			CHK(r.nrecs == 1);
+			CHK(fjson_tokener_get_error(tok) == err);
+		}
+	}
+
+	/* empty input */
+	memset(&r, 0, sizeof(r));
+	CHK(fjson_tokener_parse_records(tok, " \n ", 3, on_record, &r) == 0);
+	CHK(fjson_tokener_parse_records_parallel(tok, " \n ", 3, 2, NULL, NULL, on_record, &r) == 0);
+
+	fjson_tokener_free(tok);
+	test_depth();
+	printf("OK\n");
+	return 0;
+}
@@ -0,0 +1,154 @@
+/* libfastjson testbench tool
+ *
+ * checks callback-driven parsing: the events reported for a document,
+ * that feeding it in single-byte chunks gives the same events, and that
+ * a handler can abort parsing.
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See COPYING for details.
+ *
+ */
+#include "config.h"
+
+#include "../json.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#define CHK(x) if (!(x)) { \
+	printf("%s:%d: unexpected result with '%s'\n", \
+		__FILE__, __LINE__, #x); \
+	exit(1); \
+}
+
+static const char *input =
+	"{ \"msg\": \"a \\\"quoted\\\" string\", \"num\": -42, \"dbl\": 1.50,\n"
+	"  \"t\": true, \"f\": false, \"n\": null, \"inf\": -Infinity,\n"
+	"  \"arr\": [ 1, [ ], { }, \"\\u00e4\" ], \"o\": { \"k\": \"v\" } }";
+
+struct ctx {
+	char log[1024];
+	int nevents;
+	int abort_at; /* event number at which to abort, 0 = never */
+};
+
+static int
+add(void *const vctx, const char *const ev, const char *const s, const int len)
+{
+	struct ctx *const ctx = (struct ctx *) vctx;
+	char buf[128];
+	if (s == NULL)
+		snprintf(buf, sizeof(buf), "%s ", ev);
+	else
+		snprintf(buf, sizeof(buf), "%s(%.*s) ", ev, len, s);
+	strcat(ctx->log, buf);
+	return (++ctx->nevents == ctx->abort_at);
+}
+
+static int on_start_object(void *ctx) { return add(ctx, "{", NULL, 0); }
+static int on_end_object(void *ctx) { return add(ctx, "}", NULL, 0); }
+static int on_start_array(void *ctx) { return add(ctx, "[", NULL, 0); }
+static int on_end_array(void *ctx) { return add(ctx, "]", NULL, 0); }
+static int on_key(void *ctx, const char *s, int len) { return add(ctx, "key", s, len); }
+static int on_string(void *ctx, const char *s, int len) { return add(ctx, "str", s, len); }
+static int on_null(void *ctx) { return add(ctx, "null", NULL, 0); }
+
+static int
+on_int64(void *ctx, const int64_t i)
+{
+	char buf[32];
+	snprintf(buf, sizeof(buf), "%" PRId64, i);
+	return add(ctx, "int", buf, (int) strlen(buf));
+}
+
+static int
+on_dbl(void *ctx, const double d, const char *s, int len)
+{
+	char buf[64];
+	snprintf(buf, sizeof(buf), "%g=%.*s", d, len, s);
+	return add(ctx, "dbl", buf, (int) strlen(buf));
+}
+
+static int
+on_boolean(void *ctx, const fjson_bool b)
+{
+	return add(ctx, b ? "true" : "false", NULL, 0);
+}
+
+static const struct fjson_tokener_callbacks all_cb = {
+	on_start_object, on_end_object, on_start_array, on_end_array,
+	on_key, on_string, on_int64, on_dbl, on_boolean, on_null
+};
+
+static const struct fjson_tokener_callbacks keys_only_cb = {
+	NULL, NULL, NULL, NULL, on_key, NULL, NULL, NULL, NULL, NULL
+};
+
+int main(int __attribute__((unused)) argc, char __attribute__((unused)) **argv)
+{
+	struct fjson_tokener *const tok = fjson_tokener_new();
+	struct ctx ctx;
+	char full[1024];
+	size_t i;
+
+	CHK(tok != NULL);
+
+	/* whole document at once */
+	memset(&ctx, 0, sizeof(ctx));
+	fjson_tokener_set_callbacks(tok, &all_cb, &ctx);
+	CHK(fjson_tokener_parse_ex(tok, input, -1) == NULL);
+	CHK(fjson_tokener_get_error(tok) == fjson_tokener_success);
+	printf("events: %s\n", ctx.log);
+	strcpy(full, ctx.log);
+
+	/* one byte at a time must give the very same events */
+	memset(&ctx, 0, sizeof(ctx));
+	fjson_tokener_reset(tok);
+	for (i = 0 ; i < strlen(input) ; ++i) {
+		fjson_tokener_parse_ex(tok, input + i, 1);
+		if (fjson_tokener_get_error(tok) != fjson_tokener_continue)
+			break;
+	}
+	CHK(i == strlen(input) - 1);
+	CHK(fjson_tokener_get_error(tok) == fjson_tokener_success);
+	CHK(strcmp(ctx.log, full) == 0);
+	printf("chunked parse OK\n");
+
+	/* handlers that are not set are simply skipped */
+	memset(&ctx, 0, sizeof(ctx));
+	fjson_tokener_set_callbacks(tok, &keys_only_cb, &ctx);
+	CHK(fjson_tokener_parse_ex(tok, input, -1) == NULL);
+	CHK(fjson_tokener_get_error(tok) == fjson_tokener_success);
+	printf("keys: %s\n", ctx.log);
+
+	/* abort on the 4th event */
+	memset(&ctx, 0, sizeof(ctx));
+	ctx.abort_at = 4;
+	fjson_tokener_set_callbacks(tok, &all_cb, &ctx);
+	CHK(fjson_tokener_parse_ex(tok, input, -1) == NULL);
+	CHK(fjson_tokener_get_error(tok) == fjson_tokener_error_callback);
+	printf("aborted: %s, %s\n", ctx.log,
+		fjson_tokener_error_desc(fjson_tokener_get_error(tok)));
+
+	/* syntax errors are reported as usual */
+	memset(&ctx, 0, sizeof(ctx));
+	fjson_tokener_reset(tok);
+	CHK(fjson_tokener_parse_ex(tok, "[ 1, 2 }", -1) == NULL);
+	CHK(fjson_tokener_get_error(tok) == fjson_tokener_error_parse_array);
+	printf("error: %s\n", ctx.log);
+
+	/* and back to building objects */
+	fjson_tokener_set_callbacks(tok, NULL, NULL);
+	{
+		struct fjson_object *const jso = fjson_tokener_parse_ex(tok, input, -1);
+		CHK(jso != NULL);
+		printf("object: %s\n", fjson_object_to_json_string(jso));
+		fjson_object_put(jso);
+	}
+
+	fjson_tokener_free(tok);
+	printf("OK\n");
+	return 0;
+}
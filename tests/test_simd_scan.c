@@ -0,0 +1,194 @@
+/* libfastjson testbench tool
+ *
+ * checks the bulk byte scanners used by the tokener against a
+ * byte-by-byte reference, for all alignments and lengths, and
+ * parses strings which have special characters at every position.
+ * Also checks the structural index the same way.
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See COPYING for details.
+ *
+ */
+#include "config.h"
+
+#include "../json.h"
+#include "../simd_scan.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#define BUFLEN 100
+
+#define CHK(x) if (!(x)) { \
+	printf("%s:%d: unexpected result with '%s'\n", \
+		__FILE__, __LINE__, #x); \
+	exit(1); \
+}
+
+static const char *
+ref_scan_str(const char *p, const char *end, char quote)
+{
+	while (p < end && *p != quote && *p != '\\' && (unsigned char)*p >= 0x20)
+		++p;
+	return p;
+}
+
+static const char *
+ref_skip_ws(const char *p, const char *end)
+{
+	while (p < end && (*p == ' ' || *p == '\t' || *p == '\n'
+	       || *p == '\v' || *p == '\f' || *p == '\r'))
+		++p;
+	return p;
+}
+
+static void
+check_scanners(char *buf, const char *specials, const char *fill)
+{
+	int pos, start, len;
+	const char *s, *f;
+
+	for (s = specials ; *s ; ++s) {
+		for (pos = 0 ; pos < BUFLEN ; ++pos) {
+			for (f = fill ; *f ; ++f)
+				; /* only used for the length */
+			for (len = 0 ; len < BUFLEN ; ++len)
+				buf[len] = fill[len % (f - fill)];
+			buf[pos] = *s;
+			for (start = 0 ; start < 40 ; ++start) {
+				for (len = start ; len <= BUFLEN ; len += 7) {
+					CHK(_fjson_scan_str(buf + start, buf + len, '"')
+						== ref_scan_str(buf + start, buf + len, '"'));
+					CHK(_fjson_scan_str(buf + start, buf + len, '\'')
+						== ref_scan_str(buf + start, buf + len, '\''));
+					CHK(_fjson_skip_ws(buf + start, buf + len)
+						== ref_skip_ws(buf + start, buf + len));
+				}
+			}
+		}
+	}
+}
+
+static uint64_t rnd = 0x9e3779b97f4a7c15ull;
+
+static unsigned
+rand_next(void)
+{
+	rnd ^= rnd << 13;
+	rnd ^= rnd >> 7;
+	rnd ^= rnd << 17;
+	return (unsigned) (rnd >> 32);
+}
+
+static size_t
+ref_index(const char *const buf, const size_t len, uint32_t *const pos)
+{
+	int in_str = 0, esc = 0;
+	size_t i, n = 0;
+	for (i = 0 ; i < len ; ++i) {
+		const char c = buf[i];
+		if (esc) {
+			/* only quotes lose their meaning */
+			esc = 0;
+			if (c == '"')
+				continue;
+		} else if (c == '\\') {
+			esc = 1;
+			continue;
+		}
+		if (c == '"') {
+			in_str = !in_str;
+			pos[n++] = (uint32_t) i;
+		} else if (!in_str && c != '\0' && strchr("{}[]:,", c) != NULL) {
+			pos[n++] = (uint32_t) i;
+		}
+	}
+	return n;
+}
+
+static void
+check_index(void)
+{
+	static const char alphabet[] = "\"\\\\\\{}[]:,aa  \n\x7b\x5d\x3a\x2c\x7e\xdb";
+	char buf[300];
+	uint32_t ref[300];
+	int round;
+
+	for (round = 0 ; round < 2000 ; ++round) {
+		const size_t len = rand_next() % sizeof(buf);
+		struct _fjson_index ix = { NULL, 0, 0 };
+		size_t n, i, k;
+		int in_str = 0;
+
+		for (i = 0 ; i < len ; ++i) {
+			/* long runs of backslashes and quiet stretches, too */
+			const unsigned r = rand_next();
+			buf[i] = (r & 0x300) ? alphabet[r % (sizeof(alphabet) - 1)] : (r & 0x400) ? '\\' : 'x';
+		}
+		n = ref_index(buf, len, ref);
+		CHK(_fjson_index_range(buf, 0, len, &in_str, &ix) == 0);
+		CHK(ix.n == n && (n == 0 || memcmp(ix.pos, ref, n * sizeof(uint32_t)) == 0));
+
+		/* in two parts, with the state taken from the first, or
+		 * from the quote parity
+		 */
+		for (k = 0 ; k <= len ; k += 1 + rand_next() % 17) {
+			int in_str2 = 0;
+			ix.n = 0;
+			CHK(_fjson_index_range(buf, 0, k, &in_str2, &ix) == 0);
+			CHK(in_str2 == _fjson_index_quote_parity(buf, 0, k));
+			CHK(_fjson_index_range(buf, k, len, &in_str2, &ix) == 0);
+			CHK(in_str2 == in_str);
+			CHK(ix.n == n && (n == 0 || memcmp(ix.pos, ref, n * sizeof(uint32_t)) == 0));
+		}
+		free(ix.pos);
+	}
+}
+
+int main(int __attribute__((unused)) argc, char __attribute__((unused)) **argv)
+{
+	char buf[BUFLEN + 1];
+	char json[BUFLEN + 16];
+	struct fjson_object *jso;
+	struct fjson_tokener *tok;
+	int pos, len;
+
+	/* special chars inside regular text, as well as regular chars
+	 * (including high-bit ones) inside whitespace
+	 */
+	check_scanners(buf, "\"'\\\x01\x1f\t\n", "abcdefghij\x7f\x80\xff");
+	check_scanners(buf, "a\x80\x08\x0e!", " \t\r\n\v\f");
+	check_index();
+
+	/* strings with an escape at every position, fed in one chunk and
+	 * in two pieces
+	 */
+	CHK((tok = fjson_tokener_new()) != NULL);
+	for (pos = 0 ; pos < BUFLEN - 3 ; ++pos) {
+		memset(buf, 'x', BUFLEN - 2);
+		buf[pos] = '\\';
+		buf[pos + 1] = 'n';
+		buf[BUFLEN - 2] = '\0';
+		len = snprintf(json, sizeof(json), "  \t\"%s\"   ", buf);
+		jso = fjson_tokener_parse(json);
+		CHK(jso != NULL);
+		CHK(fjson_object_get_string_len(jso) == BUFLEN - 3);
+		CHK(fjson_object_get_string(jso)[pos] == '\n');
+		fjson_object_put(jso);
+
+		fjson_tokener_reset(tok);
+		CHK(fjson_tokener_parse_ex(tok, json, pos + 3) == NULL);
+		CHK(fjson_tokener_get_error(tok) == fjson_tokener_continue);
+		jso = fjson_tokener_parse_ex(tok, json + pos + 3, len - pos - 3);
+		CHK(jso != NULL);
+		CHK(fjson_object_get_string_len(jso) == BUFLEN - 3);
+		CHK(fjson_object_get_string(jso)[pos] == '\n');
+		fjson_object_put(jso);
+	}
+	fjson_tokener_free(tok);
+
+	printf("OK\n");
+	return 0;
+}
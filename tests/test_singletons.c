@@ -0,0 +1,104 @@
+/* libfastjson testbench tool
+ *
+ * checks the immortal singletons for booleans, small integers and the
+ * empty string: they are shared by all users, reference counting on
+ * them is a no-op and they can live in many containers at once.
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See COPYING for details.
+ *
+ */
+#include "config.h"
+
+#include "../json.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CHK(x) if (!(x)) { \
+	printf("%s:%d: unexpected result with '%s'\n", \
+		__FILE__, __LINE__, #x); \
+	exit(1); \
+}
+
+int
+main(int __attribute__((unused)) argc, char __attribute__((unused)) **argv)
+{
+	struct fjson_object *arr, *obj, *jso, *other;
+	int i;
+
+	/* same node for the same value */
+	CHK(fjson_object_new_boolean(1) == fjson_object_new_boolean(1));
+	CHK(fjson_object_new_boolean(0) == fjson_object_new_boolean(0));
+	CHK(fjson_object_new_boolean(1) != fjson_object_new_boolean(0));
+	CHK(fjson_object_new_boolean(42) == fjson_object_new_boolean(1));
+	CHK(fjson_object_new_string("") == fjson_object_new_string_len("x", 0));
+	for (i = -1 ; i <= 255 ; ++i) {
+		jso = fjson_object_new_int(i);
+		CHK(jso == fjson_object_new_int64(i));
+		CHK(fjson_object_get_int(jso) == i);
+		CHK(atoi(fjson_object_to_json_string(jso)) == i);
+	}
+
+	/* reference counting does not change anything */
+	jso = fjson_object_new_int(7);
+	for (i = 0 ; i < 5 ; ++i)
+		CHK(fjson_object_put(jso) == 0);
+	CHK(fjson_object_get(jso) == jso);
+	CHK(fjson_object_get_int(jso) == 7);
+
+	/* values outside the range are fresh nodes */
+	jso = fjson_object_new_int(256);
+	other = fjson_object_new_int(256);
+	CHK(jso != other);
+	CHK(fjson_object_put(jso) == 1);
+	CHK(fjson_object_put(other) == 1);
+	jso = fjson_object_new_int(-2);
+	other = fjson_object_new_int64(-2);
+	CHK(jso != other);
+	fjson_object_put(other);
+	fjson_object_put(jso);
+	jso = fjson_object_new_string("a");
+	other = fjson_object_new_string("a");
+	CHK(jso != other);
+	fjson_object_put(jso);
+	fjson_object_put(other);
+
+	/* one node in many containers, with cached output */
+	arr = fjson_object_new_array();
+	obj = fjson_object_new_object();
+	for (i = 0 ; i < 3 ; ++i) {
+		fjson_object_array_add(arr, fjson_object_new_boolean(1));
+		fjson_object_array_add(arr, fjson_object_new_int(i));
+		fjson_object_array_add(arr, fjson_object_new_string(""));
+	}
+	fjson_object_object_add(obj, "t", fjson_object_new_boolean(1));
+	fjson_object_object_add(obj, "z", fjson_object_new_int(0));
+	fjson_object_object_add(obj, "a", fjson_object_get(arr));
+	printf("%s\n", fjson_object_to_json_string(obj));
+	printf("%s\n", fjson_object_to_json_string(obj));
+	fjson_object_array_put_idx(arr, 0, fjson_object_new_boolean(0));
+	printf("%s\n", fjson_object_to_json_string(arr));
+	fjson_object_object_add(obj, "z", fjson_object_new_int(255));
+	printf("%s\n", fjson_object_to_json_string_ext(obj, FJSON_TO_STRING_SPACED));
+	fjson_object_put(obj);
+	fjson_object_put(arr);
+	/* still intact after all containers are gone */
+	CHK(fjson_object_get_boolean(fjson_object_new_boolean(1)));
+	CHK(!strcmp(fjson_object_to_json_string(fjson_object_new_boolean(0)), "false"));
+	CHK(!strcmp(fjson_object_to_json_string(fjson_object_new_string("")), "\"\""));
+
+	/* the parser uses them as well */
+	arr = fjson_tokener_parse("[true,false,0,255,256,-1,-2,\"\"]");
+	CHK(arr != NULL);
+	CHK(fjson_object_array_get_idx(arr, 0) == fjson_object_new_boolean(1));
+	CHK(fjson_object_array_get_idx(arr, 3) == fjson_object_new_int(255));
+	CHK(fjson_object_array_get_idx(arr, 7) == fjson_object_new_string(""));
+	CHK(fjson_object_get_int(fjson_object_array_get_idx(arr, 4)) == 256);
+	printf("%s\n", fjson_object_to_json_string(arr));
+	fjson_object_put(arr);
+
+	printf("OK\n");
+	return 0;
+}
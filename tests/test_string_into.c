@@ -0,0 +1,77 @@
+/* libfastjson testbench tool
+ *
+ * checks serialization into a caller-provided buffer and the size
+ * calculation: both must agree with fjson_object_to_json_string_ext()
+ * for all formatting flags, and truncation must work like snprintf().
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See COPYING for details.
+ *
+ */
+#include "config.h"
+
+#include "../json.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CHK(x) if (!(x)) { \
+	printf("%s:%d: unexpected result with '%s'\n", \
+		__FILE__, __LINE__, #x); \
+	exit(1); \
+}
+
+static const char *input =
+	"{ \"msg\": \"a string with \\\"quotes\\\", a \\/ and a \\u0001 in it\",\n"
+	"  \"num\": -42, \"dbl\": 1.50, \"t\": true, \"n\": null, \"e\": { },\n"
+	"  \"arr\": [ 1, [ ], { \"k\": \"v\" }, \"x\" ] }";
+
+static const int flags[] = {
+	FJSON_TO_STRING_PLAIN,
+	FJSON_TO_STRING_SPACED,
+	FJSON_TO_STRING_PRETTY,
+	FJSON_TO_STRING_PRETTY | FJSON_TO_STRING_PRETTY_TAB,
+	FJSON_TO_STRING_PRETTY | FJSON_TO_STRING_SPACED
+};
+
+int main(int __attribute__((unused)) argc, char __attribute__((unused)) **argv)
+{
+	struct fjson_object *const jso = fjson_tokener_parse(input);
+	char buf[1024];
+	size_t i;
+
+	CHK(jso != NULL);
+	for (i = 0 ; i < sizeof(flags) / sizeof(flags[0]) ; ++i) {
+		const char *const expected = fjson_object_to_json_string_ext(jso, flags[i]);
+		const size_t len = strlen(expected);
+		size_t cap;
+
+		CHK(fjson_object_size_ext(jso, flags[i]) == len);
+		memset(buf, 'X', sizeof(buf));
+		CHK(fjson_object_to_json_string_into(jso, flags[i], buf, sizeof(buf)) == len);
+		CHK(strcmp(buf, expected) == 0);
+
+		/* every possible truncation */
+		for (cap = 0 ; cap <= len + 1 ; ++cap) {
+			memset(buf, 'X', sizeof(buf));
+			CHK(fjson_object_to_json_string_into(jso, flags[i], buf, cap) == len);
+			if (cap > 0) {
+				CHK(strlen(buf) == ((cap <= len) ? cap - 1 : len));
+				CHK(strncmp(buf, expected, strlen(buf)) == 0);
+			}
+			CHK(buf[cap] == 'X');
+		}
+		printf("flags %d: %d bytes OK\n", flags[i], (int) len);
+	}
+	printf("%s\n", fjson_object_to_json_string_ext(jso, FJSON_TO_STRING_PLAIN));
+
+	/* scalars and NULL */
+	CHK(fjson_object_to_json_string_into(NULL, 0, buf, sizeof(buf)) == 4);
+	CHK(strcmp(buf, "null") == 0);
+	CHK(fjson_object_size(jso) == strlen(fjson_object_to_json_string(jso)));
+	fjson_object_put(jso);
+
+	printf("OK\n");
+	return 0;
+}
@@ -0,0 +1,216 @@
+/* libfastjson testbench tool
+ *
+ * checks fjson_tokener_validate(): for any input and however it is fed,
+ * it must stop where fjson_tokener_parse_ex() stops and report the same,
+ * but without allocating anything or calling event handlers.
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See COPYING for details.
+ *
+ */
+#include "config.h"
+
+#include "../json.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CHK(x) if (!(x)) { \
+	printf("%s:%d: unexpected result with '%s'\n", \
+		__FILE__, __LINE__, #x); \
+	exit(1); \
+}
+
+/* feed text in pieces of step bytes (all at once if 0), with parse_ex()
+ * or validate(), until it is done. The error and the offsets are
+ * recorded in res.
+ */
+struct result {
+	enum fjson_tokener_error err;
+	int calls;
+	int offset;		/**< char_offset after the last call */
+};
+
+static void
+feed(struct fjson_tokener *const tok, const char *const text, const int len, const int step,
+	const int validate, struct result *const res)
+{
+	int pos = 0;
+
+	fjson_tokener_reset(tok);
+	res->calls = 0;
+	do {
+		const int n = (step == 0 || len - pos < step) ? len - pos : step;
+		if (validate) {
+			CHK(fjson_tokener_validate(tok, text + pos, n) == fjson_tokener_get_error(tok));
+		} else {
+			fjson_object_put(fjson_tokener_parse_ex(tok, text + pos, n));
+		}
+		res->offset = tok->char_offset;
+		++res->calls;
+		pos += n;
+	} while (fjson_tokener_get_error(tok) == fjson_tokener_continue && pos < len);
+	res->err = fjson_tokener_get_error(tok);
+}
+
+static void
+check_ex(const char *const text, const int len, const int flags, const int depth)
+{
+	static const int steps[] = { 0, 1, 2, 7 };
+	struct fjson_tokener *const tok = fjson_tokener_new_ex(depth);
+	size_t i;
+
+	CHK(tok != NULL);
+	fjson_tokener_set_flags(tok, flags);
+	for (i = 0 ; i < sizeof(steps) / sizeof(steps[0]) ; ++i) {
+		struct result parsed, validated;
+		feed(tok, text, len, steps[i], 0, &parsed);
+		feed(tok, text, len, steps[i], 1, &validated);
+		if (parsed.err != validated.err || parsed.calls != validated.calls
+		    || parsed.offset != validated.offset) {
+			printf("%s (flags %d, depth %d, steps of %d): validate() stopped with %d "
+				"at %d after %d calls, parse_ex() with %d at %d after %d\n",
+				text, flags, depth, steps[i], (int) validated.err, validated.offset,
+				validated.calls, (int) parsed.err, parsed.offset, parsed.calls);
+			exit(1);
+		}
+	}
+	/* NUL-terminated */
+	if ((int) strlen(text) == len) {
+		enum fjson_tokener_error err;
+		int offset;
+		fjson_tokener_reset(tok);
+		fjson_object_put(fjson_tokener_parse_ex(tok, text, -1));
+		err = fjson_tokener_get_error(tok);
+		offset = tok->char_offset;
+		fjson_tokener_reset(tok);
+		CHK(fjson_tokener_validate(tok, text, -1) == err);
+		CHK(tok->char_offset == offset);
+	}
+	fjson_tokener_free(tok);
+}
+
+static void
+test_texts(void)
+{
+	static const char *const texts[] = {
+		"null", "true", "false", "TRUE", "nul", "nulx", "NaN", "nan", "Infinity",
+		"-Infinity", "-infinity", "infinitx", "0", "-0", "123", "01", "-", "1.", "1.5",
+		"1.5.5", "1e5", "1e", "1e+5", "1e5e5", "1-1", "12345678901234567890",
+		"\"\"", "\"abc\"", "'abc'", "\"a\\\"b\"", "\"\\\\\\/\\b\\f\\n\\r\\t\"", "\"\\x\"",
+		"\"\\u00e4\\u20ac\"", "\"\\ud83d\\ude00\"", "\"\\ud800\"", "\"\\ud800x\"",
+		"\"\\udc00\"", "\"\\u12\"", "\"\\u12g4\"", "\"open", "\"raw\tcontrol\x01\"",
+		"[]", "[1,2,3]", "[1,2,]", "[,]", "[1 2]", "[1", "[", "]", "[[[[[]]]]]",
+		"[[[[[1]]]]]", "{}", "{\"a\":1}", "{\"a\":1,}", "{\"a\" 1}", "{\"a\":}",
+		"{'a':1}", "{a:1}", "{\"a\":1 \"b\":2}", "{\"a\":{\"b\":{\"c\":[{}]}}}",
+		"{\"k\\u00e4y\\n\":\"v\\t\"}", "{\"a\":[1,{\"b\":null}],\"c\":\"d\"}",
+		"/* comment */ [1]", "[1] // comment\n", "/x", "/* open", "[1] x", "[1]]",
+		"  [ 1 , \"two\" , { \"three\" : 3.0 } ]  ", "{\"a\":1}{\"b\":2}", "1 2",
+		"\"a string long enough to need more room than the printbuf has initially, "
+			"and with an escape: \\n, so that it would be copied\"",
+	};
+	static const int flags[] = { 0, FJSON_TOKENER_STRICT };
+	size_t i, f;
+	int depth;
+
+	for (i = 0 ; i < sizeof(texts) / sizeof(texts[0]) ; ++i) {
+		for (f = 0 ; f < sizeof(flags) / sizeof(flags[0]) ; ++f) {
+			for (depth = 1 ; depth <= 6 ; ++depth)
+				check_ex(texts[i], (int) strlen(texts[i]), flags[f], depth);
+			check_ex(texts[i], (int) strlen(texts[i]), flags[f], FJSON_TOKENER_DEFAULT_DEPTH);
+		}
+	}
+	check_ex("\"a\0b\"", 5, 0, FJSON_TOKENER_DEFAULT_DEPTH);
+	check_ex("[1]\0", 4, FJSON_TOKENER_STRICT, FJSON_TOKENER_DEFAULT_DEPTH);
+	check_ex("[1\0]", 4, 0, FJSON_TOKENER_DEFAULT_DEPTH);
+}
+
+/* no allocation, no events */
+
+static int nallocs;
+
+static void *
+t_malloc(const size_t size)
+{
+	++nallocs;
+	return malloc(size);
+}
+
+static void *
+t_realloc(void *const ptr, const size_t size)
+{
+	++nallocs;
+	return realloc(ptr, size);
+}
+
+static int nevents;
+
+static int
+on_event(void __attribute__((unused)) *const ctx)
+{
+	++nevents;
+	return 0;
+}
+
+static int
+on_string(void __attribute__((unused)) *const ctx, const char __attribute__((unused)) *const s,
+	const int __attribute__((unused)) len)
+{
+	++nevents;
+	return 0;
+}
+
+static void
+test_quiet(void)
+{
+	static const struct fjson_tokener_callbacks cb = {
+		.start_object = on_event, .start_array = on_event, .key = on_string,
+		.string = on_string, .null = on_event
+	};
+	struct fjson_tokener *const tok = fjson_tokener_new();
+	char text[8192];
+	int len = 0, i;
+
+	CHK(tok != NULL);
+	len += snprintf(text + len, sizeof(text) - len, "[");
+	for (i = 0 ; i < 40 ; ++i) {
+		len += snprintf(text + len, sizeof(text) - len,
+			"%s{\"a key that is longer than the printbuf \\u00e4 is %d\":"
+			"\"and a value \\\"with\\\" escapes, \\u20ac, which is long as well\","
+			"\"n\":[null,true,-12.5e3,12345678901234567890]}",
+			(i > 0) ? "," : "", i);
+	}
+	len += snprintf(text + len, sizeof(text) - len, "]");
+	CHK(len < (int) sizeof(text) - 1);
+
+	fjson_global_set_allocator(t_malloc, t_realloc, free);
+	CHK(fjson_tokener_validate(tok, text, len) == fjson_tokener_success);
+	CHK(tok->char_offset == len);
+	/* also when fed in pieces */
+	fjson_tokener_reset(tok);
+	for (i = 0 ; i < len ; i += 3)
+		fjson_tokener_validate(tok, text + i, (len - i < 3) ? len - i : 3);
+	CHK(fjson_tokener_get_error(tok) == fjson_tokener_success);
+	fjson_global_set_allocator(NULL, NULL, NULL);
+	CHK(nallocs == 0);
+
+	/* event handlers are left alone, and still work afterwards */
+	fjson_tokener_set_callbacks(tok, &cb, NULL);
+	CHK(fjson_tokener_validate(tok, text, len) == fjson_tokener_success);
+	CHK(nevents == 0);
+	fjson_tokener_reset(tok);
+	CHK(fjson_tokener_parse_ex(tok, text, len) == NULL);
+	CHK(fjson_tokener_get_error(tok) == fjson_tokener_success);
+	CHK(nevents > 0);
+	fjson_tokener_free(tok);
+}
+
+int
+main(int __attribute__((unused)) argc, char __attribute__((unused)) **argv)
+{
+	test_texts();
+	test_quiet();
+	printf("OK\n");
+	return 0;
+}
@@ -0,0 +1,119 @@
+/* libfastjson testbench tool
+ *
+ * checks that FJSON_TOKENER_ZERO_COPY makes long unescaped strings
+ * reference the input buffer and that fjson_object_materialize()
+ * detaches them from it again.
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See COPYING for details.
+ *
+ */
+#include "config.h"
+
+#include "../json.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CHK(x) if (!(x)) { \
+	printf("%s:%d: unexpected result with '%s'\n", \
+		__FILE__, __LINE__, #x); \
+	exit(1); \
+}
+
+static const char *input =
+	"{ \"long\": \"a string which is too long to be stored directly\",\n"
+	"  \"short\": \"inline\", \"num\": \"12345678901234567890123456789012\",\n"
+	"  \"esc\": \"a string which has an \\\"escape\\\" sequence in it\",\n"
+	"  \"arr\": [ \"another string which is too long for the object\" ] }";
+
+static struct fjson_object *
+parse(struct fjson_tokener *const tok, const char *const buf, int len)
+{
+	struct fjson_object *jso;
+	fjson_tokener_reset(tok);
+	jso = fjson_tokener_parse_ex(tok, buf, len);
+	CHK(jso != NULL);
+	CHK(fjson_tokener_get_error(tok) == fjson_tokener_success);
+	return jso;
+}
+
+/* overwrite all lowercase letters "too" in buf with "TOO" */
+static void
+scribble(char *buf)
+{
+	while ((buf = strstr(buf, "too")) != NULL)
+		memcpy(buf, "TOO", 3);
+}
+
+int main(int __attribute__((unused)) argc, char __attribute__((unused)) **argv)
+{
+	struct fjson_tokener *const tok = fjson_tokener_new();
+	const size_t len = strlen(input);
+	char *const buf = malloc(len + 1);
+	struct fjson_object *jso, *val;
+
+	CHK(tok != NULL);
+	CHK(buf != NULL);
+	fjson_tokener_set_flags(tok, FJSON_TOKENER_ZERO_COPY);
+
+	/* long strings must see changes to the buffer, all others not */
+	memcpy(buf, input, len + 1);
+	jso = parse(tok, buf, (int) len);
+	scribble(buf);
+	printf("referenced: %s\n", fjson_object_to_json_string(jso));
+	CHK(fjson_object_object_get_ex(jso, "num", &val));
+	CHK(fjson_object_get_int64(val) == INT64_MAX);
+	CHK(fjson_object_get_double(val) == 12345678901234567890123456789012.0);
+
+	/* fjson_object_get_string() must return a terminated copy */
+	CHK(fjson_object_object_get_ex(jso, "long", &val));
+	CHK(fjson_object_get_string_len(val) == 48);
+	CHK(strlen(fjson_object_get_string(val)) == 48);
+	CHK(fjson_object_get_string(val) < buf || fjson_object_get_string(val) > buf + len);
+
+	/* after materialize, the buffer is no longer needed */
+	CHK(fjson_object_materialize(jso) == 0);
+	memset(buf, 'x', len);
+	printf("materialized: %s\n", fjson_object_to_json_string(jso));
+	fjson_object_put(jso);
+
+	/* a string split across calls must be copied */
+	memcpy(buf, input, len + 1);
+	fjson_tokener_reset(tok);
+	CHK(fjson_tokener_parse_ex(tok, buf, 20) == NULL);
+	CHK(fjson_tokener_get_error(tok) == fjson_tokener_continue);
+	jso = fjson_tokener_parse_ex(tok, buf + 20, (int) len - 20);
+	CHK(jso != NULL);
+	scribble(buf);
+	printf("split: %s\n", fjson_object_to_json_string(jso));
+	fjson_object_put(jso);
+
+	/* zero-copy strings in an arena */
+	{
+		struct fjson_arena *const arena = fjson_arena_new(0);
+		CHK(arena != NULL);
+		fjson_tokener_set_arena(tok, arena);
+		memcpy(buf, input, len + 1);
+		jso = parse(tok, buf, (int) len);
+		CHK(fjson_object_materialize(jso) == 0);
+		scribble(buf);
+		printf("arena: %s\n", fjson_object_to_json_string(jso));
+		fjson_tokener_set_arena(tok, NULL);
+		fjson_arena_free(arena);
+	}
+
+	/* without the flag, nothing is referenced */
+	fjson_tokener_set_flags(tok, 0);
+	memcpy(buf, input, len + 1);
+	jso = parse(tok, buf, (int) len);
+	scribble(buf);
+	printf("copied: %s\n", fjson_object_to_json_string(jso));
+	fjson_object_put(jso);
+
+	fjson_tokener_free(tok);
+	free(buf);
+	printf("OK\n");
+	return 0;
+}